@@ -26,6 +26,8 @@
 #include <QMap>
 #include <QRegularExpression>
 #include <QStringList>
+#include <QThread>
+#include <algorithm>
 
 #include "ImageId.h"
 #include "version.h"
@@ -194,6 +196,8 @@ CommandLine::setup()
     m_deskewAngle = fetchDeskewAngle();
     m_startFilterIdx = fetchStartFilterIdx();
     m_endFilterIdx = fetchEndFilterIdx();
+    m_threads = fetchThreads();
+    m_tiffCompression = fetchTiffCompression();
 }
 
 
@@ -260,6 +264,10 @@ CommandLine::printHelp()
     std::cout << "\t--depth-perception=<1.0...3.0>\t\t-- default: 2.0" << "\n";
     std::cout << "\t--start-filter=<1...6>\t\t\t-- default: 4" << "\n";
     std::cout << "\t--end-filter=<1...6>\t\t\t-- default: 6" << "\n";
+    std::cout << "\t--threads=<number>\t\t\t-- pages processed in parallel; 0: all cores. default: 1" << "\n";
+    std::cout << "\t--pipeline\t\t\t\t-- run each page through all filters in one pass" << "\n";
+    std::cout << "\t--tiff-compression=<none|lzw|deflate|zstd|packbits>[:<level>]\n\t\t\t\t\t\t-- codec for color and gray output; default: lzw" << "\n";
+    std::cout << "\t--profile=<file.json>\t\t\t-- write per page and per step timings as a Chrome trace" << "\n";
     std::cout << "\t--output-project=, -o=<project_name>" << "\n";
     std::cout << "\t--stylesheet=<path_to_stylesheets.qss>" << "\n";
     std::cout << "\n";
@@ -481,6 +489,35 @@ CommandLine::fetchEndFilterIdx()
     return m_options["end-filter"].toInt() - 1;
 }
 
+int
+CommandLine::fetchThreads()
+{
+    if (!hasThreads())
+        return 1;
+
+    int threads = m_options["threads"].toInt();
+    if (threads <= 0)
+        threads = QThread::idealThreadCount();
+
+    return std::max(1, threads);
+}
+
+TiffCompression
+CommandLine::fetchTiffCompression()
+{
+    if (!hasTiffCompression())
+        return TiffCompression();
+
+    QString const compression = m_options["tiff-compression"];
+    if (!TiffCompression::isValid(compression))
+    {
+        std::cout << "Wrong tiff compression " << compression.toLocal8Bit().constData() << "\n";
+        exit(1);
+    }
+
+    return TiffCompression(compression);
+}
+
 #if 0
 output::DewarpingMode
 CommandLine::fetchDewarpingMode()
@@ -33,6 +33,7 @@
 #include "stages/page_layout/Alignment.h"
 #include "ImageFileInfo.h"
 #include "RelativeMargins.h"
+#include "TiffCompression.h"
 #include "Despeckle.h"
 
 /**
@@ -157,6 +158,22 @@ public:
     {
         return contains("dewarping");
     }
+    bool hasThreads() const
+    {
+        return contains("threads");
+    }
+    bool isPipelined() const
+    {
+        return contains("pipeline");
+    }
+    bool hasProfile() const
+    {
+        return contains("profile");
+    }
+    bool hasTiffCompression() const
+    {
+        return contains("tiff-compression");
+    }
 
     page_split::LayoutType getLayout() const
     {
@@ -206,6 +223,18 @@ public:
     {
         return m_endFilterIdx;
     }
+    int getThreads() const
+    {
+        return m_threads;
+    }
+    QString profileFile() const
+    {
+        return m_options.value("profile");
+    }
+    TiffCompression getTiffCompression() const
+    {
+        return m_tiffCompression;
+    }
     //output::DewarpingMode getDewarpingMode() const { return m_dewarpingMode; }
     //output::DespeckleLevel getDespeckleLevel() const { return m_despeckleLevel; }
     //output::DepthPerception getDepthPerception() const { return m_depthPerception; }
@@ -257,6 +286,8 @@ private:
     double m_deskewAngle;
     int m_startFilterIdx;
     int m_endFilterIdx;
+    int m_threads;
+    TiffCompression m_tiffCompression;
     //output::DewarpingMode m_dewarpingMode;
     //output::DespeckleLevel m_despeckleLevel;
     //output::DepthPerception m_depthPerception;
@@ -277,6 +308,8 @@ private:
     double fetchDeskewAngle();
     int fetchStartFilterIdx();
     int fetchEndFilterIdx();
+    int fetchThreads();
+    TiffCompression fetchTiffCompression();
     //output::DewarpingMode fetchDewarpingMode();
     //output::DespeckleLevel fetchDespeckleLevel();
     //output::DepthPerception fetchDepthPerception();
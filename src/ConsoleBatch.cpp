@@ -19,7 +19,10 @@
 */
 
 #include <vector>
+#include <string>
 #include <iostream>
+#include <stdexcept>
+#include <algorithm>
 #include <assert.h>
 
 #include "Utils.h"
@@ -40,6 +43,8 @@
 #include "ProjectReader.h"
 #include "OrthogonalRotation.h"
 #include "SelectedPage.h"
+#include "ProcessingProfiler.h"
+#include "ParallelFor.h"
 #include "acceleration/DefaultAccelerationProvider.h"
 
 #include "stages/fix_orientation/Settings.h"
@@ -71,12 +76,18 @@
 #include <QMap>
 #include <QDomDocument>
 #include <QCoreApplication>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QMutex>
+#include <QMutexLocker>
 
 #include "ConsoleBatch.h"
 #include "CommandLine.h"
 
 ConsoleBatch::ConsoleBatch(std::vector<ImageFileInfo> const& images, QString const& output_directory, Qt::LayoutDirection const layout)
     :   batch(true), debug(true),
+        m_threads(CommandLine::get().getThreads()),
         m_pAccelerationProvider(new DefaultAccelerationProvider(QCoreApplication::instance())),
         m_ptrDisambiguator(new FileNameDisambiguator),
         m_ptrPages(new ProjectPages(images, ProjectPages::AUTO_PAGES, layout))
@@ -90,6 +101,7 @@ ConsoleBatch::ConsoleBatch(std::vector<ImageFileInfo> const& images, QString con
 
 ConsoleBatch::ConsoleBatch(QString const project_file)
     :   batch(true), debug(true),
+        m_threads(CommandLine::get().getThreads()),
         m_pAccelerationProvider(new DefaultAccelerationProvider(QCoreApplication::instance()))
 {
     QFile file(project_file);
@@ -127,6 +139,26 @@ ConsoleBatch::ConsoleBatch(QString const project_file)
 }
 
 
+namespace
+{
+
+QString pageLabel(PageInfo const& page)
+{
+    QString label(page.imageId().filePath());
+    if (page.imageId().isMultiPageFile())
+    {
+        label += QString(" #%1").arg(page.imageId().page());
+    }
+    if (page.id().subPage() != PageId::SINGLE_PAGE)
+    {
+        label += QString(" (%1)").arg(PageId::subPageToString(page.id().subPage()));
+    }
+    return label;
+}
+
+} // anonymous namespace
+
+
 BackgroundTaskPtr
 ConsoleBatch::createCompositeTask(
     PageInfo const& page,
@@ -222,22 +254,187 @@ ConsoleBatch::process()
         endFilterIdx = ef;
     }
 
-    for (int j=startFilterIdx; j<=endFilterIdx; j++)
+    if (cli.isPipelined())
+    {
+        processPipelined(startFilterIdx, endFilterIdx);
+        return;
+    }
+
+    processFilters(startFilterIdx, endFilterIdx);
+}
+
+void
+ConsoleBatch::processFilters(int const start_filter_idx, int const end_filter_idx)
+{
+    CommandLine const& cli = CommandLine::get();
+
+    for (int j=start_filter_idx; j<=end_filter_idx; j++)
     {
         if (cli.isVerbose())
             std::cout << "Filter: " << (j+1) << "\n";
 
         PageSequence page_sequence = m_ptrPages->toPageSequence(PAGE_VIEW);
         setupFilter(j, page_sequence.selectAll());
-        for (unsigned i=0; i<page_sequence.numPages(); i++)
+        processPages(page_sequence, j);
+    }
+}
+
+// Every composite task runs all the filters up to its last one, so a single
+// pass with the end filter does the work of the whole filter-by-filter sweep,
+// decoding each image once instead of once per filter.
+void
+ConsoleBatch::processPipelined(int const start_filter_idx, int const end_filter_idx)
+{
+    CommandLine const& cli = CommandLine::get();
+
+    // A few filters have to see every page before the following ones may run.
+    // page_split may split spreads into sub-pages, which changes the set of
+    // pages the following filters work on.  The output filter needs the
+    // aggregate content size, which is only final once page_layout has seen
+    // every page.
+    std::vector<int> segment_ends;
+    int const split_idx = m_ptrStages->pageSplitFilterIdx();
+    if (start_filter_idx <= split_idx && end_filter_idx > split_idx)
+    {
+        segment_ends.push_back(split_idx);
+    }
+    int const layout_idx = m_ptrStages->pageLayoutFilterIdx();
+    if (start_filter_idx <= layout_idx && end_filter_idx > layout_idx)
+    {
+        segment_ends.push_back(layout_idx);
+    }
+    segment_ends.push_back(end_filter_idx);
+
+    int segment_start = start_filter_idx;
+    for (int const segment_end : segment_ends)
+    {
+        if (cli.isVerbose())
+            std::cout << "Filters: " << (segment_start+1) << ".." << (segment_end+1) << "\n";
+
+        // Rebuilt for each segment, as page_split may have changed the pages.
+        PageSequence page_sequence = m_ptrPages->toPageSequence(PAGE_VIEW);
+        std::set<PageId> const all_pages(page_sequence.selectAll());
+        for (int j=segment_start; j<=segment_end; j++)
         {
-            PageInfo page = page_sequence.pageAt(i);
+            setupFilter(j, all_pages);
+        }
+
+        processPages(page_sequence, segment_end);
+        segment_start = segment_end + 1;
+    }
+}
+
+void
+ConsoleBatch::processPages(PageSequence const& pages, int const last_filter_idx)
+{
+    CommandLine const& cli = CommandLine::get();
+
+    // Pages and parallelFor() helpers share the same thread budget.
+    // Without --threads, pages go one by one and parallelFor() may use all cores.
+    if (cli.hasThreads())
+    {
+        setParallelForThreadLimit(m_threads);
+    }
+
+    if (m_threads <= 1)
+    {
+        ParallelForWorkerScope const worker_scope;
+        for (unsigned i=0; i<pages.numPages(); i++)
+        {
+            PageInfo page = pages.pageAt(i);
             if (cli.isVerbose())
                 std::cout << "\tProcessing: " << page.imageId().filePath().toLocal8Bit().constData() << "\n";
-            BackgroundTaskPtr bgTask = createCompositeTask(page, j);
+            BackgroundTaskPtr bgTask = createCompositeTask(page, last_filter_idx);
+            ProfileScope const profile_scope("page", "page", pageLabel(page));
             (*bgTask)();
         }
+        return;
     }
+
+    // The first exception thrown by a worker, to be rethrown from here.
+    struct Failure
+    {
+        QMutex mutex;
+        std::string what;
+        bool failed = false;
+    } failure;
+
+    class Runnable : public QRunnable
+    {
+    public:
+        Runnable(BackgroundTaskPtr const& task, QString const& page, QSemaphore& free_slots, Failure& failure)
+            : m_ptrTask(task), m_page(page), m_rFreeSlots(free_slots), m_rFailure(failure)
+        {
+            setAutoDelete(true);
+        }
+
+        virtual void run() override
+        {
+            ParallelForWorkerScope const worker_scope;
+            try
+            {
+                ProfileScope const profile_scope("page", "page", m_page);
+                (*m_ptrTask)();
+            }
+            catch (std::exception const& e)
+            {
+                QMutexLocker const locker(&m_rFailure.mutex);
+                if (!m_rFailure.failed)
+                {
+                    m_rFailure.failed = true;
+                    m_rFailure.what = e.what();
+                }
+            }
+
+            // Drop the task (and the images it holds) before
+            // letting the next page in.
+            m_ptrTask.reset();
+            m_rFreeSlots.release();
+        }
+    private:
+        BackgroundTaskPtr m_ptrTask;
+        QString m_page;
+        QSemaphore& m_rFreeSlots;
+        Failure& m_rFailure;
+    };
+
+    int const num_threads = m_threads;
+    QThreadPool pool;
+    pool.setMaxThreadCount(num_threads);
+
+    // Limits the number of pages in flight, and therefore memory usage.
+    QSemaphore free_slots(num_threads);
+
+    for (unsigned i=0; i<pages.numPages(); i++)
+    {
+        free_slots.acquire();
+        {
+            QMutexLocker const locker(&failure.mutex);
+            if (failure.failed)
+            {
+                free_slots.release();
+                break;
+            }
+        }
+
+        PageInfo page = pages.pageAt(i);
+        if (cli.isVerbose())
+            std::cout << "\tProcessing: " << page.imageId().filePath().toLocal8Bit().constData() << "\n";
+
+        // Tasks are created on this thread, as createCompositeTask() isn't reentrant.
+        pool.start(new Runnable(createCompositeTask(page, last_filter_idx), pageLabel(page), free_slots, failure));
+    }
+
+    pool.waitForDone();
+
+    if (failure.failed)
+        throw std::runtime_error(failure.what);
+}
+
+void
+ConsoleBatch::setThreads(int const threads)
+{
+    m_threads = std::max(1, threads);
 }
 
 void
@@ -264,9 +461,14 @@ ConsoleBatch::setupFilter(int idx, std::set<PageId> allPages)
 #if 0
     else if (idx == m_ptrStages->pageLayoutFilterIdx())
         setupPageLayout(allPages);
+#endif
     else if (idx == m_ptrStages->outputFilterIdx())
+    {
+        setupOutputFile();
+#if 0
         setupOutput(allPages);
 #endif
+    }
 }
 
 
@@ -372,6 +574,17 @@ ConsoleBatch::setupSelectContent(std::set<PageId> allPages)
     }
 }
 
+void
+ConsoleBatch::setupOutputFile()
+{
+    CommandLine const& cli = CommandLine::get();
+
+    if (cli.hasTiffCompression())
+    {
+        m_ptrStages->outputFilter()->getSettings()->setTiffCompression(cli.getTiffCompression());
+    }
+}
+
 #if 0
 void
 ConsoleBatch::setupPageLayout(std::set<PageId> allPages)
@@ -30,6 +30,7 @@
 #include "OutputFileNameGenerator.h"
 #include "PageId.h"
 #include "PageInfo.h"
+#include "PageSequence.h"
 #include "PageView.h"
 #include "ProjectPages.h"
 #include "ImageFileInfo.h"
@@ -54,9 +55,23 @@ public:
     void process();
     void saveProject(QString const project_file);
 
+    /**
+     * \brief Runs filters \p start_filter_idx .. \p end_filter_idx
+     *        over all pages, one filter at a time.
+     */
+    void processFilters(int start_filter_idx, int end_filter_idx);
+
+    /**
+     * \brief Sets the number of pages processed in parallel.
+     *
+     * Defaults to the one given on the command line.
+     */
+    void setThreads(int threads);
+
 private:
     bool batch;
     bool debug;
+    int m_threads;
     DefaultAccelerationProvider* m_pAccelerationProvider;
     IntrusivePtr<FileNameDisambiguator> m_ptrDisambiguator;
     IntrusivePtr<ProjectPages> m_ptrPages;
@@ -70,6 +85,7 @@ private:
     void setupPageSplit(std::set<PageId> allPages);
     void setupDeskew(std::set<PageId> allPages);
     void setupSelectContent(std::set<PageId> allPages);
+    void setupOutputFile();
     void setupPageLayout(std::set<PageId> allPages);
     void setupOutput(std::set<PageId> allPages);
 
@@ -77,6 +93,25 @@ private:
         PageInfo const& page,
         int const last_filter_idx
     );
+
+    /**
+     * \brief Runs composite tasks up to \p last_filter_idx for every page.
+     *
+     * With more than one thread requested on the command line, pages
+     * are processed concurrently, with no more pages in flight than
+     * there are threads.  Returns when all pages are done, which makes
+     * it a barrier for filters that depend on all pages (page_layout).
+     */
+    void processPages(PageSequence const& pages, int last_filter_idx);
+
+    /**
+     * \brief Runs every page through all the filters in one go.
+     *
+     * Pages are synchronized after page_split, which may split spreads
+     * into sub-pages, and before the output filter, which depends on
+     * page_layout having processed all pages.
+     */
+    void processPipelined(int start_filter_idx, int end_filter_idx);
 };
 
 #endif
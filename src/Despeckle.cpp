@@ -20,7 +20,6 @@
 #include <stdint.h>
 #include <assert.h>
 #include <vector>
-#include <map>
 #include <cmath>
 #include <limits>
 #include <algorithm>
@@ -29,10 +28,12 @@
 #include <QImage>
 #include <QSize>
 #include <QDebug>
+#include <QThreadPool>
 #include "Despeckle.h"
 #include "TaskStatus.h"
 #include "DebugImages.h"
 #include "FastQueue.h"
+#include "ParallelFor.h"
 #include "imageproc/BinaryImage.h"
 #include "imageproc/ConnectivityMap.h"
 #include "imageproc/Connectivity.h"
@@ -69,6 +70,11 @@ namespace
 static int const VERTICAL_SCALE = 2;
 static int const VERTICAL_SCALE_SQ = VERTICAL_SCALE * VERTICAL_SCALE;
 
+/**
+ * The minimum number of rows per thread when processing rows in parallel.
+ */
+static int const MIN_ROWS_PER_BAND = 64;
+
 struct Settings
 {
     /**
@@ -271,23 +277,204 @@ struct Connection
             greater_label = lbl1;
         }
     }
+};
 
-    bool operator<(Connection const& rhs) const
+/**
+ * \brief Maps connections to the minimum squared distance between
+ *        the connected components.
+ *
+ * This is an open addressing hash table with linear probing.  A noisy page
+ * produces millions of updates, most of them for connections already present,
+ * so an update must not allocate and should touch as little memory as possible.
+ * clear() keeps the storage, which allows reusing it across pages.
+ */
+class ConnectionTable
+{
+public:
+    struct Entry
     {
-        if (lesser_label < rhs.lesser_label)
+        uint32_t lesser_label; /**< 0 for unused entries. */
+        uint32_t greater_label;
+        uint32_t sqdist;
+    };
+
+    ConnectionTable() : m_size(0), m_shift(64) {}
+
+    /**
+     * \brief Removes all connections.
+     *
+     * Storage is kept, unless there is more of it than we are willing
+     * to hold on to between pages.
+     */
+    void clear();
+
+    /**
+     * \brief If the connection didn't exist, create it,
+     *        otherwise update the minimum distance.
+     */
+    void updateDistance(uint32_t label1, uint32_t label2, uint32_t sqdist);
+
+    /**
+     * \brief Adds connections from another table, keeping the minimum distances.
+     */
+    void merge(ConnectionTable const& other);
+
+    /**
+     * \brief Calls \p visitor(Entry const&) for every connection, in no particular order.
+     *
+     * The order depends on the capacity of the table and on how it was filled.
+     */
+    template<typename Visitor>
+    void visit(Visitor visitor) const;
+
+    /**
+     * \brief Returns all connections, ordered by (lesser_label, greater_label).
+     */
+    std::vector<Entry> sortedEntries() const;
+private:
+    /**
+     * Storage beyond this number of entries is released by clear().
+     */
+    static size_t const MAX_RETAINED_ENTRIES = size_t(1) << 21;
+
+    static size_t const MIN_ENTRIES = size_t(1) << 12;
+
+    size_t slotFor(uint32_t lesser_label, uint32_t greater_label) const
+    {
+        // Fibonacci hashing: take the top bits of the product.
+        uint64_t const key = (uint64_t(lesser_label) << 32) | greater_label;
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> m_shift);
+    }
+
+    void grow();
+
+    std::vector<Entry> m_entries;
+    size_t m_size;
+    int m_shift; /**< 64 - log2(m_entries.size()) */
+};
+
+void
+ConnectionTable::clear()
+{
+    if (m_entries.size() > MAX_RETAINED_ENTRIES)
+    {
+        std::vector<Entry>().swap(m_entries);
+        m_shift = 64;
+    }
+    else if (m_size != 0)
+    {
+        Entry const unused = { 0, 0, 0 };
+        std::fill(m_entries.begin(), m_entries.end(), unused);
+    }
+    m_size = 0;
+}
+
+void
+ConnectionTable::updateDistance(uint32_t label1, uint32_t label2, uint32_t const sqdist)
+{
+    // Keep the load factor at or below 1/2.
+    if ((m_size + 1) * 2 > m_entries.size())
+    {
+        grow();
+    }
+
+    Connection const conn(label1, label2);
+    size_t const mask = m_entries.size() - 1;
+    for (size_t idx = slotFor(conn.lesser_label, conn.greater_label);; idx = (idx + 1) & mask)
+    {
+        Entry& entry = m_entries[idx];
+        if (entry.lesser_label == conn.lesser_label && entry.greater_label == conn.greater_label)
         {
-            return true;
+            if (sqdist < entry.sqdist)
+            {
+                entry.sqdist = sqdist;
+            }
+            return;
         }
-        else if (lesser_label > rhs.lesser_label)
+        else if (entry.lesser_label == 0)
         {
-            return false;
+            entry.lesser_label = conn.lesser_label;
+            entry.greater_label = conn.greater_label;
+            entry.sqdist = sqdist;
+            ++m_size;
+            return;
         }
-        else
+    }
+}
+
+std::vector<ConnectionTable::Entry>
+ConnectionTable::sortedEntries() const
+{
+    std::vector<Entry> entries;
+    entries.reserve(m_size);
+    visit([&entries](Entry const& entry)
+    {
+        entries.push_back(entry);
+    });
+
+    std::sort(entries.begin(), entries.end(), [](Entry const& lhs, Entry const& rhs)
+    {
+        if (lhs.lesser_label != rhs.lesser_label)
         {
-            return greater_label < rhs.greater_label;
+            return lhs.lesser_label < rhs.lesser_label;
+        }
+        return lhs.greater_label < rhs.greater_label;
+    });
+
+    return entries;
+}
+
+void
+ConnectionTable::merge(ConnectionTable const& other)
+{
+    other.visit([this](Entry const& entry)
+    {
+        updateDistance(entry.lesser_label, entry.greater_label, entry.sqdist);
+    });
+}
+
+template<typename Visitor>
+void
+ConnectionTable::visit(Visitor visitor) const
+{
+    for (Entry const& entry : m_entries)
+    {
+        if (entry.lesser_label != 0)
+        {
+            visitor(entry);
         }
     }
-};
+}
+
+void
+ConnectionTable::grow()
+{
+    std::vector<Entry> old_entries;
+    old_entries.swap(m_entries);
+
+    size_t const new_size = old_entries.empty() ? MIN_ENTRIES : old_entries.size() * 2;
+    Entry const unused = { 0, 0, 0 };
+    m_entries.resize(new_size, unused);
+    m_shift = 64;
+    for (size_t sz = new_size; sz > 1; sz >>= 1)
+    {
+        --m_shift;
+    }
+
+    size_t const mask = new_size - 1;
+    for (Entry const& entry : old_entries)
+    {
+        if (entry.lesser_label != 0)
+        {
+            size_t idx = slotFor(entry.lesser_label, entry.greater_label);
+            while (m_entries[idx].lesser_label != 0)
+            {
+                idx = (idx + 1) & mask;
+            }
+            m_entries[idx] = entry;
+        }
+    }
+}
 
 /**
  * \brief A directional assiciation between two connected components.
@@ -321,28 +508,6 @@ struct TargetSourceConn
     }
 };
 
-/**
- * \brief If the association didn't exist, create it,
- *        otherwise the minimum distance.
- */
-void updateDistance(
-    std::map<Connection, uint32_t>& conns,
-    uint32_t label1, uint32_t label2, uint32_t sqdist)
-{
-    typedef std::map<Connection, uint32_t> Connections;
-
-    Connection const conn(label1, label2);
-    Connections::iterator it(conns.lower_bound(conn));
-    if (it == conns.end() || conn < it->first)
-    {
-        conns.insert(Connections::value_type(conn, sqdist));
-    }
-    else if (sqdist < it->second)
-    {
-        it->second = sqdist;
-    }
-}
-
 /**
  * \brief Tag the source component with ANCHORED_TO_SMALL, ANCHORED_TO_BIG
  *        or none of the above.
@@ -732,7 +897,7 @@ void voronoiSpecial(ConnectivityMap& cmap, std::vector<Distance>& dist, Distance
 void voronoiDistances(
     ConnectivityMap const& cmap,
     std::vector<Distance> const& distance_matrix,
-    std::map<Connection, uint32_t>& conns)
+    ConnectionTable& conns)
 {
     int const width = cmap.size().width();
     int const height = cmap.size().height();
@@ -741,36 +906,65 @@ void voronoiDistances(
 
     uint32_t const* const cmap_data = cmap.data();
     Distance const* const distance_data = &distance_matrix[0] + width + 3;
-    for (int y = 0, offset = 0; y < height; ++y, offset += 2)
+
+    // Each band of rows collects connections into its own table.  As merging
+    // keeps the minimum distance, the set of connections and their distances
+    // don't depend on the split, though the order of the table does.
+    int const num_bands = std::max(
+                              1, std::min(QThreadPool::globalInstance()->maxThreadCount(),
+                                          height / MIN_ROWS_PER_BAND)
+                          );
+    int const band_height = (height + num_bands - 1) / num_bands;
+    std::vector<ConnectionTable> band_conns(num_bands - 1);
+
+    // Chunks are bands rather than rows, so that each chunk knows its band
+    // without relying on how parallelFor() splits the range.
+    parallelFor(0, num_bands, 1, [&](int const band_begin, int const band_end)
     {
-        for (int x = 0; x < width; ++x, ++offset)
+        for (int band = band_begin; band < band_end; ++band)
         {
-            uint32_t const label = cmap_data[offset];
-            assert(label != 0);
+            ConnectionTable& table = band == 0 ? conns : band_conns[band - 1];
+            int const y_begin = band * band_height;
+            int const y_end = std::min(height, y_begin + band_height);
 
-            int const x1 = x + distance_data[offset].vec.x;
-            int const y1 = y + distance_data[offset].vec.y;
-
-            for (int i = 0; i < 4; ++i)
+            int offset = y_begin * (width + 2);
+            for (int y = y_begin; y < y_end; ++y, offset += 2)
             {
-                int const nbh_offset = offset + offsets[i];
-                uint32_t const nbh_label = cmap_data[nbh_offset];
-                if (nbh_label == 0 || nbh_label == label)
+                for (int x = 0; x < width; ++x, ++offset)
                 {
-                    // label 0 can be encountered in
-                    // padding lines.
-                    continue;
-                }
+                    uint32_t const label = cmap_data[offset];
+                    assert(label != 0);
 
-                int const x2 = x + distance_data[nbh_offset].vec.x;
-                int const y2 = y + distance_data[nbh_offset].vec.y;
-                int const dx = x1 - x2;
-                int const dy = y1 - y2;
-                uint32_t const sqdist = dx * dx + dy * dy;
+                    int const x1 = x + distance_data[offset].vec.x;
+                    int const y1 = y + distance_data[offset].vec.y;
 
-                updateDistance(conns, label, nbh_label, sqdist);
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        int const nbh_offset = offset + offsets[i];
+                        uint32_t const nbh_label = cmap_data[nbh_offset];
+                        if (nbh_label == 0 || nbh_label == label)
+                        {
+                            // label 0 can be encountered in
+                            // padding lines.
+                            continue;
+                        }
+
+                        int const x2 = x + distance_data[nbh_offset].vec.x;
+                        int const y2 = y + distance_data[nbh_offset].vec.y;
+                        int const dx = x1 - x2;
+                        int const dy = y1 - y2;
+                        uint32_t const sqdist = dx * dx + dy * dy;
+
+                        table.updateDistance(label, nbh_label, sqdist);
+                    }
+                }
             }
         }
+    });
+
+    for (ConnectionTable const& table : band_conns)
+    {
+        conns.merge(table);
     }
 }
 
@@ -862,15 +1056,17 @@ Despeckle::despeckleInPlace(
     uint32_t const max_label = next_avail_component - 1;
 
     // Remapping individual pixels.
-    cmap_line = cmap_data;
-    for (int y = 0; y < height; ++y)
+    parallelFor(0, height, MIN_ROWS_PER_BAND, [&](int const y_begin, int const y_end)
     {
-        for (int x = 0; x < width; ++x)
+        uint32_t* line = cmap_data + y_begin * cmap_stride;
+        for (int y = y_begin; y < y_end; ++y, line += cmap_stride)
         {
-            cmap_line[x] = remapping_table[cmap_line[x]];
+            for (int x = 0; x < width; ++x)
+            {
+                line[x] = remapping_table[line[x]];
+            }
         }
-        cmap_line += cmap_stride;
-    }
+    });
     if (dbg)
     {
         dbg->add(cmap.visualized(), "big_components_unified");
@@ -893,22 +1089,25 @@ Despeckle::despeckleInPlace(
     // Now build a bidirectional map of distances between neighboring
     // connected components.
 
-    typedef std::map<Connection, uint32_t> Connections; // conn -> sqdist
-    Connections conns;
+    // The table is per thread and reused for subsequent pages.
+    static thread_local ConnectionTable conns;
+    conns.clear();
 
     voronoiDistances(cmap, distance_matrix, conns);
 
     status.throwIfCancelled();
 
     // Tag connected components with ANCHORED_TO_BIG or ANCHORED_TO_SMALL.
-    BOOST_FOREACH(Connections::value_type const& pair, conns)
+    // Tags live in the top bits of num_pixels, which tagSourceComponent()
+    // compares, so the result depends on the order of connections.  We follow
+    // the (lesser_label, greater_label) order rather than the one of the hash
+    // table, which depends on its capacity and on how the bands were split.
+    for (ConnectionTable::Entry const& conn : conns.sortedEntries())
     {
-        Connection const conn(pair.first);
-        uint32_t const sqdist = pair.second;
         Component& comp1 = components[conn.lesser_label];
         Component& comp2 = components[conn.greater_label];
-        tagSourceComponent(comp1, comp2, sqdist, settings);
-        tagSourceComponent(comp2, comp1, sqdist, settings);
+        tagSourceComponent(comp1, comp2, conn.sqdist, settings);
+        tagSourceComponent(comp2, comp1, conn.sqdist, settings);
     }
 
     // Prevent it from growing when we compute the Voronoi diagram
@@ -998,26 +1197,24 @@ Despeckle::despeckleInPlace(
     // Build a directional connection map and only include
     // good connections, that is those with a small enough
     // distance.
-    // While at it, clear the bidirectional connection map.
+    // Then clear the bidirectional connection map.
     std::vector<TargetSourceConn> target_source;
-    while (!conns.empty())
+    conns.visit([&components, &settings, &target_source](ConnectionTable::Entry const& conn)
     {
-        Connections::iterator const it(conns.begin());
-        uint32_t const label1 = it->first.lesser_label;
-        uint32_t const label2 = it->first.greater_label;
-        uint32_t const sqdist = it->second;
+        uint32_t const label1 = conn.lesser_label;
+        uint32_t const label2 = conn.greater_label;
         Component const& comp1 = components[label1];
         Component const& comp2 = components[label2];
-        if (canBeAttachedTo(comp1, comp2, sqdist, settings))
+        if (canBeAttachedTo(comp1, comp2, conn.sqdist, settings))
         {
             target_source.push_back(TargetSourceConn(label2, label1));
         }
-        if (canBeAttachedTo(comp2, comp1, sqdist, settings))
+        if (canBeAttachedTo(comp2, comp1, conn.sqdist, settings))
         {
             target_source.push_back(TargetSourceConn(label1, label2));
         }
-        conns.erase(it);
-    }
+    });
+    conns.clear();
 
     std::sort(target_source.begin(), target_source.end());
 
@@ -1074,19 +1271,23 @@ Despeckle::despeckleInPlace(
 
     // Remove unmarked components from the binary image.
     uint32_t const msb = uint32_t(1) << 31;
-    uint32_t* image_line = image.data();
+    uint32_t* const image_data = image.data();
     int const image_stride = image.wordsPerLine();
-    cmap_line = cmap_data;
-    for (int y = 0; y < height; ++y)
+    parallelFor(0, height, MIN_ROWS_PER_BAND, [&](int const y_begin, int const y_end)
     {
-        for (int x = 0; x < width; ++x)
+        uint32_t* image_line = image_data + y_begin * image_stride;
+        uint32_t const* line = cmap_data + y_begin * cmap_stride;
+        for (int y = y_begin; y < y_end; ++y)
         {
-            if (!components[cmap_line[x]].anchoredToBig())
+            for (int x = 0; x < width; ++x)
             {
-                image_line[x >> 5] &= ~(msb >> (x & 31));
+                if (!components[line[x]].anchoredToBig())
+                {
+                    image_line[x >> 5] &= ~(msb >> (x & 31));
+                }
             }
+            image_line += image_stride;
+            line += cmap_stride;
         }
-        image_line += image_stride;
-        cmap_line += cmap_stride;
-    }
+    });
 }
@@ -18,6 +18,7 @@
 
 #include "ImageId.h"
 #include <QFileInfo>
+#include <QHash>
 
 ImageId::ImageId(QString const& file_path, int const page)
     :	m_filePath(file_path),
@@ -54,3 +55,8 @@ bool operator<(ImageId const& lhs, ImageId const& rhs)
     }
     return lhs.page() < rhs.page();
 }
+
+uint qHash(ImageId const& image_id)
+{
+    return static_cast<uint>(qHash(image_id.filePath())) ^ static_cast<uint>(image_id.page());
+}
@@ -80,5 +80,6 @@ private:
 bool operator==(ImageId const& lhs, ImageId const& rhs);
 bool operator!=(ImageId const& lhs, ImageId const& rhs);
 bool operator<(ImageId const& lhs, ImageId const& rhs);
+uint qHash(ImageId const& image_id);
 
 #endif
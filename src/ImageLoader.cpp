@@ -20,9 +20,13 @@
 #include "TiffReader.h"
 #include "ImageId.h"
 #include <QImage>
+#include <QImageReader>
+#include <QImageIOHandler>
+#include <QSize>
 #include <QString>
 #include <QIODevice>
 #include <QFile>
+#include <algorithm>
 
 QImage
 ImageLoader::load(ImageId const& image_id)
@@ -59,3 +63,64 @@ ImageLoader::load(QIODevice& io_dev, int const page_num)
     image.load(&io_dev, 0);
     return image;
 }
+
+QImage
+ImageLoader::loadDownscaled(ImageId const& image_id, QSize const& target_size)
+{
+    QFile file(image_id.filePath());
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return QImage();
+    }
+    return loadDownscaled(file, image_id.zeroBasedPage(), target_size);
+}
+
+QImage
+ImageLoader::loadDownscaled(QIODevice& io_dev, int const page_num, QSize const& target_size)
+{
+    if (TiffReader::canRead(io_dev))
+    {
+        return TiffReader::readDownscaledImage(io_dev, page_num, target_size);
+    }
+
+    if (page_num != 0)
+    {
+        // Qt can only load the first page of multi-page images.
+        return QImage();
+    }
+
+    QImageReader reader(&io_dev);
+    QSize const image_size(reader.size());
+    if (image_size.isValid() && !target_size.isEmpty()
+            && reader.supportsOption(QImageIOHandler::ScaledSize))
+    {
+        int downscale = std::min(
+            image_size.width() / target_size.width(),
+            image_size.height() / target_size.height()
+        );
+        if (reader.format() == "jpeg")
+        {
+            // libjpeg only scales by powers of two during decoding.
+            // Other factors would cost an additional resampling pass.
+            int pow2 = 1;
+            while (pow2 < 8 && pow2 * 2 <= downscale)
+            {
+                pow2 *= 2;
+            }
+            downscale = pow2;
+        }
+        if (downscale > 1)
+        {
+            reader.setScaledSize(
+                QSize(
+                    (image_size.width() + downscale - 1) / downscale,
+                    (image_size.height() + downscale - 1) / downscale
+                )
+            );
+        }
+    }
+
+    QImage image;
+    reader.read(&image);
+    return image;
+}
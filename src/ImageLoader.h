@@ -21,6 +21,7 @@
 
 class ImageId;
 class QImage;
+class QSize;
 class QString;
 class QIODevice;
 
@@ -32,6 +33,23 @@ public:
     static QImage load(ImageId const& image_id);
 
     static QImage load(QIODevice& io_dev, int page_num);
+
+    /**
+     * \brief Loads the image at a reduced resolution, where that makes
+     *        decoding cheaper.
+     *
+     * \param target_size The size the caller is going to scale the image to.
+     *        The resulting image won't be smaller than that, unless the
+     *        original one is.
+     *
+     * TIFF images are subsampled while decoding, and JPEG ones are decoded
+     * at 1/2, 1/4 or 1/8 scale by libjpeg.  Formats whose decoders can't
+     * skip any work are loaded at full resolution, leaving the scaling
+     * to the caller.
+     */
+    static QImage loadDownscaled(ImageId const& image_id, QSize const& target_size);
+
+    static QImage loadDownscaled(QIODevice& io_dev, int page_num, QSize const& target_size);
 };
 
 #endif
@@ -0,0 +1,125 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ImagePyramid.h"
+#include "imageproc/AffineTransform.h"
+#include "acceleration/AcceleratableOperations.h"
+#include <Qt>
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+
+using namespace imageproc;
+
+ImagePyramid::ImagePyramid(
+    QImage const& image, std::shared_ptr<AcceleratableOperations> const& accel_ops)
+    :	m_image(image),
+      m_ptrAccelOps(accel_ops),
+      m_maxLevel(0)
+{
+    while ((image.width() >> (m_maxLevel + 1)) >= MIN_LEVEL_SIZE &&
+            (image.height() >> (m_maxLevel + 1)) >= MIN_LEVEL_SIZE)
+    {
+        ++m_maxLevel;
+    }
+
+    m_levels.resize(m_maxLevel + 1);
+    m_levels[0] = image;
+    m_levelsBuilt.reset(new std::once_flag[m_maxLevel + 1]);
+}
+
+int
+ImagePyramid::levelFor(double const scale) const
+{
+    if (scale >= 1.0)
+    {
+        return 0;
+    }
+
+    int const level = (int)floor(-log2(scale) + 1e-9);
+    return std::min(level, m_maxLevel);
+}
+
+QImage
+ImagePyramid::level(int const level)
+{
+    assert(level >= 0 && level <= m_maxLevel);
+
+    if (level == 0)
+    {
+        return m_image;
+    }
+
+    // No lock is held while building, so building one level
+    // doesn't hold up those asking for the levels already built.
+    std::call_once(m_levelsBuilt[level], [this, level]()
+    {
+        // Each level is a 2x downscale of the previous one,
+        // which is both cheaper and smoother than a single big step.
+        QImage const prev(this->level(level - 1));
+        QSize const size(levelSize(level));
+
+        QTransform xform;
+        xform.scale(
+            (double)size.width() / prev.width(),
+            (double)size.height() / prev.height()
+        );
+
+        m_levels[level] = m_ptrAccelOps->affineTransform(
+                              prev, xform, QRect(QPoint(0, 0), size),
+                              OutsidePixels::assumeColor(Qt::white)
+                          );
+    });
+
+    return m_levels[level];
+}
+
+QTransform
+ImagePyramid::levelToImage(int const level) const
+{
+    QSize const size(levelSize(level));
+    return QTransform().scale(
+               (double)m_image.width() / size.width(),
+               (double)m_image.height() / size.height()
+           );
+}
+
+QSize
+ImagePyramid::levelSize(int const level) const
+{
+    return QSize(
+               std::max(1, m_image.width() >> level),
+               std::max(1, m_image.height() >> level)
+           );
+}
+
+QRect
+ImagePyramid::tilesCovering(QRectF const& rect, int const tile_size)
+{
+    if (rect.isEmpty())
+    {
+        return QRect();
+    }
+
+    // floor() rather than a cast, which would round negative
+    // coordinates towards zero.
+    return QRect(
+               QPoint((int)floor(rect.left() / tile_size), (int)floor(rect.top() / tile_size)),
+               QPoint((int)ceil(rect.right() / tile_size) - 1, (int)ceil(rect.bottom() / tile_size) - 1)
+           );
+}
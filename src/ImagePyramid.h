@@ -0,0 +1,103 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGE_PYRAMID_H_
+#define IMAGE_PYRAMID_H_
+
+#include "NonCopyable.h"
+#include <QImage>
+#include <QRect>
+#include <QRectF>
+#include <QTransform>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class AcceleratableOperations;
+
+/**
+ * \brief A mipmap pyramid of an image, with levels built on demand.
+ *
+ * Level 0 is the original image.  Each next level is half the size
+ * of the previous one.  Levels are built lazily and kept for the
+ * lifetime of the object.  All methods are thread-safe.
+ */
+class ImagePyramid
+{
+    DECLARE_NON_COPYABLE(ImagePyramid)
+public:
+    ImagePyramid(QImage const& image,
+                 std::shared_ptr<AcceleratableOperations> const& accel_ops);
+
+    QImage const& image() const
+    {
+        return m_image;
+    }
+
+    int maxLevel() const
+    {
+        return m_maxLevel;
+    }
+
+    /**
+     * \brief Returns the coarsest level that still has at least \p scale
+     *        times the resolution of the original image.
+     */
+    int levelFor(double scale) const;
+
+    /**
+     * \brief Returns the image of the given level, building it if necessary.
+     *
+     * Each level is built once.  Threads asking for a level being built
+     * wait for it, while other levels stay available.
+     */
+    QImage level(int level);
+
+    /**
+     * \brief Maps the pixels of the given level to the pixels
+     *        of the original image.
+     */
+    QTransform levelToImage(int level) const;
+
+    /**
+     * \brief Returns the range of square tiles covering \p rect.
+     *
+     * Tile (x, y) covers the pixels from x * tile_size to
+     * (x + 1) * tile_size - 1 horizontally, and the same vertically.
+     * \p rect may extend beyond the image, in which case the range
+     * includes tiles with negative or out of range coordinates.
+     * An empty \p rect gives an empty range.
+     */
+    static QRect tilesCovering(QRectF const& rect, int tile_size);
+private:
+    QSize levelSize(int level) const;
+
+    enum { MIN_LEVEL_SIZE = 32 };
+
+    QImage const m_image;
+    std::shared_ptr<AcceleratableOperations> const m_ptrAccelOps;
+    int m_maxLevel;
+    std::vector<QImage> m_levels;
+
+    /**
+     * m_levelsBuilt[level] guards the building of m_levels[level].
+     */
+    std::unique_ptr<std::once_flag[]> m_levelsBuilt;
+};
+
+#endif
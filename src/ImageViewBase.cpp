@@ -17,6 +17,7 @@
 */
 
 #include "ImageViewBase.h"
+#include "ImagePyramid.h"
 #include "NonCopyable.h"
 #include "ImagePresentation.h"
 #include "OpenGLSupport.h"
@@ -47,6 +48,7 @@
 #include <Qt>
 #include <QDebug>
 #include <algorithm>
+#include <tuple>
 #include <assert.h>
 #include <math.h>
 
@@ -57,17 +59,32 @@
 
 using namespace imageproc;
 
-class ImageViewBase::HqTransformTask :
+namespace
+{
+
+/**
+ * The width and height of a high quality tile, in pixels.
+ */
+int const TILE_SIZE = 256;
+
+/**
+ * The capacity of the tile cache, in kilobytes.
+ */
+int const TILE_CACHE_KB = 64 * 1024;
+
+} // anonymous namespace
+
+class ImageViewBase::TileTask :
     public AbstractCommand0<IntrusivePtr<AbstractCommand0<void> > >,
     public QObject
 {
-    DECLARE_NON_COPYABLE(HqTransformTask)
+    DECLARE_NON_COPYABLE(TileTask)
 public:
-    HqTransformTask(
+    TileTask(
         ImageViewBase* image_view,
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
-        QImage const& image, QTransform const& xform,
-        QRect const& target_rect);
+        std::shared_ptr<ImagePyramid> const& pyramid,
+        TileKey const& key, QTransform const& image_to_tile);
 
     void cancel()
     {
@@ -84,9 +101,9 @@ private:
     class Result : public AbstractCommand0<void>
     {
     public:
-        Result(ImageViewBase* image_view);
+        Result(ImageViewBase* image_view, TileKey const& key);
 
-        void setData(QImage const& hq_image);
+        void setData(QImage const& tile);
 
         void cancel()
         {
@@ -109,15 +126,16 @@ private:
         virtual void operator()();
     private:
         QPointer<ImageViewBase> m_ptrImageView;
-        QImage m_hqImage;
+        TileKey m_key;
+        QImage m_tile;
         QAtomicInt m_cancelFlag;
     };
 
     std::shared_ptr<AcceleratableOperations> m_ptrAccelOps;
+    std::shared_ptr<ImagePyramid> m_ptrPyramid;
     IntrusivePtr<Result> m_ptrResult;
-    QImage m_image;
-    QTransform m_xform;
-    QRect m_targetRect;
+    QTransform m_imageToTile;
+    QRect m_tileRect;
 };
 
 
@@ -170,6 +188,9 @@ ImageViewBase::ImageViewBase(
     ImagePresentation const& presentation, QMarginsF const& margins)
     :	m_ptrAccelOps(accel_ops),
       m_image(image),
+      m_ptrPyramid(new ImagePyramid(image, accel_ops)),
+      m_tileCache(TILE_CACHE_KB),
+      m_requestedTileLevel(0),
       m_virtualImageCropArea(presentation.cropArea()),
       m_virtualDisplayArea(presentation.displayArea()),
       m_imageToVirtual(presentation.transform()),
@@ -240,7 +261,7 @@ ImageViewBase::ImageViewBase(
     m_timer.setInterval(150); // msec
     connect(
         &m_timer, SIGNAL(timeout()),
-        this, SLOT(initiateBuildingHqVersion())
+        this, SLOT(requestMissingTiles())
     );
 
     updateWidgetTransformAndFixFocalPoint(CENTER_IF_FITS);
@@ -258,6 +279,7 @@ ImageViewBase::ImageViewBase(
 
 ImageViewBase::~ImageViewBase()
 {
+    cancelTileRequests();
 }
 
 void
@@ -267,14 +289,11 @@ ImageViewBase::hqTransformSetEnabled(bool const enabled)
     {
         // Turning off.
         m_hqTransformEnabled = false;
-        if (m_ptrHqTransformTask.get())
-        {
-            m_ptrHqTransformTask->cancel();
-            m_ptrHqTransformTask.reset();
-        }
-        if (!m_hqPixmap.isNull())
+        m_timer.stop();
+        cancelTileRequests();
+        if (!m_tileCache.isEmpty())
         {
-            m_hqPixmap = QPixmap();
+            m_tileCache.clear();
             update();
         }
     }
@@ -512,21 +531,13 @@ ImageViewBase::paintEvent(QPaintEvent* event)
     // Disable pixmap antialiasing for large zoom levels.
     painter.setRenderHint(QPainter::SmoothPixmapTransform, pixel_width < 0.5);
 
-    if (validateHqPixmap())
+    int const tile_level = currentTileLevel();
+    if (m_hqTransformEnabled && tilesCached(tile_level))
     {
-        // HQ pixmap maps one to one to screen pixels, so antialiasing is not necessary.
-        painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
-
-        QPainterPath clip_path;
-        clip_path.addPolygon(m_virtualToWidget.map(m_virtualImageCropArea));
-        painter.setClipPath(clip_path);
-
-        painter.drawPixmap(m_hqPixmapPos, m_hqPixmap);
+        drawTiles(painter, tile_level);
     }
     else
     {
-        scheduleHqVersionRebuild();
-
         QTransform const pixmap_to_virtual(m_pixmapToImage * m_imageToVirtual);
         painter.setWorldTransform(pixmap_to_virtual * m_virtualToWidget);
 
@@ -535,6 +546,16 @@ ImageViewBase::paintEvent(QPaintEvent* event)
         painter.setClipPath(clip_path);
 
         PixmapRenderer::drawPixmap(painter, m_pixmap);
+
+        if (m_hqTransformEnabled)
+        {
+            // Cover what we can with the tiles of neighbouring levels,
+            // coarser ones first, then the tiles we've got for the current one.
+            drawTiles(painter, tile_level + 1);
+            drawTiles(painter, tile_level - 1);
+            drawTiles(painter, tile_level);
+            scheduleTileRequests(tile_level);
+        }
     }
 
     painter.restore();
@@ -1102,99 +1123,220 @@ ImageViewBase::setWidgetFocalPointWithoutMoving(QPointF const new_widget_fp)
                          );
 }
 
-/**
- * Returns true if m_hqPixmap is valid and up to date.
- */
-bool
-ImageViewBase::validateHqPixmap() const
+double
+ImageViewBase::levelScale(int const level)
 {
-    if (!m_hqTransformEnabled)
-    {
-        return false;
-    }
+    return pow(2.0, -0.5 * level);
+}
 
-    if (m_hqPixmap.isNull())
+int
+ImageViewBase::currentTileLevel() const
+{
+    double const zoom = sqrt(fabs(m_virtualToWidget.determinant()));
+    if (!(zoom > 0.0))
     {
-        return false;
+        return 0;
     }
 
-    if (m_hqSourceId != m_image.cacheKey())
+    // The coarsest level that still has at least the on-screen resolution.
+    int const level = (int)floor(-2.0 * log2(zoom) + 1e-9);
+    return qBound(-16, level, 64);
+}
+
+ImageViewBase::TileKey
+ImageViewBase::tileKey(int const level, int const x, int const y) const
+{
+    TileKey key;
+    key.m11 = m_imageToVirtual.m11();
+    key.m12 = m_imageToVirtual.m12();
+    key.m21 = m_imageToVirtual.m21();
+    key.m22 = m_imageToVirtual.m22();
+    key.level = level;
+    key.x = x;
+    key.y = y;
+    return key;
+}
+
+QTransform
+ImageViewBase::imageToTileSpace(int const level) const
+{
+    double const scale = levelScale(level);
+    return QTransform(
+               m_imageToVirtual.m11() * scale, m_imageToVirtual.m12() * scale,
+               m_imageToVirtual.m21() * scale, m_imageToVirtual.m22() * scale,
+               0.0, 0.0
+           );
+}
+
+QRect
+ImageViewBase::visibleTileRange(int const level) const
+{
+    QRectF const widget_rect(
+        m_virtualToWidget.map(m_virtualImageCropArea).boundingRect()
+        .intersected(QRectF(viewport()->rect()))
+    );
+    if (widget_rect.isEmpty())
     {
-        return false;
+        return QRect();
     }
 
-    if (m_hqXform != m_imageToVirtual * m_virtualToWidget)
+    QTransform const widget_to_tile_space(
+        widgetToImage() * imageToTileSpace(level)
+    );
+    return ImagePyramid::tilesCovering(widget_to_tile_space.mapRect(widget_rect), TILE_SIZE);
+}
+
+bool
+ImageViewBase::tilesCached(int const level) const
+{
+    QRect const range(visibleTileRange(level));
+    for (int y = range.top(); y <= range.bottom(); ++y)
     {
-        return false;
+        for (int x = range.left(); x <= range.right(); ++x)
+        {
+            if (!m_tileCache.contains(tileKey(level, x, y)))
+            {
+                return false;
+            }
+        }
     }
-
     return true;
 }
 
 void
-ImageViewBase::scheduleHqVersionRebuild()
+ImageViewBase::drawTiles(QPainter& painter, int const level)
 {
-    QTransform const xform(m_imageToVirtual * m_virtualToWidget);
+    QRect const range(visibleTileRange(level));
+
+    painter.save();
+
+    // Tiles are drawn in widget coordinates, so set up clipping there.
+    painter.setWorldTransform(QTransform());
+    QPainterPath clip_path;
+    clip_path.addPolygon(m_virtualToWidget.map(m_virtualImageCropArea));
+    painter.setClipPath(clip_path);
+
+    QTransform tile_to_widget(imageToTileSpace(level).inverted() * imageToWidget());
+    if (fabs(tile_to_widget.m11() - 1.0) < 1e-6 && fabs(tile_to_widget.m22() - 1.0) < 1e-6)
+    {
+        // Tiles map one to one to screen pixels.  Keep them sharp.
+        tile_to_widget = QTransform().translate(
+                             qRound(tile_to_widget.dx()), qRound(tile_to_widget.dy())
+                         );
+        painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+    }
+    else
+    {
+        painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+    }
+    painter.setWorldTransform(tile_to_widget);
 
-    if (!m_timer.isActive() || m_potentialHqXform != xform)
+    for (int y = range.top(); y <= range.bottom(); ++y)
     {
-        if (m_ptrHqTransformTask.get())
+        for (int x = range.left(); x <= range.right(); ++x)
         {
-            m_ptrHqTransformTask->cancel();
-            m_ptrHqTransformTask.reset();
+            if (QPixmap const* tile = m_tileCache.object(tileKey(level, x, y)))
+            {
+                painter.drawPixmap(QPointF(x * TILE_SIZE, y * TILE_SIZE), *tile);
+            }
         }
-        m_potentialHqXform = xform;
     }
-    m_timer.start();
+
+    painter.restore();
 }
 
 void
-ImageViewBase::initiateBuildingHqVersion()
+ImageViewBase::scheduleTileRequests(int const level)
 {
-    if (validateHqPixmap())
+    if (level != m_requestedTileLevel)
     {
+        // The zoom has moved to another level.  Give it time to settle
+        // before rendering tiles that may never be displayed.
+        m_requestedTileLevel = level;
+        cancelTileRequests();
+        m_timer.start();
         return;
     }
 
-    m_hqPixmap = QPixmap();
+    if (!m_timer.isActive())
+    {
+        requestMissingTiles();
+    }
+}
 
-    if (m_ptrHqTransformTask.get())
+void
+ImageViewBase::requestMissingTiles()
+{
+    if (!m_hqTransformEnabled)
     {
-        m_ptrHqTransformTask->cancel();
-        m_ptrHqTransformTask.reset();
+        return;
     }
 
-    QTransform const xform(m_imageToVirtual * m_virtualToWidget);
-    QRect const target_rect(
-        m_virtualToWidget.map(m_virtualImageCropArea)
-        .boundingRect().toAlignedRect().intersected(this->rect())
-    );
+    int const level = currentTileLevel();
+    QRect const range(visibleTileRange(level));
+    m_requestedTileLevel = level;
 
-    IntrusivePtr<HqTransformTask> const task(
-        new HqTransformTask(this, m_ptrAccelOps, m_image, xform, target_rect)
-    );
+    // Cancel the tiles that are no longer visible.
+    std::map<TileKey, IntrusivePtr<TileTask> >::iterator it(m_pendingTiles.begin());
+    while (it != m_pendingTiles.end())
+    {
+        TileKey const& key = it->first;
+        if (key == tileKey(level, key.x, key.y) && range.contains(key.x, key.y))
+        {
+            ++it;
+        }
+        else
+        {
+            it->second->cancel();
+            m_pendingTiles.erase(it++);
+        }
+    }
 
-    backgroundExecutor().enqueueTask(task);
+    QTransform const image_to_tile(imageToTileSpace(level));
+    for (int y = range.top(); y <= range.bottom(); ++y)
+    {
+        for (int x = range.left(); x <= range.right(); ++x)
+        {
+            TileKey const key(tileKey(level, x, y));
+            if (m_tileCache.contains(key) || m_pendingTiles.find(key) != m_pendingTiles.end())
+            {
+                continue;
+            }
 
-    m_ptrHqTransformTask = task;
-    m_hqXform = xform;
-    m_hqPixmapPos = target_rect.topLeft();
-    m_hqSourceId = m_image.cacheKey();
+            IntrusivePtr<TileTask> const task(
+                new TileTask(this, m_ptrAccelOps, m_ptrPyramid, key, image_to_tile)
+            );
+            backgroundExecutor().enqueueTask(task);
+            m_pendingTiles.insert(std::make_pair(key, task));
+        }
+    }
+}
+
+void
+ImageViewBase::cancelTileRequests()
+{
+    for (auto const& kv : m_pendingTiles)
+    {
+        kv.second->cancel();
+    }
+    m_pendingTiles.clear();
 }
 
 /**
- * Gets called from HqTransformationTask::Result.
+ * Gets called from TileTask::Result.
  */
 void
-ImageViewBase::hqVersionBuilt(QImage const& image)
+ImageViewBase::tileBuilt(TileKey const& key, QImage const& image)
 {
+    m_pendingTiles.erase(key);
+
     if (!m_hqTransformEnabled)
     {
         return;
     }
 
-    m_hqPixmap = QPixmap::fromImage(image);
-    m_ptrHqTransformTask.reset();
+    int const cost = std::max(1, image.bytesPerLine() * image.height() / 1024);
+    m_tileCache.insert(key, new QPixmap(QPixmap::fromImage(image)), cost);
     update();
 }
 
@@ -1235,32 +1377,60 @@ ImageViewBase::backgroundExecutor()
 }
 
 
-/*==================== ImageViewBase::HqTransformTask ======================*/
+/*======================== ImageViewBase::TileKey ========================*/
+
+bool
+ImageViewBase::TileKey::operator==(TileKey const& other) const
+{
+    return x == other.x && y == other.y && level == other.level
+           && m11 == other.m11 && m12 == other.m12
+           && m21 == other.m21 && m22 == other.m22;
+}
 
-ImageViewBase::HqTransformTask::HqTransformTask(
+bool
+ImageViewBase::TileKey::operator<(TileKey const& other) const
+{
+    return std::tie(level, y, x, m11, m12, m21, m22)
+           < std::tie(other.level, other.y, other.x, other.m11, other.m12, other.m21, other.m22);
+}
+
+
+/*======================= ImageViewBase::TileTask =========================*/
+
+ImageViewBase::TileTask::TileTask(
     ImageViewBase* image_view,
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
-    QImage const& image, QTransform const& xform,
-    QRect const& target_rect)
+    std::shared_ptr<ImagePyramid> const& pyramid,
+    TileKey const& key, QTransform const& image_to_tile)
     :	m_ptrAccelOps(accel_ops),
-      m_ptrResult(new Result(image_view)),
-      m_image(image),
-      m_xform(xform),
-      m_targetRect(target_rect)
+      m_ptrPyramid(pyramid),
+      m_ptrResult(new Result(image_view, key)),
+      m_imageToTile(image_to_tile),
+      m_tileRect(key.x * TILE_SIZE, key.y * TILE_SIZE, TILE_SIZE, TILE_SIZE)
 {
 }
 
 IntrusivePtr<AbstractCommand0<void> >
-ImageViewBase::HqTransformTask::operator()()
+ImageViewBase::TileTask::operator()()
 {
     if (isCancelled())
     {
         return IntrusivePtr<AbstractCommand0<void> >();
     }
 
-    QImage hq_image(
+    // Render from the smallest pyramid level that still has enough resolution.
+    double const scale = sqrt(fabs(m_imageToTile.determinant()));
+    int const level = m_ptrPyramid->levelFor(scale);
+    QImage const source(m_ptrPyramid->level(level));
+
+    if (isCancelled())
+    {
+        return IntrusivePtr<AbstractCommand0<void> >();
+    }
+
+    QImage tile(
         m_ptrAccelOps->affineTransform(
-            m_image, m_xform, m_targetRect,
+            source, m_ptrPyramid->levelToImage(level) * m_imageToTile, m_tileRect,
             OutsidePixels::assumeColor(Qt::transparent), QSizeF(0.0, 0.0)
         )
     );
@@ -1270,42 +1440,43 @@ ImageViewBase::HqTransformTask::operator()()
         return IntrusivePtr<AbstractCommand0<void> >();
     }
 
-    // In many cases m_image and therefore hq_image are grayscale with
-    // a palette, but given that hq_image will be converted to a QPixmap
+    // In many cases the source and therefore the tile are grayscale with
+    // a palette, but given that the tile will be converted to a QPixmap
     // on the GUI thread, it's better to convert it to RGB as a preparation
     // step while we are still in a background thread.
-    hq_image = hq_image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    tile = tile.convertToFormat(QImage::Format_ARGB32_Premultiplied);
 
     if (isCancelled())
     {
         return IntrusivePtr<AbstractCommand0<void> >();
     }
 
-    m_ptrResult->setData(hq_image);
+    m_ptrResult->setData(tile);
     return m_ptrResult;
 }
 
 
-/*================ ImageViewBase::HqTransformTask::Result ================*/
+/*==================== ImageViewBase::TileTask::Result ====================*/
 
-ImageViewBase::HqTransformTask::Result::Result(
-    ImageViewBase* image_view)
-    :	m_ptrImageView(image_view)
+ImageViewBase::TileTask::Result::Result(
+    ImageViewBase* image_view, TileKey const& key)
+    :	m_ptrImageView(image_view),
+      m_key(key)
 {
 }
 
 void
-ImageViewBase::HqTransformTask::Result::setData(QImage const& hq_image)
+ImageViewBase::TileTask::Result::setData(QImage const& tile)
 {
-    m_hqImage = hq_image;
+    m_tile = tile;
 }
 
 void
-ImageViewBase::HqTransformTask::Result::operator()()
+ImageViewBase::TileTask::Result::operator()()
 {
     if (m_ptrImageView && !isCancelled())
     {
-        m_ptrImageView->hqVersionBuilt(m_hqImage);
+        m_ptrImageView->tileBuilt(m_key, m_tile);
     }
 }
 
@@ -30,6 +30,7 @@
 #include <QEnterEvent>
 #endif
 #include <QTimer>
+#include <QCache>
 #include <QWidget>
 #include <QAbstractScrollArea>
 #include <QPixmap>
@@ -42,10 +43,12 @@
 #include <QRectF>
 #include <QMarginsF>
 #include <Qt>
+#include <map>
 #include <memory>
 
 class QPainter;
 class BackgroundExecutor;
+class ImagePyramid;
 class ImagePresentation;
 class AcceleratableOperations;
 
@@ -63,6 +66,15 @@ class AcceleratableOperations;
  *     pre-transformed m_image the way we want.
  * \li Widget coordinates, where this->rect() is defined.
  *
+ * The high quality version of the image is rendered in tiles.  Tiles
+ * are rendered for discrete zoom levels spaced by a factor of sqrt(2),
+ * and a tile of the level closest to the current zoom (but not coarser
+ * than it) is drawn slightly downscaled.  Tiles are produced lazily
+ * on backgroundExecutor() from an ImagePyramid of the image, and kept
+ * in an LRU cache.  Panning therefore only renders newly exposed tiles,
+ * and zooming immediately shows the cached tiles of neighbouring levels
+ * until the tiles of the new level arrive.
+ *
  * \see m_pixmapToImage, m_imageToVirt, m_virtualToWidget, m_widgetToVirtual.
  */
 class ImageViewBase : public QAbstractScrollArea
@@ -318,13 +330,38 @@ protected:
      */
     QRectF maxViewportRect() const;
 private slots:
-    void initiateBuildingHqVersion();
+    void requestMissingTiles();
 
     void updateScrollBars();
 
     void reactToScrollBars();
 private:
-    class HqTransformTask;
+    /**
+     * \brief Identifies a high quality tile.
+     *
+     * Tiles live in tile space, which is virtual image space
+     * scaled by levelScale(level).  The linear part of m_imageToVirtual
+     * is part of the key, as tiles depend on it.
+     */
+    struct TileKey
+    {
+        qreal m11, m12, m21, m22;
+        int level;
+        int x;
+        int y;
+
+        bool operator==(TileKey const& other) const;
+
+        bool operator<(TileKey const& other) const;
+
+        friend uint qHash(TileKey const& key)
+        {
+            return static_cast<uint>(key.x) ^ (static_cast<uint>(key.y) << 12)
+                   ^ (static_cast<uint>(key.level) << 24);
+        }
+    };
+
+    class TileTask;
     class TempFocalPointAdjuster;
     class TransformChangeWatcher;
 
@@ -344,11 +381,41 @@ private:
 
     QPointF centeredWidgetFocalPoint() const;
 
-    bool validateHqPixmap() const;
+    static double levelScale(int level);
+
+    /**
+     * Returns the tile level matching the current zoom.
+     */
+    int currentTileLevel() const;
+
+    TileKey tileKey(int level, int x, int y) const;
+
+    /**
+     * Transformation from image coordinates to tile space of \p level.
+     */
+    QTransform imageToTileSpace(int level) const;
+
+    /**
+     * The range of tiles of \p level covering the visible part
+     * of the image.
+     */
+    QRect visibleTileRange(int level) const;
+
+    /**
+     * Returns true if all the visible tiles of \p level are in cache.
+     */
+    bool tilesCached(int level) const;
+
+    /**
+     * Draws the visible tiles of \p level that are in cache.
+     */
+    void drawTiles(QPainter& painter, int level);
+
+    void scheduleTileRequests(int level);
 
-    void scheduleHqVersionRebuild();
+    void cancelTileRequests();
 
-    void hqVersionBuilt(QImage const& image);
+    void tileBuilt(TileKey const& key, QImage const& image);
 
     void updateStatusTipAndCursor();
 
@@ -371,8 +438,8 @@ private:
     QImage m_image;
 
     /**
-     * This timer is used for delaying the construction of
-     * a high quality image version.
+     * This timer is used for delaying the requests of high quality
+     * tiles while zooming.
      */
     QTimer m_timer;
 
@@ -383,37 +450,26 @@ private:
     QPixmap m_pixmap;
 
     /**
-     * The high quality, pre-transformed version of m_pixmap.
-     */
-    QPixmap m_hqPixmap;
-
-    /**
-     * The position, in widget coordinates, where m_hqPixmap is to be drawn.
-     */
-    QPoint m_hqPixmapPos;
-
-    /**
-     * The transformation used to build m_hqPixmap.
-     * It's used to detect if m_hqPixmap needs to be rebuild.
+     * Downscaled versions of m_image, used as sources for tiles.
      */
-    QTransform m_hqXform;
+    std::shared_ptr<ImagePyramid> m_ptrPyramid;
 
     /**
-     * Used to check if we need to extend the delay before building m_hqPixmap.
+     * High quality tiles, least recently used ones get evicted first.
+     * The cost is measured in kilobytes.
      */
-    QTransform m_potentialHqXform;
+    QCache<TileKey, QPixmap> m_tileCache;
 
     /**
-     * The ID (QImage::cacheKey()) of the image that was used
-     * to build m_hqPixmap.  It's used to detect if m_hqPixmap
-     * needs to be rebuilt.
+     * Tiles being rendered in background.
      */
-    qint64 m_hqSourceId;
+    std::map<TileKey, IntrusivePtr<TileTask> > m_pendingTiles;
 
     /**
-     * The pending (if any) high quality transformation task.
+     * The tile level tiles were last requested for.  When the zoom moves
+     * to a different level, requesting tiles is delayed by m_timer.
      */
-    IntrusivePtr<HqTransformTask> m_ptrHqTransformTask;
+    int m_requestedTileLevel;
 
     /**
      * Transformation from m_pixmap coordinates to m_image coordinates.
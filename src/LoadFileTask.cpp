@@ -19,6 +19,7 @@
 #include "LoadFileTask.h"
 #include "CachingFactory.h"
 #include "TaskStatus.h"
+#include "ProcessingProfiler.h"
 #include "FilterResult.h"
 #include "ErrorWidget.h"
 #include "FilterUiInterface.h"
@@ -37,6 +38,7 @@
 #include <QDir>
 #include <QImage>
 #include <QString>
+#include <exception>
 #include <assert.h>
 
 class LoadFileTask::ErrorResult : public FilterResult
@@ -57,6 +59,26 @@ private:
 };
 
 
+class LoadFileTask::ImageSizeChangedException : public std::exception
+{
+public:
+    virtual char const* what() const throw()
+    {
+        return "LoadFileTask: image size changed";
+    }
+};
+
+
+class LoadFileTask::ImageLoadFailedException : public std::exception
+{
+public:
+    virtual char const* what() const throw()
+    {
+        return "LoadFileTask: image could not be loaded";
+    }
+};
+
+
 LoadFileTask::LoadFileTask(
     Type type, PageInfo const& page,
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
@@ -83,7 +105,34 @@ LoadFileTask::operator()()
 {
     using namespace imageproc;
 
-    QImage image(ImageLoader::load(m_pageId.imageId()));
+    // In batch mode, stages whose params are up to date don't look at the
+    // image at all.  If that holds for the whole chain, we avoid decoding it.
+    if (type() == BATCH && !m_imageMetadata.size().isEmpty())
+    {
+        try
+        {
+            return processLazily();
+        }
+        catch (ImageSizeChangedException const&)
+        {
+            // The file must have been replaced.  Fall through to
+            // eager processing that will update the stored size.
+        }
+        catch (ImageLoadFailedException const&)
+        {
+            return FilterResultPtr(new ErrorResult(m_pageId.imageId().filePath()));
+        }
+        catch (CancelledException const&)
+        {
+            return FilterResultPtr();
+        }
+    }
+
+    QImage image;
+    {
+        ProfileScope const profile_scope("io", "load", m_pageId.imageId().filePath());
+        image = ImageLoader::load(m_pageId.imageId());
+    }
 
     try
     {
@@ -99,7 +148,15 @@ LoadFileTask::operator()()
 
             // It's a good time to create a thumbnail if it's missing.
             AffineImageTransform const transform(image.size());
-            m_ptrThumbnailCache->ensureThumbnailExists(m_pageId, image, transform);
+            {
+                ProfileScope const profile_scope("io", "thumbnail");
+                m_ptrThumbnailCache->ensureThumbnailExists(m_pageId, image, transform);
+            }
+
+            CachingFactory<QImage> image_factory([image]()
+            {
+                return image;
+            });
 
             CachingFactory<GrayImage> gray_image_factory([image]()
             {
@@ -107,7 +164,7 @@ LoadFileTask::operator()()
             });
 
             return m_ptrNextTask->process(
-                       *this, m_ptrAccelOps, image, gray_image_factory, transform
+                       *this, m_ptrAccelOps, image_factory, gray_image_factory, transform
                    );
         }
     }
@@ -117,6 +174,68 @@ LoadFileTask::operator()()
     }
 }
 
+FilterResultPtr
+LoadFileTask::processLazily()
+{
+    using namespace imageproc;
+
+    ImageId const image_id(m_pageId.imageId());
+    QSize const expected_size(m_imageMetadata.size());
+
+    CachingFactory<QImage> image_factory([image_id, expected_size]()
+    {
+        QImage image;
+        {
+            ProfileScope const profile_scope("io", "load", image_id.filePath());
+            image = ImageLoader::load(image_id);
+        }
+
+        if (image.isNull())
+        {
+            throw ImageLoadFailedException();
+        }
+        else if (image.size() != expected_size)
+        {
+            throw ImageSizeChangedException();
+        }
+
+        return image;
+    });
+
+    CachingFactory<GrayImage> gray_image_factory([image_factory]()
+    {
+        return GrayImage(image_factory());
+    });
+
+    AffineImageTransform const transform(expected_size);
+
+    FilterResultPtr const result(
+        m_ptrNextTask->process(
+            *this, m_ptrAccelOps, image_factory, gray_image_factory, transform
+        )
+    );
+
+    if (result && !image_factory.isCached())
+    {
+        // The result may call the factory later on, from a thread that
+        // doesn't expect the exceptions above.  Decoding the image now
+        // makes it fail here instead, and later calls get the cached image.
+        // This costs little, as the other stages decode the image to build
+        // their results anyway, and output only returns one in GUI mode.
+        image_factory();
+    }
+
+    if (image_factory.isCached())
+    {
+        // The image got decoded after all, so create a thumbnail if it's missing.
+        // Otherwise a missing thumbnail gets created when it's first requested.
+        ProfileScope const profile_scope("io", "thumbnail");
+        m_ptrThumbnailCache->ensureThumbnailExists(m_pageId, image_factory(), transform);
+    }
+
+    return result;
+}
+
 void
 LoadFileTask::updateImageSizeIfChanged(QImage const& image)
 {
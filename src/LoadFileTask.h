@@ -53,6 +53,20 @@ public:
     virtual FilterResultPtr operator()();
 private:
     class ErrorResult;
+    class ImageSizeChangedException;
+    class ImageLoadFailedException;
+
+    /**
+     * \brief Runs the processing chain without decoding the image upfront.
+     *
+     * The image is decoded only if one of the stages actually needs it.
+     * It's assumed to have the size recorded in the project.  If that's not
+     * the case, ImageSizeChangedException is thrown from the point of decoding,
+     * and if the image can't be loaded, ImageLoadFailedException is.
+     * The returned result, if any, holds an already decoded image, so
+     * it never throws these later on.
+     */
+    FilterResultPtr processLazily();
 
     void updateImageSizeIfChanged(QImage const& image);
 
@@ -1618,6 +1618,7 @@ MainWindow::openSettingsDialog()
         {
             thumb_cache->setAccelOps(m_pAccelerationProvider->getOperations());
         }
+        Utils::applyProfilingSettings();
     });
 
     connect(
@@ -108,3 +108,8 @@ bool operator<(PageId const& lhs, PageId const& rhs)
         return lhs.subPage() < rhs.subPage();
     }
 }
+
+uint qHash(PageId const& page_id)
+{
+    return qHash(page_id.imageId()) ^ (static_cast<uint>(page_id.subPage()) << 16);
+}
@@ -80,5 +80,6 @@ private:
 bool operator==(PageId const& lhs, PageId const& rhs);
 bool operator!=(PageId const& lhs, PageId const& rhs);
 bool operator<(PageId const& lhs, PageId const& rhs);
+uint qHash(PageId const& page_id);
 
 #endif
@@ -27,6 +27,7 @@
 #include <QByteArray>
 #include <QString>
 #include <QDir>
+#include <QFileDialog>
 #include <string>
 
 SettingsDialog::SettingsDialog(QWidget* parent)
@@ -112,6 +113,16 @@ SettingsDialog::SettingsDialog(QWidget* parent)
     }
 #endif
 
+    ui.enableThreadedAccelerationCb->setChecked(
+        settings.value("settings/enable_threaded_acceleration", false).toBool()
+    );
+
+    ui.enableProfilingCb->setChecked(
+        settings.value("settings/enable_profiling", false).toBool()
+    );
+    ui.profileFileEdit->setText(settings.value("settings/profile_file").toString());
+    on_enableProfilingCb_toggled(ui.enableProfilingCb->isChecked());
+
     saveOldSettings();
     setupStylesheetsCombo();
 }
@@ -139,11 +150,22 @@ SettingsDialog::accept()
         }
 #endif
 
+        settings.setValue(
+            "settings/enable_threaded_acceleration",
+            ui.enableThreadedAccelerationCb->isChecked()
+        );
+
         QString stylesheetFilePath = ui.stylesheetCombo->currentData().toString();
         if (stylesheetFilePath != m_oldStylesheetFilePath)
         {
             settings.setValue("settings/stylesheet", stylesheetFilePath);
         }
+
+        settings.setValue(
+            "settings/enable_profiling",
+            ui.enableProfilingCb->isChecked() && !ui.profileFileEdit->text().isEmpty()
+        );
+        settings.setValue("settings/profile_file", ui.profileFileEdit->text());
     }
 
     emit settingsUpdated();
@@ -168,6 +190,26 @@ SettingsDialog::on_stylesheetCombo_currentIndexChanged(int index)
     emit stylesheetChanged(stylesheetFilePath);
 }
 
+void
+SettingsDialog::on_enableProfilingCb_toggled(bool const checked)
+{
+    ui.profileFileEdit->setEnabled(checked);
+    ui.profileFileBrowseBtn->setEnabled(checked);
+}
+
+void
+SettingsDialog::on_profileFileBrowseBtn_clicked()
+{
+    QString const file_path = QFileDialog::getSaveFileName(
+        this, tr("Trace File"), ui.profileFileEdit->text(),
+        tr("Trace files (*.json)")
+    );
+    if (!file_path.isEmpty())
+    {
+        ui.profileFileEdit->setText(file_path);
+    }
+}
+
 
 void
 SettingsDialog::saveOldSettings()
@@ -45,6 +45,10 @@ private slots:
     void reject();
 
     void on_stylesheetCombo_currentIndexChanged(int index);
+
+    void on_enableProfilingCb_toggled(bool checked);
+
+    void on_profileFileBrowseBtn_clicked();
 private:
     void saveOldSettings();
 
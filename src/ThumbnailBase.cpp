@@ -251,6 +251,20 @@ ThumbnailBase::setFullSizeToVirtualTransform(
     m_postTransform.translate(-m_transformedViewport.x(), -m_transformedViewport.y());
 }
 
+void
+ThumbnailBase::cancelLoadRequest()
+{
+    if (!m_ptrCompletionHandler.get())
+    {
+        return;
+    }
+
+    m_ptrThumbnailCache->cancelRequest(
+        m_pageId, *m_ptrFullSizeImageTransform, m_ptrCompletionHandler
+    );
+    m_ptrCompletionHandler.reset();
+}
+
 void
 ThumbnailBase::handleLoadResult(ThumbnailLoadResult::Status status)
 {
@@ -62,6 +62,14 @@ public:
 
     virtual void paint(QPainter* painter,
                        QStyleOptionGraphicsItem const* option, QWidget *widget);
+
+    /**
+     * \brief Withdraws the pending thumbnail load request, if any.
+     *
+     * To be called when this item goes out of view.  Painting it
+     * again will issue a new request.
+     */
+    void cancelLoadRequest();
 protected:
     /**
      * \brief A hook to allow subclasses to draw over the thumbnail.
@@ -0,0 +1,584 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ThumbnailPack.h"
+#include "AtomicFileOverwriter.h"
+#include <QByteArray>
+#include <QImage>
+#include <QIODevice>
+#include <QMutexLocker>
+#include <QVector>
+#include <QtEndian>
+#include <algorithm>
+#include <vector>
+#include <string.h>
+
+namespace
+{
+
+char const FILE_MAGIC[8] = { 'S', 'T', 'T', 'H', 'U', 'M', 'B', '1' };
+
+quint32 const RECORD_MAGIC = 0x52505453; // "STPR" in little endian.
+
+qint64 const FILE_HEADER_SIZE = sizeof(FILE_MAGIC);
+
+int const RECORD_HEADER_SIZE = 32;
+
+/**
+ * Anything larger is taken for a corrupted header.  Thumbnails are
+ * nowhere near that, and it keeps sizes well within the int range
+ * QByteArray works with.
+ */
+qint64 const MAX_RECORD_SIZE = 256 << 20;
+
+/**
+ * Thumbnails are read far more often than written, but are written
+ * in bulk while processing, so we favour speed over size.
+ */
+int const COMPRESSION_LEVEL = 1;
+
+struct RecordHeader
+{
+    quint32 magic;
+    quint32 keySize;
+    quint32 fingerprintSize;
+    quint32 colorCount;
+    qint32 width;
+    qint32 height;
+    quint32 format;
+    quint32 payloadSize;
+
+    qint64 recordSize() const
+    {
+        return RECORD_HEADER_SIZE + qint64(keySize) + fingerprintSize
+               + 4 * qint64(colorCount) + payloadSize;
+    }
+
+    bool load(uchar const* p)
+    {
+        magic = qFromLittleEndian<quint32>(p);
+        keySize = qFromLittleEndian<quint32>(p + 4);
+        fingerprintSize = qFromLittleEndian<quint32>(p + 8);
+        colorCount = qFromLittleEndian<quint32>(p + 12);
+        width = qFromLittleEndian<qint32>(p + 16);
+        height = qFromLittleEndian<qint32>(p + 20);
+        format = qFromLittleEndian<quint32>(p + 24);
+        payloadSize = qFromLittleEndian<quint32>(p + 28);
+        return magic == RECORD_MAGIC && width > 0 && height > 0 && colorCount <= 256
+               && recordSize() <= MAX_RECORD_SIZE;
+    }
+
+    void store(uchar* p) const
+    {
+        qToLittleEndian<quint32>(magic, p);
+        qToLittleEndian<quint32>(keySize, p + 4);
+        qToLittleEndian<quint32>(fingerprintSize, p + 8);
+        qToLittleEndian<quint32>(colorCount, p + 12);
+        qToLittleEndian<qint32>(width, p + 16);
+        qToLittleEndian<qint32>(height, p + 20);
+        qToLittleEndian<quint32>(format, p + 24);
+        qToLittleEndian<quint32>(payloadSize, p + 28);
+    }
+};
+
+qint64 bytesPerRow(int const width, int const depth)
+{
+    return (qint64(width) * depth + 7) / 8;
+}
+
+/**
+ * Tells whether rows of this format are sequences of 32-bit words,
+ * which we store in little endian order.  Rows of the other formats
+ * we store are sequences of bytes.
+ */
+bool hasWordPixels(QImage::Format const format)
+{
+    switch (format)
+    {
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool hasBytePixels(QImage::Format const format)
+{
+    switch (format)
+    {
+    case QImage::Format_Mono:
+    case QImage::Format_MonoLSB:
+    case QImage::Format_Indexed8:
+    case QImage::Format_Grayscale8:
+    case QImage::Format_RGB888:
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // anonymous namespace
+
+ThumbnailPack::ThumbnailPack(QString const& file_path)
+    :   m_filePath(file_path),
+        m_file(file_path),
+        m_pMap(0),
+        m_mappedSize(0),
+        m_fileSize(0),
+        m_liveBytes(0)
+{
+    QMutexLocker const locker(&m_mutex);
+    if (openLocked(false))
+    {
+        scanLocked();
+    }
+}
+
+ThumbnailPack::~ThumbnailPack()
+{
+    QMutexLocker const locker(&m_mutex);
+    closeLocked();
+}
+
+bool
+ThumbnailPack::contains(QString const& key, QString* fingerprint)
+{
+    QMutexLocker const locker(&m_mutex);
+
+    Index::const_iterator const it(m_index.find(key));
+    if (it == m_index.end())
+    {
+        return false;
+    }
+
+    if (fingerprint)
+    {
+        *fingerprint = it->second.fingerprint;
+    }
+    return true;
+}
+
+QImage
+ThumbnailPack::load(QString const& key)
+{
+    QByteArray record;
+    {
+        QMutexLocker const locker(&m_mutex);
+
+        Index::const_iterator const it(m_index.find(key));
+        if (it == m_index.end() || !readLocked(it->second.offset, it->second.size, record))
+        {
+            return QImage();
+        }
+    }
+
+    // Decompress outside of the lock, so that other threads
+    // can read at the same time.
+    return parseRecord(record);
+}
+
+bool
+ThumbnailPack::save(QString const& key, QImage const& image, QString const& fingerprint)
+{
+    if (image.isNull())
+    {
+        return false;
+    }
+
+    QByteArray const record(makeRecord(key, image, fingerprint));
+    if (record.isEmpty())
+    {
+        return false;
+    }
+
+    QMutexLocker const locker(&m_mutex);
+
+    if (!openLocked(true))
+    {
+        return false;
+    }
+
+    if (!m_file.seek(m_fileSize) || m_file.write(record) != record.size() || !m_file.flush())
+    {
+        // Don't leave a partial record behind.
+        m_file.resize(m_fileSize);
+        return false;
+    }
+
+    Entry& entry = m_index[key];
+    m_liveBytes += record.size() - entry.size;
+    entry = Entry(m_fileSize, record.size(), fingerprint);
+    m_fileSize += record.size();
+
+    return true;
+}
+
+bool
+ThumbnailPack::compact()
+{
+    QMutexLocker const locker(&m_mutex);
+
+    if (!m_file.isOpen())
+    {
+        return true;
+    }
+
+    // Keep the records in file order, which keeps reading sequential.
+    std::vector<Entry> entries;
+    entries.reserve(m_index.size());
+    for (Index::value_type const& kv : m_index)
+    {
+        entries.push_back(kv.second);
+    }
+    std::sort(
+        entries.begin(), entries.end(),
+        [](Entry const& lhs, Entry const& rhs)
+    {
+        return lhs.offset < rhs.offset;
+    }
+    );
+
+    AtomicFileOverwriter overwriter;
+    QIODevice* dev = overwriter.startWriting(m_filePath);
+    if (!dev)
+    {
+        return false;
+    }
+    if (dev->write(FILE_MAGIC, sizeof(FILE_MAGIC)) != qint64(sizeof(FILE_MAGIC)))
+    {
+        return false;
+    }
+
+    QByteArray record;
+    for (Entry const& entry : entries)
+    {
+        if (!readLocked(entry.offset, entry.size, record) || dev->write(record) != record.size())
+        {
+            return false;
+        }
+    }
+
+    // The file can't be replaced while it's open on some platforms.
+    closeLocked();
+    bool const committed = overwriter.commit();
+
+    if (openLocked(false))
+    {
+        scanLocked();
+    }
+
+    return committed;
+}
+
+bool
+ThumbnailPack::compactIfWasteful()
+{
+    {
+        QMutexLocker const locker(&m_mutex);
+
+        qint64 const dead_bytes = m_fileSize - FILE_HEADER_SIZE - m_liveBytes;
+        if (!m_file.isOpen() || dead_bytes <= m_liveBytes)
+        {
+            return true;
+        }
+    }
+
+    return compact();
+}
+
+bool
+ThumbnailPack::openLocked(bool const create)
+{
+    if (m_file.isOpen())
+    {
+        return true;
+    }
+    if (!create && !m_file.exists())
+    {
+        return false;
+    }
+    if (!m_file.open(QIODevice::ReadWrite))
+    {
+        return false;
+    }
+
+    m_index.clear();
+    m_liveBytes = 0;
+    m_fileSize = m_file.size();
+
+    char magic[sizeof(FILE_MAGIC)];
+    if (m_fileSize < FILE_HEADER_SIZE || m_file.read(magic, sizeof(magic)) != qint64(sizeof(magic))
+            || memcmp(magic, FILE_MAGIC, sizeof(magic)) != 0)
+    {
+        // A new file or one we don't understand.  It's only a cache,
+        // so we start over.
+        if (!m_file.resize(0) || !m_file.seek(0)
+                || m_file.write(FILE_MAGIC, sizeof(FILE_MAGIC)) != qint64(sizeof(FILE_MAGIC)))
+        {
+            m_file.close();
+            return false;
+        }
+        m_fileSize = FILE_HEADER_SIZE;
+    }
+
+    return true;
+}
+
+void
+ThumbnailPack::closeLocked()
+{
+    if (m_pMap)
+    {
+        m_file.unmap(m_pMap);
+        m_pMap = 0;
+        m_mappedSize = 0;
+    }
+    m_file.close();
+    m_fileSize = 0;
+    m_liveBytes = 0;
+    m_index.clear();
+}
+
+void
+ThumbnailPack::scanLocked()
+{
+    m_index.clear();
+    m_liveBytes = 0;
+
+    qint64 offset = FILE_HEADER_SIZE;
+    QByteArray buf;
+    while (offset + RECORD_HEADER_SIZE <= m_fileSize)
+    {
+        RecordHeader header;
+        if (!readLocked(offset, RECORD_HEADER_SIZE, buf) || !header.load((uchar const*)buf.constData()))
+        {
+            break;
+        }
+
+        qint64 const size = header.recordSize();
+        if (offset + size > m_fileSize)
+        {
+            break;
+        }
+
+        if (!readLocked(offset + RECORD_HEADER_SIZE, header.keySize + header.fingerprintSize, buf))
+        {
+            break;
+        }
+        QString const key(QString::fromUtf8(buf.constData(), header.keySize));
+        QString const fingerprint(
+            QString::fromUtf8(buf.constData() + header.keySize, header.fingerprintSize)
+        );
+
+        // Later records supersede earlier ones.
+        Entry& entry = m_index[key];
+        m_liveBytes += size - entry.size;
+        entry = Entry(offset, size, fingerprint);
+
+        offset += size;
+    }
+
+    if (offset != m_fileSize)
+    {
+        // Drop whatever follows the last intact record, which would be
+        // a record cut short by a crash.
+        if (m_pMap)
+        {
+            m_file.unmap(m_pMap);
+            m_pMap = 0;
+            m_mappedSize = 0;
+        }
+        m_file.resize(offset);
+        m_fileSize = offset;
+    }
+}
+
+bool
+ThumbnailPack::readLocked(qint64 const offset, qint64 const size, QByteArray& out)
+{
+    if (size < 0 || size > MAX_RECORD_SIZE)
+    {
+        return false;
+    }
+
+    if (offset + size > m_mappedSize && m_fileSize >= 2 * m_mappedSize)
+    {
+        // The file grew since we mapped it.  Mapping it again costs
+        // in proportion to its size, so until it doubles, the records
+        // past the mapped part are read from the file instead.
+        if (m_pMap)
+        {
+            m_file.unmap(m_pMap);
+        }
+        m_pMap = m_file.map(0, m_fileSize);
+        m_mappedSize = m_pMap ? m_fileSize : 0;
+    }
+
+    if (offset + size <= m_mappedSize)
+    {
+        out = QByteArray((char const*)m_pMap + offset, int(size));
+        return true;
+    }
+
+    // Mapping isn't available everywhere, notably on some network file systems.
+    // We also end up here for records appended since we last mapped the file.
+    if (!m_file.seek(offset))
+    {
+        return false;
+    }
+    out = m_file.read(size);
+    return out.size() == size;
+}
+
+QByteArray
+ThumbnailPack::makeRecord(
+    QString const& key, QImage const& src, QString const& fingerprint)
+{
+    QByteArray const key_utf8(key.toUtf8());
+    QByteArray const fingerprint_utf8(fingerprint.toUtf8());
+
+    QImage image(src);
+    if (!hasBytePixels(image.format()) && !hasWordPixels(image.format()))
+    {
+        image = image.convertToFormat(
+                    image.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32
+                );
+    }
+    QVector<QRgb> const colors(image.colorTable());
+
+    qint64 const row_bytes = bytesPerRow(image.width(), image.depth());
+    if (row_bytes * image.height() > MAX_RECORD_SIZE)
+    {
+        return QByteArray();
+    }
+
+    QByteArray pixels(int(row_bytes * image.height()), Qt::Uninitialized);
+    bool const words = hasWordPixels(image.format());
+    for (int y = 0; y < image.height(); ++y)
+    {
+        uchar* dst = (uchar*)pixels.data() + y * row_bytes;
+        if (words)
+        {
+            quint32 const* src_line = (quint32 const*)image.scanLine(y);
+            for (int x = 0; x < image.width(); ++x)
+            {
+                qToLittleEndian<quint32>(src_line[x], dst + 4 * x);
+            }
+        }
+        else
+        {
+            memcpy(dst, image.scanLine(y), size_t(row_bytes));
+        }
+    }
+    QByteArray const payload(qCompress(pixels, COMPRESSION_LEVEL));
+
+    RecordHeader header;
+    header.magic = RECORD_MAGIC;
+    header.keySize = key_utf8.size();
+    header.fingerprintSize = fingerprint_utf8.size();
+    header.colorCount = colors.size();
+    header.width = image.width();
+    header.height = image.height();
+    header.format = image.format();
+    header.payloadSize = payload.size();
+    if (header.recordSize() > MAX_RECORD_SIZE)
+    {
+        return QByteArray();
+    }
+
+    QByteArray record(int(header.recordSize()), Qt::Uninitialized);
+    uchar* p = (uchar*)record.data();
+    header.store(p);
+    p += RECORD_HEADER_SIZE;
+    memcpy(p, key_utf8.constData(), key_utf8.size());
+    p += key_utf8.size();
+    memcpy(p, fingerprint_utf8.constData(), fingerprint_utf8.size());
+    p += fingerprint_utf8.size();
+    for (QRgb const color : colors)
+    {
+        qToLittleEndian<quint32>(color, p);
+        p += 4;
+    }
+    memcpy(p, payload.constData(), payload.size());
+
+    return record;
+}
+
+QImage
+ThumbnailPack::parseRecord(QByteArray const& record)
+{
+    uchar const* p = (uchar const*)record.constData();
+    RecordHeader header;
+    if (record.size() < RECORD_HEADER_SIZE || !header.load(p) || header.recordSize() != record.size())
+    {
+        return QImage();
+    }
+    p += RECORD_HEADER_SIZE + header.keySize + header.fingerprintSize;
+
+    QVector<QRgb> colors(header.colorCount);
+    for (QRgb& color : colors)
+    {
+        color = qFromLittleEndian<quint32>(p);
+        p += 4;
+    }
+
+    QImage::Format const format = QImage::Format(header.format);
+    if (!hasBytePixels(format) && !hasWordPixels(format))
+    {
+        return QImage();
+    }
+
+    QByteArray const pixels(qUncompress(p, header.payloadSize));
+
+    QImage image(header.width, header.height, format);
+    if (image.isNull())
+    {
+        return QImage();
+    }
+
+    qint64 const row_bytes = bytesPerRow(image.width(), image.depth());
+    if (pixels.size() != row_bytes * image.height())
+    {
+        return QImage();
+    }
+    bool const words = hasWordPixels(format);
+    for (int y = 0; y < image.height(); ++y)
+    {
+        uchar const* src = (uchar const*)pixels.constData() + y * row_bytes;
+        if (words)
+        {
+            quint32* dst_line = (quint32*)image.scanLine(y);
+            for (int x = 0; x < image.width(); ++x)
+            {
+                dst_line[x] = qFromLittleEndian<quint32>(src + 4 * x);
+            }
+        }
+        else
+        {
+            memcpy(image.scanLine(y), src, size_t(row_bytes));
+        }
+    }
+    if (!colors.isEmpty())
+    {
+        image.setColorTable(colors);
+    }
+
+    return image;
+}
@@ -0,0 +1,134 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THUMBNAIL_PACK_H_
+#define THUMBNAIL_PACK_H_
+
+#include "NonCopyable.h"
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QtGlobal>
+#include <map>
+
+class QByteArray;
+class QImage;
+
+/**
+ * \brief All the thumbnails of a project in a single file.
+ *
+ * The file is a header followed by records, each holding a key,
+ * a transform fingerprint and zlib-compressed pixels.  Saving appends
+ * a record, superseding any earlier one with the same key.  The index
+ * of live records is built once, by walking the record headers in
+ * the memory-mapped file, which makes opening a project a single
+ * file open rather than a file open and a PNG decode per page.
+ *
+ * The space taken by superseded records is reclaimed by compact(),
+ * which compactIfWasteful() calls when it exceeds the live data.
+ * A record that was cut short by a crash is dropped when the file
+ * is opened.  Pixels and colors are stored in little endian order,
+ * so a pack can be moved between machines along with the project.
+ *
+ * All methods are thread-safe.
+ */
+class ThumbnailPack
+{
+    DECLARE_NON_COPYABLE(ThumbnailPack)
+public:
+    /**
+     * \brief Opens the pack at \p file_path.
+     *
+     * A missing file is only created by the first save().
+     */
+    explicit ThumbnailPack(QString const& file_path);
+
+    ~ThumbnailPack();
+
+    QString const& filePath() const
+    {
+        return m_filePath;
+    }
+
+    /**
+     * \brief Checks for a thumbnail without decoding it.
+     *
+     * \param fingerprint If not null and the thumbnail exists,
+     *        receives the fingerprint it was saved with.
+     */
+    bool contains(QString const& key, QString* fingerprint = 0);
+
+    /**
+     * \return The thumbnail saved under \p key, or a null image.
+     */
+    QImage load(QString const& key);
+
+    bool save(QString const& key, QImage const& image, QString const& fingerprint);
+
+    /**
+     * \brief Rewrites the file without the superseded records.
+     *
+     * This reads and writes the whole file, and other calls block
+     * until it's done, so it's best done from a background thread.
+     */
+    bool compact();
+
+    /**
+     * \brief Calls compact() if the superseded records take more space
+     *        than the live ones.
+     */
+    bool compactIfWasteful();
+private:
+    struct Entry
+    {
+        qint64 offset;
+        qint64 size;
+        QString fingerprint;
+
+        Entry() : offset(0), size(0) {}
+
+        Entry(qint64 offset, qint64 size, QString const& fingerprint)
+            : offset(offset), size(size), fingerprint(fingerprint) {}
+    };
+
+    typedef std::map<QString, Entry> Index;
+
+    bool openLocked(bool create);
+
+    void closeLocked();
+
+    void scanLocked();
+
+    bool readLocked(qint64 offset, qint64 size, QByteArray& out);
+
+    static QByteArray makeRecord(
+        QString const& key, QImage const& image, QString const& fingerprint);
+
+    static QImage parseRecord(QByteArray const& record);
+
+    QMutex m_mutex;
+    QString m_filePath;
+    QFile m_file;
+    uchar* m_pMap;
+    qint64 m_mappedSize;
+    qint64 m_fileSize;
+    qint64 m_liveBytes;
+    Index m_index;
+};
+
+#endif
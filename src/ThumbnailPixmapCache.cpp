@@ -17,10 +17,10 @@
 */
 
 #include "ThumbnailPixmapCache.h"
+#include "ThumbnailPack.h"
 #include "ImageId.h"
 #include "PageId.h"
 #include "ImageLoader.h"
-#include "AtomicFileOverwriter.h"
 #include "RelinkablePath.h"
 #include "OutOfMemoryHandler.h"
 #include "imageproc/AffineImageTransform.h"
@@ -29,7 +29,10 @@
 #include "imageproc/GrayImage.h"
 #include <QCoreApplication>
 #include <QCryptographicHash>
+#include <QObject>
 #include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
 #include <QMutex>
 #include <QMutexLocker>
 #include <QFileInfo>
@@ -229,7 +232,7 @@ private:
 };
 
 
-class ThumbnailPixmapCache::Impl : public QThread
+class ThumbnailPixmapCache::Impl : public QObject
 {
 public:
     Impl(QString const& thumb_dir,
@@ -246,6 +249,9 @@ public:
                                 AbstractImageTransform const& full_size_image_transform,
                                 boost::weak_ptr<CompletionHandler> const& completion_handler);
 
+    void cancelRequest(ThumbId const& thumb_id,
+                       boost::weak_ptr<CompletionHandler> const& completion_handler);
+
     void ensureThumbnailExists(
         ThumbId const& thumb_id, QImage const& full_size_image,
         AbstractImageTransform const& full_size_image_transform,
@@ -253,8 +259,6 @@ public:
 
     void recreateThumbnail(PageId const& page_id, QImage const& image);
 protected:
-    virtual void run();
-
     virtual void customEvent(QEvent* e);
 private:
     class LoadResultEvent;
@@ -275,21 +279,62 @@ private:
     typedef Container::index<LoadQueueTag>::type LoadQueue;
     typedef Container::index<RemoveQueueTag>::type RemoveQueue;
 
-    class BackgroundLoader : public QObject
+    class Worker : public QRunnable
     {
     public:
-        BackgroundLoader(Impl& owner);
-    protected:
-        virtual void customEvent(QEvent* e);
+        Worker(Impl& owner);
+
+        virtual void run();
     private:
         Impl& m_rOwner;
     };
 
+    class Compactor : public QRunnable
+    {
+    public:
+        Compactor(std::shared_ptr<ThumbnailPack> const& pack);
+
+        virtual void run();
+    private:
+        std::shared_ptr<ThumbnailPack> m_ptrPack;
+    };
+
     void backgroundProcessing();
 
+    /**
+     * \brief Starts as many workers as there are QUEUED items,
+     *        within the limits of m_workers.
+     */
+    void startWorkersLocked();
+
+    static QString getThumbKey(ThumbId const& thumb_id);
+
     static QString getThumbFilePath(
         ThumbId const& thumb_id, QString const& thumb_dir);
 
+    static QString getThumbPackPath(QString const& thumb_dir);
+
+    /**
+     * \brief Checks if an up to date thumbnail exists, without decoding it.
+     */
+    static bool validateThumbnail(
+        ThumbId const& thumb_id,
+        AbstractImageTransform const& full_size_image_transform,
+        ThumbnailPack& pack, QString const& thumb_dir);
+
+    /**
+     * \brief Loads an up to date thumbnail from the pack, or from the
+     *        PNG files written before there was a pack.
+     *
+     * PNG thumbnails are copied into the pack, so they are only
+     * decoded from PNG once.
+     * \return The thumbnail, or a null image if it's missing or stale.
+     */
+    static QImage loadThumbnail(
+        ThumbId const& thumb_id,
+        AbstractImageTransform const& full_size_image_transform,
+        ThumbnailPack& pack, QString const& thumb_dir);
+
     static std::unique_ptr<QImageReader> validateThumbnailOnDisk(
         QString const& thumb_file_path,
         AbstractImageTransform const& full_size_image_transform);
@@ -298,9 +343,11 @@ private:
     loadSaveThumbnail(ThumbId const& thumb_id,
                       AbstractImageTransform const& full_size_image_transform,
                       std::shared_ptr<AcceleratableOperations> const& accel_ops,
+                      std::shared_ptr<ThumbnailPack> const& pack,
                       QString const& thumb_dir, QSize const& max_thumb_size);
 
-    static void saveThumbnail(QImage const& thumb, QString const& thumb_file_path);
+    static void saveThumbnail(
+        QImage const& thumb, ThumbId const& thumb_id, ThumbnailPack& pack);
 
     static boost::optional<AffineTransformedImage> makeThumbnail(
         QSize const& max_thumb_size, QImage const& full_size_image,
@@ -352,7 +399,17 @@ private:
      */
     std::shared_ptr<AcceleratableOperations> m_ptrAccelOps;
 
-    BackgroundLoader m_backgroundLoader;
+    /**
+     * Loads thumbnails in background.  Each worker keeps taking QUEUED
+     * items from the front of m_loadQueue until there are none left.
+     */
+    QThreadPool m_workers;
+
+    /**
+     * The number of workers either running or scheduled to run.
+     */
+    int m_numActiveWorkers;
+
     Container m_items;
     ItemsByKey& m_itemsByKey; /**< ThumbId => Item mapping */
 
@@ -384,6 +441,13 @@ private:
     uint64_t m_nextRetirementIdentity = 1;
 
     QString m_thumbDir;
+
+    /**
+     * The thumbnails of m_thumbDir.  Follows the same copy-under-mutex
+     * rule as m_ptrAccelOps.
+     */
+    std::shared_ptr<ThumbnailPack> m_ptrPack;
+
     QSize m_maxThumbSize;
     int m_maxCachedPixmaps;
 
@@ -401,7 +465,6 @@ private:
      */
     int m_totalLoadAttempts;
 
-    bool m_threadStarted;
     bool m_shuttingDown;
 };
 
@@ -468,6 +531,17 @@ ThumbnailPixmapCache::loadRequest(PageId const& page_id,
            );
 }
 
+void
+ThumbnailPixmapCache::cancelRequest(PageId const& page_id,
+                                    AbstractImageTransform const& full_size_image_transform,
+                                    boost::weak_ptr<CompletionHandler> const& completion_handler)
+{
+    m_ptrImpl->cancelRequest(
+        ThumbId(page_id, full_size_image_transform.isAffine()),
+        completion_handler
+    );
+}
+
 void
 ThumbnailPixmapCache::ensureThumbnailExists(
     PageId const& page_id, QImage const& full_size_image,
@@ -500,20 +574,20 @@ ThumbnailPixmapCache::Impl::Impl(
     QSize const& max_thumb_size,
     int const max_cached_pixmaps, int const expiration_threshold)
     :	m_ptrAccelOps(accel_ops),
-      m_backgroundLoader(*this),
+      m_numActiveWorkers(0),
       m_items(),
       m_itemsByKey(m_items.get<ItemsByKeyTag>()),
       m_loadQueue(m_items.get<LoadQueueTag>()),
       m_removeQueue(m_items.get<RemoveQueueTag>()),
       m_endOfLoadedItems(m_removeQueue.end()),
       m_thumbDir(thumb_dir),
+      m_ptrPack(std::make_shared<ThumbnailPack>(getThumbPackPath(thumb_dir))),
       m_maxThumbSize(max_thumb_size),
       m_maxCachedPixmaps(max_cached_pixmaps),
       m_expirationThreshold(expiration_threshold),
       m_numQueuedItems(0),
       m_numLoadedItems(0),
       m_totalLoadAttempts(0),
-      m_threadStarted(false),
       m_shuttingDown(false)
 {
     // Note that QDir::mkdir() will fail if the parent directory,
@@ -522,37 +596,47 @@ ThumbnailPixmapCache::Impl::Impl(
     // a whole bunch of bogus directories would be created.
     QDir().mkdir(m_thumbDir);
 
-    m_backgroundLoader.moveToThread(this);
+    // Each worker holds a full size image while making a thumbnail,
+    // so we don't let their number grow with the core count unbounded.
+    m_workers.setMaxThreadCount(
+        std::max(1, std::min(QThread::idealThreadCount(), 4))
+    );
+
+    m_workers.start(new Compactor(m_ptrPack));
 }
 
 ThumbnailPixmapCache::Impl::~Impl()
 {
     {
         QMutexLocker const locker(&m_mutex);
-
-        if (!m_threadStarted)
-        {
-            return;
-        }
-
         m_shuttingDown = true;
     }
 
-    quit();
-    wait();
+    m_workers.waitForDone();
 }
 
 void
 ThumbnailPixmapCache::Impl::setThumbDir(QString const& thumb_dir)
 {
-    QMutexLocker locker(&m_mutex);
-
-    if (thumb_dir == m_thumbDir)
     {
-        return;
+        QMutexLocker const locker(&m_mutex);
+        if (thumb_dir == m_thumbDir)
+        {
+            return;
+        }
     }
 
+    // Opening a pack reads its index, which workers shouldn't wait for.
+    // Compacting it rewrites the file, which the GUI shouldn't wait for.
+    std::shared_ptr<ThumbnailPack> const pack(
+        std::make_shared<ThumbnailPack>(getThumbPackPath(thumb_dir))
+    );
+    m_workers.start(new Compactor(pack));
+
+    QMutexLocker locker(&m_mutex);
+
     m_thumbDir = thumb_dir;
+    m_ptrPack = pack;
 
     BOOST_FOREACH(Item const& item, m_loadQueue)
     {
@@ -707,24 +791,52 @@ ThumbnailPixmapCache::Impl::request(ThumbId const& thumb_id,
         lq_it->completionHandlers.push_back(completion_handler);
     }
 
-    if (m_numQueuedItems++ == 0)
+    ++m_numQueuedItems;
+    startWorkersLocked();
+
+    return ThumbnailLoadResult::QUEUED;
+}
+
+void
+ThumbnailPixmapCache::Impl::cancelRequest(
+    ThumbId const& thumb_id,
+    boost::weak_ptr<CompletionHandler> const& completion_handler)
+{
+    assert(QCoreApplication::instance()->thread() == QThread::currentThread());
+
+    QMutexLocker const locker(&m_mutex);
+
+    ItemsByKey::iterator const k_it(m_itemsByKey.find(thumb_id));
+    if (k_it == m_itemsByKey.end())
+    {
+        return;
+    }
+
+    Item const& item = *k_it;
+    if (item.status != Item::QUEUED && item.status != Item::IN_PROGRESS)
     {
-        if (m_threadStarted)
-        {
-            // Wake the background thread up.
-            QCoreApplication::postEvent(
-                &m_backgroundLoader, new QEvent(QEvent::User)
-            );
-        }
-        else
+        return;
+    }
+
+    // Drop this handler, along with any handlers whose owners are gone.
+    boost::shared_ptr<CompletionHandler> const handler(completion_handler.lock());
+    std::vector<boost::weak_ptr<CompletionHandler>> remaining;
+    for (boost::weak_ptr<CompletionHandler> const& wh : item.completionHandlers)
+    {
+        boost::shared_ptr<CompletionHandler> const sh(wh.lock());
+        if (sh && sh != handler)
         {
-            // Start the background thread.
-            start();
-            m_threadStarted = true;
+            remaining.push_back(wh);
         }
     }
+    item.completionHandlers.swap(remaining);
 
-    return ThumbnailLoadResult::QUEUED;
+    // An IN_PROGRESS item is already being loaded, and the result is
+    // worth keeping.  A QUEUED one nobody waits for is not worth loading.
+    if (item.status == Item::QUEUED && item.completionHandlers.empty())
+    {
+        removeItemGuiThreadLocked(item);
+    }
 }
 
 void
@@ -746,16 +858,15 @@ ThumbnailPixmapCache::Impl::ensureThumbnailExists(
     }
 
     QString const thumb_dir(m_thumbDir);
+    std::shared_ptr<ThumbnailPack> const pack(m_ptrPack);
     QSize const max_thumb_size(m_maxThumbSize);
     std::shared_ptr<AcceleratableOperations> const accel_ops(m_ptrAccelOps);
 
     locker.unlock();
 
-    QString const thumb_file_path(getThumbFilePath(thumb_id, thumb_dir));
-
     if (!force_recreate)
     {
-        if (validateThumbnailOnDisk(thumb_file_path, full_size_image_transform))
+        if (validateThumbnail(thumb_id, full_size_image_transform, *pack, thumb_dir))
         {
             return;
         }
@@ -769,7 +880,7 @@ ThumbnailPixmapCache::Impl::ensureThumbnailExists(
         return;
     }
 
-    saveThumbnail(thumb->origImage(), thumb_file_path);
+    saveThumbnail(thumb->origImage(), thumb_id, *pack);
 
     locker.relock();
 
@@ -794,13 +905,6 @@ ThumbnailPixmapCache::Impl::ensureThumbnailExists(
     postLoadedResult(item.thisPtr, *thumb);
 }
 
-void
-ThumbnailPixmapCache::Impl::run()
-{
-    backgroundProcessing();
-    exec(); // Wait for further processing requests (via custom events).
-}
-
 void
 ThumbnailPixmapCache::Impl::customEvent(QEvent* e)
 {
@@ -822,30 +926,32 @@ ThumbnailPixmapCache::Impl::backgroundProcessing()
             ThumbId thumb_id;
             std::shared_ptr<AbstractImageTransform const> full_size_image_transform;
             QString thumb_dir;
+            std::shared_ptr<ThumbnailPack> pack;
             QSize max_thumb_size;
             std::shared_ptr<AcceleratableOperations> accel_ops;
 
             {
                 QMutexLocker const locker(&m_mutex);
 
-                if (m_shuttingDown || m_items.empty())
+                if (m_shuttingDown || m_numQueuedItems == 0)
                 {
+                    // Done with this worker.  It has to be accounted for
+                    // under the same lock that told us there is no work,
+                    // otherwise request() could count on it to pick up
+                    // a new item.
+                    --m_numActiveWorkers;
+                    assert(m_numActiveWorkers >= 0);
                     break;
                 }
 
+                // All QUEUED items precede any other items in the load queue,
+                // and new requests are put in front of older ones, so that
+                // thumbnails currently on screen get loaded first.
                 Item const& item = m_loadQueue.front();
+                assert(item.status == Item::QUEUED);
                 thumb_id = item.thumbId;
                 full_size_image_transform = item.fullSizeImageTransform;
 
-                if (item.status != Item::QUEUED)
-                {
-                    // All QUEUED items precede any other items
-                    // in the load queue, so it means there are no
-                    // QUEUED items at all.
-                    assert(m_numQueuedItems == 0);
-                    break;
-                }
-
                 // By marking the item as IN_PROGRESS, we prevent it
                 // from being processed again before the GUI thread
                 // receives our LoadResultEvent.
@@ -873,6 +979,7 @@ ThumbnailPixmapCache::Impl::backgroundProcessing()
 
                 // Copy those while holding the mutex.
                 thumb_dir = m_thumbDir;
+                pack = m_ptrPack;
                 max_thumb_size = m_maxThumbSize;
                 accel_ops = m_ptrAccelOps;
             } // mutex scope
@@ -882,7 +989,7 @@ ThumbnailPixmapCache::Impl::backgroundProcessing()
             boost::optional<AffineTransformedImage> const thumb(
                 loadSaveThumbnail(
                     thumb_id, *full_size_image_transform, accel_ops,
-                    thumb_dir, max_thumb_size
+                    pack, thumb_dir, max_thumb_size
                 )
             );
             if (thumb)
@@ -901,13 +1008,23 @@ ThumbnailPixmapCache::Impl::backgroundProcessing()
     }
 }
 
+void
+ThumbnailPixmapCache::Impl::startWorkersLocked()
+{
+    while (!m_shuttingDown && m_numActiveWorkers < m_numQueuedItems
+            && m_numActiveWorkers < m_workers.maxThreadCount())
+    {
+        ++m_numActiveWorkers;
+        m_workers.start(new Worker(*this));
+    }
+}
+
 QString
-ThumbnailPixmapCache::Impl::getThumbFilePath(
-    ThumbId const& thumb_id, QString const& thumb_dir)
+ThumbnailPixmapCache::Impl::getThumbKey(ThumbId const& thumb_id)
 {
     // Because a project may have several files with the same name (from
     // different directories), we add a hash of the original image path
-    // to the thumbnail file name.
+    // to the thumbnail key.
 
     QByteArray const orig_path_hash(
         QCryptographicHash::hash(
@@ -920,11 +1037,9 @@ ThumbnailPixmapCache::Impl::getThumbFilePath(
     );
 
     QFileInfo const orig_img_path(thumb_id.pageId.imageId().filePath());
-    QString thumb_file_path(thumb_dir);
-    thumb_file_path += QChar('/');
-    thumb_file_path += orig_img_path.baseName();
-    thumb_file_path += QChar('_');
-    thumb_file_path += QString::number(thumb_id.pageId.imageId().zeroBasedPage());
+    QString thumb_key(orig_img_path.baseName());
+    thumb_key += QChar('_');
+    thumb_key += QString::number(thumb_id.pageId.imageId().zeroBasedPage());
     if (!thumb_id.isAffineTransform)
     {
         QChar sub_page_mark = QChar('S');
@@ -939,15 +1054,87 @@ ThumbnailPixmapCache::Impl::getThumbFilePath(
             sub_page_mark = QChar('R');
             break;
         }
-        thumb_file_path += sub_page_mark;
+        thumb_key += sub_page_mark;
     }
-    thumb_file_path += QChar('_');
-    thumb_file_path += orig_path_hash_str;
+    thumb_key += QChar('_');
+    thumb_key += orig_path_hash_str;
+
+    return thumb_key;
+}
+
+QString
+ThumbnailPixmapCache::Impl::getThumbFilePath(
+    ThumbId const& thumb_id, QString const& thumb_dir)
+{
+    QString thumb_file_path(thumb_dir);
+    thumb_file_path += QChar('/');
+    thumb_file_path += getThumbKey(thumb_id);
     thumb_file_path += QString::fromLatin1(".png");
 
     return thumb_file_path;
 }
 
+QString
+ThumbnailPixmapCache::Impl::getThumbPackPath(QString const& thumb_dir)
+{
+    return thumb_dir + QString::fromLatin1("/thumbs.pack");
+}
+
+bool
+ThumbnailPixmapCache::Impl::validateThumbnail(
+    ThumbId const& thumb_id,
+    AbstractImageTransform const& full_size_image_transform,
+    ThumbnailPack& pack, QString const& thumb_dir)
+{
+    QString fingerprint;
+    if (pack.contains(getThumbKey(thumb_id), &fingerprint))
+    {
+        // We reuse the same thumbnail for all affine transforms,
+        // so no further validation is required for them.
+        return full_size_image_transform.isAffine()
+               || fingerprint == full_size_image_transform.fingerprint();
+    }
+
+    return bool(validateThumbnailOnDisk(getThumbFilePath(thumb_id, thumb_dir), full_size_image_transform));
+}
+
+QImage
+ThumbnailPixmapCache::Impl::loadThumbnail(
+    ThumbId const& thumb_id,
+    AbstractImageTransform const& full_size_image_transform,
+    ThumbnailPack& pack, QString const& thumb_dir)
+{
+    QString const thumb_key(getThumbKey(thumb_id));
+
+    QString fingerprint;
+    if (pack.contains(thumb_key, &fingerprint))
+    {
+        if (!full_size_image_transform.isAffine()
+                && fingerprint != full_size_image_transform.fingerprint())
+        {
+            // The thumbnail is stale and needs to be re-generated.
+            return QImage();
+        }
+        return pack.load(thumb_key);
+    }
+
+    std::unique_ptr<QImageReader> thumb_reader(
+        validateThumbnailOnDisk(getThumbFilePath(thumb_id, thumb_dir), full_size_image_transform)
+    );
+    if (!thumb_reader)
+    {
+        return QImage();
+    }
+
+    QImage const thumb_image(thumb_reader->read());
+    if (!thumb_image.isNull())
+    {
+        pack.save(thumb_key, thumb_image, thumb_reader->text(TRANSFORM_FINGERPRINT_KEY));
+    }
+    return thumb_image;
+}
+
+
 std::unique_ptr<QImageReader>
 ThumbnailPixmapCache::Impl::validateThumbnailOnDisk(
     QString const& thumb_file_path,
@@ -985,27 +1172,29 @@ boost::optional<AffineTransformedImage>
 ThumbnailPixmapCache::Impl::loadSaveThumbnail(ThumbId const& thumb_id,
         AbstractImageTransform const& full_size_image_transform,
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
+        std::shared_ptr<ThumbnailPack> const& pack,
         QString const& thumb_dir, QSize const& max_thumb_size)
 {
-    QString const thumb_file_path(getThumbFilePath(thumb_id, thumb_dir));
-    std::unique_ptr<QImageReader> thumb_reader(
-        validateThumbnailOnDisk(thumb_file_path, full_size_image_transform)
+    QImage const thumb_image(
+        loadThumbnail(thumb_id, full_size_image_transform, *pack, thumb_dir)
     );
-    if (thumb_reader)   // Validation succeeded.
+    if (!thumb_image.isNull())   // Validation succeeded.
     {
-        QImage thumb_image(thumb_reader->read());
-        if (thumb_image.isNull())
-        {
-            return boost::optional<AffineTransformedImage>();
-        }
-
         AffineImageTransform thumb_transform(full_size_image_transform.toAffine());
         thumb_transform.adjustForScaledOrigImage(thumb_image.size());
         return AffineTransformedImage(thumb_image, thumb_transform);
     }
 
-    // Load full size image.
-    QImage full_size_image(ImageLoader::load(thumb_id.pageId.imageId()));
+    // Load full size image.  An affine thumbnail is just a downscaled
+    // copy of it, so we let the decoder drop the resolution we'd throw
+    // away anyway, keeping twice the thumbnail size for a smooth result.
+    // Dewarping needs the image at its original resolution.
+    ImageId const& image_id = thumb_id.pageId.imageId();
+    QImage const full_size_image(
+        full_size_image_transform.isAffine()
+        ? ImageLoader::loadDownscaled(image_id, max_thumb_size * 2)
+        : ImageLoader::load(image_id)
+    );
     if (full_size_image.isNull())
     {
         return boost::optional<AffineTransformedImage>();
@@ -1018,7 +1207,7 @@ ThumbnailPixmapCache::Impl::loadSaveThumbnail(ThumbId const& thumb_id,
     // Save thumbnail image.
     if (thumb)
     {
-        saveThumbnail(thumb->origImage(), thumb_file_path);
+        saveThumbnail(thumb->origImage(), thumb_id, *pack);
     }
 
     return thumb;
@@ -1082,14 +1271,9 @@ ThumbnailPixmapCache::Impl::makeThumbnail(
 
 void
 ThumbnailPixmapCache::Impl::saveThumbnail(
-    QImage const& thumb, QString const& thumb_file_path)
+    QImage const& thumb, ThumbId const& thumb_id, ThumbnailPack& pack)
 {
-    AtomicFileOverwriter overwriter;
-    QIODevice* iodev = overwriter.startWriting(thumb_file_path);
-    if (iodev && thumb.save(iodev, "PNG"))
-    {
-        overwriter.commit();
-    }
+    pack.save(getThumbKey(thumb_id), thumb, thumb.text(TRANSFORM_FINGERPRINT_KEY));
 }
 
 QImage
@@ -1444,15 +1628,30 @@ ThumbnailPixmapCache::Impl::LoadResultEvent::~LoadResultEvent()
 }
 
 
-/*================== ThumbnailPixmapCache::BackgroundLoader =================*/
+/*===================== ThumbnailPixmapCache::Impl::Worker ==================*/
 
-ThumbnailPixmapCache::Impl::BackgroundLoader::BackgroundLoader(Impl& owner)
+ThumbnailPixmapCache::Impl::Worker::Worker(Impl& owner)
     :	m_rOwner(owner)
 {
 }
 
 void
-ThumbnailPixmapCache::Impl::BackgroundLoader::customEvent(QEvent*)
+ThumbnailPixmapCache::Impl::Worker::run()
 {
     m_rOwner.backgroundProcessing();
 }
+
+
+/*==================== ThumbnailPixmapCache::Impl::Compactor ================*/
+
+ThumbnailPixmapCache::Impl::Compactor::Compactor(
+    std::shared_ptr<ThumbnailPack> const& pack)
+    :	m_ptrPack(pack)
+{
+}
+
+void
+ThumbnailPixmapCache::Impl::Compactor::run()
+{
+    m_ptrPack->compactIfWasteful();
+}
@@ -107,6 +107,20 @@ public:
                                     imageproc::AbstractImageTransform const& full_size_image_transform,
                                     boost::weak_ptr<CompletionHandler> const& completion_handler);
 
+    /**
+     * \brief Withdraw a request made by loadRequest().
+     *
+     * Meant for thumbnails that went out of view before being loaded.
+     * \p completion_handler won't be called after this.  If no other
+     * requests are waiting for the same thumbnail and it's not being
+     * loaded yet, it won't be loaded at all.
+     *
+     * \note This function is to be called from the GUI thread only.
+     */
+    void cancelRequest(PageId const& page_id,
+                       imageproc::AbstractImageTransform const& full_size_image_transform,
+                       boost::weak_ptr<CompletionHandler> const& completion_handler);
+
     /**
      * \brief If no thumbnail exists for this image, create it.
      *
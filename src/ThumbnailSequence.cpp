@@ -19,6 +19,7 @@
 #include "ThumbnailSequence.h"
 #include "ThumbnailFactory.h"
 #include "IncompleteThumbnail.h"
+#include "ThumbnailBase.h"
 #include "PageSequence.h"
 #include "PageOrderProvider.h"
 #include "PageInfo.h"
@@ -39,6 +40,7 @@
 #include <QGraphicsSimpleTextItem>
 #include <QGraphicsPixmapItem>
 #include <QGraphicsView>
+#include <QScrollBar>
 #include <QStyle>
 #include <QStyleOptionGraphicsItem>
 #include <QGraphicsSceneMouseEvent>
@@ -201,6 +203,12 @@ private:
 
     void invalidateThumbnailImpl(ItemsById::iterator id_it);
 
+    /**
+     * Withdraws pending thumbnail load requests of items scrolled out of
+     * view, to let the visible ones load first.
+     */
+    void cancelInvisibleLoadRequests();
+
     void sceneContextMenuEvent(QGraphicsSceneContextMenuEvent* evt);
 
     void selectItemNoModifiers(ItemsById::iterator const& it);
@@ -264,6 +272,7 @@ private:
     IntrusivePtr<ThumbnailFactory> m_ptrFactory;
     IntrusivePtr<PageOrderProvider const> m_ptrOrderProvider;
     GraphicsScene m_graphicsScene;
+    QGraphicsView* m_pView;
     QRectF m_sceneRect;
 };
 
@@ -320,6 +329,8 @@ public:
 
     bool incompleteThumbnail() const;
 
+    void cancelLoadRequest();
+
     void updateSceneRect(QRectF& scene_rect);
 
     void updateAppearence(bool selected, bool selection_leader);
@@ -499,7 +510,8 @@ ThumbnailSequence::Impl::Impl(
       m_itemsById(m_items.get<ItemsByIdTag>()),
       m_itemsInOrder(m_items.get<ItemsInOrderTag>()),
       m_selectedThenUnselected(m_items.get<SelectedThenUnselectedTag>()),
-      m_pSelectionLeader(0)
+      m_pSelectionLeader(0),
+      m_pView(0)
 {
     m_graphicsScene.setContextMenuEventCallback(
         [this](QGraphicsSceneContextMenuEvent* evt)
@@ -523,7 +535,16 @@ ThumbnailSequence::Impl::setThumbnailFactory(
 void
 ThumbnailSequence::Impl::attachView(QGraphicsView* const view)
 {
+    m_pView = view;
     view->setScene(&m_graphicsScene);
+
+    QObject::connect(
+        view->verticalScrollBar(), &QScrollBar::valueChanged, &m_rOwner,
+        [this]()
+    {
+        cancelInvisibleLoadRequests();
+    }
+    );
 }
 
 void
@@ -1544,6 +1565,27 @@ ThumbnailSequence::Impl::getLabelGroup(PageInfo const& page_info)
     return std::unique_ptr<LabelGroup>(new LabelGroup(std::move(normal_text_item), std::move(bold_text_item), std::move(pixmap_item)));
 }
 
+void
+ThumbnailSequence::Impl::cancelInvisibleLoadRequests()
+{
+    if (!m_pView)
+    {
+        return;
+    }
+
+    QRectF const visible_rect(
+        m_pView->mapToScene(m_pView->viewport()->rect()).boundingRect()
+    );
+
+    for (Item const& item : m_itemsInOrder)
+    {
+        if (!item.composite->sceneBoundingRect().intersects(visible_rect))
+        {
+            item.composite->cancelLoadRequest();
+        }
+    }
+}
+
 std::unique_ptr<ThumbnailSequence::CompositeItem>
 ThumbnailSequence::Impl::getCompositeItem(
     Item const* item, PageInfo const& page_info)
@@ -1717,6 +1759,15 @@ ThumbnailSequence::CompositeItem::incompleteThumbnail() const
     return dynamic_cast<IncompleteThumbnail*>(m_pThumb) != 0;
 }
 
+void
+ThumbnailSequence::CompositeItem::cancelLoadRequest()
+{
+    if (ThumbnailBase* thumb = dynamic_cast<ThumbnailBase*>(m_pThumb))
+    {
+        thumb->cancelLoadRequest();
+    }
+}
+
 void
 ThumbnailSequence::CompositeItem::updateSceneRect(QRectF& scene_rect)
 {
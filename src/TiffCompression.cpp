@@ -0,0 +1,144 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TiffCompression.h"
+#include <QtGlobal>
+#include <assert.h>
+
+TiffCompression::TiffCompression(Codec const codec, int const level)
+    :   m_codec(codec),
+        m_level(qBound(0, level, maxLevel(codec)))
+{
+}
+
+TiffCompression::TiffCompression(QString const& str)
+    :   m_codec(LZW),
+        m_level(0)
+{
+    int const colon = str.indexOf(QChar(':'));
+    if (!codecFromString(str.left(colon), m_codec))
+    {
+        m_codec = LZW;
+    }
+
+    if (colon >= 0)
+    {
+        m_level = qBound(0, str.mid(colon + 1).toInt(), maxLevel(m_codec));
+    }
+}
+
+bool
+TiffCompression::isValid(QString const& str)
+{
+    int const colon = str.indexOf(QChar(':'));
+    Codec codec = LZW;
+    if (!codecFromString(str.left(colon), codec))
+    {
+        return false;
+    }
+
+    if (colon >= 0)
+    {
+        bool ok = false;
+        int const level = str.mid(colon + 1).toInt(&ok);
+        if (!ok || level < 0 || level > maxLevel(codec))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QString
+TiffCompression::toString() const
+{
+    QString str(codecToString(m_codec));
+    if (m_level > 0)
+    {
+        str += QChar(':');
+        str += QString::number(m_level);
+    }
+    return str;
+}
+
+int
+TiffCompression::maxLevel(Codec const codec)
+{
+    switch (codec)
+    {
+    case DEFLATE:
+        return 9;
+    case ZSTD:
+        return 22;
+    default:
+        return 0;
+    }
+}
+
+bool
+TiffCompression::codecFromString(QString const& str, Codec& codec)
+{
+    QString const name(str.toLower());
+    if (name == "none")
+    {
+        codec = NONE;
+    }
+    else if (name == "lzw")
+    {
+        codec = LZW;
+    }
+    else if (name == "deflate")
+    {
+        codec = DEFLATE;
+    }
+    else if (name == "zstd")
+    {
+        codec = ZSTD;
+    }
+    else if (name == "packbits")
+    {
+        codec = PACKBITS;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+QString
+TiffCompression::codecToString(Codec const codec)
+{
+    switch (codec)
+    {
+    case NONE:
+        return "none";
+    case LZW:
+        return "lzw";
+    case DEFLATE:
+        return "deflate";
+    case ZSTD:
+        return "zstd";
+    case PACKBITS:
+        return "packbits";
+    }
+
+    assert(!"Unreachable");
+    return QString();
+}
@@ -0,0 +1,91 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TIFF_COMPRESSION_H_
+#define TIFF_COMPRESSION_H_
+
+#include <QString>
+
+/**
+ * \brief The codec TiffWriter uses for gray and color images.
+ *
+ * Bilevel images are always written with CCITT G4, which beats
+ * any of these on black and white scans.
+ */
+class TiffCompression
+{
+public:
+    enum Codec { NONE, LZW, DEFLATE, ZSTD, PACKBITS };
+
+    /**
+     * \param level The compression level for DEFLATE (1 to 9) or
+     *        ZSTD (1 to 22).  Zero selects the codec's default.
+     *        Other codecs ignore it.
+     *
+     * DEFLATE and ZSTD store differences of neighbouring samples
+     * (the horizontal predictor) of gray and color images.
+     */
+    TiffCompression(Codec codec = LZW, int level = 0);
+
+    /**
+     * \brief Parses "codec" or "codec:level", as produced by toString().
+     *
+     * Unknown codecs map to LZW, and levels are clamped to the codec's
+     * range.  Use isValid() to reject such strings instead.
+     */
+    explicit TiffCompression(QString const& str);
+
+    /**
+     * \brief Tells whether \p str names a known codec and, if it has
+     *        a level, whether that is a number from 0 to maxLevel().
+     */
+    static bool isValid(QString const& str);
+
+    Codec codec() const
+    {
+        return m_codec;
+    }
+
+    int level() const
+    {
+        return m_level;
+    }
+
+    QString toString() const;
+
+    bool operator==(TiffCompression const& other) const
+    {
+        return m_codec == other.m_codec && m_level == other.m_level;
+    }
+
+    bool operator!=(TiffCompression const& other) const
+    {
+        return !(*this == other);
+    }
+
+    static int maxLevel(Codec codec);
+private:
+    static bool codecFromString(QString const& str, Codec& codec);
+
+    static QString codecToString(Codec codec);
+
+    Codec m_codec;
+    int m_level;
+};
+
+#endif
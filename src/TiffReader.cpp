@@ -25,13 +25,16 @@
 #include <QImage>
 #include <QColor>
 #include <QSize>
+#include <QVector>
 #include <QDebug>
 #include <algorithm>
+#include <vector>
 #include <tiff.h>
 #include <tiffio.h>
 #include <new>
 #include <assert.h>
 #include <stdint.h>
+#include <string.h>
 
 class TiffReader::TiffHeader
 {
@@ -313,8 +316,146 @@ static void convertAbgrToArgb(uint32_t const* src, uint32_t* dst, int count)
     }
 }
 
+/**
+ * Unpacks \p count samples of up to 8 bits.
+ * Reads up to one byte past the last byte holding the samples.
+ */
+static void unpackSamples(
+    uint8_t const* src, int const bits_per_sample, int const count, uint8_t* dst)
+{
+    unsigned const mask = (1u << bits_per_sample) - 1;
+    int bit = 0;
+    for (int i = 0; i < count; ++i, bit += bits_per_sample)
+    {
+        uint8_t const* p = src + (bit >> 3);
+        unsigned const word = (unsigned(p[0]) << 8) | p[1];
+        dst[i] = static_cast<uint8_t>((word >> (16 - bits_per_sample - (bit & 7))) & mask);
+    }
+}
+
+/**
+ * Serves the scanlines of the current page in top to bottom order,
+ * whether the page is organized in strips or in tiles.
+ */
+class TiffReader::LineReader
+{
+    DECLARE_NON_COPYABLE(LineReader)
+public:
+    LineReader(TiffHandle const& tif, TiffInfo const& info);
+
+    /**
+     * Returns line \p y, followed by a spare zero byte.  The pointer
+     * stays valid until the next call.  Lines that fail to decode
+     * come out as zeros for tiled images and as whatever libtiff
+     * left in the buffer for strip-based ones.
+     */
+    uint8_t const* readLine(int y);
+private:
+    void readBand(int top);
+
+    TIFF* m_pTif;
+    tsize_t m_lineSize;
+    int m_width;
+    int m_height;
+    int m_bitsPerPixel;
+    uint32_t m_tileWidth;
+    uint32_t m_tileLength;
+    int m_bandTop;
+    TiffBuffer<uint8_t> m_lines;
+    TiffBuffer<uint8_t> m_tile;
+};
+
+
+TiffReader::LineReader::LineReader(TiffHandle const& tif, TiffInfo const& info)
+    :	m_pTif(tif.handle()),
+      m_lineSize(TIFFScanlineSize(tif.handle())),
+      m_width(info.width),
+      m_height(info.height),
+      m_bitsPerPixel(info.bits_per_sample * info.samples_per_pixel),
+      m_tileWidth(0),
+      m_tileLength(1),
+      m_bandTop(-1)
+{
+    if (TIFFIsTiled(m_pTif))
+    {
+        TIFFGetField(m_pTif, TIFFTAG_TILEWIDTH, &m_tileWidth);
+        TIFFGetField(m_pTif, TIFFTAG_TILELENGTH, &m_tileLength);
+        m_tileLength = std::max<uint32_t>(m_tileLength, 1);
+        TiffBuffer<uint8_t>(TIFFTileSize(m_pTif)).swap(m_tile);
+    }
+
+    // A tiled image is decoded a row of tiles at a time.
+    tsize_t const buf_size = m_lineSize * m_tileLength;
+    TiffBuffer<uint8_t>(buf_size + 1).swap(m_lines);
+    m_lines.data()[buf_size] = 0;
+}
+
+uint8_t const*
+TiffReader::LineReader::readLine(int const y)
+{
+    if (!m_tileWidth)
+    {
+        TIFFReadScanline(m_pTif, m_lines.data(), y);
+        return m_lines.data();
+    }
+
+    int const top = y - y % int(m_tileLength);
+    if (top != m_bandTop)
+    {
+        readBand(top);
+        m_bandTop = top;
+    }
+    return m_lines.data() + m_lineSize * (y - top);
+}
+
+void
+TiffReader::LineReader::readBand(int const top)
+{
+    int const rows = std::min(int(m_tileLength), m_height - top);
+    tsize_t const tile_row_size = TIFFTileRowSize(m_pTif);
+
+    for (uint32_t x = 0; x < uint32_t(m_width); x += m_tileWidth)
+    {
+        // Tile widths are multiples of 16, so tiles start on byte boundaries.
+        tsize_t const offset = tsize_t(x) * m_bitsPerPixel / 8;
+        tsize_t const bytes = std::min(tile_row_size, m_lineSize - offset);
+
+        bool const ok = TIFFReadTile(m_pTif, m_tile.data(), x, top, 0, 0) >= 0;
+        for (int row = 0; row < rows; ++row)
+        {
+            uint8_t* dst = m_lines.data() + m_lineSize * row + offset;
+            if (ok)
+            {
+                memcpy(dst, m_tile.data() + tile_row_size * row, bytes);
+            }
+            else
+            {
+                memset(dst, 0, bytes);
+            }
+        }
+    }
+}
+
 QImage
 TiffReader::readImage(QIODevice& device, int const page_num)
+{
+    return readImageImpl(device, page_num, QSize());
+}
+
+QImage
+TiffReader::readDownscaledImage(
+    QIODevice& device, int const page_num, QSize const& target_size)
+{
+    return readImageImpl(device, page_num, target_size);
+}
+
+/**
+ * \param target_size If valid, the image gets downscaled by the largest
+ *        integer factor that doesn't make it smaller than that.
+ */
+QImage
+TiffReader::readImageImpl(
+    QIODevice& device, int const page_num, QSize const& target_size)
 {
     if (!device.isReadable())
     {
@@ -351,63 +492,32 @@ TiffReader::readImage(QIODevice& device, int const page_num)
 
     TiffInfo const info(tif, header);
 
-    QImage image;
+    if (info.width <= 0 || info.height <= 0)
+    {
+        return QImage();
+    }
+
+    int downscale = 1;
+    if (target_size.isValid() && !target_size.isEmpty())
+    {
+        downscale = std::max(
+            1, std::min(
+                info.width / target_size.width(),
+                info.height / target_size.height()
+            )
+        );
+    }
 
     if (info.mapsToBinaryOrIndexed8())
     {
         // Common case optimization.
-        image = extractBinaryOrIndexed8Image(tif, info);
+        return extractBinaryOrIndexed8Image(tif, info, downscale);
     }
     else
     {
         // General case.
-        image = QImage(
-                    info.width, info.height,
-                    info.samples_per_pixel == 3
-                    ? QImage::Format_RGB32 : QImage::Format_ARGB32
-                );
-        if (image.isNull())
-        {
-            throw std::bad_alloc();
-        }
-
-        // For ABGR -> ARGB conversion.
-        TiffBuffer<uint32_t> tmp_buffer;
-        uint32_t const* src_line = 0;
-
-        if (image.bytesPerLine() == 4 * info.width)
-        {
-            // We can avoid creating a temporary buffer in this case.
-            if (!TIFFReadRGBAImageOriented(tif.handle(), info.width, info.height,
-                                           (uint32_t*)image.bits(), ORIENTATION_TOPLEFT, 0))
-            {
-                return QImage();
-            }
-            src_line = (uint32_t const*)image.bits();
-        }
-        else
-        {
-            TiffBuffer<uint32_t>(info.width * info.height).swap(tmp_buffer);
-            if (!TIFFReadRGBAImageOriented(tif.handle(), info.width, info.height,
-                                           tmp_buffer.data(), ORIENTATION_TOPLEFT, 0))
-            {
-                return QImage();
-            }
-            src_line = tmp_buffer.data();
-        }
-
-        uint32_t* dst_line = (uint32_t*)image.bits();
-        assert(image.bytesPerLine() % 4 == 0);
-        int const dst_stride = image.bytesPerLine() / 4;
-        for (int y = 0; y < info.height; ++y)
-        {
-            convertAbgrToArgb(src_line, dst_line, info.width);
-            src_line += info.width;
-            dst_line += dst_stride;
-        }
+        return extractRgbaImage(tif, info, downscale);
     }
-
-    return image;
 }
 
 TiffReader::TiffHeader
@@ -463,24 +573,10 @@ TiffReader::currentPageMetadata(TiffHandle const& tif)
 
 QImage
 TiffReader::extractBinaryOrIndexed8Image(
-    TiffHandle const& tif, TiffInfo const& info)
+    TiffHandle const& tif, TiffInfo const& info, int const downscale)
 {
-    QImage::Format format = QImage::Format_Indexed8;
-    if (info.bits_per_sample == 1)
-    {
-        // Because we specify B option when opening, we can
-        // always use Format_Mono, and not Format_MonoLSB.
-        format = QImage::Format_Mono;
-    }
-
-    QImage image(info.width, info.height, format);
-    if (image.isNull())
-    {
-        throw std::bad_alloc();
-    }
-
     int const num_colors = 1 << info.bits_per_sample;
-    image.setColorCount(num_colors);
+    QVector<QRgb> color_table(num_colors);
 
     if (info.photometric == PHOTOMETRIC_PALETTE)
     {
@@ -505,7 +601,7 @@ TiffReader::extractBinaryOrIndexed8Image(
             uint32_t const g = (uint32_t)(pg[i] * f + 0.5);
             uint32_t const b = (uint32_t)(pb[i] * f + 0.5);
             uint32_t const a = 0xFF000000;
-            image.setColor(i, a | (r << 16) | (g << 8) | b);
+            color_table[i] = a | (r << 16) | (g << 8) | b;
         }
     }
     else if (info.photometric == PHOTOMETRIC_MINISBLACK)
@@ -514,7 +610,7 @@ TiffReader::extractBinaryOrIndexed8Image(
         for (int i = 0; i < num_colors; ++i)
         {
             int const gray = (int)(i * f + 0.5);
-            image.setColor(i, qRgb(gray, gray, gray));
+            color_table[i] = qRgb(gray, gray, gray);
         }
     }
     else if (info.photometric == PHOTOMETRIC_MINISWHITE)
@@ -524,7 +620,7 @@ TiffReader::extractBinaryOrIndexed8Image(
         for (int i = 0; i < num_colors; ++i, --c)
         {
             int const gray = (int)(c * f + 0.5);
-            image.setColor(i, qRgb(gray, gray, gray));
+            color_table[i] = qRgb(gray, gray, gray);
         }
     }
     else
@@ -532,60 +628,270 @@ TiffReader::extractBinaryOrIndexed8Image(
         return QImage();
     }
 
-    if (info.bits_per_sample == 1 || info.bits_per_sample == 8)
+    if (downscale > 1)
+    {
+        QImage image(
+            (info.width + downscale - 1) / downscale,
+            (info.height + downscale - 1) / downscale,
+            QImage::Format_Indexed8
+        );
+        if (image.isNull())
+        {
+            throw std::bad_alloc();
+        }
+
+        std::vector<uint8_t> gray_levels;
+        if (info.photometric == PHOTOMETRIC_PALETTE)
+        {
+            image.setColorTable(color_table);
+        }
+        else
+        {
+            // Averaging produces intermediate shades, so even bilevel
+            // images become 8-bit grayscale.
+            QVector<QRgb> gray_table(256);
+            for (int i = 0; i < 256; ++i)
+            {
+                gray_table[i] = qRgb(i, i, i);
+            }
+            image.setColorTable(gray_table);
+
+            gray_levels.resize(num_colors);
+            for (int i = 0; i < num_colors; ++i)
+            {
+                gray_levels[i] = static_cast<uint8_t>(qGray(color_table[i]));
+            }
+        }
+
+        readAndDownscaleLines(tif, info, gray_levels, downscale, image);
+        return image;
+    }
+
+    QImage::Format format = QImage::Format_Indexed8;
+    if (info.bits_per_sample == 1)
     {
-        readLines(tif, image);
+        // Because we specify B option when opening, we can
+        // always use Format_Mono, and not Format_MonoLSB.
+        format = QImage::Format_Mono;
     }
-    else
+
+    QImage image(info.width, info.height, format);
+    if (image.isNull())
     {
-        readAndUnpackLines(tif, info, image);
+        throw std::bad_alloc();
     }
+    image.setColorTable(color_table);
+
+    readLines(tif, info, image);
 
     return image;
 }
 
 void
-TiffReader::readLines(TiffHandle const& tif, QImage& image)
+TiffReader::readLines(
+    TiffHandle const& tif, TiffInfo const& info, QImage& image)
 {
+    LineReader reader(tif, info);
+
+    int const bits_per_sample = info.bits_per_sample;
+    int const width = image.width();
     int const height = image.height();
+    int const bytes = (width * bits_per_sample + 7) / 8;
+
     for (int y = 0; y < height; ++y)
     {
-        TIFFReadScanline(tif.handle(), image.scanLine(y), y);
+        uint8_t const* src = reader.readLine(y);
+        uint8_t* dst = (uint8_t*)image.scanLine(y);
+        if (bits_per_sample == 1 || bits_per_sample == 8)
+        {
+            memcpy(dst, src, bytes);
+        }
+        else
+        {
+            unpackSamples(src, bits_per_sample, width, dst);
+        }
     }
 }
 
 void
-TiffReader::readAndUnpackLines(
-    TiffHandle const& tif, TiffInfo const& info, QImage& image)
+TiffReader::readAndDownscaleLines(
+    TiffHandle const& tif, TiffInfo const& info,
+    std::vector<uint8_t> const& gray_levels, int const downscale, QImage& image)
 {
-    TiffBuffer<uint8_t> buf(TIFFScanlineSize(tif.handle()));
+    LineReader reader(tif, info);
 
-    int const width = image.width();
-    int const height = image.height();
-    int const bits_per_sample = info.bits_per_sample;
-    unsigned const dst_mask = (1 << bits_per_sample) - 1;
+    int const width = info.width;
+    int const height = info.height;
+    int const dst_width = image.width();
+    int const dst_height = image.height();
+    std::vector<uint8_t> samples(width);
 
-    for (int y = 0; y < height; ++y)
+    if (gray_levels.empty())
     {
-        TIFFReadScanline(tif.handle(), buf.data(), y);
+        // A palette image.  Averaging indices makes no sense,
+        // so we only read the rows we keep.
+        for (int dst_y = 0; dst_y < dst_height; ++dst_y)
+        {
+            uint8_t const* src = reader.readLine(dst_y * downscale);
+            unpackSamples(src, info.bits_per_sample, width, &samples[0]);
 
-        unsigned accum = 0;
-        int bits_in_accum = 0;
+            uint8_t* dst = (uint8_t*)image.scanLine(dst_y);
+            for (int dst_x = 0; dst_x < dst_width; ++dst_x)
+            {
+                dst[dst_x] = samples[dst_x * downscale];
+            }
+        }
+        return;
+    }
 
-        uint8_t const* src = buf.data();
-        uint8_t* dst = (uint8_t*)image.scanLine(y);
+    std::vector<unsigned> sums(dst_width);
+    for (int dst_y = 0; dst_y < dst_height; ++dst_y)
+    {
+        int const y0 = dst_y * downscale;
+        int const y1 = std::min(y0 + downscale, height);
+        std::fill(sums.begin(), sums.end(), 0u);
 
-        for (int i = width; i > 0; --i, ++dst)
+        for (int y = y0; y < y1; ++y)
         {
-            while (bits_in_accum < bits_per_sample)
+            uint8_t const* src = reader.readLine(y);
+            unpackSamples(src, info.bits_per_sample, width, &samples[0]);
+            for (int x = 0; x < width; ++x)
             {
-                accum <<= 8;
-                accum |= *src;
-                bits_in_accum += 8;
-                ++src;
+                sums[x / downscale] += gray_levels[samples[x]];
             }
-            bits_in_accum -= bits_per_sample;
-            *dst = static_cast<uint8_t>((accum >> bits_in_accum) & dst_mask);
+        }
+
+        uint8_t* dst = (uint8_t*)image.scanLine(dst_y);
+        for (int dst_x = 0; dst_x < dst_width; ++dst_x)
+        {
+            int const block_width = std::min(downscale, width - dst_x * downscale);
+            unsigned const count = block_width * (y1 - y0);
+            dst[dst_x] = static_cast<uint8_t>((sums[dst_x] + count / 2) / count);
         }
     }
 }
+
+QImage
+TiffReader::extractRgbaImage(
+    TiffHandle const& tif, TiffInfo const& info, int const downscale)
+{
+    char emsg[1024];
+    TIFFRGBAImage img;
+    if (!TIFFRGBAImageOK(tif.handle(), emsg) ||
+        !TIFFRGBAImageBegin(&img, tif.handle(), 0, emsg))
+    {
+        return QImage();
+    }
+
+    class RgbaImageEnd
+    {
+    public:
+        RgbaImageEnd(TIFFRGBAImage* img) : m_pImg(img) {}
+
+        ~RgbaImageEnd()
+        {
+            TIFFRGBAImageEnd(m_pImg);
+        }
+    private:
+        TIFFRGBAImage* m_pImg;
+    };
+    RgbaImageEnd const img_end(&img);
+
+    img.req_orientation = ORIENTATION_TOPLEFT;
+
+    int const width = info.width;
+    int const height = info.height;
+
+    QImage image(
+        (width + downscale - 1) / downscale,
+        (height + downscale - 1) / downscale,
+        info.samples_per_pixel == 3
+        ? QImage::Format_RGB32 : QImage::Format_ARGB32
+    );
+    if (image.isNull())
+    {
+        throw std::bad_alloc();
+    }
+    assert(image.bytesPerLine() == 4 * image.width());
+
+    uint32_t rows_per_block = 0;
+    if (TIFFIsTiled(tif.handle()))
+    {
+        TIFFGetField(tif.handle(), TIFFTAG_TILELENGTH, &rows_per_block);
+    }
+    else
+    {
+        TIFFGetFieldDefaulted(tif.handle(), TIFFTAG_ROWSPERSTRIP, &rows_per_block);
+    }
+    int const block_rows = int(std::min<uint32_t>(std::max<uint32_t>(rows_per_block, 1), height));
+
+    TiffBuffer<uint32_t> band;
+    std::vector<unsigned> sums;
+    int const dst_width = image.width();
+    if (downscale > 1)
+    {
+        TiffBuffer<uint32_t>(tsize_t(width) * (block_rows + downscale)).swap(band);
+        sums.resize(dst_width * 4);
+    }
+
+    for (int y = 0; y < height;)
+    {
+        // Bands end on strip or tile boundaries, so that every strip or
+        // tile gets decoded only once, extended to whole downscaling blocks.
+        int end = std::min(height, (y / block_rows + 1) * block_rows);
+        end = std::min(height, (end + downscale - 1) / downscale * downscale);
+        int const rows = end - y;
+
+        img.row_offset = y;
+        uint32_t* const raster = downscale == 1
+                                 ? (uint32_t*)image.scanLine(y) : band.data();
+        if (!TIFFRGBAImageGet(&img, raster, width, rows))
+        {
+            return QImage();
+        }
+
+        if (downscale == 1)
+        {
+            // The bands are stored right where they belong, so we convert in place.
+            convertAbgrToArgb(raster, raster, width * rows);
+            y = end;
+            continue;
+        }
+
+        for (int band_y = 0; band_y < rows; band_y += downscale)
+        {
+            int const block_height = std::min(downscale, rows - band_y);
+            std::fill(sums.begin(), sums.end(), 0u);
+
+            for (int i = 0; i < block_height; ++i)
+            {
+                uint32_t const* src = raster + size_t(width) * (band_y + i);
+                for (int x = 0; x < width; ++x)
+                {
+                    uint32_t const abgr = src[x];
+                    unsigned* sum = &sums[(x / downscale) * 4];
+                    sum[0] += TIFFGetR(abgr);
+                    sum[1] += TIFFGetG(abgr);
+                    sum[2] += TIFFGetB(abgr);
+                    sum[3] += TIFFGetA(abgr);
+                }
+            }
+
+            QRgb* dst = (QRgb*)image.scanLine((y + band_y) / downscale);
+            for (int dst_x = 0; dst_x < dst_width; ++dst_x)
+            {
+                int const block_width = std::min(downscale, width - dst_x * downscale);
+                unsigned const count = block_width * block_height;
+                unsigned const* sum = &sums[dst_x * 4];
+                dst[dst_x] = qRgba(
+                                 (sum[0] + count / 2) / count, (sum[1] + count / 2) / count,
+                                 (sum[2] + count / 2) / count, (sum[3] + count / 2) / count
+                             );
+            }
+        }
+
+        y = end;
+    }
+
+    return image;
+}
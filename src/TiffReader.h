@@ -21,9 +21,12 @@
 
 #include "ImageMetadataLoader.h"
 #include "VirtualFunction.h"
+#include <vector>
+#include <stdint.h>
 
 class QIODevice;
 class QImage;
+class QSize;
 class ImageMetadata;
 
 class TiffReader
@@ -45,11 +48,27 @@ public:
      * \return The resulting image, or a null image in case of failure.
      */
     static QImage readImage(QIODevice& device, int page_num = 0);
+
+    /**
+     * \brief Reads the whole image, subsampled while decoding.
+     *
+     * Each block of N x N pixels becomes a single pixel, N being the
+     * largest factor that still leaves the image at least as large as
+     * \p target_size.  Gray and color blocks are averaged, with bilevel
+     * images becoming grayscale, while palette images keep the top-left
+     * pixel of each block.
+     */
+    static QImage readDownscaledImage(
+        QIODevice& device, int page_num, QSize const& target_size);
 private:
+    static QImage readImageImpl(
+        QIODevice& device, int page_num, QSize const& target_size);
+
     class TiffHeader;
     class TiffHandle;
     struct TiffInfo;
     template<typename T> class TiffBuffer;
+    class LineReader;
 
     static TiffHeader readHeader(QIODevice& device);
 
@@ -58,12 +77,17 @@ private:
     static ImageMetadata currentPageMetadata(TiffHandle const& tif);
 
     static QImage extractBinaryOrIndexed8Image(
-        TiffHandle const& tif, TiffInfo const& info);
-
-    static void readLines(TiffHandle const& tif, QImage& image);
+        TiffHandle const& tif, TiffInfo const& info, int downscale);
 
-    static void readAndUnpackLines(
+    static void readLines(
         TiffHandle const& tif, TiffInfo const& info, QImage& image);
+
+    static void readAndDownscaleLines(
+        TiffHandle const& tif, TiffInfo const& info,
+        std::vector<uint8_t> const& gray_levels, int downscale, QImage& image);
+
+    static QImage extractRgbaImage(
+        TiffHandle const& tif, TiffInfo const& info, int downscale);
 };
 
 #endif
@@ -17,8 +17,11 @@
 */
 
 #include "TiffWriter.h"
+#include "ParallelFor.h"
 #include "imageproc/Constants.h"
 #include <QtGlobal>
+#include <QBuffer>
+#include <QByteArray>
 #include <QFile>
 #include <QIODevice>
 #include <QImage>
@@ -26,7 +29,9 @@
 #include <QVector>
 #include <QSize>
 #include <QDebug>
+#include <QThreadPool>
 #include <vector>
+#include <algorithm>
 #include <tiff.h>
 #include <tiffio.h>
 #include <string.h>
@@ -36,6 +41,13 @@
 
 #define TIFF_DEFAULT_DPI 96.0f
 
+/**
+ * The uncompressed size we aim for when splitting an image into strips.
+ * Small enough to give every thread a few strips of a typical page,
+ * large enough to keep the per-strip overhead negligible.
+ */
+#define TIFF_STRIP_BYTES (256 * 1024)
+
 /**
  * m_reverseBitsLUT[byte] gives the same byte, but with bit order reversed.
  */
@@ -156,7 +168,8 @@ static void deviceUnmap(thandle_t, tdata_t, toff_t)
 }
 
 bool
-TiffWriter::writeImage(QString const& file_path, QImage const& image)
+TiffWriter::writeImage(QString const& file_path, QImage const& image,
+                       TiffCompression const& compression)
 {
     if (image.isNull())
     {
@@ -169,7 +182,7 @@ TiffWriter::writeImage(QString const& file_path, QImage const& image)
         return false;
     }
 
-    if (!writeImage(file, image))
+    if (!writeImage(file, image, compression))
     {
         file.remove();
         return false;
@@ -179,7 +192,8 @@ TiffWriter::writeImage(QString const& file_path, QImage const& image)
 }
 
 bool
-TiffWriter::writeImage(QIODevice& device, QImage const& image)
+TiffWriter::writeImage(QIODevice& device, QImage const& image,
+                       TiffCompression const& compression)
 {
     if (image.isNull())
     {
@@ -221,7 +235,7 @@ TiffWriter::writeImage(QIODevice& device, QImage const& image)
     case QImage::Format_Mono:
     case QImage::Format_MonoLSB:
     case QImage::Format_Indexed8:
-        return writeBitonalOrIndexed8Image(tif, image);
+        return writeBitonalOrIndexed8Image(tif, image, compression);
     default:
         ;
     }
@@ -229,24 +243,22 @@ TiffWriter::writeImage(QIODevice& device, QImage const& image)
     if (image.hasAlphaChannel())
     {
         return writeARGB32Image(
-                   tif, image.convertToFormat(QImage::Format_ARGB32)
+                   tif, image.convertToFormat(QImage::Format_ARGB32), compression
                );
     }
     else
     {
         return writeRGB32Image(
-                   tif, image.convertToFormat(QImage::Format_RGB32)
+                   tif, image.convertToFormat(QImage::Format_RGB32), compression
                );
     }
 }
 
 bool
 TiffWriter::writeBitonalOrIndexed8Image(
-    TiffHandle const& tif, QImage const& image)
+    TiffHandle const& tif, QImage const& image,
+    TiffCompression const& compression)
 {
-    TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, uint16_t(1));
-
-    uint16_t compression = COMPRESSION_LZW;
     uint16_t bits_per_sample = 8;
     uint16_t photometric = PHOTOMETRIC_PALETTE;
     if (image.isGrayscale())
@@ -258,9 +270,6 @@ TiffWriter::writeBitonalOrIndexed8Image(
     {
     case QImage::Format_Mono:
     case QImage::Format_MonoLSB:
-        // Don't use CCITTFAX4 compression, as Photoshop
-        // has problems with it.
-        compression = COMPRESSION_CCITTFAX4;
         bits_per_sample = 1;
         if (image.colorCount() < 2)
         {
@@ -287,9 +296,8 @@ TiffWriter::writeBitonalOrIndexed8Image(
         ;
     }
 
-    TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, compression);
-    TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, bits_per_sample);
-    TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, photometric);
+    Format const format(makeFormat(1, bits_per_sample, photometric, compression));
+    setFormatFields(tif, format);
 
     if (photometric == PHOTOMETRIC_PALETTE)
     {
@@ -314,175 +322,320 @@ TiffWriter::writeBitonalOrIndexed8Image(
 
     if (image.format() == QImage::Format_Indexed8)
     {
-        return write8bitLines(tif, image);
+        int const width = image.width();
+        return writeStrips(
+            tif, image, format, width,
+            [&image, width](int y, uint8_t* line)
+            {
+                memcpy(line, image.scanLine(y), width);
+            }
+        );
+    }
+
+    int const bpl = (image.width() + 7) / 8;
+    if (image.format() == QImage::Format_MonoLSB)
+    {
+        return writeStrips(
+            tif, image, format, bpl,
+            [&image, bpl](int y, uint8_t* line)
+            {
+                uint8_t const* src_line = image.scanLine(y);
+                for (int i = 0; i < bpl; ++i)
+                {
+                    line[i] = m_reverseBitsLUT[src_line[i]];
+                }
+            }
+        );
     }
     else
     {
-        if (image.format() == QImage::Format_MonoLSB)
-        {
-            return writeBinaryLinesReversed(tif, image);
-        }
-        else
-        {
-            return writeBinaryLinesAsIs(tif, image);
-        }
+        return writeStrips(
+            tif, image, format, bpl,
+            [&image, bpl](int y, uint8_t* line)
+            {
+                memcpy(line, image.scanLine(y), bpl);
+            }
+        );
     }
 }
 
 bool
 TiffWriter::writeRGB32Image(
-    TiffHandle const& tif, QImage const& image)
+    TiffHandle const& tif, QImage const& image,
+    TiffCompression const& compression)
 {
     assert(image.format() == QImage::Format_RGB32);
 
-    TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, uint16_t(3));
-    TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, COMPRESSION_LZW);
-    TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, uint16_t(8));
-    TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+    Format const format(makeFormat(3, 8, PHOTOMETRIC_RGB, compression));
+    setFormatFields(tif, format);
 
     int const width = image.width();
-    int const height = image.height();
-
-    std::vector<uint8_t> tmp_line(width * 3);
 
     // Libtiff expects "RR GG BB" sequences regardless of CPU byte order.
 
-    for (int y = 0; y < height; ++y)
-    {
-        uint32_t const* p_src = (uint32_t const*)image.scanLine(y);
-        uint8_t* p_dst = &tmp_line[0];
-        for (int x = 0; x < width; ++x)
-        {
-            uint32_t const ARGB = *p_src;
-            p_dst[0] = static_cast<uint8_t>(ARGB >> 16);
-            p_dst[1] = static_cast<uint8_t>(ARGB >> 8);
-            p_dst[2] = static_cast<uint8_t>(ARGB);
-            ++p_src;
-            p_dst += 3;
-        }
-        if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1)
+    return writeStrips(
+        tif, image, format, width * 3,
+        [&image, width](int y, uint8_t* p_dst)
         {
-            return false;
+            uint32_t const* p_src = (uint32_t const*)image.scanLine(y);
+            for (int x = 0; x < width; ++x)
+            {
+                uint32_t const ARGB = *p_src;
+                p_dst[0] = static_cast<uint8_t>(ARGB >> 16);
+                p_dst[1] = static_cast<uint8_t>(ARGB >> 8);
+                p_dst[2] = static_cast<uint8_t>(ARGB);
+                ++p_src;
+                p_dst += 3;
+            }
         }
-    }
-
-    return true;
+    );
 }
 
 bool
 TiffWriter::writeARGB32Image(
-    TiffHandle const& tif, QImage const& image)
+    TiffHandle const& tif, QImage const& image,
+    TiffCompression const& compression)
 {
     assert(image.format() == QImage::Format_ARGB32);
 
-    TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, uint16_t(4));
-    TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, COMPRESSION_LZW);
-    TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, uint16_t(8));
-    TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+    Format const format(makeFormat(4, 8, PHOTOMETRIC_RGB, compression));
+    setFormatFields(tif, format);
 
     int const width = image.width();
-    int const height = image.height();
-
-    std::vector<uint8_t> tmp_line(width * 4);
 
     // Libtiff expects "RR GG BB AA" sequences regardless of CPU byte order.
 
-    for (int y = 0; y < height; ++y)
-    {
-        uint32_t const* p_src = (uint32_t const*)image.scanLine(y);
-        uint8_t* p_dst = &tmp_line[0];
-        for (int x = 0; x < width; ++x)
+    return writeStrips(
+        tif, image, format, width * 4,
+        [&image, width](int y, uint8_t* p_dst)
         {
-            uint32_t const ARGB = *p_src;
-            p_dst[0] = static_cast<uint8_t>(ARGB >> 16);
-            p_dst[1] = static_cast<uint8_t>(ARGB >> 8);
-            p_dst[2] = static_cast<uint8_t>(ARGB);
-            p_dst[3] = static_cast<uint8_t>(ARGB >> 24);
-            ++p_src;
-            p_dst += 4;
+            uint32_t const* p_src = (uint32_t const*)image.scanLine(y);
+            for (int x = 0; x < width; ++x)
+            {
+                uint32_t const ARGB = *p_src;
+                p_dst[0] = static_cast<uint8_t>(ARGB >> 16);
+                p_dst[1] = static_cast<uint8_t>(ARGB >> 8);
+                p_dst[2] = static_cast<uint8_t>(ARGB);
+                p_dst[3] = static_cast<uint8_t>(ARGB >> 24);
+                ++p_src;
+                p_dst += 4;
+            }
         }
-        if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1)
+    );
+}
+
+TiffWriter::Format
+TiffWriter::makeFormat(
+    uint16_t const samples_per_pixel, uint16_t const bits_per_sample,
+    uint16_t const photometric, TiffCompression const& compression)
+{
+    Format format;
+    format.samplesPerPixel = samples_per_pixel;
+    format.bitsPerSample = bits_per_sample;
+    format.photometric = photometric;
+    format.predictor = PREDICTOR_NONE;
+    format.level = compression.level();
+
+    if (bits_per_sample == 1)
+    {
+        // Don't use CCITTFAX4 compression, as Photoshop
+        // has problems with it.
+        format.compression = COMPRESSION_CCITTFAX4;
+        return format;
+    }
+
+    switch (compression.codec())
+    {
+    case TiffCompression::NONE:
+        format.compression = COMPRESSION_NONE;
+        break;
+    case TiffCompression::PACKBITS:
+        format.compression = COMPRESSION_PACKBITS;
+        break;
+    case TiffCompression::ZSTD:
+#ifdef COMPRESSION_ZSTD
+        if (TIFFIsCODECConfigured(COMPRESSION_ZSTD))
         {
-            return false;
+            format.compression = COMPRESSION_ZSTD;
+            break;
         }
+#endif
+        // Fall back to the closest codec every libtiff build has.
+        format.compression = COMPRESSION_ADOBE_DEFLATE;
+        format.level = std::min(format.level, TiffCompression::maxLevel(TiffCompression::DEFLATE));
+        break;
+    case TiffCompression::DEFLATE:
+        format.compression = COMPRESSION_ADOBE_DEFLATE;
+        break;
+    case TiffCompression::LZW:
+    default:
+        format.compression = COMPRESSION_LZW;
+        break;
     }
 
-    return true;
+    if (format.compression != COMPRESSION_LZW &&
+        format.compression != COMPRESSION_NONE &&
+        format.compression != COMPRESSION_PACKBITS &&
+        photometric != PHOTOMETRIC_PALETTE)
+    {
+        // Differences of neighbouring samples compress much better
+        // than the samples themselves on scanned material.  LZW, being
+        // the default, stays without one, so that the files written
+        // by default don't change.
+        format.predictor = PREDICTOR_HORIZONTAL;
+    }
+
+    return format;
 }
 
-bool
-TiffWriter::write8bitLines(
-    TiffHandle const& tif, QImage const& image)
+void
+TiffWriter::setFormatFields(TiffHandle const& tif, Format const& format)
 {
-    int const width = image.width();
-    int const height = image.height();
-
-    // TIFFWriteScanline() can actually modify the data you pass it,
-    // so we have to use a temporary buffer even when no coversion
-    // is required.
-    std::vector<uint8_t> tmp_line(width, 0);
+    TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, format.samplesPerPixel);
+    TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, format.bitsPerSample);
+    TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, format.photometric);
+    TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, format.compression);
+    if (format.predictor != PREDICTOR_NONE)
+    {
+        TIFFSetField(tif.handle(), TIFFTAG_PREDICTOR, format.predictor);
+    }
 
-    for (int y = 0; y < height; ++y)
+    // Codec specific pseudo-tags have to follow TIFFTAG_COMPRESSION.
+    if (format.level > 0)
     {
-        uint8_t const* src_line = image.scanLine(y);
-        memcpy(&tmp_line[0], src_line, tmp_line.size());
-        if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1)
+        if (format.compression == COMPRESSION_ADOBE_DEFLATE)
+        {
+            TIFFSetField(tif.handle(), TIFFTAG_ZIPQUALITY, format.level);
+        }
+#ifdef COMPRESSION_ZSTD
+        else if (format.compression == COMPRESSION_ZSTD)
         {
-            return false;
+            TIFFSetField(tif.handle(), TIFFTAG_ZSTD_LEVEL, format.level);
         }
+#endif
     }
-
-    return true;
 }
 
 bool
-TiffWriter::writeBinaryLinesAsIs(
-    TiffHandle const& tif, QImage const& image)
+TiffWriter::writeStrips(
+    TiffHandle const& tif, QImage const& image, Format const& format,
+    int const bytes_per_line, LinePacker const& pack_line)
 {
     int const width = image.width();
     int const height = image.height();
+    int const rows_per_strip = qBound(1, TIFF_STRIP_BYTES / std::max(bytes_per_line, 1), height);
+    int const num_strips = (height + rows_per_strip - 1) / rows_per_strip;
+    TIFFSetField(tif.handle(), TIFFTAG_ROWSPERSTRIP, uint32_t(rows_per_strip));
 
-    // TIFFWriteScanline() can actually modify the data you pass it,
-    // so we have to use a temporary buffer even when no coversion
-    // is required.
-    int const bpl = (width + 7) / 8;
-    std::vector<uint8_t> tmp_line(bpl, 0);
+    // Compress a few strips per thread at a time, then append them
+    // in order.  This bounds the memory held by compressed strips
+    // waiting to be written.
+    int const batch_size = std::max(1, QThreadPool::globalInstance()->maxThreadCount()) * 4;
+    std::vector<QByteArray> strips;
 
-    for (int y = 0; y < height; ++y)
+    for (int first = 0; first < num_strips; first += batch_size)
     {
-        uint8_t const* src_line = image.scanLine(y);
-        memcpy(&tmp_line[0], src_line, bpl);
-        if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1)
+        int const last = std::min(first + batch_size, num_strips);
+        strips.assign(last - first, QByteArray());
+
+        parallelFor(
+            first, last, 1,
+            [&](int const begin, int const end)
+            {
+                for (int strip = begin; strip < end; ++strip)
+                {
+                    int const first_row = strip * rows_per_strip;
+                    int const num_rows = std::min(rows_per_strip, height - first_row);
+                    strips[strip - first] = encodeStrip(
+                        format, width, first_row, num_rows, bytes_per_line, pack_line
+                    );
+                }
+            }
+        );
+
+        for (int strip = first; strip < last; ++strip)
         {
-            return false;
+            QByteArray& data = strips[strip - first];
+            if (data.isEmpty())
+            {
+                return false;
+            }
+            if (TIFFWriteRawStrip(tif.handle(), strip, data.data(), data.size()) == -1)
+            {
+                return false;
+            }
         }
     }
 
     return true;
 }
 
-bool
-TiffWriter::writeBinaryLinesReversed(
-    TiffHandle const& tif, QImage const& image)
+/**
+ * Compresses a strip by writing it as a single strip image into
+ * a memory buffer, which lets every thread use its own libtiff handle
+ * and any codec libtiff was built with.  Libtiff has no public
+ * interface to its codecs other than that.  Strips are encoded
+ * independently of each other, so the result is the same as if
+ * the whole image had been written by a single handle.
+ * \return The compressed strip, or an empty array on failure.
+ */
+QByteArray
+TiffWriter::encodeStrip(
+    Format const& format, int const width, int const first_row,
+    int const num_rows, int const bytes_per_line, LinePacker const& pack_line)
 {
-    int const width = image.width();
-    int const height = image.height();
+    // TIFFWriteEncodedStrip() can actually modify the data you pass it,
+    // so the packed rows go to a buffer we own even when no conversion
+    // is required.
+    std::vector<uint8_t> rows(size_t(bytes_per_line) * num_rows);
+    for (int i = 0; i < num_rows; ++i)
+    {
+        pack_line(first_row + i, &rows[size_t(bytes_per_line) * i]);
+    }
 
-    int const bpl = (width + 7) / 8;
-    std::vector<uint8_t> tmp_line(bpl, 0);
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
 
-    for (int y = 0; y < height; ++y)
+    TiffHandle tif(
+        TIFFClientOpen(
+            "strip", "wBm", &buffer, &deviceRead, &deviceWrite,
+            &deviceSeek, &deviceClose, &deviceSize,
+            &deviceMap, &deviceUnmap
+        )
+    );
+    if (!tif.handle())
     {
-        uint8_t const* src_line = image.scanLine(y);
-        for (int i = 0; i < bpl; ++i)
-        {
-            tmp_line[i] = m_reverseBitsLUT[src_line[i]];
-        }
-        if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1)
-        {
-            return false;
-        }
+        return QByteArray();
     }
 
-    return true;
+    Format strip_format(format);
+    if (strip_format.photometric == PHOTOMETRIC_PALETTE)
+    {
+        // Encoding doesn't depend on the palette, so spare us setting one.
+        strip_format.photometric = PHOTOMETRIC_MINISBLACK;
+    }
+
+    TIFFSetField(tif.handle(), TIFFTAG_IMAGEWIDTH, uint32_t(width));
+    TIFFSetField(tif.handle(), TIFFTAG_IMAGELENGTH, uint32_t(num_rows));
+    TIFFSetField(tif.handle(), TIFFTAG_ROWSPERSTRIP, uint32_t(num_rows));
+    TIFFSetField(tif.handle(), TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
+    TIFFSetField(tif.handle(), TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    setFormatFields(tif, strip_format);
+
+    if (TIFFWriteEncodedStrip(tif.handle(), 0, &rows[0], rows.size()) == -1)
+    {
+        return QByteArray();
+    }
+
+    // The strip went to the buffer right away, while the directory
+    // only gets written on close.
+    toff_t* offsets = 0;
+    TIFFGetField(tif.handle(), TIFFTAG_STRIPOFFSETS, &offsets);
+    tsize_t const size = TIFFRawStripSize(tif.handle(), 0);
+    if (!offsets || size <= 0 || offsets[0] + size > toff_t(buffer.data().size()))
+    {
+        return QByteArray();
+    }
+
+    return buffer.data().mid(int(offsets[0]), int(size));
 }
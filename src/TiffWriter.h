@@ -19,12 +19,15 @@
 #ifndef TIFFWRITER_H_
 #define TIFFWRITER_H_
 
+#include "TiffCompression.h"
+#include <functional>
 #include <stdint.h>
 #include <stddef.h>
 
 class QIODevice;
 class QString;
 class QImage;
+class QByteArray;
 class Dpm;
 
 class TiffWriter
@@ -35,39 +38,72 @@ public:
      *
      * \param file_path The full path to the file.
      * \param image The image to write.  Writing a null image will fail.
+     * \param compression The codec for gray and color images.
      * \return True on success, false on failure.
      */
-    static bool writeImage(QString const& file_path, QImage const& image);
+    static bool writeImage(QString const& file_path, QImage const& image,
+                           TiffCompression const& compression = TiffCompression());
 
     /**
      * \brief Writes a QImage in TIFF format to an IO device.
      *
+     * The image is written in strips of several rows, which are
+     * compressed in parallel.
+     *
      * \param device The device to write to.  This device must be
      *        opened for writing and seekable.
      * \param image The image to write.  Writing a null image will fail.
+     * \param compression The codec for gray and color images.
      * \return True on success, false on failure.
      */
-    static bool writeImage(QIODevice& device, QImage const& image);
+    static bool writeImage(QIODevice& device, QImage const& image,
+                           TiffCompression const& compression = TiffCompression());
 private:
     class TiffHandle;
 
+    /**
+     * The fields that determine how the strips are encoded.
+     */
+    struct Format
+    {
+        uint16_t samplesPerPixel;
+        uint16_t bitsPerSample;
+        uint16_t photometric;
+        uint16_t compression;
+        uint16_t predictor;
+        int level;
+    };
+
+    /**
+     * Packs row y of the image into the TIFF sample layout.
+     */
+    typedef std::function<void(int y, uint8_t* line)> LinePacker;
+
     static bool writeBitonalOrIndexed8Image(
-        TiffHandle const& tif, QImage const& image);
+        TiffHandle const& tif, QImage const& image,
+        TiffCompression const& compression);
 
     static bool writeRGB32Image(
-        TiffHandle const& tif, QImage const& image);
+        TiffHandle const& tif, QImage const& image,
+        TiffCompression const& compression);
 
     static bool writeARGB32Image(
-        TiffHandle const& tif, QImage const& image);
+        TiffHandle const& tif, QImage const& image,
+        TiffCompression const& compression);
+
+    static Format makeFormat(
+        uint16_t samples_per_pixel, uint16_t bits_per_sample,
+        uint16_t photometric, TiffCompression const& compression);
 
-    static bool write8bitLines(
-        TiffHandle const& tif, QImage const& image);
+    static void setFormatFields(TiffHandle const& tif, Format const& format);
 
-    static bool writeBinaryLinesAsIs(
-        TiffHandle const& tif, QImage const& image);
+    static bool writeStrips(
+        TiffHandle const& tif, QImage const& image, Format const& format,
+        int bytes_per_line, LinePacker const& pack_line);
 
-    static bool writeBinaryLinesReversed(
-        TiffHandle const& tif, QImage const& image);
+    static QByteArray encodeStrip(
+        Format const& format, int width, int first_row, int num_rows,
+        int bytes_per_line, LinePacker const& pack_line);
 
     static uint8_t const m_reverseBitsLUT[256];
 };
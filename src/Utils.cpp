@@ -17,6 +17,8 @@
 */
 
 #include "Utils.h"
+#include "ProcessingProfiler.h"
+#include <QSettings>
 #include <QString>
 #include <QByteArray>
 #include <QFile>
@@ -87,3 +89,17 @@ Utils::createThumbnailCache(QString const& output_dir,
            );
 }
 
+void
+Utils::applyProfilingSettings()
+{
+    QSettings settings;
+    QString const file_path(settings.value("settings/profile_file").toString());
+    if (settings.value("settings/enable_profiling", false).toBool() && !file_path.isEmpty())
+    {
+        ProcessingProfiler::start(file_path);
+    }
+    else
+    {
+        ProcessingProfiler::stop();
+    }
+}
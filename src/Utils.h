@@ -46,6 +46,13 @@ public:
     static IntrusivePtr<ThumbnailPixmapCache> createThumbnailCache(
         QString const& output_dir, std::shared_ptr<AcceleratableOperations> const& accel_ops);
 
+    /**
+     * \brief Starts or stops ProcessingProfiler according to
+     *        the "settings/enable_profiling" and "settings/profile_file"
+     *        settings.
+     */
+    static void applyProfilingSettings();
+
     /**
      * Unlike QFile::rename(), this one overwrites existing files.
      */
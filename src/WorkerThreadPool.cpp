@@ -18,6 +18,7 @@
 
 #include "WorkerThreadPool.h"
 #include "OutOfMemoryHandler.h"
+#include "ParallelFor.h"
 #include <QCoreApplication>
 #include <QThreadPool>
 #include <QThread>
@@ -90,6 +91,7 @@ WorkerThreadPool::submitTask(BackgroundTaskPtr const& task)
                 return;
             }
 
+            ParallelForWorkerScope const worker_scope;
             try
             {
                 FilterResultPtr const result((*m_ptrTask)());
@@ -137,4 +139,7 @@ WorkerThreadPool::updateNumberOfThreads()
     int num_threads = m_settings.value("settings/batch_processing_threads", max_threads).toInt();
     num_threads = std::min<int>(num_threads, max_threads);
     m_pPool->setMaxThreadCount(num_threads);
+
+    // Pages and parallelFor() helpers share the same thread budget.
+    setParallelForThreadLimit(num_threads);
 }
@@ -19,6 +19,7 @@
 #include "DefaultAccelerationProvider.h"
 #include "NonAcceleratedOperations.h"
 #include "AccelerationPlugin.h"
+#include "ThreadedAccelerationPlugin.h"
 #include <QCoreApplication>
 #include <QPluginLoader>
 #include <QSettings>
@@ -28,6 +29,8 @@
 DefaultAccelerationProvider::DefaultAccelerationProvider(QObject* parent)
     :	QObject(parent)
     ,	m_pPlugin(nullptr)
+    ,	m_ptrThreadedPlugin(new ThreadedAccelerationPlugin)
+    ,	m_threadedAccelerationEnabled(false)
     ,	m_ptrNonAcceleratedOperations(std::make_shared<NonAcceleratedOperations>())
 {
     processUpdatedConfiguration();
@@ -38,6 +41,10 @@ DefaultAccelerationProvider::processUpdatedConfiguration()
 {
     QSettings settings;
 
+    m_threadedAccelerationEnabled = settings.value(
+                                        "settings/enable_threaded_acceleration", false
+                                    ).toBool();
+
 #ifdef ENABLE_OPENCL
     if (settings.value("settings/enable_opencl", false).toBool())
     {
@@ -82,17 +89,25 @@ DefaultAccelerationProvider::releaseResources()
         opencl_plugin->releaseResources();
     }
 #endif
+
+    m_ptrThreadedPlugin->releaseResources();
 }
 
 std::shared_ptr<AcceleratableOperations>
 DefaultAccelerationProvider::getOperations()
 {
+    std::shared_ptr<AcceleratableOperations> fallback(m_ptrNonAcceleratedOperations);
+    if (m_threadedAccelerationEnabled)
+    {
+        fallback = m_ptrThreadedPlugin->getOperations(fallback);
+    }
+
     if (m_pPlugin)
     {
-        return m_pPlugin->getOperations(m_ptrNonAcceleratedOperations);
+        return m_pPlugin->getOperations(fallback);
     }
     else
     {
-        return m_ptrNonAcceleratedOperations;
+        return fallback;
     }
 }
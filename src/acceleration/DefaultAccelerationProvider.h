@@ -44,7 +44,8 @@ public:
      * @brief Re-checks configuration and loads plug-ins if necessary.
      *
      * This method should be called after changing the value of "settings/enable_opencl"
-     * key in QSettings. This method is called from this class' constructor.
+     * or "settings/enable_threaded_acceleration" keys in QSettings. This method is
+     * called from this class' constructor.
      */
     void processUpdatedConfiguration();
 
@@ -62,10 +63,16 @@ public:
 
     /**
      * @brief Delegates to a plugin, if one is loaded or returns a non-accelerated version.
+     *
+     * When multithreaded acceleration is enabled, the threaded operations
+     * take the place of the non-accelerated ones, including their role
+     * as a fallback for the OpenCL plugin.
      */
     std::shared_ptr<AcceleratableOperations> getOperations();
 private:
     AccelerationPlugin* m_pPlugin;
+    std::unique_ptr<AccelerationPlugin> m_ptrThreadedPlugin;
+    bool m_threadedAccelerationEnabled;
     std::shared_ptr<AcceleratableOperations> m_ptrNonAcceleratedOperations;
 };
 
@@ -0,0 +1,471 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ThreadedAcceleratedOperations.h"
+#include "ParallelFor.h"
+#include "imageproc/GaussBlur.h"
+#include "imageproc/AffineTransform.h"
+#include "imageproc/OutsidePixels.h"
+#include "imageproc/SavGolFilter.h"
+#include "imageproc/Morphology.h"
+#include "imageproc/BadAllocIfNull.h"
+#include <QThreadPool>
+#include <QPoint>
+#include <QPointF>
+#include <QRect>
+#include <QSize>
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+#include <cstring>
+
+using namespace imageproc;
+
+namespace
+{
+
+/**
+ * Rows per parallelFor() chunk for operations where rows are independent.
+ */
+int const ROW_BAND = 64;
+
+/**
+ * Rows per parallelFor() chunk for operations that need to process
+ * some extra rows above and below each chunk.
+ */
+int const OVERLAPPING_BAND = 256;
+
+/**
+ * \brief Converts the source image the way imageproc::affineTransform() would.
+ *
+ * It converts the whole source image on each call, so we do it once
+ * before processing the destination band by band.  The converted image
+ * then passes through its conversion without being copied.
+ */
+QImage prepareSource(QImage const& src, QRgb const outside_rgba)
+{
+    bool const outside_opaque_gray = qAlpha(outside_rgba) == 0xff
+                                     && qRed(outside_rgba) == qGreen(outside_rgba)
+                                     && qRed(outside_rgba) == qBlue(outside_rgba);
+
+    switch (src.format())
+    {
+    case QImage::Format_Indexed8:
+    case QImage::Format_Mono:
+    case QImage::Format_MonoLSB:
+        if (src.allGray() && outside_opaque_gray)
+        {
+            return GrayImage(src).toQImage();
+        }
+    // fall through
+    default:
+        if (!src.hasAlphaChannel() && qAlpha(outside_rgba) == 0xff)
+        {
+            return badAllocIfNull(src.convertToFormat(QImage::Format_RGB32));
+        }
+        else
+        {
+            return badAllocIfNull(src.convertToFormat(QImage::Format_ARGB32));
+        }
+    }
+}
+
+/**
+ * \brief Puts together an image from bands stacked top to bottom.
+ */
+QImage assembleRows(std::vector<QImage> const& bands, QSize const& size)
+{
+    QImage const& first = bands.front();
+    QImage dst(size, first.format());
+    badAllocIfNull(dst);
+    dst.setColorTable(first.colorTable());
+
+    size_t const line_bytes = size_t(size.width()) * first.depth() / 8;
+    int y = 0;
+    for (QImage const& band : bands)
+    {
+        for (int band_y = 0; band_y < band.height(); ++band_y, ++y)
+        {
+            memcpy(dst.scanLine(y), band.constScanLine(band_y), line_bytes);
+        }
+    }
+
+    return dst;
+}
+
+} // anonymous namespace
+
+ThreadedAcceleratedOperations::ThreadedAcceleratedOperations(
+    std::shared_ptr<AcceleratableOperations> const& fallback)
+    :	m_ptrFallback(fallback)
+{
+}
+
+Grid<float>
+ThreadedAcceleratedOperations::gaussBlur(
+    Grid<float> const& src, float const h_sigma, float const v_sigma) const
+{
+    // gaussBlurGeneric() already processes bands of rows and columns in parallel.
+    return m_ptrFallback->gaussBlur(src, h_sigma, v_sigma);
+}
+
+Grid<float>
+ThreadedAcceleratedOperations::anisotropicGaussBlur(
+    Grid<float> const& src, float const dir_x, float const dir_y,
+    float const dir_sigma, float const ortho_dir_sigma) const
+{
+    // anisotropicGaussBlurGeneric() already runs its axis-aligned pass in parallel.
+    // The skewed pass carries state from one line to the next, so it can't be split.
+    return m_ptrFallback->anisotropicGaussBlur(src, dir_x, dir_y, dir_sigma, ortho_dir_sigma);
+}
+
+std::pair<Grid<float>, Grid<uint8_t>>
+                                   ThreadedAcceleratedOperations::textFilterBank(
+                                       Grid<float> const& src, std::vector<Vec2f> const& directions,
+                                       std::vector<Vec2f> const& sigmas, float const shoulder_length) const
+{
+    int const width = src.width();
+    int const height = src.height();
+
+    Grid<float> accum(width, height);
+    accum.initInterior(-std::numeric_limits<float>::max());
+
+    Grid<uint8_t> direction_map(width, height);
+    direction_map.initInterior(0);
+
+    // (sigma index, direction index) pairs in the order NonAcceleratedOperations
+    // applies them.  When responses are equal, that order decides the direction.
+    std::vector<std::pair<size_t, size_t>> filters;
+    for (size_t sigma_idx = 0; sigma_idx < sigmas.size(); ++sigma_idx)
+    {
+        for (size_t dir_idx = 0; dir_idx < directions.size(); ++dir_idx)
+        {
+            filters.emplace_back(sigma_idx, dir_idx);
+        }
+    }
+
+    // We only keep as many blurred images as we have threads to make them.
+    size_t const batch_size = std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+    std::vector<Grid<float>> blurred(std::min(batch_size, filters.size()));
+    std::vector<QPoint> shoulders(blurred.size());
+
+    for (size_t batch_begin = 0; batch_begin < filters.size(); batch_begin += batch_size)
+    {
+        int const batch_len = int(std::min(batch_size, filters.size() - batch_begin));
+
+        parallelFor(0, batch_len, 1, [&](int const begin, int const end)
+        {
+            for (int i = begin; i < end; ++i)
+            {
+                Vec2f const& s = sigmas[filters[batch_begin + i].first];
+                Vec2f const& dir = directions[filters[batch_begin + i].second];
+
+                if (blurred[i].isNull())
+                {
+                    blurred[i] = Grid<float>(width, height, /*padding=*/0);
+                }
+                anisotropicGaussBlurGeneric(
+                    QSize(width, height), dir[0], dir[1], s[0], s[1],
+                    src.data(), src.stride(), [](float val)
+                {
+                    return val;
+                },
+                blurred[i].data(), blurred[i].stride(), [](float& dst, float src)
+                {
+                    dst = src;
+                }
+                );
+
+                QPointF shoulder_f(dir[1], -dir[0]);
+                shoulder_f *= s[1] * shoulder_length;
+                shoulders[i] = shoulder_f.toPoint();
+            }
+        });
+
+        // Fold the batch into accum, applying the filters in order for each pixel.
+        parallelFor(0, height, ROW_BAND, [&](int const y_begin, int const y_end)
+        {
+            for (int i = 0; i < batch_len; ++i)
+            {
+                Grid<float> const& b = blurred[i];
+                QPoint const shoulder(shoulders[i]);
+                uint8_t const dir_idx = static_cast<uint8_t>(filters[batch_begin + i].second);
+
+                for (int y = y_begin; y < y_end; ++y)
+                {
+                    int const y1 = y + shoulder.y();
+                    int const y2 = y - shoulder.y();
+                    bool const y1_inside = y1 >= 0 && y1 < height;
+                    bool const y2_inside = y2 >= 0 && y2 < height;
+                    float const* const b_line = b.data() + y * b.stride();
+                    float* const accum_line = accum.data() + y * accum.stride();
+                    uint8_t* const dir_line = direction_map.data() + y * direction_map.stride();
+
+                    for (int x = 0; x < width; ++x)
+                    {
+                        float const origin_px = b_line[x];
+                        int const x1 = x + shoulder.x();
+                        int const x2 = x - shoulder.x();
+
+                        float pt1_px = origin_px;
+                        float pt2_px = origin_px;
+                        if (y1_inside && x1 >= 0 && x1 < width)
+                        {
+                            pt1_px = b(x1, y1);
+                        }
+                        if (y2_inside && x2 >= 0 && x2 < width)
+                        {
+                            pt2_px = b(x2, y2);
+                        }
+
+                        float const response = 0.5f * (pt1_px + pt2_px) - origin_px;
+                        if (response > accum_line[x])
+                        {
+                            accum_line[x] = response;
+                            dir_line[x] = dir_idx;
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    return std::make_pair(std::move(accum), std::move(direction_map));
+}
+
+QImage
+ThreadedAcceleratedOperations::dewarp(
+    QImage const& src, QSize const& dst_size,
+    dewarping::CylindricalSurfaceDewarper const& distortion_model,
+    QRectF const& model_domain, QColor const& background_color,
+    float const min_density, float const max_density,
+    QSizeF const& min_mapping_area) const
+{
+    // RasterDewarper already spreads the work across threads.
+    return m_ptrFallback->dewarp(
+               src, dst_size, distortion_model, model_domain,
+               background_color, min_density, max_density, min_mapping_area
+           );
+}
+
+QImage
+ThreadedAcceleratedOperations::affineTransform(
+    QImage const& src, QTransform const& xform,
+    QRect const& dst_rect, OutsidePixels const& outside_pixels,
+    QSizeF const& min_mapping_area) const
+{
+    if (src.isNull() || !dst_rect.isValid() || !xform.isAffine()
+            || dst_rect.height() < 2 * ROW_BAND)
+    {
+        return m_ptrFallback->affineTransform(
+                   src, xform, dst_rect, outside_pixels, min_mapping_area
+               );
+    }
+
+    QImage const prepared_src(prepareSource(src, outside_pixels.rgba()));
+
+    int const num_bands = (dst_rect.height() + ROW_BAND - 1) / ROW_BAND;
+    std::vector<QImage> bands(num_bands);
+    parallelFor(0, num_bands, 1, [&](int const begin, int const end)
+    {
+        for (int i = begin; i < end; ++i)
+        {
+            int const y0 = dst_rect.top() + i * ROW_BAND;
+            int const band_height = std::min(ROW_BAND, dst_rect.bottom() + 1 - y0);
+            bands[i] = imageproc::affineTransform(
+                           prepared_src, xform, QRect(dst_rect.left(), y0, dst_rect.width(), band_height),
+                           outside_pixels, min_mapping_area
+                       );
+        }
+    });
+
+    return assembleRows(bands, dst_rect.size());
+}
+
+/**
+ * Same as PolynomialSurface::render(), with rows rendered in parallel.
+ */
+GrayImage
+ThreadedAcceleratedOperations::renderPolynomialSurface(
+    PolynomialSurface const& surface, int const width, int const height)
+{
+    if (width <= 1 || height < 2 * ROW_BAND)
+    {
+        return m_ptrFallback->renderPolynomialSurface(surface, width, height);
+    }
+
+    Eigen::MatrixXd const& coeffs = surface.coeffs();
+    int const num_coeffs = int(coeffs.rows() * coeffs.cols());
+
+    // Pretend that both x and y positions of pixels
+    // lie in range of [0, 1].
+    double const xscale = 1.0 / (width - 1);
+    double const yscale = 1.0 / (height - 1);
+
+    std::vector<float> hor_matrix(num_coeffs * width);
+    float* out = &hor_matrix[0];
+    for (int x = 0; x < width; ++x)
+    {
+        double const x_adjusted = x * xscale;
+        for (int i = 0; i < coeffs.rows(); ++i)
+        {
+            double pow = 1.0;
+            for (int j = 0; j < coeffs.cols(); ++j, ++out)
+            {
+                *out = static_cast<float>(pow);
+                pow *= x_adjusted;
+            }
+        }
+    }
+
+    GrayImage image(QSize(width, height));
+    unsigned char* const data = image.data();
+    int const stride = image.stride();
+
+    parallelFor(0, height, ROW_BAND, [&](int const y_begin, int const y_end)
+    {
+        std::vector<float> vert_line(num_coeffs);
+
+        for (int y = y_begin; y < y_end; ++y)
+        {
+            double const y_adjusted = y * yscale;
+            double pow = 1.0;
+            float* out = &vert_line[0];
+            for (int i = 0; i < coeffs.rows(); ++i)
+            {
+                for (int j = 0; j < coeffs.cols(); ++j, ++out)
+                {
+                    *out = static_cast<float>(coeffs(i, j) * pow);
+                }
+                pow *= y_adjusted;
+            }
+
+            unsigned char* const line = data + y * stride;
+            float const* hor_line = &hor_matrix[0];
+            for (int x = 0; x < width; ++x, hor_line += num_coeffs)
+            {
+                float sum = 0.5f / 255.0f; // for rounding purposes.
+                for (int i = 0; i < num_coeffs; ++i)
+                {
+                    sum += hor_line[i] * vert_line[i];
+                }
+                int const isum = (int)(sum * 255.0);
+                line[x] = static_cast<unsigned char>(qBound(0, isum, 255));
+            }
+        }
+    });
+
+    return image;
+}
+
+GrayImage
+ThreadedAcceleratedOperations::savGolFilter(
+    GrayImage const& src, QSize const& window_size,
+    int const hor_degree, int const vert_degree)
+{
+    int const width = src.width();
+    int const height = src.height();
+
+    // Rows closer than window_size.height() to a band boundary are filtered
+    // as part of the band they belong to, so the result is the same as
+    // filtering the whole image.
+    int const margin = window_size.height();
+
+    if (src.isNull() || window_size.isEmpty() || height < 2 * OVERLAPPING_BAND)
+    {
+        return m_ptrFallback->savGolFilter(src, window_size, hor_degree, vert_degree);
+    }
+
+    GrayImage dst(src.size());
+    unsigned char* const dst_data = dst.data();
+    int const dst_stride = dst.stride();
+
+    parallelFor(0, height, OVERLAPPING_BAND, [&](int const y_begin, int const y_end)
+    {
+        int const top = std::max(0, y_begin - margin);
+        int const bottom = std::min(height, y_end + margin);
+        GrayImage const band(src.toQImage().copy(0, top, width, bottom - top));
+        GrayImage const filtered(
+            imageproc::savGolFilter(band, window_size, hor_degree, vert_degree)
+        );
+
+        for (int y = y_begin; y < y_end; ++y)
+        {
+            memcpy(
+                dst_data + y * dst_stride,
+                filtered.data() + (y - top) * filtered.stride(), width
+            );
+        }
+    });
+
+    return dst;
+}
+
+void
+ThreadedAcceleratedOperations::hitMissReplaceInPlace(
+    BinaryImage& img, BWColor const img_surroundings,
+    std::vector<Grid<char>> const& patterns)
+{
+    int const height = img.height();
+    if (img.isNull() || height < 2 * OVERLAPPING_BAND)
+    {
+        m_ptrFallback->hitMissReplaceInPlace(img, img_surroundings, patterns);
+        return;
+    }
+
+    for (Grid<char> const& pattern : patterns)
+    {
+        if (pattern.stride() != pattern.width())
+        {
+            throw std::invalid_argument(
+                "ThreadedAcceleratedOperations::hitMissReplaceInPlace: "
+                "patterns with extended stride are not supported"
+            );
+        }
+
+        // A pixel may be changed by a match up to pattern.height() - 1 rows away,
+        // which in turn depends on pixels up to pattern.height() - 1 rows further.
+        int const margin = 2 * pattern.height();
+
+        BinaryImage const src(img);
+        BinaryImage dst(img.width(), height);
+        int const wpl = src.wordsPerLine();
+        uint32_t const* const src_data = src.data();
+        uint32_t* const dst_data = dst.data();
+
+        parallelFor(0, height, OVERLAPPING_BAND, [&](int const y_begin, int const y_end)
+        {
+            int const top = std::max(0, y_begin - margin);
+            int const bottom = std::min(height, y_end + margin);
+
+            BinaryImage band(img.width(), bottom - top);
+            memcpy(band.data(), src_data + top * wpl, size_t(bottom - top) * wpl * 4);
+
+            imageproc::hitMissReplaceInPlace(
+                band, img_surroundings, pattern.data(), pattern.width(), pattern.height()
+            );
+
+            memcpy(
+                dst_data + y_begin * wpl, band.data() + (y_begin - top) * wpl,
+                size_t(y_end - y_begin) * wpl * 4
+            );
+        });
+
+        img = dst;
+    }
+}
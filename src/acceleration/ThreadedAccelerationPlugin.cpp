@@ -0,0 +1,69 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ThreadedAccelerationPlugin.h"
+#include "ThreadedAcceleratedOperations.h"
+#include <QThreadPool>
+#include <QString>
+
+ThreadedAccelerationPlugin::ThreadedAccelerationPlugin()
+{
+}
+
+ThreadedAccelerationPlugin::~ThreadedAccelerationPlugin()
+{
+}
+
+std::vector<std::string>
+ThreadedAccelerationPlugin::devices() const
+{
+    return std::vector<std::string>(1, selectedDevice());
+}
+
+void
+ThreadedAccelerationPlugin::selectDevice(std::string const&)
+{
+    // There is nothing to choose from.
+}
+
+std::string
+ThreadedAccelerationPlugin::selectedDevice() const
+{
+    int const num_threads = QThreadPool::globalInstance()->maxThreadCount();
+    return QString("CPU (%1 threads)").arg(num_threads).toStdString();
+}
+
+std::shared_ptr<AcceleratableOperations>
+ThreadedAccelerationPlugin::getOperations(
+    std::shared_ptr<AcceleratableOperations> const& fallback)
+{
+    if (!m_ptrCachedOperations || m_ptrCachedFallback != fallback)
+    {
+        m_ptrCachedOperations = std::make_shared<ThreadedAcceleratedOperations>(fallback);
+        m_ptrCachedFallback = fallback;
+    }
+
+    return m_ptrCachedOperations;
+}
+
+void
+ThreadedAccelerationPlugin::releaseResources()
+{
+    m_ptrCachedOperations.reset();
+    m_ptrCachedFallback.reset();
+}
@@ -0,0 +1,61 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THREADED_ACCELERATION_PLUGIN_H_
+#define THREADED_ACCELERATION_PLUGIN_H_
+
+#include "acceleration_config.h"
+#include "AccelerationPlugin.h"
+#include "NonCopyable.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Provides ThreadedAcceleratedOperations through the plugin interface.
+ *
+ * Unlike the OpenCL plugin, this one is linked in statically and
+ * instantiated by DefaultAccelerationProvider directly.  There is only
+ * one device: the CPU.
+ *
+ * @note This class is not thread-safe.
+ */
+class ACCELERATION_EXPORT ThreadedAccelerationPlugin : public AccelerationPlugin
+{
+    DECLARE_NON_COPYABLE(ThreadedAccelerationPlugin)
+public:
+    ThreadedAccelerationPlugin();
+
+    virtual ~ThreadedAccelerationPlugin();
+
+    virtual std::vector<std::string> devices() const;
+
+    virtual void selectDevice(std::string const& device_name);
+
+    virtual std::string selectedDevice() const;
+
+    virtual std::shared_ptr<AcceleratableOperations> getOperations(
+        std::shared_ptr<AcceleratableOperations> const& fallback);
+
+    virtual void releaseResources();
+private:
+    std::shared_ptr<AcceleratableOperations> m_ptrCachedOperations;
+    std::shared_ptr<AcceleratableOperations> m_ptrCachedFallback;
+};
+
+#endif
@@ -0,0 +1,298 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ThreadedAcceleratedOperations.h"
+#include "NonAcceleratedOperations.h"
+#include "Grid.h"
+#include "VecNT.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/BWColor.h"
+#include "imageproc/GrayImage.h"
+#include "imageproc/PolynomialSurface.h"
+#include "imageproc/AffineTransform.h"
+#include <QImage>
+#include <QColor>
+#include <QTransform>
+#include <QVector>
+#include <QRect>
+#include <QSize>
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <random>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+using namespace imageproc;
+
+namespace tests
+{
+
+namespace
+{
+
+Grid<float> randomGrid(int width, int height, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> dist(0.0f, 255.0f);
+    Grid<float> grid(width, height);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            grid(x, y) = dist(rng);
+        }
+    }
+    return grid;
+}
+
+GrayImage randomGrayImage(int width, int height, std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> dist(0, 255);
+    GrayImage image(QSize(width, height));
+    for (int y = 0; y < height; ++y)
+    {
+        uint8_t* line = image.data() + y * image.stride();
+        for (int x = 0; x < width; ++x)
+        {
+            line[x] = static_cast<uint8_t>(dist(rng));
+        }
+    }
+    return image;
+}
+
+BinaryImage randomBinaryImage(int width, int height, std::mt19937& rng)
+{
+    BinaryImage image(width, height);
+    uint32_t* data = image.data();
+    int const wpl = image.wordsPerLine();
+    for (int i = 0; i < wpl * height; ++i)
+    {
+        data[i] = rng();
+    }
+    return image;
+}
+
+QImage randomImage(int width, int height, QImage::Format format, std::mt19937& rng)
+{
+    QImage image(width, height, format);
+    for (int y = 0; y < height; ++y)
+    {
+        uint8_t* line = image.scanLine(y);
+        for (int i = 0; i < image.bytesPerLine(); ++i)
+        {
+            line[i] = static_cast<uint8_t>(rng());
+        }
+    }
+
+    if (format == QImage::Format_Indexed8)
+    {
+        QVector<QRgb> gray_table(256);
+        for (int i = 0; i < 256; ++i)
+        {
+            gray_table[i] = qRgb(i, i, i);
+        }
+        image.setColorTable(gray_table);
+    }
+    else if (format == QImage::Format_Mono)
+    {
+        QVector<QRgb> bw_table(2);
+        bw_table[0] = 0xffffffff;
+        bw_table[1] = 0xff000000;
+        image.setColorTable(bw_table);
+    }
+
+    return image;
+}
+
+bool gridsEqual(Grid<float> const& lhs, Grid<float> const& rhs)
+{
+    if (lhs.width() != rhs.width() || lhs.height() != rhs.height())
+    {
+        return false;
+    }
+
+    for (int y = 0; y < lhs.height(); ++y)
+    {
+        for (int x = 0; x < lhs.width(); ++x)
+        {
+            if (lhs(x, y) != rhs(x, y))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+class ThreadedOperationsFixture
+{
+public:
+    ThreadedOperationsFixture()
+        :	m_ptrNonAccelerated(std::make_shared<NonAcceleratedOperations>())
+        ,	m_threaded(m_ptrNonAccelerated)
+        ,	m_rng(12345)
+    {
+    }
+protected:
+    std::shared_ptr<AcceleratableOperations> m_ptrNonAccelerated;
+    ThreadedAcceleratedOperations m_threaded;
+    std::mt19937 m_rng;
+};
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE(ThreadedAcceleratedOperationsTestSuite, ThreadedOperationsFixture);
+
+BOOST_AUTO_TEST_CASE(test_text_filter_bank)
+{
+    Grid<float> const src(randomGrid(200, 150, m_rng));
+
+    std::vector<Vec2f> const directions
+    {
+        Vec2f(1.0f, 0.0f), Vec2f(0.7f, 0.7f), Vec2f(0.0f, 1.0f), Vec2f(-0.7f, 0.7f)
+    };
+    std::vector<Vec2f> const sigmas
+    {
+        Vec2f(2.0f, 1.0f), Vec2f(4.0f, 2.0f)
+    };
+
+    auto const threaded = m_threaded.textFilterBank(src, directions, sigmas, 3.0f);
+    auto const control = m_ptrNonAccelerated->textFilterBank(src, directions, sigmas, 3.0f);
+
+    BOOST_CHECK(gridsEqual(threaded.first, control.first));
+
+    bool directions_equal = true;
+    for (int y = 0; y < src.height(); ++y)
+    {
+        for (int x = 0; x < src.width(); ++x)
+        {
+            directions_equal &= threaded.second(x, y) == control.second(x, y);
+        }
+    }
+    BOOST_CHECK(directions_equal);
+}
+
+BOOST_AUTO_TEST_CASE(test_affine_transform)
+{
+    // ThreadedAcceleratedOperations transforms bands of 64 rows, starting
+    // at the top of dst_rect.  These heights make the last band full,
+    // one row longer than that and one row short of that, with the
+    // bands starting at odd positions.
+    QRect const dst_rects[] = {
+        QRect(-13, -7, 201, 128),
+        QRect(5, 11, 173, 129),
+        QRect(-1, 3, 97, 191)
+    };
+
+    QTransform rotate_and_scale;
+    rotate_and_scale.translate(40.5, -20.0);
+    rotate_and_scale.rotate(7.0);
+    rotate_and_scale.scale(1.3, 0.8);
+
+    QTransform downscale;
+    downscale.scale(0.45, 0.55);
+
+    QImage const sources[] = {
+        randomImage(157, 211, QImage::Format_Indexed8, m_rng),
+        randomImage(149, 203, QImage::Format_Mono, m_rng),
+        randomImage(131, 187, QImage::Format_RGB32, m_rng),
+        randomImage(139, 199, QImage::Format_ARGB32, m_rng)
+    };
+
+    OutsidePixels const outside_pixels[] = {
+        OutsidePixels::assumeColor(Qt::white),
+        OutsidePixels::assumeColor(QColor(200, 100, 50)),
+        OutsidePixels::assumeWeakColor(QColor(0, 0, 0, 0)),
+        OutsidePixels::assumeWeakNearest()
+    };
+
+    for (QImage const& src : sources)
+    {
+        for (QTransform const& xform : { rotate_and_scale, downscale })
+        {
+            for (QRect const& dst_rect : dst_rects)
+            {
+                for (OutsidePixels const& outside : outside_pixels)
+                {
+                    QImage const threaded(
+                        m_threaded.affineTransform(src, xform, dst_rect, outside)
+                    );
+                    QImage const control(
+                        m_ptrNonAccelerated->affineTransform(src, xform, dst_rect, outside)
+                    );
+                    BOOST_CHECK(threaded.format() == control.format());
+                    BOOST_CHECK(threaded == control);
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_render_polynomial_surface)
+{
+    PolynomialSurface const surface(3, 4, randomGrayImage(40, 50, m_rng));
+
+    BOOST_CHECK(
+        m_threaded.renderPolynomialSurface(surface, 333, 555)
+        == m_ptrNonAccelerated->renderPolynomialSurface(surface, 333, 555)
+    );
+}
+
+BOOST_AUTO_TEST_CASE(test_sav_gol_filter)
+{
+    GrayImage const src(randomGrayImage(211, 700, m_rng));
+    QSize const window(7, 9);
+
+    BOOST_CHECK(
+        m_threaded.savGolFilter(src, window, 2, 3)
+        == m_ptrNonAccelerated->savGolFilter(src, window, 2, 3)
+    );
+}
+
+BOOST_AUTO_TEST_CASE(test_hit_miss_replace)
+{
+    static char const pattern1[] =
+        " - "
+        "X+X"
+        "XXX";
+    static char const pattern2[] =
+        "?X?"
+        "X-X"
+        "?X?";
+
+    std::vector<Grid<char>> patterns;
+    for (char const* pattern : { pattern1, pattern2 })
+    {
+        Grid<char> grid(3, 3);
+        memcpy(grid.data(), pattern, 9);
+        patterns.push_back(grid);
+    }
+
+    BinaryImage threaded(randomBinaryImage(190, 777, m_rng));
+    BinaryImage control(threaded);
+
+    m_threaded.hitMissReplaceInPlace(threaded, WHITE, patterns);
+    m_ptrNonAccelerated->hitMissReplaceInPlace(control, WHITE, patterns);
+
+    BOOST_CHECK(threaded == control);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
@@ -0,0 +1,143 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BenchmarkRunner.h"
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <algorithm>
+#include <numeric>
+#include <iostream>
+#include <utility>
+
+namespace bench
+{
+
+BenchmarkRunner::BenchmarkRunner(int const iterations, QString const& filter)
+    :   m_iterations(std::max(1, iterations)),
+        m_filter(filter)
+{
+}
+
+bool
+BenchmarkRunner::isEnabled(QString const& group, QString const& name) const
+{
+    if (m_filter.isEmpty())
+    {
+        return true;
+    }
+    return (group + QChar('/') + name).contains(m_filter, Qt::CaseInsensitive);
+}
+
+void
+BenchmarkRunner::run(
+    QString const& group, QString const& name,
+    BenchmarkConditions const& conditions,
+    std::function<void()> const& body)
+{
+    if (!isEnabled(group, name))
+    {
+        return;
+    }
+
+    // The first run pulls the code and the data into caches
+    // and lets the thread pool spin up its threads.
+    body();
+
+    std::vector<double> samples;
+    samples.reserve(m_iterations);
+
+    QElapsedTimer timer;
+    for (int i = 0; i < m_iterations; ++i)
+    {
+        timer.start();
+        body();
+        samples.push_back(timer.nsecsElapsed() * 1e-6);
+    }
+
+    addResult(group, name, conditions, std::move(samples));
+}
+
+void
+BenchmarkRunner::addResult(
+    QString const& group, QString const& name,
+    BenchmarkConditions const& conditions,
+    std::vector<double> samples_ms)
+{
+    if (samples_ms.empty())
+    {
+        return;
+    }
+
+    std::sort(samples_ms.begin(), samples_ms.end());
+
+    std::cerr << group.toLocal8Bit().constData() << '/'
+              << name.toLocal8Bit().constData()
+              << " dpi=" << conditions.dpi
+              << " threads=" << conditions.threads
+              << ": " << samples_ms.front() << " ms" << std::endl;
+
+    Result result;
+    result.group = group;
+    result.name = name;
+    result.conditions = conditions;
+    result.samplesMs = std::move(samples_ms);
+    m_results.push_back(std::move(result));
+}
+
+QJsonDocument
+BenchmarkRunner::toJson() const
+{
+    QJsonArray results;
+    for (Result const& result : m_results)
+    {
+        std::vector<double> const& samples = result.samplesMs;
+        size_t const n = samples.size();
+        double const median = n % 2 ? samples[n / 2]
+                              : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+        double const mean = std::accumulate(samples.begin(), samples.end(), 0.0) / n;
+
+        QJsonArray samples_json;
+        for (double const sample : samples)
+        {
+            samples_json.append(sample);
+        }
+
+        QJsonObject obj;
+        obj["group"] = result.group;
+        obj["name"] = result.name;
+        obj["dpi"] = result.conditions.dpi;
+        obj["threads"] = result.conditions.threads;
+        obj["width"] = result.conditions.width;
+        obj["height"] = result.conditions.height;
+        obj["pages"] = result.conditions.pages;
+        obj["iterations"] = int(n);
+        obj["min_ms"] = samples.front();
+        obj["median_ms"] = median;
+        obj["mean_ms"] = mean;
+        obj["max_ms"] = samples.back();
+        obj["samples_ms"] = samples_json;
+        results.append(obj);
+    }
+
+    QJsonObject root;
+    root["results"] = results;
+    return QJsonDocument(root);
+}
+
+} // namespace bench
@@ -0,0 +1,100 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCH_BENCHMARKRUNNER_H_
+#define BENCH_BENCHMARKRUNNER_H_
+
+#include "NonCopyable.h"
+#include <QString>
+#include <QJsonDocument>
+#include <functional>
+#include <vector>
+
+namespace bench
+{
+
+/**
+ * \brief The conditions a measurement was taken under.
+ */
+struct BenchmarkConditions
+{
+    int dpi = 0;
+    int threads = 1;
+    int width = 0;
+    int height = 0;
+    int pages = 1;
+};
+
+/**
+ * \brief Times benchmark cases and collects the results.
+ *
+ * Every case is run a fixed number of times, and the minimum, median
+ * and mean wall times are reported.  The results are meant for trend
+ * tracking, so they are written as JSON rather than as a table.
+ */
+class BenchmarkRunner
+{
+    DECLARE_NON_COPYABLE(BenchmarkRunner)
+public:
+    /**
+     * \param iterations The number of timed runs per case.
+     * \param filter Only cases whose "group/name" contains this string
+     *        are run.  An empty string matches everything.
+     */
+    BenchmarkRunner(int iterations, QString const& filter);
+
+    int iterations() const
+    {
+        return m_iterations;
+    }
+
+    bool isEnabled(QString const& group, QString const& name) const;
+
+    /**
+     * \brief Runs \p body once to warm up, then times it
+     *        iterations() times and records the result.
+     */
+    void run(QString const& group, QString const& name,
+             BenchmarkConditions const& conditions,
+             std::function<void()> const& body);
+
+    /**
+     * \brief Records times measured elsewhere, in milliseconds.
+     */
+    void addResult(QString const& group, QString const& name,
+                   BenchmarkConditions const& conditions,
+                   std::vector<double> samples_ms);
+
+    QJsonDocument toJson() const;
+private:
+    struct Result
+    {
+        QString group;
+        QString name;
+        BenchmarkConditions conditions;
+        std::vector<double> samplesMs;
+    };
+
+    int m_iterations;
+    QString m_filter;
+    std::vector<Result> m_results;
+};
+
+} // namespace bench
+
+#endif
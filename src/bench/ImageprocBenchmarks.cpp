@@ -0,0 +1,155 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ImageprocBenchmarks.h"
+#include "BenchmarkRunner.h"
+#include "Despeckle.h"
+#include "TaskStatus.h"
+#include "stages/output/DespeckleLevel.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/Binarize.h"
+#include "imageproc/Connectivity.h"
+#include "imageproc/ConnectivityMap.h"
+#include "imageproc/GaussBlur.h"
+#include "imageproc/GrayImage.h"
+#include "imageproc/Grayscale.h"
+#include "imageproc/LocalStats.h"
+#include "imageproc/RasterOp.h"
+#include "imageproc/Scale.h"
+#include "imageproc/SEDM.h"
+#include "imageproc/SeedFill.h"
+#include <QImage>
+#include <QRect>
+#include <QPoint>
+#include <algorithm>
+
+using namespace imageproc;
+
+namespace bench
+{
+
+namespace
+{
+
+class NeverCancelled : public TaskStatus
+{
+public:
+    virtual void cancel() {}
+
+    virtual bool isCancelled() const
+    {
+        return false;
+    }
+
+    virtual void throwIfCancelled() const {}
+};
+
+} // anonymous namespace
+
+void runImageprocBenchmarks(
+    BenchmarkRunner& runner, QImage const& page,
+    BenchmarkConditions const& conditions)
+{
+    QString const group("imageproc");
+    int const dpi = std::max(conditions.dpi, 1);
+
+    // 100 at 300 DPI, which is the default for the local binarizers.
+    int const radius = std::max(1, dpi / 3);
+    float const sigma = dpi / 100.0f;
+
+    GrayImage const gray(page);
+    BinaryImage const bw(binarizeOtsu(gray));
+
+    runner.run(group, "toGrayscale", conditions, [&]()
+    {
+        GrayImage const res(page);
+    });
+    runner.run(group, "scaleToGray", conditions, [&]()
+    {
+        scaleToGray(gray, gray.size() / 2);
+    });
+    runner.run(group, "gaussBlur", conditions, [&]()
+    {
+        gaussBlur(gray, sigma, sigma);
+    });
+
+    runner.run(group, "binarizeOtsu", conditions, [&]()
+    {
+        binarizeOtsu(gray);
+    });
+    runner.run(group, "binarizeNiblack", conditions, [&]()
+    {
+        binarizeNiblack(gray, radius);
+    });
+    runner.run(group, "binarizeSauvola", conditions, [&]()
+    {
+        binarizeSauvola(gray, radius);
+    });
+    runner.run(group, "binarizeWolf", conditions, [&]()
+    {
+        binarizeWolf(gray, radius);
+    });
+    runner.run(group, "binarizeBradley", conditions, [&]()
+    {
+        binarizeBradley(gray, radius);
+    });
+    runner.run(group, "binarizeNick", conditions, [&]()
+    {
+        binarizeNick(gray, radius);
+    });
+    runner.run(group, "binarizeSingh", conditions, [&]()
+    {
+        binarizeSingh(gray, radius);
+    });
+    runner.run(group, "binarizeWAN", conditions, [&]()
+    {
+        binarizeWAN(gray, radius);
+    });
+    runner.run(group, "binarizeSauvolaWolfShared", conditions, [&]()
+    {
+        LocalStats stats(gray);
+        binarizeSauvola(stats, radius);
+        binarizeWolf(stats, radius);
+    });
+
+    runner.run(group, "seedFill", conditions, [&]()
+    {
+        // Grow the middle third of the page over the rest of it.
+        QRect const band(0, bw.height() / 3, bw.width(), bw.height() / 3);
+        BinaryImage seed(bw.size(), WHITE);
+        rasterOp<RopSrc>(seed, band, bw, band.topLeft());
+        seedFill(seed, bw, CONN8);
+    });
+    runner.run(group, "SEDM", conditions, [&]()
+    {
+        SEDM const sedm(bw, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_NO_BORDERS);
+    });
+    runner.run(group, "ConnectivityMap", conditions, [&]()
+    {
+        ConnectivityMap const cmap(bw, CONN8);
+    });
+    runner.run(group, "despeckle", conditions, [&]()
+    {
+        NeverCancelled const status;
+        Despeckle::despeckle(
+            bw, output::despeckleLevelToFactor(output::DESPECKLE_NORMAL), status
+        );
+    });
+}
+
+} // namespace bench
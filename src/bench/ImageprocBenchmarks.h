@@ -0,0 +1,43 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCH_IMAGEPROCBENCHMARKS_H_
+#define BENCH_IMAGEPROCBENCHMARKS_H_
+
+class QImage;
+
+namespace bench
+{
+
+class BenchmarkRunner;
+struct BenchmarkConditions;
+
+/**
+ * \brief Times the imageproc primitives the processing stages spend
+ *        most of their time in, on a single page.
+ *
+ * The window sizes and blur radii are scaled with \p conditions.dpi,
+ * the way the output stage scales them.
+ */
+void runImageprocBenchmarks(
+    BenchmarkRunner& runner, QImage const& page,
+    BenchmarkConditions const& conditions);
+
+} // namespace bench
+
+#endif
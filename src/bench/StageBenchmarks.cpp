@@ -0,0 +1,111 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StageBenchmarks.h"
+#include "BenchmarkRunner.h"
+#include "ConsoleBatch.h"
+#include "ImageFileInfo.h"
+#include "ImageMetadata.h"
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QString>
+#include <QTemporaryDir>
+#include <stdexcept>
+#include <vector>
+
+namespace bench
+{
+
+namespace
+{
+
+// In the order of the --start-filter / --end-filter indexes.
+char const* const stageNames[] =
+{
+    "fix_orientation", "page_split", "deskew",
+    "select_content", "page_layout", "output"
+};
+
+int const numStages = sizeof(stageNames) / sizeof(stageNames[0]);
+
+/**
+ * A pass over a stage decodes every page and runs all the stages up to
+ * that one, so that's what the result is named after.
+ */
+QString resultName(int const stage_idx)
+{
+    return QString("decode_through_") + stageNames[stage_idx];
+}
+
+} // anonymous namespace
+
+void runStageBenchmarks(
+    BenchmarkRunner& runner, QStringList const& files,
+    BenchmarkConditions const& conditions)
+{
+    QString const group("stages");
+
+    bool any_enabled = false;
+    for (int i = 0; i < numStages; ++i)
+    {
+        any_enabled |= runner.isEnabled(group, resultName(i));
+    }
+    if (!any_enabled)
+    {
+        return;
+    }
+
+    std::vector<ImageFileInfo> images;
+    for (QString const& file : files)
+    {
+        std::vector<ImageMetadata> metadata(1);
+        images.push_back(ImageFileInfo(QFileInfo(file), metadata));
+    }
+
+    std::vector<std::vector<double>> samples(numStages);
+
+    QElapsedTimer timer;
+    for (int iteration = 0; iteration < runner.iterations(); ++iteration)
+    {
+        QTemporaryDir const output_dir;
+        if (!output_dir.isValid())
+        {
+            throw std::runtime_error("Unable to create a temporary output directory.");
+        }
+
+        ConsoleBatch batch(images, output_dir.path(), Qt::LeftToRight);
+        batch.setThreads(conditions.threads);
+
+        for (int i = 0; i < numStages; ++i)
+        {
+            timer.start();
+            batch.processFilters(i, i);
+            samples[i].push_back(timer.nsecsElapsed() * 1e-6);
+        }
+    }
+
+    for (int i = 0; i < numStages; ++i)
+    {
+        if (runner.isEnabled(group, resultName(i)))
+        {
+            runner.addResult(group, resultName(i), conditions, samples[i]);
+        }
+    }
+}
+
+} // namespace bench
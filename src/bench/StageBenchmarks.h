@@ -0,0 +1,49 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCH_STAGEBENCHMARKS_H_
+#define BENCH_STAGEBENCHMARKS_H_
+
+#include <QStringList>
+
+namespace bench
+{
+
+class BenchmarkRunner;
+struct BenchmarkConditions;
+
+/**
+ * \brief Times the passes the command line batch makes over the pages,
+ *        one per processing stage.
+ *
+ * Each iteration starts a fresh batch over \p files and runs the stages
+ * one after another over all pages, timing each pass separately.
+ * A pass over stage N decodes every page again and runs the stages
+ * before it too, just like it does in the batch.  Those find their
+ * parameters already computed by the previous passes, but still
+ * transform the image.  The results are therefore named
+ * "decode_through_<stage>" and measure the whole chain up to
+ * and including that stage, not the stage alone.
+ */
+void runStageBenchmarks(
+    BenchmarkRunner& runner, QStringList const& files,
+    BenchmarkConditions const& conditions);
+
+} // namespace bench
+
+#endif
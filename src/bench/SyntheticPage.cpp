@@ -0,0 +1,178 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SyntheticPage.h"
+#include <QImage>
+#include <QtGlobal>
+#include <algorithm>
+#include <stdint.h>
+
+namespace bench
+{
+
+namespace
+{
+
+/**
+ * A tiny xorshift generator, as rand() sequences differ between platforms.
+ */
+class Random
+{
+public:
+    explicit Random(unsigned seed) : m_state(seed * 2654435761u + 1) {}
+
+    uint32_t next()
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return m_state;
+    }
+
+    int range(int from, int to)
+    {
+        return from + int(next() % uint32_t(to - from + 1));
+    }
+private:
+    uint32_t m_state;
+};
+
+void fillRect(QImage& image, int left, int top, int width, int height, int level)
+{
+    int const right = std::min(left + width, image.width());
+    int const bottom = std::min(top + height, image.height());
+    left = std::max(left, 0);
+    top = std::max(top, 0);
+
+    for (int y = top; y < bottom; ++y)
+    {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = left; x < right; ++x)
+        {
+            line[x] = qRgb(level, level, level + 4);
+        }
+    }
+}
+
+} // anonymous namespace
+
+QImage makeSyntheticPage(int const dpi, unsigned const seed)
+{
+    Random rng(seed);
+
+    int const width = qRound(8.27 * dpi);
+    int const height = qRound(11.69 * dpi);
+    QImage page(width, height, QImage::Format_RGB32);
+    int const dpm = qRound(dpi / 0.0254);
+    page.setDotsPerMeterX(dpm);
+    page.setDotsPerMeterY(dpm);
+
+    // Paper, getting darker towards the spine on the left.
+    for (int y = 0; y < height; ++y)
+    {
+        QRgb* line = reinterpret_cast<QRgb*>(page.scanLine(y));
+        for (int x = 0; x < width; ++x)
+        {
+            int const level = 238 - 40 * (width - x) / width - int(rng.next() & 7);
+            line[x] = qRgb(level, level - 2, level - 12);
+        }
+    }
+
+    // The shadow of the spine.
+    fillRect(page, 0, 0, dpi / 5, height, 40);
+
+    int const margin = dpi;
+    int const line_height = dpi / 6;
+    int const x_height = dpi / 16;
+    int const stroke = std::max(1, dpi / 100);
+    // A skew of about 0.5 degrees.
+    int const skew_num = 9;
+    int const skew_den = 1000;
+
+    // A picture in the upper part of the text block.
+    int const picture_top = margin + line_height * 4;
+    int const picture_height = height / 6;
+    for (int y = 0; y < picture_height; ++y)
+    {
+        QRgb* line = reinterpret_cast<QRgb*>(page.scanLine(picture_top + y));
+        for (int x = margin; x < width - margin; ++x)
+        {
+            int const level = 60 + (x * 7 + y * 3) % 150 + int(rng.next() & 15);
+            line[x] = qRgb(level, level, level);
+        }
+    }
+
+    // Lines of text.
+    for (int baseline = margin + line_height; baseline < height - margin; baseline += line_height)
+    {
+        if (baseline > picture_top - line_height && baseline < picture_top + picture_height + line_height)
+        {
+            continue;
+        }
+
+        int x = margin + (rng.range(0, 9) == 0 ? dpi / 3 : 0);
+        int const line_end = width - margin - rng.range(0, 2) * dpi / 2;
+        while (x < line_end)
+        {
+            int const word_end = std::min(line_end, x + rng.range(dpi / 6, dpi * 3 / 4));
+            while (x < word_end)
+            {
+                int const glyph_width = rng.range(x_height / 2, x_height);
+                int glyph_height = x_height;
+                switch (rng.range(0, 5))
+                {
+                case 0:
+                    glyph_height = x_height * 3 / 2; // ascender
+                    break;
+                case 1:
+                    glyph_height = -x_height / 2; // descender
+                    break;
+                }
+                int const y = baseline + x * skew_num / skew_den;
+                int const level = rng.range(15, 50);
+                if (glyph_height > 0)
+                {
+                    // A vertical stroke, a bowl and a bar.
+                    fillRect(page, x, y - glyph_height, stroke, glyph_height, level);
+                    fillRect(page, x, y - x_height, glyph_width, stroke, level);
+                    fillRect(page, x + glyph_width - stroke, y - x_height, stroke, x_height, level);
+                    fillRect(page, x, y - stroke, glyph_width, stroke, level);
+                }
+                else
+                {
+                    fillRect(page, x, y - x_height, stroke, x_height - glyph_height, level);
+                    fillRect(page, x, y - x_height, glyph_width, stroke, level);
+                }
+                x += glyph_width + stroke * 2;
+            }
+            x += x_height;
+        }
+    }
+
+    // Speckles.
+    int const num_speckles = width * height / 20000;
+    for (int i = 0; i < num_speckles; ++i)
+    {
+        int const size = rng.range(1, std::max(1, stroke));
+        fillRect(page, rng.range(0, width - 1), rng.range(0, height - 1), size, size, rng.range(0, 90));
+    }
+
+    return page;
+}
+
+} // namespace bench
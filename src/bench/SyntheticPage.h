@@ -0,0 +1,42 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCH_SYNTHETICPAGE_H_
+#define BENCH_SYNTHETICPAGE_H_
+
+class QImage;
+
+namespace bench
+{
+
+/**
+ * \brief Generates an A4 page that looks roughly like a scanned book page.
+ *
+ * The page has unevenly lit, slightly tinted paper, a slightly skewed
+ * block of text-like glyphs, a picture, a dark border on the spine side
+ * and scattered speckles, which gives every processing stage something
+ * to do.  The output only depends on \p dpi and \p seed, so the same page
+ * is generated on every machine.
+ *
+ * \return An RGB32 image with its dots per meter set according to \p dpi.
+ */
+QImage makeSyntheticPage(int dpi, unsigned seed);
+
+} // namespace bench
+
+#endif
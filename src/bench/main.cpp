@@ -0,0 +1,265 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BenchmarkRunner.h"
+#include "ImageprocBenchmarks.h"
+#include "StageBenchmarks.h"
+#include "SyntheticPage.h"
+#include "CommandLine.h"
+#include "TiffWriter.h"
+#include "version.h"
+#include "imageproc/PixelKernels.h"
+#include "ParallelFor.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMap>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QThread>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <QImageReader>
+#endif
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace bench;
+
+namespace
+{
+
+void printHelp()
+{
+    std::cout << "Scan Tailor benchmarks, version " << VERSION << "\n\n";
+    std::cout << "Usage: scantailor-bench [options] [image files]\n\n";
+    std::cout << "Without image files, synthetic pages are generated for every DPI.\n";
+    std::cout << "Options:\n";
+    std::cout << "\t--dpi=<list>\t\t-- DPIs of synthetic pages. default: 300,600\n";
+    std::cout << "\t--threads=<list>\t-- thread counts; 0: all cores. default: 1,0\n";
+    std::cout << "\t--iterations=<number>\t-- timed runs per case. default: 5\n";
+    std::cout << "\t--pages=<number>\t-- synthetic pages for stage runs. default: 4\n";
+    std::cout << "\t--groups=<list>\t\t-- imageproc, stages. default: both\n";
+    std::cout << "\t--filter=<text>\t\t-- only run cases whose group/name contains the text\n";
+    std::cout << "\t--output=<file.json>\t-- default: standard output\n";
+}
+
+QList<int> parseIntList(QString const& str)
+{
+    QList<int> values;
+    for (QString const& item : str.split(','))
+    {
+        if (item.trimmed().isEmpty())
+        {
+            continue;
+        }
+
+        bool ok = false;
+        int const value = item.trimmed().toInt(&ok);
+        if (!ok || value < 0)
+        {
+            throw std::runtime_error("Invalid number: " + item.toStdString());
+        }
+        values.push_back(value);
+    }
+    return values;
+}
+
+int imageDpi(QImage const& image)
+{
+    return qRound(image.dotsPerMeterX() * 0.0254);
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+
+#ifdef _WIN32
+    // Get rid of all references to Qt's installation directory.
+    app.setLibraryPaths(QStringList(app.applicationDirPath()));
+#endif
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    QImageReader::setAllocationLimit(0);
+#endif
+
+    // Filters look at the global command line, so give them
+    // an empty, non-GUI one.
+    CommandLine::set(CommandLine(QStringList(app.arguments().first()), false));
+
+    QMap<QString, QString> options;
+    QStringList files;
+    QStringList const args(app.arguments());
+    for (int i = 1; i < args.size(); ++i)
+    {
+        QString const& arg = args[i];
+        if (arg.startsWith("--"))
+        {
+            int const eq = arg.indexOf('=');
+            if (eq < 0)
+            {
+                options[arg.mid(2)] = "true";
+            }
+            else
+            {
+                options[arg.mid(2, eq - 2)] = arg.mid(eq + 1);
+            }
+        }
+        else
+        {
+            files.push_back(arg);
+        }
+    }
+
+    if (options.contains("help"))
+    {
+        printHelp();
+        return 0;
+    }
+
+    try
+    {
+        QList<int> const dpis(parseIntList(options.value("dpi", "300,600")));
+        QList<int> threads(parseIntList(options.value("threads", "1,0")));
+        for (int& t : threads)
+        {
+            if (t == 0)
+            {
+                t = QThread::idealThreadCount();
+            }
+        }
+        std::sort(threads.begin(), threads.end());
+        threads.erase(std::unique(threads.begin(), threads.end()), threads.end());
+
+        int const num_pages = std::max(1, options.value("pages", "4").toInt());
+        QStringList const groups(options.value("groups", "imageproc,stages").split(','));
+
+        BenchmarkRunner runner(options.value("iterations", "5").toInt(), options.value("filter"));
+
+        // Each entry is a set of pages to run the stages on, and the first
+        // of them is also used for the imageproc primitives.
+        struct PageSet
+        {
+            int dpi;
+            QStringList files;
+            QImage firstPage;
+        };
+        std::vector<PageSet> page_sets;
+
+        QTemporaryDir const pages_dir;
+        if (!files.isEmpty())
+        {
+            QImage const first(files.first());
+            if (first.isNull())
+            {
+                throw std::runtime_error("Unable to load " + files.first().toStdString());
+            }
+            page_sets.push_back(PageSet{imageDpi(first), files, first});
+        }
+        else
+        {
+            if (!pages_dir.isValid())
+            {
+                throw std::runtime_error("Unable to create a temporary directory.");
+            }
+            for (int const dpi : dpis)
+            {
+                PageSet set;
+                set.dpi = dpi;
+                for (int i = 0; i < num_pages; ++i)
+                {
+                    QImage const page(makeSyntheticPage(dpi, i));
+                    QString const path(
+                        QDir(pages_dir.path()).filePath(
+                            QString("page_%1dpi_%2.tif").arg(dpi).arg(i, 3, 10, QChar('0'))
+                        )
+                    );
+                    if (!TiffWriter::writeImage(path, page))
+                    {
+                        throw std::runtime_error("Unable to write " + path.toStdString());
+                    }
+                    set.files.push_back(path);
+                    if (i == 0)
+                    {
+                        set.firstPage = page;
+                    }
+                }
+                page_sets.push_back(set);
+            }
+        }
+
+        for (PageSet const& set : page_sets)
+        {
+            for (int const num_threads : threads)
+            {
+                setParallelForThreadLimit(num_threads);
+
+                BenchmarkConditions conditions;
+                conditions.dpi = set.dpi;
+                conditions.threads = num_threads;
+                conditions.width = set.firstPage.width();
+                conditions.height = set.firstPage.height();
+
+                if (groups.contains("imageproc"))
+                {
+                    runImageprocBenchmarks(runner, set.firstPage, conditions);
+                }
+                if (groups.contains("stages"))
+                {
+                    conditions.pages = set.files.size();
+                    runStageBenchmarks(runner, set.files, conditions);
+                }
+            }
+        }
+
+        QJsonObject root(runner.toJson().object());
+        root["version"] = QString(VERSION);
+        root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+        root["ideal_thread_count"] = QThread::idealThreadCount();
+        root["simd_level"] = int(imageproc::kernels::simdLevel());
+        root["iterations"] = runner.iterations();
+
+        QByteArray const json(QJsonDocument(root).toJson());
+        QString const output(options.value("output"));
+        if (output.isEmpty())
+        {
+            std::cout << json.constData();
+        }
+        else
+        {
+            QFile file(output);
+            if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size())
+            {
+                throw std::runtime_error("Unable to write " + output.toStdString());
+            }
+        }
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -18,6 +18,8 @@
 
 #include <cstdint>
 #include <utility>
+#include <vector>
+#include <algorithm>
 #include <cmath>
 #include <QtGlobal>
 #include <QColor>
@@ -29,6 +31,7 @@
 #include "CylindricalSurfaceDewarper.h"
 #include "HomographicTransform.h"
 #include "VecNT.h"
+#include "ParallelFor.h"
 #include "imageproc/ColorMixer.h"
 #include "imageproc/GrayImage.h"
 #include "imageproc/BadAllocIfNull.h"
@@ -41,324 +44,320 @@ namespace dewarping
 namespace
 {
 
+/**
+ * \brief Maps the area between two adjacent grid columns and two adjacent
+ *        grid rows in the source image to a destination pixel.
+ *
+ * \param src_left_points The top-left corner of the area, followed by
+ *        the bottom-left corner.
+ * \param src_right_points The top-right corner of the area, followed by
+ *        the bottom-right corner.
+ */
 template<typename ColorMixer, typename PixelType>
-void areaMapGeneratrix(
+PixelType areaMapPixel(
     PixelType const* const src_data,
     QSize const src_size,
     int const src_stride,
-    PixelType* p_dst,
-    QSize const dst_size,
-    int const dst_stride,
-    int const dst_y_first,
-    int const dst_y_last,
     PixelType const bg_color,
-    std::vector<Vec2f> const& prev_grid_column,
-    std::vector<Vec2f> const& next_grid_column,
+    Vec2f const* const src_left_points,
+    Vec2f const* const src_right_points,
     float const f_src32_min_mapping_width,
     float const f_src32_min_mapping_height)
 {
     int const sw = src_size.width();
     int const sh = src_size.height();
-    int const dst_height = dst_size.height();
-
-    Vec2f const* src_left_points = &prev_grid_column[0];
-    Vec2f const* src_right_points = &next_grid_column[0];
 
     Vec2f f_src32_quad[4];
 
-    int dst_y = 0;
+    // Take a mid-point of each edge, pre-multiply by 32,
+    // write the result to f_src32_quad. 16 comes from 32*0.5
 
-    // Process top out-of-density-bounds segment.
-    for (; dst_y < dst_y_first; ++dst_y)
-    {
-        *p_dst = bg_color;
-        p_dst += dst_stride;
-    }
-
-    for (; dst_y <= dst_y_last; ++dst_y)
-    {
-        // Take a mid-point of each edge, pre-multiply by 32,
-        // write the result to f_src32_quad. 16 comes from 32*0.5
+    f_src32_quad[0] = 16.0f * (src_left_points[0] + src_right_points[0]);
+    f_src32_quad[1] = 16.0f * (src_right_points[0] + src_right_points[1]);
+    f_src32_quad[2] = 16.0f * (src_right_points[1] + src_left_points[1]);
+    f_src32_quad[3] = 16.0f * (src_left_points[0] + src_left_points[1]);
 
-        f_src32_quad[0] = 16.0f * (src_left_points[0] + src_right_points[0]);
-        f_src32_quad[1] = 16.0f * (src_right_points[0] + src_right_points[1]);
-        f_src32_quad[2] = 16.0f * (src_right_points[1] + src_left_points[1]);
-        f_src32_quad[3] = 16.0f * (src_left_points[0] + src_left_points[1]);
-        ++src_left_points;
-        ++src_right_points;
+    // Calculate the bounding box of src_quad.
 
-        // Calculate the bounding box of src_quad.
+    float f_src32_left = f_src32_quad[0][0];
+    float f_src32_top = f_src32_quad[0][1];
+    float f_src32_right = f_src32_left;
+    float f_src32_bottom = f_src32_top;
 
-        float f_src32_left = f_src32_quad[0][0];
-        float f_src32_top = f_src32_quad[0][1];
-        float f_src32_right = f_src32_left;
-        float f_src32_bottom = f_src32_top;
-
-        for (int i = 1; i < 4; ++i)
+    for (int i = 1; i < 4; ++i)
+    {
+        Vec2f const pt(f_src32_quad[i]);
+        if (pt[0] < f_src32_left)
         {
-            Vec2f const pt(f_src32_quad[i]);
-            if (pt[0] < f_src32_left)
-            {
-                f_src32_left = pt[0];
-            }
-            else if (pt[0] > f_src32_right)
-            {
-                f_src32_right = pt[0];
-            }
-            if (pt[1] < f_src32_top)
-            {
-                f_src32_top = pt[1];
-            }
-            else if (pt[1] > f_src32_bottom)
-            {
-                f_src32_bottom = pt[1];
-            }
+            f_src32_left = pt[0];
         }
-
-        // Enforce the minimum mapping area.
-        if (f_src32_right - f_src32_left < f_src32_min_mapping_width)
+        else if (pt[0] > f_src32_right)
         {
-            float const midpoint = 0.5f * (f_src32_left + f_src32_right);
-            f_src32_left = midpoint - f_src32_min_mapping_width * 0.5f;
-            f_src32_right = midpoint + f_src32_min_mapping_width * 0.5f;
+            f_src32_right = pt[0];
         }
-        if (f_src32_bottom - f_src32_top < f_src32_min_mapping_height)
+        if (pt[1] < f_src32_top)
         {
-            float const midpoint = 0.5f * (f_src32_top + f_src32_bottom);
-            f_src32_top = midpoint - f_src32_min_mapping_height * 0.5f;
-            f_src32_bottom = midpoint + f_src32_min_mapping_height * 0.5f;
+            f_src32_top = pt[1];
         }
-
-        if (f_src32_top < -32.0f * 10000.0f || f_src32_left < -32.0f * 10000.0f ||
-                f_src32_bottom > 32.0f * (float(sh) + 10000.f) ||
-                f_src32_right > 32.0f * (float(sw) + 10000.f))
+        else if (pt[1] > f_src32_bottom)
         {
-            // This helps to prevent integer overflows.
-            *p_dst = bg_color;
-            p_dst += dst_stride;
-            continue;
+            f_src32_bottom = pt[1];
         }
+    }
 
-        // Note: the code below is more or less the same as in transformGeneric()
-        // in imageproc/Transform.cpp
-
-        // Note that without using floor() and ceil()
-        // we can't guarantee that src_bottom >= src_top
-        // and src_right >= src_left.
-        int src32_left = (int)floor(f_src32_left);
-        int src32_right = (int)ceil(f_src32_right);
-        int src32_top = (int)floor(f_src32_top);
-        int src32_bottom = (int)ceil(f_src32_bottom);
-        int src_left = src32_left >> 5;
-        int src_right = (src32_right - 1) >> 5; // inclusive
-        int src_top = src32_top >> 5;
-        int src_bottom = (src32_bottom - 1) >> 5; // inclusive
-        assert(src_bottom >= src_top);
-        assert(src_right >= src_left);
-
-        if (src_bottom < 0 || src_right < 0 || src_left >= sw || src_top >= sh)
-        {
-            // Completely outside of src image.
-            *p_dst = bg_color;
-            p_dst += dst_stride;
-            continue;
-        }
+    // Enforce the minimum mapping area.
+    if (f_src32_right - f_src32_left < f_src32_min_mapping_width)
+    {
+        float const midpoint = 0.5f * (f_src32_left + f_src32_right);
+        f_src32_left = midpoint - f_src32_min_mapping_width * 0.5f;
+        f_src32_right = midpoint + f_src32_min_mapping_width * 0.5f;
+    }
+    if (f_src32_bottom - f_src32_top < f_src32_min_mapping_height)
+    {
+        float const midpoint = 0.5f * (f_src32_top + f_src32_bottom);
+        f_src32_top = midpoint - f_src32_min_mapping_height * 0.5f;
+        f_src32_bottom = midpoint + f_src32_min_mapping_height * 0.5f;
+    }
 
-        /*
-         * Note that (intval / 32) is not the same as (intval >> 5).
-         * The former rounds towards zero, while the latter rounds towards
-         * negative infinity.
-         * Likewise, (intval % 32) is not the same as (intval & 31).
-         * The following expression:
-         * top_fraction = 32 - (src32_top & 31);
-         * works correctly with both positive and negative src32_top.
-         */
+    if (f_src32_top < -32.0f * 10000.0f || f_src32_left < -32.0f * 10000.0f ||
+            f_src32_bottom > 32.0f * (float(sh) + 10000.f) ||
+            f_src32_right > 32.0f * (float(sw) + 10000.f))
+    {
+        // This helps to prevent integer overflows.
+        return bg_color;
+    }
 
-        unsigned background_area = 0;
+    // Note: the code below is more or less the same as in transformGeneric()
+    // in imageproc/Transform.cpp
+
+    // Note that without using floor() and ceil()
+    // we can't guarantee that src_bottom >= src_top
+    // and src_right >= src_left.
+    int src32_left = (int)floor(f_src32_left);
+    int src32_right = (int)ceil(f_src32_right);
+    int src32_top = (int)floor(f_src32_top);
+    int src32_bottom = (int)ceil(f_src32_bottom);
+    int src_left = src32_left >> 5;
+    int src_right = (src32_right - 1) >> 5; // inclusive
+    int src_top = src32_top >> 5;
+    int src_bottom = (src32_bottom - 1) >> 5; // inclusive
+    assert(src_bottom >= src_top);
+    assert(src_right >= src_left);
+
+    if (src_bottom < 0 || src_right < 0 || src_left >= sw || src_top >= sh)
+    {
+        // Completely outside of src image.
+        return bg_color;
+    }
 
-        if (src_top < 0)
-        {
-            unsigned const top_fraction = 32 - (src32_top & 31);
-            unsigned const hor_fraction = src32_right - src32_left;
-            background_area += top_fraction * hor_fraction;
-            unsigned const full_pixels_ver = -1 - src_top;
-            background_area += hor_fraction * (full_pixels_ver << 5);
-            src_top = 0;
-            src32_top = 0;
-        }
-        if (src_bottom >= sh)
-        {
-            unsigned const bottom_fraction = src32_bottom - (src_bottom << 5);
-            unsigned const hor_fraction = src32_right - src32_left;
-            background_area += bottom_fraction * hor_fraction;
-            unsigned const full_pixels_ver = src_bottom - sh;
-            background_area += hor_fraction * (full_pixels_ver << 5);
-            src_bottom = sh - 1; // inclusive
-            src32_bottom = sh << 5; // exclusive
-        }
-        if (src_left < 0)
-        {
-            unsigned const left_fraction = 32 - (src32_left & 31);
-            unsigned const vert_fraction = src32_bottom - src32_top;
-            background_area += left_fraction * vert_fraction;
-            unsigned const full_pixels_hor = -1 - src_left;
-            background_area += vert_fraction * (full_pixels_hor << 5);
-            src_left = 0;
-            src32_left = 0;
-        }
-        if (src_right >= sw)
-        {
-            unsigned const right_fraction = src32_right - (src_right << 5);
-            unsigned const vert_fraction = src32_bottom - src32_top;
-            background_area += right_fraction * vert_fraction;
-            unsigned const full_pixels_hor = src_right - sw;
-            background_area += vert_fraction * (full_pixels_hor << 5);
-            src_right = sw - 1; // inclusive
-            src32_right = sw << 5; // exclusive
-        }
-        assert(src_bottom >= src_top);
-        assert(src_right >= src_left);
+    /*
+     * Note that (intval / 32) is not the same as (intval >> 5).
+     * The former rounds towards zero, while the latter rounds towards
+     * negative infinity.
+     * Likewise, (intval % 32) is not the same as (intval & 31).
+     * The following expression:
+     * top_fraction = 32 - (src32_top & 31);
+     * works correctly with both positive and negative src32_top.
+     */
 
-        ColorMixer mixer;
-        mixer.add(bg_color, background_area);
+    unsigned background_area = 0;
 
-        unsigned const left_fraction = 32 - (src32_left & 31);
+    if (src_top < 0)
+    {
         unsigned const top_fraction = 32 - (src32_top & 31);
-        unsigned const right_fraction = src32_right - (src_right << 5);
+        unsigned const hor_fraction = src32_right - src32_left;
+        background_area += top_fraction * hor_fraction;
+        unsigned const full_pixels_ver = -1 - src_top;
+        background_area += hor_fraction * (full_pixels_ver << 5);
+        src_top = 0;
+        src32_top = 0;
+    }
+    if (src_bottom >= sh)
+    {
         unsigned const bottom_fraction = src32_bottom - (src_bottom << 5);
+        unsigned const hor_fraction = src32_right - src32_left;
+        background_area += bottom_fraction * hor_fraction;
+        unsigned const full_pixels_ver = src_bottom - sh;
+        background_area += hor_fraction * (full_pixels_ver << 5);
+        src_bottom = sh - 1; // inclusive
+        src32_bottom = sh << 5; // exclusive
+    }
+    if (src_left < 0)
+    {
+        unsigned const left_fraction = 32 - (src32_left & 31);
+        unsigned const vert_fraction = src32_bottom - src32_top;
+        background_area += left_fraction * vert_fraction;
+        unsigned const full_pixels_hor = -1 - src_left;
+        background_area += vert_fraction * (full_pixels_hor << 5);
+        src_left = 0;
+        src32_left = 0;
+    }
+    if (src_right >= sw)
+    {
+        unsigned const right_fraction = src32_right - (src_right << 5);
+        unsigned const vert_fraction = src32_bottom - src32_top;
+        background_area += right_fraction * vert_fraction;
+        unsigned const full_pixels_hor = src_right - sw;
+        background_area += vert_fraction * (full_pixels_hor << 5);
+        src_right = sw - 1; // inclusive
+        src32_right = sw << 5; // exclusive
+    }
+    assert(src_bottom >= src_top);
+    assert(src_right >= src_left);
 
-        assert(left_fraction + right_fraction + (src_right - src_left - 1) * 32 == static_cast<unsigned>(src32_right - src32_left));
-        assert(top_fraction + bottom_fraction + (src_bottom - src_top - 1) * 32 == static_cast<unsigned>(src32_bottom - src32_top));
-
-        unsigned const src_area = (src32_bottom - src32_top) * (src32_right - src32_left);
-        if (src_area == 0)
-        {
-            *p_dst = bg_color;
-            p_dst += dst_stride;
-            continue;
-        }
+    ColorMixer mixer;
+    mixer.add(bg_color, background_area);
 
-        PixelType const* src_line = &src_data[src_top * src_stride];
+    unsigned const left_fraction = 32 - (src32_left & 31);
+    unsigned const top_fraction = 32 - (src32_top & 31);
+    unsigned const right_fraction = src32_right - (src_right << 5);
+    unsigned const bottom_fraction = src32_bottom - (src_bottom << 5);
 
-        if (src_top == src_bottom)
-        {
-            if (src_left == src_right)
-            {
-                // dst pixel maps to a single src pixel
-                PixelType const c = src_line[src_left];
-                if (background_area == 0)
-                {
-                    // common case optimization
-                    *p_dst = c;
-                    p_dst += dst_stride;
-                    continue;
-                }
-                mixer.add(c, src_area);
-            }
-            else
-            {
-                // dst pixel maps to a horizontal line of src pixels
-                unsigned const vert_fraction = src32_bottom - src32_top;
-                unsigned const left_area = vert_fraction * left_fraction;
-                unsigned const middle_area = vert_fraction << 5;
-                unsigned const right_area = vert_fraction * right_fraction;
+    assert(left_fraction + right_fraction + (src_right - src_left - 1) * 32 == static_cast<unsigned>(src32_right - src32_left));
+    assert(top_fraction + bottom_fraction + (src_bottom - src_top - 1) * 32 == static_cast<unsigned>(src32_bottom - src32_top));
 
-                mixer.add(src_line[src_left], left_area);
+    unsigned const src_area = (src32_bottom - src32_top) * (src32_right - src32_left);
+    if (src_area == 0)
+    {
+        return bg_color;
+    }
 
-                for (int sx = src_left + 1; sx < src_right; ++sx)
-                {
-                    mixer.add(src_line[sx], middle_area);
-                }
+    PixelType const* src_line = &src_data[src_top * src_stride];
 
-                mixer.add(src_line[src_right], right_area);
-            }
-        }
-        else if (src_left == src_right)
+    if (src_top == src_bottom)
+    {
+        if (src_left == src_right)
         {
-            // dst pixel maps to a vertical line of src pixels
-            unsigned const hor_fraction = src32_right - src32_left;
-            unsigned const top_area = hor_fraction * top_fraction;
-            unsigned const middle_area = hor_fraction << 5;
-            unsigned const bottom_area =  hor_fraction * bottom_fraction;
-
-            src_line += src_left;
-            mixer.add(*src_line, top_area);
-
-            src_line += src_stride;
-
-            for (int sy = src_top + 1; sy < src_bottom; ++sy)
+            // dst pixel maps to a single src pixel
+            PixelType const c = src_line[src_left];
+            if (background_area == 0)
             {
-                mixer.add(*src_line, middle_area);
-                src_line += src_stride;
+                // common case optimization
+                return c;
             }
-
-            mixer.add(*src_line, bottom_area);
+            mixer.add(c, src_area);
         }
         else
         {
-            // dst pixel maps to a block of src pixels
-            unsigned const top_area = top_fraction << 5;
-            unsigned const bottom_area = bottom_fraction << 5;
-            unsigned const left_area = left_fraction << 5;
-            unsigned const right_area = right_fraction << 5;
-            unsigned const topleft_area = top_fraction * left_fraction;
-            unsigned const topright_area = top_fraction * right_fraction;
-            unsigned const bottomleft_area = bottom_fraction * left_fraction;
-            unsigned const bottomright_area = bottom_fraction * right_fraction;
-
-            // process the top-left corner
-            mixer.add(src_line[src_left], topleft_area);
-
-            // process the top line (without corners)
+            // dst pixel maps to a horizontal line of src pixels
+            unsigned const vert_fraction = src32_bottom - src32_top;
+            unsigned const left_area = vert_fraction * left_fraction;
+            unsigned const middle_area = vert_fraction << 5;
+            unsigned const right_area = vert_fraction * right_fraction;
+
+            mixer.add(src_line[src_left], left_area);
+
             for (int sx = src_left + 1; sx < src_right; ++sx)
             {
-                mixer.add(src_line[sx], top_area);
+                mixer.add(src_line[sx], middle_area);
             }
 
-            // process the top-right corner
-            mixer.add(src_line[src_right], topright_area);
+            mixer.add(src_line[src_right], right_area);
+        }
+    }
+    else if (src_left == src_right)
+    {
+        // dst pixel maps to a vertical line of src pixels
+        unsigned const hor_fraction = src32_right - src32_left;
+        unsigned const top_area = hor_fraction * top_fraction;
+        unsigned const middle_area = hor_fraction << 5;
+        unsigned const bottom_area =  hor_fraction * bottom_fraction;
 
-            src_line += src_stride;
+        src_line += src_left;
+        mixer.add(*src_line, top_area);
 
-            // process middle lines
-            for (int sy = src_top + 1; sy < src_bottom; ++sy)
-            {
-                mixer.add(src_line[src_left], left_area);
+        src_line += src_stride;
 
-                for (int sx = src_left + 1; sx < src_right; ++sx)
-                {
-                    mixer.add(src_line[sx], 32*32);
-                }
+        for (int sy = src_top + 1; sy < src_bottom; ++sy)
+        {
+            mixer.add(*src_line, middle_area);
+            src_line += src_stride;
+        }
+
+        mixer.add(*src_line, bottom_area);
+    }
+    else
+    {
+        // dst pixel maps to a block of src pixels
+        unsigned const top_area = top_fraction << 5;
+        unsigned const bottom_area = bottom_fraction << 5;
+        unsigned const left_area = left_fraction << 5;
+        unsigned const right_area = right_fraction << 5;
+        unsigned const topleft_area = top_fraction * left_fraction;
+        unsigned const topright_area = top_fraction * right_fraction;
+        unsigned const bottomleft_area = bottom_fraction * left_fraction;
+        unsigned const bottomright_area = bottom_fraction * right_fraction;
+
+        // process the top-left corner
+        mixer.add(src_line[src_left], topleft_area);
+
+        // process the top line (without corners)
+        for (int sx = src_left + 1; sx < src_right; ++sx)
+        {
+            mixer.add(src_line[sx], top_area);
+        }
 
-                mixer.add(src_line[src_right], right_area);
+        // process the top-right corner
+        mixer.add(src_line[src_right], topright_area);
 
-                src_line += src_stride;
-            }
+        src_line += src_stride;
 
-            // process bottom-left corner
-            mixer.add(src_line[src_left], bottomleft_area);
+        // process middle lines
+        for (int sy = src_top + 1; sy < src_bottom; ++sy)
+        {
+            mixer.add(src_line[src_left], left_area);
 
-            // process the bottom line (without corners)
             for (int sx = src_left + 1; sx < src_right; ++sx)
             {
-                mixer.add(src_line[sx], bottom_area);
+                mixer.add(src_line[sx], 32*32);
             }
 
-            // process the bottom-right corner
-            mixer.add(src_line[src_right], bottomright_area);
+            mixer.add(src_line[src_right], right_area);
+
+            src_line += src_stride;
+        }
+
+        // process bottom-left corner
+        mixer.add(src_line[src_left], bottomleft_area);
+
+        // process the bottom line (without corners)
+        for (int sx = src_left + 1; sx < src_right; ++sx)
+        {
+            mixer.add(src_line[sx], bottom_area);
         }
 
-        *p_dst = mixer.mix(src_area + background_area);
-        p_dst += dst_stride;
+        // process the bottom-right corner
+        mixer.add(src_line[src_right], bottomright_area);
     }
 
-    // Process bottom out-of-density-bounds segment.
-    for (; dst_y < dst_height; ++dst_y)
+    return mixer.mix(src_area + background_area);
+}
+
+/**
+ * \brief The mapping of a vertical grid line in the destination image
+ *        into the source image.
+ */
+struct GridColumn
+{
+    HomographicTransform<1, float> homog;
+    Vec2f origin;
+    Vec2f vec;
+
+    /**
+     * The inclusive range of grid rows where pixel density
+     * is within the allowed bounds.
+     */
+    std::pair<int, int> dstYRange;
+
+    GridColumn(HomographicTransform<1, float> const& hom,
+               Vec2f const& orig, Vec2f const& v, std::pair<int, int> const& dst_y_range)
+        : homog(hom), origin(orig), vec(v), dstYRange(dst_y_range) {}
+
+    Vec2f mapGridPoint(float model_y) const
     {
-        *p_dst = bg_color;
-        p_dst += dst_stride;
+        return origin + vec * homog(model_y);
     }
-}
+};
 
 template<typename ColorMixer, typename PixelType>
 void dewarpGeneric(
@@ -390,9 +389,11 @@ void dewarpGeneric(
     float const f_src32_min_mapping_width = min_mapping_area.width() * 32.0f;
     float const f_src32_min_mapping_height = min_mapping_area.height() * 32.0f;
 
-    std::vector<Vec2f> prev_grid_column(dst_height + 1);
-    std::vector<Vec2f> next_grid_column(dst_height + 1);
-    std::pair<int, int> prev_dst_y_range(0, dst_height - 1); // Inclusive.
+    // Map all the grid columns upfront.  This is sequential, as the state
+    // carries search hints from one column to the next, but cheap compared
+    // to the area mapping below.
+    std::vector<GridColumn> grid_columns;
+    grid_columns.reserve(dst_width + 1);
 
     for (int dst_x = 0; dst_x <= dst_width; ++dst_x)
     {
@@ -404,11 +405,6 @@ void dewarpGeneric(
         HomographicTransform<1, float> const homog(generatrix.pln2img.mat().cast<float>());
         Vec2f const origin(generatrix.imgLine.p1());
         Vec2f const vec(generatrix.imgLine.p2() - generatrix.imgLine.p1());
-        for (int dst_y = 0; dst_y <= dst_height; ++dst_y)
-        {
-            float const model_y = (float(dst_y) - model_domain_top) * model_y_scale;
-            next_grid_column[dst_y] = origin + vec * homog(model_y);
-        }
 
         std::pair<int, int> dst_y_range(0, dst_height - 1); // Inclusive.
 
@@ -461,35 +457,72 @@ void dewarpGeneric(
         }
         );
 
-        int const dst_y_first = std::max(prev_dst_y_range.first, dst_y_range.first);
-        int const dst_y_last = std::min(prev_dst_y_range.second, dst_y_range.second);
-        // The case with dst_y_first > dst_y_first is not a problem, as long as both
-        // are within [0, dst_height)
+        grid_columns.emplace_back(homog, origin, vec, dst_y_range);
+    }
+
+    // Area mapping is done in tiles, which are independent of each other.
+    // Within a tile we go line by line, as both images are stored that way.
+    int const tiles_per_row = (dst_width + TILE_SIZE - 1) / TILE_SIZE;
+    int const tiles_per_column = (dst_height + TILE_SIZE - 1) / TILE_SIZE;
+
+    parallelFor(0, tiles_per_row * tiles_per_column, 1, [&](int const begin, int const end)
+    {
+        // Grid points surrounding the tile, stored column by column.
+        std::vector<Vec2f> grid((TILE_SIZE + 1) * (TILE_SIZE + 1));
 
-        if (dst_x != 0)
+        for (int tile = begin; tile < end; ++tile)
         {
-            areaMapGeneratrix<ColorMixer, PixelType>(
-                src_data,
-                src_size,
-                src_stride,
-                dst_data + dst_x - 1,
-                dst_size,
-                dst_stride,
-                dst_y_first,
-                dst_y_last,
-                bg_color,
-                prev_grid_column,
-                next_grid_column,
-                f_src32_min_mapping_width,
-                f_src32_min_mapping_height
-            );
-        }
+            int const x0 = (tile % tiles_per_row) * TILE_SIZE;
+            int const y0 = (tile / tiles_per_row) * TILE_SIZE;
+            int const x1 = std::min(x0 + TILE_SIZE, dst_width); // exclusive
+            int const y1 = std::min(y0 + TILE_SIZE, dst_height); // exclusive
+            int const grid_stride = y1 - y0 + 1;
+
+            Vec2f* p_grid = &grid[0];
+            for (int x = x0; x <= x1; ++x)
+            {
+                GridColumn const& column = grid_columns[x];
+                for (int y = y0; y <= y1; ++y, ++p_grid)
+                {
+                    float const model_y = (float(y) - model_domain_top) * model_y_scale;
+                    *p_grid = column.mapGridPoint(model_y);
+                }
+            }
 
-        prev_grid_column.swap(next_grid_column);
-        prev_dst_y_range = dst_y_range;
-    }
+            PixelType* dst_line = dst_data + y0 * dst_stride;
+            for (int y = y0; y < y1; ++y, dst_line += dst_stride)
+            {
+                Vec2f const* left_points = &grid[y - y0];
+                for (int x = x0; x < x1; ++x, left_points += grid_stride)
+                {
+                    std::pair<int, int> const& left_range = grid_columns[x].dstYRange;
+                    std::pair<int, int> const& right_range = grid_columns[x + 1].dstYRange;
+                    int const dst_y_first = std::max(left_range.first, right_range.first);
+                    int const dst_y_last = std::min(left_range.second, right_range.second);
+                    // The case with dst_y_first > dst_y_last is not a problem,
+                    // as it just makes the whole column out of bounds.
+
+                    if (y < dst_y_first || y > dst_y_last)
+                    {
+                        // Out of density bounds.
+                        dst_line[x] = bg_color;
+                    }
+                    else
+                    {
+                        dst_line[x] = areaMapPixel<ColorMixer, PixelType>(
+                                          src_data, src_size, src_stride, bg_color,
+                                          left_points, left_points + grid_stride,
+                                          f_src32_min_mapping_width,
+                                          f_src32_min_mapping_height
+                                      );
+                    }
+                }
+            }
+        }
+    });
 }
 
+
 typedef uint32_t MixingWeight;
 typedef float ArgbMixingWeight;
 /* We can't use uint32_t for ArgbMixingWeight because additional scaling
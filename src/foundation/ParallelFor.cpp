@@ -0,0 +1,252 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ParallelFor.h"
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <exception>
+#include <memory>
+#include <algorithm>
+
+namespace
+{
+
+/**
+ * The number of helper threads running parallelFor() chunks plus
+ * the number of other threads that are counted as busy, either
+ * by a ParallelForWorkerScope or by being inside parallelFor().
+ */
+QAtomicInt g_numBusyThreads(0);
+
+/**
+ * Whether the current thread is included in g_numBusyThreads.
+ */
+thread_local bool t_threadCounted = false;
+
+/**
+ * \brief Counts one more thread as busy, unless \p limit is already reached.
+ */
+bool tryReserveThread(int const limit)
+{
+    for (;;)
+    {
+        int const busy = g_numBusyThreads.loadAcquire();
+        if (busy >= limit)
+        {
+            return false;
+        }
+        if (g_numBusyThreads.testAndSetOrdered(busy, busy + 1))
+        {
+            return true;
+        }
+    }
+}
+
+void releaseThread()
+{
+    g_numBusyThreads.fetchAndAddOrdered(-1);
+}
+
+class ParallelForState
+{
+public:
+    ParallelForState(int begin, int end, int grain,
+                     std::function<void(int, int)> const& body)
+        : m_begin(begin), m_end(end), m_grain(grain),
+          m_numChunks((end - begin + grain - 1) / grain),
+          m_nextChunk(0), m_failed(0), m_doneChunks(0), m_rBody(body) {}
+
+    int numChunks() const
+    {
+        return m_numChunks;
+    }
+
+    /**
+     * Processes chunks until there are none left to claim.
+     * The body is only accessed for claimed chunks, which
+     * keeps late starters from touching it after wait() returned.
+     */
+    void work()
+    {
+        for (;;)
+        {
+            int const chunk = m_nextChunk.fetchAndAddRelaxed(1);
+            if (chunk >= m_numChunks)
+            {
+                break;
+            }
+
+            // After a failure, the remaining chunks are claimed but skipped.
+            if (!m_failed.loadAcquire())
+            {
+                int const chunk_begin = m_begin + chunk * m_grain;
+                int const chunk_end = std::min(m_end, chunk_begin + m_grain);
+                try
+                {
+                    m_rBody(chunk_begin, chunk_end);
+                }
+                catch (...)
+                {
+                    QMutexLocker const locker(&m_mutex);
+                    if (!m_exception)
+                    {
+                        m_exception = std::current_exception();
+                    }
+                    m_failed.storeRelease(1);
+                }
+            }
+
+            QMutexLocker const locker(&m_mutex);
+            if (++m_doneChunks == m_numChunks)
+            {
+                m_cond.wakeAll();
+            }
+        }
+    }
+
+    void wait()
+    {
+        QMutexLocker const locker(&m_mutex);
+        while (m_doneChunks < m_numChunks)
+        {
+            m_cond.wait(&m_mutex);
+        }
+        if (m_exception)
+        {
+            std::rethrow_exception(m_exception);
+        }
+    }
+private:
+    int const m_begin;
+    int const m_end;
+    int const m_grain;
+    int const m_numChunks;
+    QAtomicInt m_nextChunk;
+    QAtomicInt m_failed;
+    int m_doneChunks;
+    std::function<void(int, int)> const& m_rBody;
+    QMutex m_mutex;
+    QWaitCondition m_cond;
+    std::exception_ptr m_exception;
+};
+
+
+class ParallelForRunnable : public QRunnable
+{
+public:
+    ParallelForRunnable(std::shared_ptr<ParallelForState> const& state)
+        : m_ptrState(state)
+    {
+        setAutoDelete(true);
+    }
+
+    virtual void run() override
+    {
+        // The thread was reserved by whoever started us.
+        bool const was_counted = t_threadCounted;
+        t_threadCounted = true;
+        m_ptrState->work();
+        t_threadCounted = was_counted;
+
+        // Let go of the state before letting another helper start.
+        m_ptrState.reset();
+        releaseThread();
+    }
+private:
+    std::shared_ptr<ParallelForState> m_ptrState;
+};
+
+} // anonymous namespace
+
+void parallelFor(
+    int const begin, int const end, int const grain,
+    std::function<void(int, int)> const& body)
+{
+    if (begin >= end)
+    {
+        return;
+    }
+
+    ParallelForWorkerScope const caller_scope;
+
+    int const chunk = std::max(1, grain);
+    if (end - begin <= chunk)
+    {
+        body(begin, end);
+        return;
+    }
+
+    auto const state = std::make_shared<ParallelForState>(begin, end, chunk, body);
+
+    QThreadPool* const pool = QThreadPool::globalInstance();
+    int const limit = pool->maxThreadCount();
+    int const num_helpers = std::min(state->numChunks() - 1, limit);
+    for (int i = 0; i < num_helpers; ++i)
+    {
+        if (!tryReserveThread(limit))
+        {
+            // Enough threads are busy already.  We'll do the rest ourselves.
+            break;
+        }
+
+        std::unique_ptr<ParallelForRunnable> runnable(new ParallelForRunnable(state));
+        if (!pool->tryStart(runnable.get()))
+        {
+            // All pool threads are busy.  We'll do the rest ourselves.
+            releaseThread();
+            break;
+        }
+        runnable.release();
+    }
+
+    state->work();
+    state->wait();
+}
+
+void setParallelForThreadLimit(int const num_threads)
+{
+    QThreadPool::globalInstance()->setMaxThreadCount(std::max(1, num_threads));
+}
+
+int parallelForThreadLimit()
+{
+    return QThreadPool::globalInstance()->maxThreadCount();
+}
+
+ParallelForWorkerScope::ParallelForWorkerScope()
+    : m_counted(!t_threadCounted)
+{
+    if (m_counted)
+    {
+        g_numBusyThreads.fetchAndAddOrdered(1);
+        t_threadCounted = true;
+    }
+}
+
+ParallelForWorkerScope::~ParallelForWorkerScope()
+{
+    if (m_counted)
+    {
+        t_threadCounted = false;
+        releaseThread();
+    }
+}
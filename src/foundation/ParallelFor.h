@@ -0,0 +1,80 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PARALLEL_FOR_H_
+#define PARALLEL_FOR_H_
+
+#include "foundation_config.h"
+#include "NonCopyable.h"
+#include <functional>
+
+/**
+ * \brief Splits [begin, end) into chunks and processes them on several threads.
+ *
+ * \p body is called as body(chunk_begin, chunk_end) for consecutive,
+ * non-overlapping chunks of at most \p grain items each.  The calling
+ * thread takes part in the processing, so the function makes progress
+ * even when no pool threads are available, and returns only after all
+ * chunks were processed.  The first exception thrown by \p body is
+ * rethrown from the calling thread.
+ *
+ * Helper threads come from the global thread pool and are only started
+ * while fewer than parallelForThreadLimit() threads are busy, counting
+ * helpers, threads holding a ParallelForWorkerScope and threads inside
+ * parallelFor().  The calling thread counts as busy for the duration of
+ * the call, unless it already was.  Once all of them are busy, including
+ * from nested calls, the calling thread processes all the chunks itself.
+ */
+FOUNDATION_EXPORT void parallelFor(
+    int begin, int end, int grain, std::function<void(int, int)> const& body);
+
+/**
+ * \brief Sets the process-wide number of threads that may be busy at once.
+ *
+ * It also becomes the maximum thread count of the global thread pool.
+ * Values below 1 are treated as 1.
+ */
+FOUNDATION_EXPORT void setParallelForThreadLimit(int num_threads);
+
+/**
+ * \brief Returns the limit set by setParallelForThreadLimit().
+ *
+ * Defaults to the maximum thread count of the global thread pool.
+ */
+FOUNDATION_EXPORT int parallelForThreadLimit();
+
+/**
+ * \brief Counts the current thread as busy for the lifetime of the object.
+ *
+ * Threads doing coarse-grained work, like processing a whole page, hold
+ * one of these.  Then parallelFor() calls made from several of them don't
+ * start more helper threads than there are free cores.  Nested scopes
+ * count the thread only once.
+ */
+class FOUNDATION_EXPORT ParallelForWorkerScope
+{
+    DECLARE_NON_COPYABLE(ParallelForWorkerScope)
+public:
+    ParallelForWorkerScope();
+
+    ~ParallelForWorkerScope();
+private:
+    bool const m_counted;
+};
+
+#endif
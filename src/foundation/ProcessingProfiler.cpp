@@ -0,0 +1,308 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ProcessingProfiler.h"
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#ifndef PSAPI_VERSION
+#define PSAPI_VERSION 2 // GetProcessMemoryInfo() from kernel32.
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+namespace
+{
+
+class Session
+{
+public:
+    Session() : m_active(0), m_numEvents(0) {}
+
+    ~Session()
+    {
+        // Keeps the file well-formed if nobody called stop().
+        finishLocked();
+    }
+
+    bool isActive() const
+    {
+        return m_active.loadAcquire() != 0;
+    }
+
+    qint64 elapsedUs() const
+    {
+        return m_clock.nsecsElapsed() / 1000;
+    }
+
+    bool start(QString const& file_path)
+    {
+        QMutexLocker const locker(&m_mutex);
+
+        if (m_ptrFile && m_ptrFile->fileName() == file_path)
+        {
+            return true;
+        }
+        finishLocked();
+
+        std::unique_ptr<QFile> file(new QFile(file_path));
+        if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            return false;
+        }
+        file->write("[\n");
+
+        m_ptrFile = std::move(file);
+        m_numEvents = 0;
+        m_clock.start();
+        m_active.storeRelease(1);
+        return true;
+    }
+
+    void stop()
+    {
+        QMutexLocker const locker(&m_mutex);
+        finishLocked();
+    }
+
+    void write(QJsonObject const& event)
+    {
+        QByteArray const json(QJsonDocument(event).toJson(QJsonDocument::Compact));
+
+        QMutexLocker const locker(&m_mutex);
+        if (!m_ptrFile)
+        {
+            return;
+        }
+        if (m_numEvents++)
+        {
+            m_ptrFile->write(",\n");
+        }
+        m_ptrFile->write(json);
+    }
+private:
+    void finishLocked()
+    {
+        m_active.storeRelease(0);
+        if (m_ptrFile)
+        {
+            m_ptrFile->write("\n]\n");
+            m_ptrFile.reset();
+        }
+    }
+
+    QMutex m_mutex;
+    QAtomicInt m_active;
+    QElapsedTimer m_clock;
+    std::unique_ptr<QFile> m_ptrFile;
+    int m_numEvents;
+};
+
+Session& session()
+{
+    static Session instance;
+    return instance;
+}
+
+/**
+ * Trace viewers want small integer thread ids, so threads are
+ * numbered in the order they first record something.
+ */
+int currentThreadNumber()
+{
+    static QAtomicInt counter(0);
+    thread_local int const number = counter.fetchAndAddRelaxed(1) + 1;
+    return number;
+}
+
+#if defined(__linux__)
+void readIoCounters(qint64& read_bytes, qint64& written_bytes)
+{
+    FILE* file = fopen("/proc/thread-self/io", "r");
+    if (!file)
+    {
+        file = fopen("/proc/self/io", "r");
+    }
+    if (!file)
+    {
+        return;
+    }
+
+    char line[128];
+    long long value = 0;
+    while (fgets(line, sizeof(line), file))
+    {
+        if (sscanf(line, "rchar: %lld", &value) == 1)
+        {
+            read_bytes = value;
+        }
+        else if (sscanf(line, "wchar: %lld", &value) == 1)
+        {
+            written_bytes = value;
+        }
+    }
+    fclose(file);
+}
+#endif
+
+} // anonymous namespace
+
+
+bool
+ProcessingProfiler::start(QString const& file_path)
+{
+    return session().start(file_path);
+}
+
+void
+ProcessingProfiler::stop()
+{
+    session().stop();
+}
+
+bool
+ProcessingProfiler::isActive()
+{
+    return session().isActive();
+}
+
+
+ProfileScope::ProfileScope(char const* category, char const* name)
+    :   m_pCategory(category),
+        m_pName(name),
+        m_active(session().isActive())
+{
+    if (m_active)
+    {
+        m_start = currentSample();
+    }
+}
+
+ProfileScope::ProfileScope(char const* category, char const* name, QString const& page)
+    :   m_pCategory(category),
+        m_pName(name),
+        m_page(page),
+        m_active(session().isActive())
+{
+    if (m_active)
+    {
+        m_start = currentSample();
+    }
+}
+
+ProfileScope::~ProfileScope()
+{
+    if (!m_active || !session().isActive())
+    {
+        return;
+    }
+
+    Sample const end(currentSample());
+
+    QJsonObject args;
+    if (!m_page.isEmpty())
+    {
+        args["page"] = m_page;
+    }
+    args["cpu_ms"] = (end.cpuUs - m_start.cpuUs) / 1000.0;
+    args["peak_rss_delta_kb"] = double(end.peakRssKb - m_start.peakRssKb);
+    args["read_bytes"] = double(end.readBytes - m_start.readBytes);
+    args["written_bytes"] = double(end.writtenBytes - m_start.writtenBytes);
+
+    QJsonObject event;
+    event["name"] = QString::fromLatin1(m_pName);
+    event["cat"] = QString::fromLatin1(m_pCategory);
+    event["ph"] = QString("X");
+    event["ts"] = double(m_start.wallUs);
+    event["dur"] = double(end.wallUs - m_start.wallUs);
+    event["pid"] = 1;
+    event["tid"] = currentThreadNumber();
+    event["args"] = args;
+
+    session().write(event);
+}
+
+ProfileScope::Sample
+ProfileScope::currentSample()
+{
+    Sample sample;
+    memset(&sample, 0, sizeof(sample));
+    sample.wallUs = session().elapsedUs();
+
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    if (GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+    {
+        ULARGE_INTEGER k, u;
+        k.LowPart = kernel.dwLowDateTime;
+        k.HighPart = kernel.dwHighDateTime;
+        u.LowPart = user.dwLowDateTime;
+        u.HighPart = user.dwHighDateTime;
+        // FILETIME counts 100 ns intervals.
+        sample.cpuUs = qint64((k.QuadPart + u.QuadPart) / 10);
+    }
+
+    PROCESS_MEMORY_COUNTERS memory;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory)))
+    {
+        sample.peakRssKb = qint64(memory.PeakWorkingSetSize / 1024);
+    }
+
+    IO_COUNTERS io;
+    if (GetProcessIoCounters(GetCurrentProcess(), &io))
+    {
+        sample.readBytes = qint64(io.ReadTransferCount);
+        sample.writtenBytes = qint64(io.WriteTransferCount);
+    }
+#else
+    timespec cpu_time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_time) == 0)
+    {
+        sample.cpuUs = qint64(cpu_time.tv_sec) * 1000000 + cpu_time.tv_nsec / 1000;
+    }
+
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+#if defined(__APPLE__)
+        sample.peakRssKb = qint64(usage.ru_maxrss) / 1024; // bytes on macOS
+#else
+        sample.peakRssKb = qint64(usage.ru_maxrss);
+#endif
+    }
+
+#if defined(__linux__)
+    readIoCounters(sample.readBytes, sample.writtenBytes);
+#endif
+#endif
+
+    return sample;
+}
@@ -0,0 +1,99 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROCESSING_PROFILER_H_
+#define PROCESSING_PROFILER_H_
+
+#include "foundation_config.h"
+#include "NonCopyable.h"
+#include <QString>
+#include <QtGlobal>
+
+/**
+ * \brief Records where the processing time and resources go.
+ *
+ * While a session is active, every ProfileScope that ends writes
+ * a Chrome trace event to the session file, which can be opened with
+ * chrome://tracing or Perfetto.  Besides the wall time, each event
+ * carries the CPU time of the thread, the growth of the peak resident
+ * set size and the bytes read and written while the scope was open.
+ * With no active session, a scope costs an atomic load.
+ *
+ * \note The I/O counters are per thread on Linux and per process
+ *       elsewhere, and the peak RSS is always per process, so with
+ *       several pages in flight the latter two include other pages.
+ */
+class FOUNDATION_EXPORT ProcessingProfiler
+{
+public:
+    /**
+     * \brief Starts a session writing to \p file_path.
+     *
+     * An already active session is finished first, unless it writes
+     * to the same file, in which case it's left running.
+     * \return false if the file couldn't be opened.
+     */
+    static bool start(QString const& file_path);
+
+    /**
+     * \brief Finishes the active session, if any.
+     */
+    static void stop();
+
+    static bool isActive();
+};
+
+
+/**
+ * \brief Times the enclosing block for ProcessingProfiler.
+ *
+ * \code
+ * ProfileScope const scope("task", "deskew", page_id.imageId().filePath());
+ * \endcode
+ * \p category and \p name must outlive the scope, which string
+ * literals always do.
+ */
+class FOUNDATION_EXPORT ProfileScope
+{
+    DECLARE_NON_COPYABLE(ProfileScope)
+public:
+    ProfileScope(char const* category, char const* name);
+
+    ProfileScope(char const* category, char const* name, QString const& page);
+
+    ~ProfileScope();
+private:
+    struct Sample
+    {
+        qint64 wallUs;
+        qint64 cpuUs;
+        qint64 peakRssKb;
+        qint64 readBytes;
+        qint64 writtenBytes;
+    };
+
+    static Sample currentSample();
+
+    char const* m_pCategory;
+    char const* m_pName;
+    QString m_page;
+    bool m_active;
+    Sample m_start;
+};
+
+#endif
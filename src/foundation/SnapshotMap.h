@@ -0,0 +1,397 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SNAPSHOT_MAP_H_
+#define SNAPSHOT_MAP_H_
+
+#include "NonCopyable.h"
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
+#include <utility>
+
+/**
+ * \brief A map with lock-free snapshot reads and copy-on-write updates.
+ *
+ * Entries are spread over a fixed number of shards by qHash(key).  Each shard
+ * publishes an immutable std::map of shared, immutable values.  Readers
+ * atomically grab the current map of a shard and never block.  Writers to
+ * the same shard serialize on that shard's mutex, copy its map (only the
+ * value pointers get copied), apply their changes and publish the new map.
+ * Writers to different shards don't contend at all.
+ *
+ * Updates are atomic per shard.  clear(), updateAll() and rekey() lock
+ * all shards and so are atomic with respect to other updates of the map.
+ *
+ * \note Key has to be ordered by operator<() and hashable by qHash().
+ */
+template<typename Key, typename Value>
+class SnapshotMap
+{
+    DECLARE_NON_COPYABLE(SnapshotMap)
+public:
+    typedef std::shared_ptr<Value const> ValuePtr;
+
+    SnapshotMap();
+
+    /**
+     * \brief Returns the current value for \p key or a null pointer.
+     *
+     * This function never blocks.  The returned value is immutable
+     * and stays valid regardless of later updates.
+     */
+    ValuePtr find(Key const& key) const;
+
+    void set(Key const& key, Value const& value);
+
+    void erase(Key const& key);
+
+    void clear();
+
+    /**
+     * \brief Atomically reads, modifies and writes back a single entry.
+     *
+     * \p modifier is called as modifier(value), where value is a
+     * std::unique_ptr<Value>& holding a copy of the current value,
+     * or null if there is no entry for \p key.  The modifier may change,
+     * replace or reset it.  Leaving it null removes the entry.
+     *
+     * \note The modifier is called with the shard locked and therefore
+     *       must not access this map.
+     */
+    template<typename Modifier>
+    void update(Key const& key, Modifier modifier);
+
+    /**
+     * \brief Same as update(), but for a collection of keys.
+     *
+     * \p modifier is called as modifier(key, value) for each key.
+     * Each affected shard is copied and published only once.
+     */
+    template<typename Keys, typename Modifier>
+    void updateBatch(Keys const& keys, Modifier modifier);
+
+    /**
+     * \brief Calls modifier(key, value) for every existing entry.
+     *
+     * Unlike update(), value is never null on entry.
+     */
+    template<typename Modifier>
+    void updateAll(Modifier modifier);
+
+    /**
+     * \brief Same as above, but calls \p prepare() first.
+     *
+     * \p prepare is called with all shards already locked, so no update
+     * of the map can run between it and the modifications.  That makes
+     * it the place to change state the modifier, or updates of single
+     * entries, depend on.  Like the modifier, it must not access this map.
+     */
+    template<typename Modifier, typename Prepare>
+    void updateAll(Modifier modifier, Prepare prepare);
+
+    /**
+     * \brief Replaces every key with mapper(key).
+     *
+     * If several keys map to the same key, the value of the smallest
+     * of them wins, just like when inserting into a std::map in key order.
+     */
+    template<typename Mapper>
+    void rekey(Mapper mapper);
+private:
+    typedef std::map<Key, ValuePtr> Map;
+    typedef std::shared_ptr<Map const> MapPtr;
+
+    enum { NUM_SHARDS = 16 };
+
+    struct Shard
+    {
+        QMutex mutex;
+        MapPtr map;
+    };
+
+    static int shardIndex(Key const& key)
+    {
+        return static_cast<int>(static_cast<unsigned>(qHash(key)) % NUM_SHARDS);
+    }
+
+    static MapPtr load(Shard const& shard)
+    {
+        return std::atomic_load(&shard.map);
+    }
+
+    static void publish(Shard& shard, Map& map)
+    {
+        std::shared_ptr<Map> const new_map(new Map);
+        new_map->swap(map);
+        std::atomic_store(&shard.map, MapPtr(new_map));
+    }
+
+    template<typename Modifier>
+    static void modifyEntry(Map& map, Key const& key, Modifier& modifier);
+
+    Shard m_shards[NUM_SHARDS];
+};
+
+
+template<typename Key, typename Value>
+SnapshotMap<Key, Value>::SnapshotMap()
+{
+    for (Shard& shard : m_shards)
+    {
+        shard.map.reset(new Map);
+    }
+}
+
+template<typename Key, typename Value>
+typename SnapshotMap<Key, Value>::ValuePtr
+SnapshotMap<Key, Value>::find(Key const& key) const
+{
+    MapPtr const map(load(m_shards[shardIndex(key)]));
+    typename Map::const_iterator const it(map->find(key));
+    return it != map->end() ? it->second : ValuePtr();
+}
+
+template<typename Key, typename Value>
+void
+SnapshotMap<Key, Value>::set(Key const& key, Value const& value)
+{
+    ValuePtr const new_value(std::make_shared<Value const>(value));
+    Shard& shard = m_shards[shardIndex(key)];
+
+    QMutexLocker const locker(&shard.mutex);
+    Map map(*shard.map);
+    map[key] = new_value;
+    publish(shard, map);
+}
+
+template<typename Key, typename Value>
+void
+SnapshotMap<Key, Value>::erase(Key const& key)
+{
+    Shard& shard = m_shards[shardIndex(key)];
+
+    QMutexLocker const locker(&shard.mutex);
+    if (shard.map->find(key) == shard.map->end())
+    {
+        return;
+    }
+
+    Map map(*shard.map);
+    map.erase(key);
+    publish(shard, map);
+}
+
+template<typename Key, typename Value>
+void
+SnapshotMap<Key, Value>::clear()
+{
+    for (Shard& shard : m_shards)
+    {
+        shard.mutex.lock();
+    }
+
+    for (Shard& shard : m_shards)
+    {
+        Map empty;
+        publish(shard, empty);
+    }
+
+    for (Shard& shard : m_shards)
+    {
+        shard.mutex.unlock();
+    }
+}
+
+template<typename Key, typename Value>
+template<typename Modifier>
+void
+SnapshotMap<Key, Value>::modifyEntry(Map& map, Key const& key, Modifier& modifier)
+{
+    typename Map::iterator const it(map.lower_bound(key));
+    bool const exists = it != map.end() && !map.key_comp()(key, it->first);
+
+    std::unique_ptr<Value> value;
+    if (exists)
+    {
+        value.reset(new Value(*it->second));
+    }
+
+    modifier(value);
+
+    if (value)
+    {
+        ValuePtr new_value(std::move(value));
+        if (exists)
+        {
+            it->second = new_value;
+        }
+        else
+        {
+            map.insert(it, typename Map::value_type(key, new_value));
+        }
+    }
+    else if (exists)
+    {
+        map.erase(it);
+    }
+}
+
+template<typename Key, typename Value>
+template<typename Modifier>
+void
+SnapshotMap<Key, Value>::update(Key const& key, Modifier modifier)
+{
+    Shard& shard = m_shards[shardIndex(key)];
+
+    QMutexLocker const locker(&shard.mutex);
+    Map map(*shard.map);
+    modifyEntry(map, key, modifier);
+    publish(shard, map);
+}
+
+template<typename Key, typename Value>
+template<typename Keys, typename Modifier>
+void
+SnapshotMap<Key, Value>::updateBatch(Keys const& keys, Modifier modifier)
+{
+    std::vector<Key const*> shard_keys[NUM_SHARDS];
+    for (Key const& key : keys)
+    {
+        shard_keys[shardIndex(key)].push_back(&key);
+    }
+
+    for (int i = 0; i < NUM_SHARDS; ++i)
+    {
+        if (shard_keys[i].empty())
+        {
+            continue;
+        }
+
+        Shard& shard = m_shards[i];
+        QMutexLocker const locker(&shard.mutex);
+        Map map(*shard.map);
+
+        for (Key const* key : shard_keys[i])
+        {
+            auto bound_modifier = [&modifier, key](std::unique_ptr<Value>& value)
+            {
+                modifier(*key, value);
+            };
+            modifyEntry(map, *key, bound_modifier);
+        }
+
+        publish(shard, map);
+    }
+}
+
+template<typename Key, typename Value>
+template<typename Modifier>
+void
+SnapshotMap<Key, Value>::updateAll(Modifier modifier)
+{
+    updateAll(modifier, []() {});
+}
+
+template<typename Key, typename Value>
+template<typename Modifier, typename Prepare>
+void
+SnapshotMap<Key, Value>::updateAll(Modifier modifier, Prepare prepare)
+{
+    for (Shard& shard : m_shards)
+    {
+        shard.mutex.lock();
+    }
+
+    prepare();
+
+    for (Shard& shard : m_shards)
+    {
+        Map map;
+
+        for (typename Map::value_type const& kv : *shard.map)
+        {
+            std::unique_ptr<Value> value(new Value(*kv.second));
+            modifier(kv.first, value);
+            if (value)
+            {
+                map.insert(map.end(), typename Map::value_type(kv.first, ValuePtr(std::move(value))));
+            }
+        }
+
+        publish(shard, map);
+    }
+
+    for (Shard& shard : m_shards)
+    {
+        shard.mutex.unlock();
+    }
+}
+
+template<typename Key, typename Value>
+template<typename Mapper>
+void
+SnapshotMap<Key, Value>::rekey(Mapper mapper)
+{
+    for (Shard& shard : m_shards)
+    {
+        shard.mutex.lock();
+    }
+
+    // Entries are spread over shards by hash, so we put them back
+    // in key order to decide which value wins.
+    std::vector<typename Map::value_type const*> entries;
+    for (Shard const& shard : m_shards)
+    {
+        for (typename Map::value_type const& kv : *shard.map)
+        {
+            entries.push_back(&kv);
+        }
+    }
+    std::sort(
+        entries.begin(), entries.end(),
+        [](typename Map::value_type const* lhs, typename Map::value_type const* rhs)
+    {
+        return lhs->first < rhs->first;
+    }
+    );
+
+    Map new_maps[NUM_SHARDS];
+    for (typename Map::value_type const* kv : entries)
+    {
+        Key const new_key(mapper(kv->first));
+        // insert() leaves an existing entry alone.
+        new_maps[shardIndex(new_key)].insert(typename Map::value_type(new_key, kv->second));
+    }
+
+    for (int i = 0; i < NUM_SHARDS; ++i)
+    {
+        publish(m_shards[i], new_maps[i]);
+    }
+
+    for (Shard& shard : m_shards)
+    {
+        shard.mutex.unlock();
+    }
+}
+
+#endif
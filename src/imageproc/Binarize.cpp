@@ -31,6 +31,7 @@
 #include "BinaryThreshold.h"
 #include "Grayscale.h"
 #include "GrayImage.h"
+#include "LocalStats.h"
 #include "RasterOpGeneric.h"
 #include "GaussBlur.h"
 
@@ -415,12 +416,25 @@ BinaryImage binarizeNiblack(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    LocalStats stats(src);
+    return binarizeNiblack(stats, radius, k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeNiblack(
+    LocalStats& stats,
+    int const radius,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(grayNiblackMap(src, radius, k, delta));
+    GrayImage threshold_map(grayNiblackMap(stats, radius, k, delta));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, 0, bound_lower, bound_upper));
 
     return bw_img;
@@ -570,12 +584,25 @@ BinaryImage binarizeSauvola(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    LocalStats stats(src);
+    return binarizeSauvola(stats, radius, k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeSauvola(
+    LocalStats& stats,
+    int const radius,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(graySauvolaMap(src, radius, k, delta));
+    GrayImage threshold_map(graySauvolaMap(stats, radius, k, delta));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, 0, bound_lower, bound_upper));
 
     return bw_img;
@@ -595,12 +622,25 @@ BinaryImage binarizeWolf(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    LocalStats stats(src);
+    return binarizeWolf(stats, radius, k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeWolf(
+    LocalStats& stats,
+    int const radius,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(grayWolfMap(src, radius, k, delta));
+    GrayImage threshold_map(grayWolfMap(stats, radius, k, delta));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, 0, bound_lower, bound_upper));
 
     return bw_img;
@@ -625,12 +665,25 @@ BinaryImage binarizeWindow(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    LocalStats stats(src);
+    return binarizeWindow(stats, radius, k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeWindow(
+    LocalStats& stats,
+    int const radius,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(grayWindowMap(src, radius, k, delta));
+    GrayImage threshold_map(grayWindowMap(stats, radius, k, delta));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, 0, bound_lower, bound_upper));
 
     return bw_img;
@@ -647,12 +700,25 @@ BinaryImage binarizeBradley(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    LocalStats stats(src);
+    return binarizeBradley(stats, radius, k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeBradley(
+    LocalStats& stats,
+    int const radius,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(grayBradleyMap(src, radius, k));
+    GrayImage threshold_map(grayBradleyMap(stats, radius, k));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, delta, bound_lower, bound_upper));
 
     return bw_img;
@@ -671,12 +737,25 @@ BinaryImage binarizeNick(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    LocalStats stats(src);
+    return binarizeNick(stats, radius, k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeNick(
+    LocalStats& stats,
+    int const radius,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(grayNickMap(src, radius, k, delta));
+    GrayImage threshold_map(grayNickMap(stats, radius, k, delta));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, 0, bound_lower, bound_upper));
 
     return bw_img;
@@ -773,12 +852,25 @@ BinaryImage binarizeSingh(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    LocalStats stats(src);
+    return binarizeSingh(stats, radius, k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeSingh(
+    LocalStats& stats,
+    int const radius,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(graySinghMap(src, radius, k, delta));
+    GrayImage threshold_map(graySinghMap(stats, radius, k, delta));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, 0, bound_lower, bound_upper));
 
     return bw_img;
@@ -796,12 +888,25 @@ BinaryImage binarizeFox(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    LocalStats stats(src);
+    return binarizeFox(stats, radius, k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeFox(
+    LocalStats& stats,
+    int const radius,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(grayFoxMap(src, radius, k, delta));
+    GrayImage threshold_map(grayFoxMap(stats, radius, k, delta));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, 0, bound_lower, bound_upper));
 
     return bw_img;
@@ -821,12 +926,25 @@ BinaryImage binarizeWAN(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    LocalStats stats(src);
+    return binarizeWAN(stats, radius, k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeWAN(
+    LocalStats& stats,
+    int const radius,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(grayWANMap(src, radius, k, delta));
+    GrayImage threshold_map(grayWANMap(stats, radius, k, delta));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, 0, bound_lower, bound_upper));
 
     return bw_img;
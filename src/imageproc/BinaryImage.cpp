@@ -529,9 +529,19 @@ BinaryImage::countBlackPixels(QRect const& rect) const
         {
             int idx = first_word_idx;
             count += countNonZeroBits(line[idx] & first_word_mask);
-            for (++idx; idx != last_word_idx; ++idx)
+            ++idx;
+            // The order of words doesn't matter for counting, so the middle
+            // of the line is consumed two words at a time.
+            for (; idx + 1 < last_word_idx; idx += 2)
+            {
+                uint64_t pair;
+                memcpy(&pair, line + idx, sizeof(pair));
+                count += countNonZeroBits(pair);
+            }
+            if (idx != last_word_idx)
             {
                 count += countNonZeroBits(line[idx]);
+                ++idx;
             }
             count += countNonZeroBits(line[idx] & last_word_mask);
         }
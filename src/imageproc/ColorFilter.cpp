@@ -26,6 +26,8 @@
 #include <stdexcept>
 #include <vector>
 #include <algorithm>
+#include <unordered_map>
+#include <utility>
 #include <QImage>
 #include <QtGlobal>
 #include <QRect>
@@ -35,6 +37,8 @@
 #include "BinaryImage.h"
 #include "Binarize.h"
 #include "ColorFilter.h"
+#include "PixelKernels.h"
+#include "ParallelFor.h"
 
 namespace imageproc
 {
@@ -1245,28 +1249,16 @@ QImage imageYCbCr(QImage const& image)
         return QImage();
     }
 
+    // Scan lines in these formats hold what pixel() would return, alpha aside.
+    QImage const rgb_img(
+        ((image.format() == QImage::Format_RGB32) || (image.format() == QImage::Format_ARGB32))
+        ? image : image.convertToFormat(QImage::Format_ARGB32));
+
     for (unsigned int y = 0; y < h; y++)
     {
-        QRgb *rowh = (QRgb*)ycbcr_img.constScanLine(y);
-        for (unsigned int x = 0; x < w; x++)
-        {
-            QRgb pixel = image.pixel(x, y);
-            int r = qRed(pixel);
-            int g = qGreen(pixel);
-            int b = qBlue(pixel);
-
-            float cy = 0.299f  * r + 0.587f * g + 0.114f * b;
-            float cb = 128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b;
-            float cr = 128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b;
-
-            r = (int) (0.5f + cb);
-            r = (r < 0) ? 0 : (r < 255) ? r : 255;
-            g = (int) (0.5f + cr);
-            g = (g < 0) ? 0 : (g < 255) ? g : 255;
-            b = (int) (0.5f + cy);
-            b = (b < 0) ? 0 : (b < 255) ? b : 255;
-            rowh[x] = qRgb(r, g, b);
-        }
+        QRgb const* rowi = (QRgb const*) rgb_img.constScanLine(y);
+        QRgb* rowh = (QRgb*) ycbcr_img.scanLine(y);
+        kernels::rgbToYCbCrRow(rowi, rowh, w);
     }
 
     return ycbcr_img;
@@ -1526,6 +1518,58 @@ void paletteYCbCrtoRGB(
     }
 }
 
+namespace
+{
+
+/**
+ * \brief A distinct color taking part in hsvKMeansInPlace() clustering.
+ */
+struct KMeansColor
+{
+    float h;
+    float s;
+    float v;
+    bool inMask;
+    uint32_t count;
+    uint64_t firstIndex;
+    int cluster;
+};
+
+int const KMEANS_BAND_HEIGHT = 256;
+
+/**
+ * \brief Finds the nearest foreground cluster for pixels in the mask
+ *        and the nearest background cluster for the rest.
+ */
+int kMeansNearestCluster(
+    float const hsv_h, float const hsv_s, float const hsv_v, bool const in_mask,
+    double const* mean_h, double const* mean_s, double const* mean_v,
+    int const fgcount, int const ncount)
+{
+    int const k_begin = in_mask ? 1 : (fgcount + 1);
+    int const k_end = in_mask ? fgcount : ncount;
+    if (k_begin > k_end)
+    {
+        return in_mask ? 0 : (ncount + 1);
+    }
+
+    float dist_min = -1.0f;
+    int indx_min = 0;
+    for (int k = k_begin; k <= k_end; k++)
+    {
+        float const dist = pixelDistance(hsv_h, hsv_s, hsv_v, mean_h[k], mean_s[k], mean_v[k]);
+        if ((dist_min < 0.0f) || (dist < dist_min))
+        {
+            indx_min = k;
+            dist_min = dist;
+        }
+    }
+
+    return indx_min;
+}
+
+} // anonymous namespace
+
 double hsvKMeansInPlace(
     QImage& dst,
     QImage const& image,
@@ -1568,9 +1612,7 @@ double hsvKMeansInPlace(
         int const sfull = ncount + 2;
         int const stop = (bgcount > 0) ? (sfull - 1) : sfull;
 
-        uint32_t const* mask_line = mask.data();
         int const mask_stride = mask.wordsPerLine();
-        uint32_t const* mask_zones_line = mask_zones.data();
         int const mask_zones_stride = mask_zones.wordsPerLine();
 
         /* RGB to CS */
@@ -1622,19 +1664,92 @@ double hsvKMeansInPlace(
         float dist_c[256] = {0.0f}, dist_c_max = 0.0f;
         bool dist_bg[256] = {false};
         /* reinit clusters*/
-        unsigned int mean_y[256] = {0};
-        unsigned int mean_x[256] = {0};
+        uint64_t reinit_index[256] = {0};
 
         uint32_t const msb = uint32_t(1) << 31;
 
-        GrayImage clusters(image);
-        if (clusters.isNull())
+        /* distinct colors of the zones */
+        // All the pixels of the same color and the same mask value are
+        // clustered together, so we cluster such colors weighted by their
+        // pixel counts.  Colors are ordered by their first occurrence, which
+        // makes ties resolve to the same color a raster scan would pick.
+        int const num_bands = (h + KMEANS_BAND_HEIGHT - 1) / KMEANS_BAND_HEIGHT;
+        std::vector<KMeansColor> colors;
         {
-            return mse;
-        }
+            typedef std::unordered_map<uint32_t, KMeansColor> ColorMap;
+            std::vector<ColorMap> band_colors(num_bands);
+
+            parallelFor(0, num_bands, 1, [&](int const band_begin, int const band_end)
+            {
+                for (int band = band_begin; band < band_end; ++band)
+                {
+                    ColorMap& band_map = band_colors[band];
+                    unsigned int const y_begin = band * KMEANS_BAND_HEIGHT;
+                    unsigned int const y_end = std::min<unsigned int>(h, y_begin + KMEANS_BAND_HEIGHT);
+                    uint32_t const* mask_line = mask.data() + y_begin * mask_stride;
+                    uint32_t const* mask_zones_line = mask_zones.data() + y_begin * mask_zones_stride;
+                    for (unsigned int y = y_begin; y < y_end; y++)
+                    {
+                        QRgb const* rowh = (QRgb const*)hsv_img.constScanLine(y);
+                        for (unsigned int x = 0; x < w; x++)
+                        {
+                            if (mask_zones_line[x >> 5] & (msb >> (x & 31)))
+                            {
+                                bool const in_mask = (mask_line[x >> 5] & (msb >> (x & 31))) != 0;
+                                uint32_t const key = (rowh[x] & 0x00ffffff) | (uint32_t(in_mask) << 24);
+                                ColorMap::iterator const it(band_map.find(key));
+                                if (it != band_map.end())
+                                {
+                                    it->second.count++;
+                                }
+                                else
+                                {
+                                    KMeansColor color;
+                                    color.h = qRed(rowh[x]);
+                                    color.s = qGreen(rowh[x]);
+                                    color.v = qBlue(rowh[x]);
+                                    color.inMask = in_mask;
+                                    color.count = 1;
+                                    color.firstIndex = uint64_t(y) * w + x;
+                                    color.cluster = 0;
+                                    band_map.emplace(key, color);
+                                }
+                            }
+                        }
+                        mask_line += mask_stride;
+                        mask_zones_line += mask_zones_stride;
+                    }
+                }
+            });
 
-        unsigned char* clusters_line = clusters.data();
-        int const clusters_stride = clusters.stride();
+            // Bands are merged in order, so the first occurrence is kept.
+            ColorMap all_colors;
+            for (int band = 0; band < num_bands; band++)
+            {
+                for (ColorMap::value_type const& kv : band_colors[band])
+                {
+                    std::pair<ColorMap::iterator, bool> const res(all_colors.insert(kv));
+                    if (!res.second)
+                    {
+                        res.first->second.count += kv.second.count;
+                    }
+                }
+                ColorMap().swap(band_colors[band]);
+            }
+
+            colors.reserve(all_colors.size());
+            for (ColorMap::value_type const& kv : all_colors)
+            {
+                colors.push_back(kv.second);
+            }
+            std::sort(
+                colors.begin(), colors.end(),
+                [](KMeansColor const& lhs, KMeansColor const& rhs)
+            {
+                return lhs.firstIndex < rhs.firstIndex;
+            }
+            );
+        }
 
         /* init clusters */
         paletteHSVcylinderGenerate(mean_h0, mean_s0, mean_v0, ncount, start_value);
@@ -1642,31 +1757,19 @@ double hsvKMeansInPlace(
         /* find and sort clusters */
         for (int i = 1; i <= ncount; i++)
         {
-            mask_zones_line = mask_zones.data();
             float dist_min = -1.0f;
-            for (unsigned int y = 0; y < h; y++)
+            for (KMeansColor const& color : colors)
             {
-                QRgb *rowh = (QRgb*)hsv_img.constScanLine(y);
-                for (unsigned int x = 0; x < w; x++)
+                float const dist = pixelDistance(color.h, color.s, color.v, mean_h0[i], mean_s0[i], mean_v0[i]);
+                if ((dist_min < 0.0f) || (dist < dist_min))
                 {
-                    if (mask_zones_line[x >> 5] & (msb >> (x & 31)))
-                    {
-                        float const hsv_h = qRed(rowh[x]);
-                        float const hsv_s = qGreen(rowh[x]);
-                        float const hsv_v = qBlue(rowh[x]);
-                        float const dist = pixelDistance(hsv_h, hsv_s, hsv_v, mean_h0[i], mean_s0[i], mean_v0[i]);
-                        if ((dist_min < 0.0f) || (dist < dist_min))
-                        {
-                            mean_h[i] = hsv_h;
-                            mean_s[i] = hsv_s;
-                            mean_v[i] = hsv_v;
-                            dist_c[i] = dist;
-                            dist_min = dist;
-                            dist_bg[i] = (mask_line[x >> 5] & (msb >> (x & 31))) ? false : true;
-                        }
-                    }
+                    mean_h[i] = color.h;
+                    mean_s[i] = color.s;
+                    mean_v[i] = color.v;
+                    dist_c[i] = dist;
+                    dist_min = dist;
+                    dist_bg[i] = !color.inMask;
                 }
-                mask_zones_line += mask_zones_stride;
             }
             dist_c_max = (dist_c_max < dist_c[i]) ? dist_c[i] : dist_c_max;
             mean_h0[i] = mean_h[i];
@@ -1712,96 +1815,56 @@ double hsvKMeansInPlace(
         /* reinit clusters (separate fg and bg) */
         for (int i = 1; i <= ncount; i++)
         {
-            mask_line = mask.data();
-            mask_zones_line = mask_zones.data();
             float dist_min = -1.0f;
-            for (unsigned int y = 0; y < h; y++)
+            for (KMeansColor const& color : colors)
             {
-                QRgb *rowh = (QRgb*)hsv_img.constScanLine(y);
-                for (unsigned int x = 0; x < w; x++)
+                if ((i > fgcount) != color.inMask)
                 {
-                    if (mask_zones_line[x >> 5] & (msb >> (x & 31)))
+                    float const dist = pixelDistance(color.h, color.s, color.v, mean_h0[i], mean_s0[i], mean_v0[i]);
+                    if ((dist_min < 0.0f) || (dist < dist_min))
                     {
-                        if ((i > fgcount) ^ (mask_line[x >> 5] & (msb >> (x & 31))))
-                        {
-                            float const hsv_h = qRed(rowh[x]);
-                            float const hsv_s = qGreen(rowh[x]);
-                            float const hsv_v = qBlue(rowh[x]);
-                            float const dist = pixelDistance(hsv_h, hsv_s, hsv_v, mean_h0[i], mean_s0[i], mean_v0[i]);
-                            if ((dist_min < 0.0f) || (dist < dist_min))
-                            {
-                                mean_h[i] = hsv_h;
-                                mean_s[i] = hsv_s;
-                                mean_v[i] = hsv_v;
-                                mean_y[i] = y;
-                                mean_x[i] = x;
-                                dist_min = dist;
-                            }
-                        }
+                        mean_h[i] = color.h;
+                        mean_s[i] = color.s;
+                        mean_v[i] = color.v;
+                        reinit_index[i] = color.firstIndex;
+                        dist_min = dist;
                     }
                 }
-                mask_line += mask_stride;
-                mask_zones_line += mask_zones_stride;
             }
             mean_h0[i] = mean_h[i];
             mean_s0[i] = mean_s[i];
             mean_v0[i] = mean_v[i];
         }
 
+        // An empty cluster takes over the pixel at reinit_index[], which
+        // may be outside the zones.  Its current cluster loses a pixel.
+        KMeansColor reinit_pixel[256];
+        for (int i = 0; i < sfull; i++)
+        {
+            unsigned int const y = reinit_index[i] / w;
+            unsigned int const x = reinit_index[i] % w;
+            QRgb const pixel = ((QRgb const*)hsv_img.constScanLine(y))[x];
+            reinit_pixel[i].h = qRed(pixel);
+            reinit_pixel[i].s = qGreen(pixel);
+            reinit_pixel[i].v = qBlue(pixel);
+            reinit_pixel[i].inMask = (mask.data()[y * mask_stride + (x >> 5)] & (msb >> (x & 31))) != 0;
+        }
+
         /* init clusters map */
-        mask_line = mask.data();
-        for (unsigned int y = 0; y < h; y++)
+        for (KMeansColor& color : colors)
         {
-            QRgb *rowh = (QRgb*)hsv_img.constScanLine(y);
-            for (unsigned int x = 0; x < w; x++)
-            {
-                float const hsv_h = qRed(rowh[x]);
-                float const hsv_s = qGreen(rowh[x]);
-                float const hsv_v = qBlue(rowh[x]);
-                float dist_min = -1.0f;
-                int indx_min = 0;
-                if (mask_line[x >> 5] & (msb >> (x & 31)))
-                {
-                    if (fgcount > 0)
-                    {
-                        for (int k = 1; k <= fgcount; k++)
-                        {
-                            float const dist = pixelDistance(hsv_h, hsv_s, hsv_v, mean_h[k], mean_s[k], mean_v[k]);
-                            if ((dist_min < 0.0f) || (dist < dist_min))
-                            {
-                                indx_min = k;
-                                dist_min = dist;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        indx_min = 0;
-                    }
-                }
-                else
-                {
-                    if (bgcount > 0)
-                    {
-                        for (int k = (fgcount + 1); k <= ncount; k++)
-                        {
-                            float const dist = pixelDistance(hsv_h, hsv_s, hsv_v, mean_h[k], mean_s[k], mean_v[k]);
-                            if ((dist_min < 0.0f) || (dist < dist_min))
-                            {
-                                indx_min = k;
-                                dist_min = dist;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        indx_min = ncount + 1;
-                    }
-                }
-                clusters_line[x] = indx_min;
-            }
-            mask_line += mask_stride;
-            clusters_line += clusters_stride;
+            color.cluster = kMeansNearestCluster(
+                                color.h, color.s, color.v, color.inMask,
+                                mean_h, mean_s, mean_v, fgcount, ncount
+                            );
+        }
+        for (int i = 0; i < sfull; i++)
+        {
+            KMeansColor& pixel = reinit_pixel[i];
+            pixel.cluster = kMeansNearestCluster(
+                                pixel.h, pixel.s, pixel.v, pixel.inMask,
+                                mean_h, mean_s, mean_v, fgcount, ncount
+                            );
         }
 
         /* iteration clusters map */
@@ -1815,30 +1878,18 @@ double hsvKMeansInPlace(
                 mean_len[i] = 0;
             }
 
-            mask_zones_line = mask_zones.data();
-            clusters_line = clusters.data();
-            for (unsigned int y = 0; y < h; y++)
+            for (KMeansColor const& color : colors)
             {
-                QRgb *rowh = (QRgb*)hsv_img.constScanLine(y);
-                for (unsigned int x = 0; x < w; x++)
-                {
-                    if (mask_zones_line[x >> 5] & (msb >> (x & 31)))
-                    {
-                        int const cluster = clusters_line[x];
-                        float const hsv_h = qRed(rowh[x]);
-                        float const hsv_s = qGreen(rowh[x]);
-                        float const hsv_v = qBlue(rowh[x]);
-                        mean_h[cluster] += hsv_h;
-                        mean_s[cluster] += hsv_s;
-                        mean_v[cluster] += hsv_v;
-                        mean_len[cluster]++;
-                    }
-                }
-                mask_zones_line += mask_zones_stride;
-                clusters_line += clusters_stride;
+                mean_h[color.cluster] += color.h * (double) color.count;
+                mean_s[color.cluster] += color.s * (double) color.count;
+                mean_v[color.cluster] += color.v * (double) color.count;
+                mean_len[color.cluster] += color.count;
             }
-            clusters_line = clusters.data();
-            uint32_t changes = 0;
+
+            // An empty cluster is reset to its default every time, so
+            // unlike the assignment, it can't make the next iteration
+            // differ from this one and doesn't count as a change.
+            bool reinit_moved[256] = {false};
             for (int i = 0; i < sfull; i++)
             {
                 if (mean_len[i] > 0)
@@ -1854,76 +1905,45 @@ double hsvKMeansInPlace(
                     mean_s[i] = mean_s0[i];
                     mean_v[i] = mean_v0[i];
 
-                    unsigned int y0 = mean_y[i];
-                    unsigned int x0 = mean_x[i];
-                    uint32_t indx = y0 * clusters_stride + x0;
-                    int const cluster = clusters_line[indx];
+                    int cluster = reinit_pixel[i].cluster;
+                    for (int j = 0; j < i; j++)
+                    {
+                        if (reinit_moved[j] && (reinit_index[j] == reinit_index[i]))
+                        {
+                            cluster = j;
+                        }
+                    }
                     mean_len[cluster]--;
-                    clusters_line[indx] = i;
                     mean_len[i] = 1;
-                    changes++;
+                    reinit_moved[i] = true;
                 }
             }
 
-            mask_line = mask.data();
-            clusters_line = clusters.data();
-            for (unsigned int y = 0; y < h; y++)
+            uint32_t changes = 0;
+            for (KMeansColor& color : colors)
             {
-                QRgb *rowh = (QRgb*)hsv_img.constScanLine(y);
-                for (unsigned int x = 0; x < w; x++)
+                int const cluster = kMeansNearestCluster(
+                                        color.h, color.s, color.v, color.inMask,
+                                        mean_h, mean_s, mean_v, fgcount, ncount
+                                    );
+                if (cluster != color.cluster)
                 {
-                    float const hsv_h = qRed(rowh[x]);
-                    float const hsv_s = qGreen(rowh[x]);
-                    float const hsv_v = qBlue(rowh[x]);
-                    float dist_min = -1.0f;
-                    int indx_min = 0;
-                    if (mask_line[x >> 5] & (msb >> (x & 31)))
-                    {
-                        if (fgcount > 0)
-                        {
-                            for (int k = 1; k <= fgcount; k++)
-                            {
-                                float const dist = pixelDistance(hsv_h, hsv_s, hsv_v, mean_h[k], mean_s[k], mean_v[k]);
-                                if ((dist_min < 0.0f) || (dist < dist_min))
-                                {
-                                    indx_min = k;
-                                    dist_min = dist;
-                                }
-                            }
-                        }
-                        else
-                        {
-                            indx_min = 0;
-                        }
-                    }
-                    else
-                    {
-                        if (bgcount > 0)
-                        {
-                            for (int k = (fgcount + 1); k <= ncount; k++)
-                            {
-                                float const dist = pixelDistance(hsv_h, hsv_s, hsv_v, mean_h[k], mean_s[k], mean_v[k]);
-                                if ((dist_min < 0.0f) || (dist < dist_min))
-                                {
-                                    indx_min = k;
-                                    dist_min = dist;
-                                }
-                            }
-                        }
-                        else
-                        {
-                            indx_min = ncount + 1;
-                        }
-                    }
-                    if (indx_min != clusters_line[x])
-                    {
-                        clusters_line[x] = indx_min;
-                        changes++;
-                    }
-
+                    color.cluster = cluster;
+                    changes++;
+                }
+            }
+            for (int i = 0; i < sfull; i++)
+            {
+                KMeansColor& pixel = reinit_pixel[i];
+                int const cluster = kMeansNearestCluster(
+                                        pixel.h, pixel.s, pixel.v, pixel.inMask,
+                                        mean_h, mean_s, mean_v, fgcount, ncount
+                                    );
+                if (cluster != pixel.cluster)
+                {
+                    pixel.cluster = cluster;
+                    changes++;
                 }
-                mask_line += mask_stride;
-                clusters_line += clusters_stride;
             }
 
             if (changes == 0)
@@ -1931,6 +1951,16 @@ double hsvKMeansInPlace(
                 break;
             }
         }
+        colors.clear();
+        colors.shrink_to_fit();
+
+        /* clusters the pixels were assigned with */
+        double assign_h[256];
+        double assign_s[256];
+        double assign_v[256];
+        std::copy(mean_h, mean_h + sfull, assign_h);
+        std::copy(mean_s, mean_s + sfull, assign_s);
+        std::copy(mean_v, mean_v + sfull, assign_v);
 
         /* Norm abd Sat */
         if (color_space < 2)
@@ -2049,46 +2079,68 @@ double hsvKMeansInPlace(
         mean_v[ncount + 1] = 255.0;
 
         /* Replace pixels and metrics */
-        uint32_t cntkm = 0;
-        mask_zones_line = mask_zones.data();
-        clusters_line = clusters.data();
-        for (unsigned int y = 0; y < h; y++)
+        std::vector<double> band_mse(num_bands, 0.0);
+        std::vector<uint32_t> band_cntkm(num_bands, 0);
+        parallelFor(0, num_bands, 1, [&](int const band_begin, int const band_end)
         {
-            QRgb *rowh = (QRgb*)hsv_img.constScanLine(y);
-            double msel = 0.0;
-            for (unsigned int x = 0; x < w; x++)
+            for (int band = band_begin; band < band_end; ++band)
             {
-                int r, g, b;
-                if (mask_zones_line[x >> 5] & (msb >> (x & 31)))
+                unsigned int const y_begin = band * KMEANS_BAND_HEIGHT;
+                unsigned int const y_end = std::min<unsigned int>(h, y_begin + KMEANS_BAND_HEIGHT);
+                uint32_t const* mask_line = mask.data() + y_begin * mask_stride;
+                uint32_t const* mask_zones_line = mask_zones.data() + y_begin * mask_zones_stride;
+                for (unsigned int y = y_begin; y < y_end; y++)
                 {
-                    int r0, g0, b0, dr, dg, db;
-                    QRgb const origin = image.pixel(x, y);
-                    r0 = qRed(origin);
-                    g0 = qGreen(origin);
-                    b0 = qBlue(origin);
-                    int const cluster = clusters_line[x];
-                    r = mean_h[cluster];
-                    g = mean_s[cluster];
-                    b = mean_v[cluster];
-                    dr = r0 - r;
-                    dg = g0 - g;
-                    db = b0 - b;
-                    double dt = dr * dr + dg * dg + db * db;
-                    msel += dt;
-                    cntkm++;
-                }
-                else
-                {
-                    QRgb const pixel = dst.pixel(x, y);
-                    r = qRed(pixel);
-                    g = qGreen(pixel);
-                    b = qBlue(pixel);
+                    QRgb *rowh = (QRgb*)hsv_img.constScanLine(y);
+                    double msel = 0.0;
+                    for (unsigned int x = 0; x < w; x++)
+                    {
+                        int r, g, b;
+                        if (mask_zones_line[x >> 5] & (msb >> (x & 31)))
+                        {
+                            int r0, g0, b0, dr, dg, db;
+                            QRgb const origin = image.pixel(x, y);
+                            r0 = qRed(origin);
+                            g0 = qGreen(origin);
+                            b0 = qBlue(origin);
+                            int const cluster = kMeansNearestCluster(
+                                                    qRed(rowh[x]), qGreen(rowh[x]), qBlue(rowh[x]),
+                                                    (mask_line[x >> 5] & (msb >> (x & 31))) != 0,
+                                                    assign_h, assign_s, assign_v, fgcount, ncount
+                                                );
+                            r = mean_h[cluster];
+                            g = mean_s[cluster];
+                            b = mean_v[cluster];
+                            dr = r0 - r;
+                            dg = g0 - g;
+                            db = b0 - b;
+                            double dt = dr * dr + dg * dg + db * db;
+                            msel += dt;
+                            band_cntkm[band]++;
+                        }
+                        else
+                        {
+                            QRgb const pixel = dst.pixel(x, y);
+                            r = qRed(pixel);
+                            g = qGreen(pixel);
+                            b = qBlue(pixel);
+                        }
+                        rowh[x] = qRgb(r, g, b);
+                    }
+                    band_mse[band] += msel;
+                    mask_line += mask_stride;
+                    mask_zones_line += mask_zones_stride;
                 }
-                rowh[x] = qRgb(r, g, b);
             }
-            mse += msel;
-            mask_zones_line += mask_zones_stride;
-            clusters_line += clusters_stride;
+        });
+
+        // The squared differences are integers, so the order
+        // of summation doesn't affect the result.
+        uint32_t cntkm = 0;
+        for (int band = 0; band < num_bands; band++)
+        {
+            mse += band_mse[band];
+            cntkm += band_cntkm[band];
         }
         mse = (cntkm > 0) ? (sqrt(mse / cntkm / 3.0) / 255.0) : 0.0;
 
@@ -28,6 +28,7 @@ namespace imageproc
 {
 
 class GrayImage;
+class BinaryImage;
 
 IMAGEPROC_EXPORT void imageLevelSet(
     QImage& image,  GrayImage const y_new);
@@ -42,6 +42,7 @@
 #include "ValueConv.h"
 #include "GridAccessor.h"
 #include "RasterOpGeneric.h"
+#include "ParallelFor.h"
 #include <QSize>
 #include <boost/scoped_array.hpp>
 #include <algorithm>
@@ -118,6 +119,11 @@ IMAGEPROC_EXPORT GrayImage anisotropicGaussBlur(
  * RoundAndClipValueConv<uint8_t> const float2byte;
  * gaussBlurGeneric(..., [float2byte](uint8_t& dst, float src) { dst = float2byte(src); });
  * \endcode
+ *
+ * \note float_reader and float_writer are called concurrently from several
+ *       threads, each working on its own band of rows or columns.  They are
+ *       never called on the same item at the same time, but any state they
+ *       share between items needs to be thread-safe.
  */
 template<typename SrcIt, typename DstIt, typename FloatReader, typename FloatWriter>
 void gaussBlurGeneric(QSize size, float h_sigma, float v_sigma,
@@ -165,6 +171,9 @@ void gaussBlurGeneric(QSize size, float h_sigma, float v_sigma,
  * RoundAndClipValueConv<uint8_t> const float2byte;
  * anisotropicGaussBlurGeneric(..., [float2byte](uint8_t& dst, float src) { dst = float2byte(src); });
  * \endcode
+ *
+ * \note As with gaussBlurGeneric(), float_reader and float_writer are called
+ *       concurrently from several threads, on different items.
  */
 template<typename SrcIt, typename DstIt, typename FloatReader, typename FloatWriter>
 void anisotropicGaussBlurGeneric(
@@ -209,95 +218,63 @@ void IMAGEPROC_EXPORT calcBackwardPassInitialConditions(
 
 void IMAGEPROC_EXPORT initPaddingLayers(Grid<float>& intermediate_image);
 
-} // namespace gauss_blur_impl
+/**
+ * The number of rows per parallelFor() chunk in horizontalPass().
+ */
+int const ROW_BAND = 32;
 
+/**
+ * The number of columns verticalPass() filters side by side.
+ */
+int const COLUMN_BAND = 32;
+
+/**
+ * \brief Applies a 1D recursive gaussian filter to each row of a grid.
+ *
+ * Rows are independent, so bands of rows are processed in parallel.
+ *
+ * \param exact_backward_init Whether to initialize the backward pass with
+ *        calcBackwardPassInitialConditions() or with a cheaper approximation.
+ */
 template<typename SrcIt, typename DstIt, typename FloatReader, typename FloatWriter>
-void gaussBlurGeneric(QSize const size, float const h_sigma, float const v_sigma,
-                      SrcIt const input, int const input_stride, FloatReader const float_reader,
-                      DstIt const output, int const output_stride, FloatWriter const float_writer)
+void horizontalPass(QSize const size, FilterParams const& p, bool const exact_backward_init,
+                    SrcIt const input, int const input_stride, FloatReader const float_reader,
+                    DstIt const output, int const output_stride, FloatWriter const float_writer)
 {
-    using namespace gauss_blur_impl;
-
-    if (size.isEmpty())
-    {
-        return;
-    }
-
-    if (h_sigma < 0.0f || v_sigma < 0.0f)
-    {
-        throw std::invalid_argument("gaussBlur: stddev can't be negative");
-    }
-    else if (h_sigma < 1e-2f && v_sigma < 1e-2f)
-    {
-        return;
-    }
-
     int const width = size.width();
     int const height = size.height();
-    int const width_height_max = width > height ? width : height;
-
-    boost::scoped_array<float> const w(new float[3 + width_height_max + 3]);
-    Grid<float> intermediate_image(width, height, /*padding=*/0);
-    int const intermediate_stride = intermediate_image.stride();
+    float const B2 = p.B * p.B;
 
+    parallelFor(0, height, ROW_BAND, [&](int const y_begin, int const y_end)
     {
-        // Vertical pass.
-        gauss_blur_impl::FilterParams const p(v_sigma);
-        float const B2 = p.B * p.B;
+        boost::scoped_array<float> const w(new float[3 + width + 3]);
+        SrcIt input_line = input + y_begin * input_stride;
+        DstIt output_line = output + y_begin * output_stride;
 
-        for (int x = 0; x < width; ++x)
+        for (int y = y_begin; y < y_end; ++y)
         {
             // Forward pass.
-            SrcIt inp_it = input + x;
+            SrcIt inp_it = input_line;
             float pixel = float_reader(*inp_it);
             float* p_w = &w[3];
             p_w[-1] = p_w[-2] = p_w[-3] = pixel * p.A;
-
-            for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
             {
                 pixel = float_reader(*inp_it);
                 *p_w = pixel + p.a1 * p_w[-1] + p.a2 * p_w[-2] + p.a3 * p_w[-3];
-                inp_it += input_stride;
                 ++p_w;
+                ++inp_it;
             }
 
             // Backward pass.
-            //calcBackwardPassInitialConditions(p, p_w, pixel);
-            p_w[0] = p_w[1] = p_w[2] = p_w[-1] * p.A;
-            float* p_int = intermediate_image.data() + x + height * intermediate_stride;
-            for (int y = height - 1; y >= 0; --y)
+            if (exact_backward_init)
             {
-                --p_w;
-                p_int -= intermediate_stride;
-                *p_w = *p_w + p.a1 * p_w[1] + p.a2 * p_w[2] + p.a3 * p_w[3];
-                *p_int = *p_w * B2; // Re-scale by B^2.
+                calcBackwardPassInitialConditions(p, p_w, pixel);
             }
-        }
-    }
-
-    {
-        // Horizontal pass.
-        gauss_blur_impl::FilterParams const p(h_sigma);
-        float const B2 = p.B * p.B;
-        float* intermediate_line = intermediate_image.data();
-        DstIt output_line(output);
-
-        for (int y = 0; y < height; ++y)
-        {
-            // Forward pass.
-            float* p_int = intermediate_line;
-            float* p_w = &w[3];
-            p_w[-1] = p_w[-2] = p_w[-3] = intermediate_line[0] * p.A;
-            for (int x = 0; x < width; ++x)
+            else
             {
-                *p_w = *p_int + p.a1 * p_w[-1] + p.a2 * p_w[-2] + p.a3 * p_w[-3];
-                ++p_int;
-                ++p_w;
+                p_w[0] = p_w[1] = p_w[2] = p_w[-1] * p.A;
             }
-
-            // Backward pass.
-            //calcBackwardPassInitialConditions(p, p_w, p_int[-1]);
-            p_w[0] = p_w[1] = p_w[2] = p_w[-1] * p.A;
             DstIt out_it = output_line + (width - 1);
             for (int x = width - 1; x >= 0; --x)
             {
@@ -307,10 +284,132 @@ void gaussBlurGeneric(QSize const size, float const h_sigma, float const v_sigma
                 --out_it;
             }
 
-            intermediate_line += intermediate_stride;
+            input_line += input_stride;
             output_line += output_stride;
         }
+    });
+}
+
+/**
+ * \brief Applies a 1D recursive gaussian filter to each column of a grid.
+ *
+ * Bands of COLUMN_BAND columns are processed in parallel.  Within a band,
+ * the columns are filtered side by side, with their intermediate signals
+ * interleaved, which makes the inner loops vectorizable and keeps memory
+ * accesses sequential.
+ *
+ * \param exact_backward_init Whether to initialize the backward pass with
+ *        calcBackwardPassInitialConditions() or with a cheaper approximation.
+ */
+template<typename SrcIt, typename FloatReader>
+void verticalPass(QSize const size, FilterParams const& p, bool const exact_backward_init,
+                  SrcIt const input, int const input_stride, FloatReader const float_reader,
+                  float* const output, int const output_stride)
+{
+    int const width = size.width();
+    int const height = size.height();
+    float const B2 = p.B * p.B;
+
+    parallelFor(0, width, COLUMN_BAND, [&](int const x_begin, int const x_end)
+    {
+        // w[(3 + y) * bw + i] corresponds to column x_begin + i.
+        int const bw = x_end - x_begin;
+        boost::scoped_array<float> const w(new float[(3 + height + 3) * bw]);
+        float* w_line = &w[3 * bw];
+
+        // Forward pass.
+        SrcIt inp_line = input + x_begin;
+        for (int i = 0; i < bw; ++i)
+        {
+            w_line[i - bw] = w_line[i - 2 * bw] = w_line[i - 3 * bw]
+                = float_reader(*(inp_line + i)) * p.A;
+        }
+        for (int y = 0; y < height; ++y)
+        {
+            for (int i = 0; i < bw; ++i)
+            {
+                w_line[i] = float_reader(*(inp_line + i)) + p.a1 * w_line[i - bw]
+                            + p.a2 * w_line[i - 2 * bw] + p.a3 * w_line[i - 3 * bw];
+            }
+            inp_line += input_stride;
+            w_line += bw;
+        }
+
+        // Backward pass.
+        if (exact_backward_init)
+        {
+            SrcIt const last_inp_line = input + x_begin + (height - 1) * input_stride;
+            for (int i = 0; i < bw; ++i)
+            {
+                float w_tail[6] = { w_line[i - 3 * bw], w_line[i - 2 * bw], w_line[i - bw] };
+                calcBackwardPassInitialConditions(
+                    p, &w_tail[3], float_reader(*(last_inp_line + i))
+                );
+                w_line[i] = w_tail[3];
+                w_line[i + bw] = w_tail[4];
+                w_line[i + 2 * bw] = w_tail[5];
+            }
+        }
+        else
+        {
+            for (int i = 0; i < bw; ++i)
+            {
+                w_line[i] = w_line[i + bw] = w_line[i + 2 * bw] = w_line[i - bw] * p.A;
+            }
+        }
+        float* out_line = output + x_begin + height * output_stride;
+        for (int y = height - 1; y >= 0; --y)
+        {
+            w_line -= bw;
+            out_line -= output_stride;
+            for (int i = 0; i < bw; ++i)
+            {
+                w_line[i] = w_line[i] + p.a1 * w_line[i + bw]
+                            + p.a2 * w_line[i + 2 * bw] + p.a3 * w_line[i + 3 * bw];
+                out_line[i] = w_line[i] * B2; // Re-scale by B^2.
+            }
+        }
+    });
+}
+
+} // namespace gauss_blur_impl
+
+template<typename SrcIt, typename DstIt, typename FloatReader, typename FloatWriter>
+void gaussBlurGeneric(QSize const size, float const h_sigma, float const v_sigma,
+                      SrcIt const input, int const input_stride, FloatReader const float_reader,
+                      DstIt const output, int const output_stride, FloatWriter const float_writer)
+{
+    using namespace gauss_blur_impl;
+
+    if (size.isEmpty())
+    {
+        return;
     }
+
+    if (h_sigma < 0.0f || v_sigma < 0.0f)
+    {
+        throw std::invalid_argument("gaussBlur: stddev can't be negative");
+    }
+    else if (h_sigma < 1e-2f && v_sigma < 1e-2f)
+    {
+        return;
+    }
+
+    Grid<float> intermediate_image(size.width(), size.height(), /*padding=*/0);
+
+    // Vertical pass.
+    verticalPass(
+        size, FilterParams(v_sigma), /*exact_backward_init=*/false,
+        input, input_stride, float_reader,
+        intermediate_image.data(), intermediate_image.stride()
+    );
+
+    // Horizontal pass.
+    horizontalPass(
+        size, FilterParams(h_sigma), /*exact_backward_init=*/false,
+        intermediate_image.data(), intermediate_image.stride(), StaticCastValueConv<float>(),
+        output, output_stride, float_writer
+    );
 }
 
 template<typename SrcIt, typename DstIt, typename FloatReader, typename FloatWriter>
@@ -393,72 +492,23 @@ void anisotropicGaussBlurGeneric(
     if (horizontal_decomposition)
     {
         // Horizontal pass.
-        gauss_blur_impl::FilterParams const p(hdp.sigma_x);
-        float const B2 = p.B * p.B;
-        SrcIt input_line = input;
-        float* intermediate_line = intermediate_image.data();
-
-        for (int y = 0; y < height; ++y)
+        horizontalPass(
+            size, FilterParams(hdp.sigma_x), /*exact_backward_init=*/true,
+            input, input_stride, float_reader,
+            intermediate_image.data(), intermediate_stride, [](float& dst, float src)
         {
-            // Forward pass.
-            SrcIt inp_it = input_line;
-            float pixel = *inp_it;
-            float* p_w = &w[3];
-            p_w[-1] = p_w[-2] = p_w[-3] = pixel * p.A;
-            for (int x = 0; x < width; ++x)
-            {
-                pixel = float_reader(*inp_it);
-                *p_w = pixel + p.a1 * p_w[-1] + p.a2 * p_w[-2] + p.a3 * p_w[-3];
-                ++p_w;
-                ++inp_it;
-            }
-
-            // Backward pass.
-            calcBackwardPassInitialConditions(p, p_w, pixel);
-            for (int x = width - 1; x >= 0; --x)
-            {
-                --p_w;
-                *p_w = *p_w + p.a1 * p_w[1] + p.a2 * p_w[2] + p.a3 * p_w[3];
-                intermediate_line[x] = *p_w * B2; // Re-scale by B^2.
-            }
-
-            input_line += input_stride;
-            intermediate_line += intermediate_stride;
+            dst = src;
         }
+        );
     }
     else
     {
         // Vertical pass.
-        gauss_blur_impl::FilterParams const p(vdp.sigma_y);
-        float const B2 = p.B * p.B;
-
-        for (int x = 0; x < width; ++x)
-        {
-            // Forward pass.
-            SrcIt inp_it = input + x;
-            float pixel = float_reader(*inp_it);
-            float* p_w = &w[3];
-            p_w[-1] = p_w[-2] = p_w[-3] = pixel * p.A;
-
-            for (int y = 0; y < height; ++y)
-            {
-                pixel = float_reader(*inp_it);
-                *p_w = pixel + p.a1 * p_w[-1] + p.a2 * p_w[-2] + p.a3 * p_w[-3];
-                inp_it += input_stride;
-                ++p_w;
-            }
-
-            // Backward pass.
-            calcBackwardPassInitialConditions(p, p_w, pixel);
-            float* p_int = intermediate_image.data() + x + height * intermediate_stride;
-            for (int y = height - 1; y >= 0; --y)
-            {
-                --p_w;
-                p_int -= intermediate_stride;
-                *p_w = *p_w + p.a1 * p_w[1] + p.a2 * p_w[2] + p.a3 * p_w[3];
-                *p_int = *p_w * B2; // Re-scale by B^2.
-            }
-        }
+        verticalPass(
+            size, FilterParams(vdp.sigma_y), /*exact_backward_init=*/true,
+            input, input_stride, float_reader,
+            intermediate_image.data(), intermediate_stride
+        );
     }
 
     // Initialise padded areas of intermediate_image. The outer area is filled with zeros
@@ -781,14 +831,19 @@ void anisotropicGaussBlurGeneric(
 
     // Copy from intermediate image to output image.
     using OutPixel = typename std::iterator_traits<DstIt>::value_type;
-    rasterOpGeneric(
-        [float_writer](OutPixel& out, float value)
+    parallelFor(0, height, ROW_BAND, [&](int const y_begin, int const y_end)
     {
-        float_writer(out, value);
-    },
-    GridAccessor<OutPixel> {output, output_stride, width, height},
-    GridAccessor<float> {output_origin, intermediate_stride, width, height}
-    );
+        int const band_height = y_end - y_begin;
+        rasterOpGeneric(
+            [float_writer](OutPixel& out, float value)
+        {
+            float_writer(out, value);
+        },
+        GridAccessor<OutPixel> {output + y_begin * output_stride, output_stride, width, band_height},
+        GridAccessor<float> {output_origin + y_begin * intermediate_stride,
+                             intermediate_stride, width, band_height}
+        );
+    });
 }
 
 } // namespace imageproc
@@ -0,0 +1,145 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GrayFilterChain.h"
+#include "GrayImage.h"
+#include "ParallelFor.h"
+#include <QSize>
+#include <algorithm>
+#include <string.h>
+
+namespace imageproc
+{
+
+namespace
+{
+
+// Bands of about this many bytes (not counting the halo) fit in L2 cache.
+int const BAND_BYTES = 256 * 1024;
+
+// Very narrow bands would spend most of the time on halos.
+int const MIN_BAND_HEIGHT = 16;
+
+} // anonymous namespace
+
+void
+GrayFilterChain::appendLocal(int const halo, Filter const& filter)
+{
+    m_stages.push_back(Stage{filter, std::max(0, halo), true});
+}
+
+void
+GrayFilterChain::appendGlobal(Filter const& filter)
+{
+    m_stages.push_back(Stage{filter, 0, false});
+}
+
+void
+GrayFilterChain::process(GrayImage& image) const
+{
+    if (image.isNull())
+    {
+        return;
+    }
+
+    size_t i = 0;
+    while (i < m_stages.size())
+    {
+        if (!m_stages[i].local)
+        {
+            m_stages[i].filter(image);
+            ++i;
+            continue;
+        }
+
+        size_t const begin = i;
+        while (i < m_stages.size() && m_stages[i].local)
+        {
+            ++i;
+        }
+        processBanded(image, begin, i);
+    }
+}
+
+void
+GrayFilterChain::processBanded(GrayImage& image, size_t const begin, size_t const end) const
+{
+    int const w = image.width();
+    int const h = image.height();
+    int const stride = image.stride();
+
+    int halo = 0;
+    for (size_t i = begin; i < end; ++i)
+    {
+        halo += m_stages[i].halo;
+    }
+
+    // With a large halo, bands have to grow for the overlap to stay reasonable.
+    int const band_height = std::max(std::max(MIN_BAND_HEIGHT, BAND_BYTES / stride), 2 * halo);
+    if (h <= band_height)
+    {
+        // Banding wouldn't pay off.
+        for (size_t i = begin; i < end; ++i)
+        {
+            m_stages[i].filter(image);
+        }
+        return;
+    }
+
+    // Bands read their halos from the source, so they can't write there.
+    GrayImage dst(image.size());
+    unsigned char const* const src_data = image.data();
+    unsigned char* const dst_data = dst.data();
+    int const dst_stride = dst.stride();
+    int const num_bands = (h + band_height - 1) / band_height;
+
+    parallelFor(0, num_bands, 1, [&](int const band_begin, int const band_end)
+    {
+        for (int band = band_begin; band < band_end; ++band)
+        {
+            int const y0 = band * band_height;
+            int const y1 = std::min(h, y0 + band_height);
+            int const top = std::max(0, y0 - halo);
+            int const bottom = std::min(h, y1 + halo);
+
+            GrayImage tile(QSize(w, bottom - top));
+            unsigned char* const tile_data = tile.data();
+            int const tile_stride = tile.stride();
+            for (int y = top; y < bottom; ++y)
+            {
+                memcpy(tile_data + (y - top) * tile_stride, src_data + y * stride, w);
+            }
+
+            for (size_t i = begin; i < end; ++i)
+            {
+                m_stages[i].filter(tile);
+            }
+
+            // A filter may have replaced the tile's buffer.
+            unsigned char const* const result_data = tile.data();
+            for (int y = y0; y < y1; ++y)
+            {
+                memcpy(dst_data + y * dst_stride, result_data + (y - top) * tile.stride(), w);
+            }
+        }
+    });
+
+    image = dst;
+}
+
+} // namespace imageproc
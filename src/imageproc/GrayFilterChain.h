@@ -0,0 +1,80 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_GRAYFILTERCHAIN_H_
+#define IMAGEPROC_GRAYFILTERCHAIN_H_
+
+#include "imageproc_config.h"
+#include <functional>
+#include <vector>
+
+namespace imageproc
+{
+
+class GrayImage;
+
+/**
+ * \brief Applies a sequence of in-place GrayImage filters.
+ *
+ * Consecutive local filters are fused: the image is cut into horizontal
+ * bands small enough to stay in cache, and each band, extended by the
+ * accumulated halo of the fused filters, goes through all of them before
+ * the next band is touched.  Bands are processed in parallel.  Global
+ * filters, those that need the whole image (global statistics, recursive
+ * blurring), act as barriers between fused runs.
+ *
+ * The result is identical to applying the filters one after another
+ * to the whole image, provided the declared halos are correct.
+ */
+class IMAGEPROC_EXPORT GrayFilterChain
+{
+public:
+    typedef std::function<void(GrayImage&)> Filter;
+
+    /**
+     * \brief Appends a filter whose output pixel depends only on input pixels
+     *        that are at most \p halo rows above or below it.
+     *
+     * Point operations have a zero halo.  The filter must treat the top
+     * and bottom edges of the image it is given no differently from how
+     * it treats those of a full image.
+     */
+    void appendLocal(int halo, Filter const& filter);
+
+    /**
+     * \brief Appends a filter that needs to see the whole image.
+     */
+    void appendGlobal(Filter const& filter);
+
+    void process(GrayImage& image) const;
+private:
+    struct Stage
+    {
+        Filter filter;
+        int halo;
+        bool local;
+    };
+
+    void processBanded(GrayImage& image, size_t begin, size_t end) const;
+
+    std::vector<Stage> m_stages;
+};
+
+} // namespace imageproc
+
+#endif
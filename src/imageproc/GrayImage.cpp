@@ -19,6 +19,8 @@
 #include <new>
 #include <stdexcept>
 #include "GrayImage.h"
+#include "LocalStats.h"
+#include "PixelKernels.h"
 #include "Grayscale.h"
 
 namespace imageproc
@@ -63,65 +65,7 @@ GrayImage grayMapMean(
     GrayImage const& src,
     int const radius)
 {
-    if (src.isNull())
-    {
-        return GrayImage();
-    }
-    GrayImage gray = GrayImage(src);
-    if (gray.isNull())
-    {
-        return GrayImage();
-    }
-
-    if (radius > 0)
-    {
-        int const w = src.width();
-        int const h = src.height();
-        unsigned char const* src_line = src.data();
-        int const src_stride = src.stride();
-        unsigned char* gray_line = gray.data();
-        int const gray_stride = gray.stride();
-
-        IntegralImage<uint32_t> integral_image(w, h);
-
-        for (int y = 0; y < h; y++)
-        {
-            integral_image.beginRow();
-            for (int x = 0; x < w; x++)
-            {
-                uint32_t const pixel = src_line[x];
-                integral_image.push(pixel);
-            }
-            src_line += src_stride;
-        }
-
-        for (int y = 0; y < h; y++)
-        {
-            int const top = ((y - radius) < 0) ? 0 : (y - radius);
-            int const bottom = ((y + radius + 1) < h) ? (y + radius + 1) : h;
-
-            for (int x = 0; x < w; x++)
-            {
-                int const left = ((x - radius) < 0) ? 0 : (x - radius);
-                int const right = ((x + radius) < w) ? (x + radius) : w;
-                int const area = (bottom - top) * (right - left);
-                assert(area > 0);  // because windowSize > 0 and w > 0 and h > 0
-
-                QRect const rect(left, top, right - left, bottom - top);
-                double const window_sum = integral_image.sum(rect);
-
-                double const r_area = 1.0 / area;
-                double mean = window_sum * r_area;
-
-                mean += 0.5;
-                mean = (mean < 0.0) ? 0.0 : ((mean < 255.0) ? mean : 255.0);
-                gray_line[x] = (unsigned char) mean;
-            }
-            gray_line += gray_stride;
-        }
-    }
-
-    return gray;
+    return LocalStats(src).mean(radius);
 }  // grayMapMean
 
 /*
@@ -131,156 +75,14 @@ GrayImage grayMapDeviation(
     GrayImage const& src,
     int const radius)
 {
-    if (src.isNull())
-    {
-        return GrayImage();
-    }
-    GrayImage gray = GrayImage(src);
-    if (gray.isNull())
-    {
-        return GrayImage();
-    }
-
-    if (radius > 0)
-    {
-        int const w = src.width();
-        int const h = src.height();
-        unsigned char const* src_line = src.data();
-        int const src_stride = src.stride();
-        unsigned char* gray_line = gray.data();
-        int const gray_stride = gray.stride();
-
-        IntegralImage<uint32_t> integral_image(w, h);
-        IntegralImage<uint64_t> integral_sqimage(w, h);
-
-        uint32_t gray_min = 255;
-
-        for (int y = 0; y < h; y++)
-        {
-            integral_image.beginRow();
-            integral_sqimage.beginRow();
-            for (int x = 0; x < w; x++)
-            {
-                uint32_t const pixel = src_line[x];
-                integral_image.push(pixel);
-                integral_sqimage.push(pixel * pixel);
-                gray_min = std::min(gray_min, pixel);
-            }
-            src_line += src_stride;
-        }
-
-        for (int y = 0; y < h; y++)
-        {
-            int const top = ((y - radius) < 0) ? 0 : (y - radius);
-            int const bottom = ((y + radius + 1) < h) ? (y + radius + 1) : h;
-
-            for (int x = 0; x < w; x++)
-            {
-                int const left = ((x - radius) < 0) ? 0 : (x - radius);
-                int const right = ((x + radius + 1) < w) ? (x + radius + 1) : w;
-                int const area = (bottom - top) * (right - left);
-                assert(area > 0); // because window_size > 0 and w > 0 and h > 0
-
-                QRect const rect(left, top, right - left, bottom - top);
-                double const window_sum = integral_image.sum(rect);
-                double const window_sqsum = integral_sqimage.sum(rect);
-
-                double const r_area = 1.0 / area;
-                double const mean = window_sum * r_area;
-                double const sqmean = window_sqsum * r_area;
-
-                double const variance = sqmean - mean * mean;
-                double deviation = sqrt(fabs(variance));
-
-                deviation += 0.5;
-                deviation = (deviation < 0.0) ? 0.0 : ((deviation < 255.0) ? deviation : 255.0);
-                gray_line[x] = (unsigned char) deviation;
-            }
-            gray_line += gray_stride;
-        }
-    }
-
-    return gray;
+    return LocalStats(src).deviation(radius);
 } // grayMapDeviation
 
 GrayImage grayMapMax(
     GrayImage const& src,
     int const radius)
 {
-    if (src.isNull())
-    {
-        return GrayImage();
-    }
-    GrayImage gray = GrayImage(src);
-    if (gray.isNull())
-    {
-        return GrayImage();
-    }
-
-    if (radius > 0)
-    {
-        GrayImage gmax = GrayImage(src);
-        if (gmax.isNull())
-        {
-            return gray;
-        }
-        int const w = src.width();
-        int const h = src.height();
-        unsigned char* gray_line = gray.data();
-        int const gray_stride = gray.stride();
-        unsigned char* gmax_line = gmax.data();
-
-        for (int y = 0; y < h; y++)
-        {
-            for (int x = 0; x < w; x++)
-            {
-                int const left = ((x - radius) < 0) ? 0 : (x - radius);
-                int const right = ((x + radius + 1) < w) ? (x + radius + 1) : w;
-
-                unsigned char const origin = gray_line[x];
-                unsigned char immax = origin;
-                for (int xf = left; xf < right; xf++)
-                {
-                    unsigned char imf = gray_line[xf];
-                    if (imf > immax)
-                    {
-                        immax = imf;
-                    }
-                }
-                gmax_line[x] = immax;
-            }
-            gray_line += gray_stride;
-            gmax_line += gray_stride;
-        }
-
-        gmax_line = gmax.data();
-        gray_line = gray.data();
-        for (int y = 0; y < h; y++)
-        {
-            int const top = ((y - radius) < 0) ? 0 : (y - radius);
-            int const bottom = ((y + radius + 1) < h) ? (y + radius + 1) : h;
-
-            for (int x = 0; x < w; x++)
-            {
-                unsigned char const origin = gray_line[x];
-                unsigned char immax = origin;
-                unsigned long int idx = top * gray_stride + x;
-                for (int yf = top; yf < bottom; yf++)
-                {
-                    unsigned char immaxf = gmax_line[idx];
-                    if (immaxf > immax)
-                    {
-                        immax = immaxf;
-                    }
-                    idx += gray_stride;
-                }
-                gray_line[x] = immax;
-            }
-            gray_line += gray_stride;
-        }
-    }
-
-    return gray;
+    return LocalStats(src).max(radius);
 }  // grayMapMax
 
 GrayImage grayMapContrast(
@@ -603,11 +405,22 @@ GrayImage grayNiblackMap(
     float const k,
     int const delta)
 {
+    LocalStats stats(src);
+    return grayNiblackMap(stats, radius, k, delta);
+}
+
+GrayImage grayNiblackMap(
+    LocalStats& stats,
+    int const radius,
+    float const k,
+    int const delta)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean(radius);
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -615,7 +428,7 @@ GrayImage grayNiblackMap(
 
     if (radius > 0)
     {
-        GrayImage gdeviation = grayMapDeviation(src, radius);
+        GrayImage gdeviation = stats.deviation(radius);
         if (gdeviation.isNull())
         {
             return gmean;
@@ -754,11 +567,22 @@ GrayImage graySauvolaMap(
     float const k,
     int const delta)
 {
+    LocalStats stats(src);
+    return graySauvolaMap(stats, radius, k, delta);
+}
+
+GrayImage graySauvolaMap(
+    LocalStats& stats,
+    int const radius,
+    float const k,
+    int const delta)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean(radius);
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -766,7 +590,7 @@ GrayImage graySauvolaMap(
 
     if (radius > 0)
     {
-        GrayImage gdeviation = grayMapDeviation(src, radius);
+        GrayImage gdeviation = stats.deviation(radius);
         if (gdeviation.isNull())
         {
             return gmean;
@@ -781,18 +605,7 @@ GrayImage graySauvolaMap(
 
         for (int y = 0; y < h; y++)
         {
-            for (int x = 0; x < w; x++)
-            {
-                float const mean = gmean_line[x];
-                float const deviation = gdeviation_line[x];
-
-                float const shift = deviation + delta;
-                float const part = k * (1.0f - shift / 128.0f);
-                float threshold = mean * (1.0f - part);
-
-                threshold = (threshold < 0.0f) ? 0.0f : ((threshold < 255.0f) ? threshold : 255.0f);
-                gmean_line[x] = (unsigned char) threshold;
-            }
+            kernels::sauvolaThresholdRow(gmean_line, gdeviation_line, gmean_line, w, k, delta);
             gmean_line += gmean_stride;
             gdeviation_line += gdeviation_stride;
         }
@@ -813,11 +626,22 @@ GrayImage grayWolfMap(
     float const k,
     int const delta)
 {
+    LocalStats stats(src);
+    return grayWolfMap(stats, radius, k, delta);
+}
+
+GrayImage grayWolfMap(
+    LocalStats& stats,
+    int const radius,
+    float const k,
+    int const delta)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean(radius);
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -825,7 +649,7 @@ GrayImage grayWolfMap(
 
     if (radius > 0)
     {
-        GrayImage gdeviation = grayMapDeviation(src, radius);
+        GrayImage gdeviation = stats.deviation(radius);
         if (gdeviation.isNull())
         {
             return gmean;
@@ -861,20 +685,8 @@ GrayImage grayWolfMap(
         gdeviation_line = gdeviation.data();
         for (int y = 0; y < h; y++)
         {
-            for (int x = 0; x < w; x++)
-            {
-                float const mean = gmean_line[x];
-                float const deviation = gdeviation_line[x];
-
-                float const base = mean - gray_min;
-                float const frac = (deviation_max > 0.0f) ? (deviation / deviation_max) : 1.0f;
-                float const frac_delta = (float) delta / 128.0f;
-                float const part = 1.0f - (frac + frac_delta);
-                float threshold = base * (1.0f - k * part) + gray_min;
-
-                threshold = (threshold < 0.0f) ? 0.0f : ((threshold < 255.0f) ? threshold : 255.0f);
-                gmean_line[x] = (unsigned char) threshold;
-            }
+            kernels::wolfThresholdRow(
+                gmean_line, gdeviation_line, gmean_line, w, k, delta, gray_min, deviation_max);
             gmean_line += gmean_stride;
             gdeviation_line += gdeviation_stride;
         }
@@ -900,11 +712,22 @@ GrayImage grayWindowMap(
     float const k,
     int const delta)
 {
+    LocalStats stats(src);
+    return grayWindowMap(stats, radius, k, delta);
+}
+
+GrayImage grayWindowMap(
+    LocalStats& stats,
+    int const radius,
+    float const k,
+    int const delta)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean(radius);
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -912,7 +735,7 @@ GrayImage grayWindowMap(
 
     if (radius > 0)
     {
-        GrayImage gdeviation = grayMapDeviation(src, radius);
+        GrayImage gdeviation = stats.deviation(radius);
         if (gdeviation.isNull())
         {
             return gmean;
@@ -982,11 +805,21 @@ GrayImage grayBradleyMap(
     int const radius,
     float const k)
 {
+    LocalStats stats(src);
+    return grayBradleyMap(stats, radius, k);
+}
+
+GrayImage grayBradleyMap(
+    LocalStats& stats,
+    int const radius,
+    float const k)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean(radius);
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -1028,11 +861,22 @@ GrayImage grayNickMap(
     float const k,
     int const delta)
 {
+    LocalStats stats(src);
+    return grayNickMap(stats, radius, k, delta);
+}
+
+GrayImage grayNickMap(
+    LocalStats& stats,
+    int const radius,
+    float const k,
+    int const delta)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean(radius);
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -1041,7 +885,7 @@ GrayImage grayNickMap(
     if (radius > 0)
     {
         float cnick = (50.0f - delta) * 0.01f;
-        GrayImage gdeviation = grayMapDeviation(src, radius);
+        GrayImage gdeviation = stats.deviation(radius);
         if (gdeviation.isNull())
         {
             return gmean;
@@ -1150,11 +994,22 @@ GrayImage graySinghMap(
     float const k,
     int const delta)
 {
+    LocalStats stats(src);
+    return graySinghMap(stats, radius, k, delta);
+}
+
+GrayImage graySinghMap(
+    LocalStats& stats,
+    int const radius,
+    float const k,
+    int const delta)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean(radius);
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -1203,11 +1058,22 @@ GrayImage grayFoxMap(
     float const k,
     int const delta)
 {
+    LocalStats stats(src);
+    return grayFoxMap(stats, radius, k, delta);
+}
+
+GrayImage grayFoxMap(
+    LocalStats& stats,
+    int const radius,
+    float const k,
+    int const delta)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean(radius);
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -1282,11 +1148,22 @@ GrayImage grayWANMap(
     float const k,
     int const delta)
 {
+    LocalStats stats(src);
+    return grayWANMap(stats, radius, k, delta);
+}
+
+GrayImage grayWANMap(
+    LocalStats& stats,
+    int const radius,
+    float const k,
+    int const delta)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean(radius);
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -1294,12 +1171,12 @@ GrayImage grayWANMap(
 
     if (radius > 0)
     {
-        GrayImage gdeviation = grayMapDeviation(src, radius);
+        GrayImage gdeviation = stats.deviation(radius);
         if (gdeviation.isNull())
         {
             return gmean;
         }
-        GrayImage gmax = grayMapMax(src, radius);
+        GrayImage gmax = stats.max(radius);
         if (gmax.isNull())
         {
             return gmean;
@@ -1742,16 +1619,7 @@ void grayCurveFilterInPlace(
         int const src_stride = src.stride();
         unsigned char pix_replace[256];
 
-        uint64_t thres = 0;
-        for (unsigned int y = 0; y < h; y++)
-        {
-            for (unsigned int x = 0; x < w; x++)
-            {
-                unsigned char const val = src_line[x];
-                thres += val;
-            }
-            src_line += src_stride;
-        }
+        uint64_t thres = kernels::sumPixels(src_line, w, h, src_stride);
 
         thres <<= 8; /* no round */
         thres /= h;
@@ -2090,24 +1958,7 @@ void grayWienerInPlace(
 
         for (int y = 0; y < h; y++)
         {
-            for (int x = 0; x < w; x++)
-            {
-                float const mean = gmean_line[x];
-                float const deviation = gdeviation_line[x];
-                float const variance = deviation * deviation;
-
-                float const src_pixel = (float) src_line[x];
-                float const delta_pixel = src_pixel - mean;
-                float const delta_variance = variance - noise_variance;
-                float dst_pixel = mean;
-                if (delta_variance > 0.0f)
-                {
-                    dst_pixel += delta_pixel * delta_variance / variance;
-                }
-                int val = (int) (dst_pixel + 0.5f);
-                val = (val < 0) ? 0 : (val < 255) ? val : 255;
-                src_line[x] = (unsigned char) val;
-            }
+            kernels::wienerRow(src_line, gmean_line, gdeviation_line, w, noise_variance);
             src_line += src_stride;
             gmean_line += gmean_stride;
             gdeviation_line += gdeviation_stride;
@@ -2143,28 +1994,16 @@ void grayKnnDenoiserInPlace(
 
         int const w = src.width();
         int const h = src.height();
-        unsigned char* src_line = src.data();
-        int const src_stride = src.stride();
-
-        IntegralImage<uint32_t> integral_image(w, h);
-
-        for (int y = 0; y < h; y++)
-        {
-            integral_image.beginRow();
-            for (int x = 0; x < w; x++)
-            {
-                uint32_t const pixel = src_line[x];
-                integral_image.push(pixel);
-            }
-            src_line += src_stride;
-        }
+        LocalStats const stats(src);
 
         int const noise_area = ((2 * radius + 1) * (2 * radius + 1));
         float const noise_area_inv = (1.0f / (float) noise_area);
         float const noise_weight = (1.0f / (coef * coef));
         float const pixel_weight = (1.0f / 255.0f);
 
-        src_line = src.data();
+        // stats keeps the original pixels, src detaches from them here.
+        unsigned char* src_line = src.data();
+        int const src_stride = src.stride();
         for (int y = 0; y < h; y++)
         {
             for (int x = 0; x < w; x++)
@@ -2182,7 +2021,7 @@ void grayKnnDenoiserInPlace(
                     int const right = ((x + r) < w) ? (x + r) : w;
                     int const area = (bottom - top) * (right - left);
                     QRect const rect(left, top, right - left, bottom - top);
-                    float const window_sum = integral_image.sum(rect);
+                    float const window_sum = stats.sum(rect);
                     float const r_area = 1.0f / area;
                     float const mean = window_sum * r_area;
                     float const delta = (origin - mean) * pixel_weight * r;
@@ -33,6 +33,8 @@
 namespace imageproc
 {
 
+class LocalStats;
+
 /**
  * \brief A wrapper class around QImage that is always guaranteed to be 8-bit grayscale.
  */
@@ -235,6 +237,54 @@ IMAGEPROC_EXPORT GrayImage grayWANMap(
     int radius = 100,
     float k = 0.30f,
     int delta = 0);
+/**
+ * \brief The same threshold maps, computed from window statistics
+ * that may be shared with other maps of the same image.
+ */
+IMAGEPROC_EXPORT GrayImage grayNiblackMap(
+    LocalStats& stats,
+    int radius = 100,
+    float k = 0.20f,
+    int delta = 0);
+IMAGEPROC_EXPORT GrayImage graySauvolaMap(
+    LocalStats& stats,
+    int radius = 100,
+    float k = 0.30f,
+    int delta = 0);
+IMAGEPROC_EXPORT GrayImage grayWolfMap(
+    LocalStats& stats,
+    int radius = 100,
+    float k = 0.30f,
+    int delta = 0);
+IMAGEPROC_EXPORT GrayImage grayWindowMap(
+    LocalStats& stats,
+    int radius = 50,
+    float k = 1.0f,
+    int delta = 0);
+IMAGEPROC_EXPORT GrayImage grayBradleyMap(
+    LocalStats& stats,
+    int radius = 100,
+    float k = 0.20f);
+IMAGEPROC_EXPORT GrayImage grayNickMap(
+    LocalStats& stats,
+    int radius = 100,
+    float k = 0.10f,
+    int delta = 0);
+IMAGEPROC_EXPORT GrayImage graySinghMap(
+    LocalStats& stats,
+    int radius = 100,
+    float k = 0.30f,
+    int delta = 0);
+IMAGEPROC_EXPORT GrayImage grayFoxMap(
+    LocalStats& stats,
+    int radius = 100,
+    float k = 0.30f,
+    int delta = 0);
+IMAGEPROC_EXPORT GrayImage grayWANMap(
+    LocalStats& stats,
+    int radius = 100,
+    float k = 0.30f,
+    int delta = 0);
 IMAGEPROC_EXPORT GrayImage grayMScaleMap(
     GrayImage const& src,
     int radius = 10,
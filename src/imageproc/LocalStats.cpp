@@ -0,0 +1,420 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LocalStats.h"
+#include "ParallelFor.h"
+#include "PixelKernels.h"
+#include <algorithm>
+#include <functional>
+#include <math.h>
+#include <assert.h>
+
+namespace imageproc
+{
+
+namespace
+{
+
+// Rows per parallel work item.
+int const ROW_GRAIN = 32;
+
+// Integral image columns per parallel work item of the vertical pass.
+int const COLUMN_GRAIN = 1024;
+
+/**
+ * Builds a (width + 1) x (height + 1) integral image of transform(pixel).
+ * Each row is first turned into its own prefix sum, which rows do
+ * independently of each other, then the rows are accumulated downwards
+ * in column strips.  The latter is a plain addition of contiguous arrays
+ * the compiler vectorizes.
+ */
+template<typename T, typename Transform>
+void buildIntegral(std::vector<T>& integral, GrayImage const& src, Transform transform)
+{
+    int const w = src.width();
+    int const h = src.height();
+    int const iw = w + 1;
+    integral.assign(size_t(iw) * (h + 1), T());
+
+    T* const data = &integral[0];
+    unsigned char const* const src_data = src.data();
+    int const src_stride = src.stride();
+
+    parallelFor(0, h, ROW_GRAIN, [=](int const y_begin, int const y_end)
+    {
+        for (int y = y_begin; y < y_end; y++)
+        {
+            unsigned char const* src_line = src_data + size_t(y) * src_stride;
+            T* line = data + size_t(y + 1) * iw + 1;
+            T line_sum = T();
+            for (int x = 0; x < w; x++)
+            {
+                line_sum += transform(src_line[x]);
+                line[x] = line_sum;
+            }
+        }
+    });
+
+    parallelFor(1, iw, COLUMN_GRAIN, [=](int const x_begin, int const x_end)
+    {
+        for (int y = 2; y <= h; y++)
+        {
+            T* const line = data + size_t(y) * iw;
+            T const* const above = line - iw;
+            for (int x = x_begin; x < x_end; x++)
+            {
+                line[x] += above[x];
+            }
+        }
+    });
+}
+
+template<typename T>
+inline T rectSum(std::vector<T> const& integral, int const iw, QRect const& rect)
+{
+    // Keep in mind that row 0 and column 0 are fake.
+    int const pre_left = rect.left();
+    int const pre_right = rect.right() + 1; // QRect::right() is inclusive.
+    int const pre_top = rect.top();
+    int const pre_bottom = rect.bottom() + 1; // QRect::bottom() is inclusive.
+    T sum(integral[pre_bottom * iw + pre_right]);
+    sum -= integral[pre_top * iw + pre_right];
+    sum += integral[pre_top * iw + pre_left];
+    sum -= integral[pre_bottom * iw + pre_left];
+    return sum;
+}
+
+struct Identity
+{
+    uint32_t operator()(unsigned char const pixel) const
+    {
+        return pixel;
+    }
+};
+
+struct Square
+{
+    uint64_t operator()(unsigned char const pixel) const
+    {
+        uint32_t const p = pixel;
+        return p * p;
+    }
+};
+
+struct Min
+{
+    unsigned char operator()(unsigned char const a, unsigned char const b) const
+    {
+        return (b < a) ? b : a;
+    }
+};
+
+struct Max
+{
+    unsigned char operator()(unsigned char const a, unsigned char const b) const
+    {
+        return (b > a) ? b : a;
+    }
+};
+
+} // anonymous namespace
+
+LocalStats::LocalStats(GrayImage const& src)
+    : m_src(src),
+      m_width(src.width()),
+      m_height(src.height())
+{
+    if (!m_src.isNull())
+    {
+        buildIntegral(m_sum, m_src, Identity());
+    }
+}
+
+void
+LocalStats::buildSqSum()
+{
+    if (m_sqsum.empty() && !m_src.isNull())
+    {
+        buildIntegral(m_sqsum, m_src, Square());
+    }
+}
+
+uint32_t
+LocalStats::sum(QRect const& rect) const
+{
+    return rectSum(m_sum, m_width + 1, rect);
+}
+
+uint64_t
+LocalStats::sqsum(QRect const& rect)
+{
+    buildSqSum();
+    return rectSum(m_sqsum, m_width + 1, rect);
+}
+
+GrayImage
+LocalStats::mean(int const radius)
+{
+    if (m_src.isNull())
+    {
+        return GrayImage();
+    }
+    if (radius <= 0)
+    {
+        return m_src;
+    }
+
+    std::map<int, GrayImage>::const_iterator const it(m_meanCache.find(radius));
+    if (it != m_meanCache.end())
+    {
+        return it->second;
+    }
+
+    int const w = m_width;
+    int const h = m_height;
+    int const iw = m_width + 1;
+    // Pixels in [radius, mean_inner_end) have windows clear of the left and right edges.
+    int const mean_inner_end = w - radius + 1;
+    GrayImage gray(m_src.size());
+    unsigned char* const gray_data = gray.data();
+    int const gray_stride = gray.stride();
+
+    parallelFor(0, h, ROW_GRAIN, [&](int const y_begin, int const y_end)
+    {
+        for (int y = y_begin; y < y_end; y++)
+        {
+            unsigned char* const gray_line = gray_data + size_t(y) * gray_stride;
+            int const top = ((y - radius) < 0) ? 0 : (y - radius);
+            int const bottom = ((y + radius + 1) < h) ? (y + radius + 1) : h;
+
+            for (int x = 0; x < w; x++)
+            {
+                if ((x == radius) && (x < mean_inner_end))
+                {
+                    // Windows that don't touch the left or right edge all have the same area.
+                    uint32_t const* const top_line = &m_sum[size_t(top) * iw];
+                    uint32_t const* const bottom_line = &m_sum[size_t(bottom) * iw];
+                    int const area = (bottom - top) * (2 * radius);
+                    kernels::windowMeanRow(
+                        top_line, top_line + 2 * radius, bottom_line, bottom_line + 2 * radius,
+                        1.0 / area, gray_line + x, mean_inner_end - x);
+                    x = mean_inner_end - 1;
+                    continue;
+                }
+
+                // The window is one pixel narrower on the right, as it has always been in grayMapMean().
+                int const left = ((x - radius) < 0) ? 0 : (x - radius);
+                int const right = ((x + radius) < w) ? (x + radius) : w;
+                int const area = (bottom - top) * (right - left);
+                assert(area > 0);  // because windowSize > 0 and w > 0 and h > 0
+
+                QRect const rect(left, top, right - left, bottom - top);
+                double const window_sum = sum(rect);
+
+                double const r_area = 1.0 / area;
+                double mean = window_sum * r_area;
+
+                mean += 0.5;
+                mean = (mean < 0.0) ? 0.0 : ((mean < 255.0) ? mean : 255.0);
+                gray_line[x] = (unsigned char) mean;
+            }
+        }
+    });
+
+    m_meanCache[radius] = gray;
+    return gray;
+}
+
+GrayImage
+LocalStats::deviation(int const radius)
+{
+    if (m_src.isNull())
+    {
+        return GrayImage();
+    }
+    if (radius <= 0)
+    {
+        return m_src;
+    }
+
+    std::map<int, GrayImage>::const_iterator const it(m_deviationCache.find(radius));
+    if (it != m_deviationCache.end())
+    {
+        return it->second;
+    }
+
+    buildSqSum();
+
+    int const w = m_width;
+    int const h = m_height;
+    int const iw = m_width + 1;
+    // Pixels in [radius, deviation_inner_end) have windows clear of the left and right edges.
+    int const deviation_inner_end = w - radius;
+    GrayImage gray(m_src.size());
+    unsigned char* const gray_data = gray.data();
+    int const gray_stride = gray.stride();
+
+    parallelFor(0, h, ROW_GRAIN, [&](int const y_begin, int const y_end)
+    {
+        for (int y = y_begin; y < y_end; y++)
+        {
+            unsigned char* const gray_line = gray_data + size_t(y) * gray_stride;
+            int const top = ((y - radius) < 0) ? 0 : (y - radius);
+            int const bottom = ((y + radius + 1) < h) ? (y + radius + 1) : h;
+
+            for (int x = 0; x < w; x++)
+            {
+                if ((x == radius) && (x < deviation_inner_end))
+                {
+                    // Windows that don't touch the left or right edge all have the same area.
+                    size_t const top_offset = size_t(top) * iw;
+                    size_t const bottom_offset = size_t(bottom) * iw;
+                    int const span = 2 * radius + 1;
+                    int const area = (bottom - top) * span;
+                    kernels::windowDeviationRow(
+                        &m_sum[top_offset], &m_sum[top_offset + span],
+                        &m_sum[bottom_offset], &m_sum[bottom_offset + span],
+                        &m_sqsum[top_offset], &m_sqsum[top_offset + span],
+                        &m_sqsum[bottom_offset], &m_sqsum[bottom_offset + span],
+                        1.0 / area, gray_line + x, deviation_inner_end - x);
+                    x = deviation_inner_end - 1;
+                    continue;
+                }
+
+                int const left = ((x - radius) < 0) ? 0 : (x - radius);
+                int const right = ((x + radius + 1) < w) ? (x + radius + 1) : w;
+                int const area = (bottom - top) * (right - left);
+                assert(area > 0); // because window_size > 0 and w > 0 and h > 0
+
+                QRect const rect(left, top, right - left, bottom - top);
+                double const window_sum = rectSum(m_sum, iw, rect);
+                double const window_sqsum = rectSum(m_sqsum, iw, rect);
+
+                double const r_area = 1.0 / area;
+                double const mean = window_sum * r_area;
+                double const sqmean = window_sqsum * r_area;
+
+                double const variance = sqmean - mean * mean;
+                double deviation = sqrt(fabs(variance));
+
+                deviation += 0.5;
+                deviation = (deviation < 0.0) ? 0.0 : ((deviation < 255.0) ? deviation : 255.0);
+                gray_line[x] = (unsigned char) deviation;
+            }
+        }
+    });
+
+    m_deviationCache[radius] = gray;
+    return gray;
+}
+
+template<typename Op>
+GrayImage
+LocalStats::extremum(std::map<int, GrayImage>& cache, int const radius, Op const op)
+{
+    if (m_src.isNull())
+    {
+        return GrayImage();
+    }
+    if (radius <= 0)
+    {
+        return m_src;
+    }
+
+    std::map<int, GrayImage>::const_iterator const it(cache.find(radius));
+    if (it != cache.end())
+    {
+        return it->second;
+    }
+
+    int const w = m_width;
+    int const h = m_height;
+    unsigned char const* const src_data = m_src.data();
+    int const src_stride = m_src.stride();
+
+    // The square window is separable: first along the rows, then along the columns.
+    GrayImage horizontal(m_src.size());
+    unsigned char* const horizontal_data = horizontal.data();
+    int const horizontal_stride = horizontal.stride();
+
+    parallelFor(0, h, ROW_GRAIN, [&](int const y_begin, int const y_end)
+    {
+        for (int y = y_begin; y < y_end; y++)
+        {
+            unsigned char const* const src_line = src_data + size_t(y) * src_stride;
+            unsigned char* const horizontal_line = horizontal_data + size_t(y) * horizontal_stride;
+            for (int x = 0; x < w; x++)
+            {
+                int const left = ((x - radius) < 0) ? 0 : (x - radius);
+                int const right = ((x + radius + 1) < w) ? (x + radius + 1) : w;
+
+                unsigned char val = src_line[x];
+                for (int xf = left; xf < right; xf++)
+                {
+                    val = op(val, src_line[xf]);
+                }
+                horizontal_line[x] = val;
+            }
+        }
+    });
+
+    GrayImage gray(m_src.size());
+    unsigned char* const gray_data = gray.data();
+    int const gray_stride = gray.stride();
+
+    parallelFor(0, h, ROW_GRAIN, [&](int const y_begin, int const y_end)
+    {
+        for (int y = y_begin; y < y_end; y++)
+        {
+            int const top = ((y - radius) < 0) ? 0 : (y - radius);
+            int const bottom = ((y + radius + 1) < h) ? (y + radius + 1) : h;
+
+            unsigned char* const gray_line = gray_data + size_t(y) * gray_stride;
+            unsigned char const* const first_line = horizontal_data + size_t(top) * horizontal_stride;
+            for (int x = 0; x < w; x++)
+            {
+                gray_line[x] = first_line[x];
+            }
+            for (int yf = top + 1; yf < bottom; yf++)
+            {
+                unsigned char const* const horizontal_line = horizontal_data + size_t(yf) * horizontal_stride;
+                for (int x = 0; x < w; x++)
+                {
+                    gray_line[x] = op(gray_line[x], horizontal_line[x]);
+                }
+            }
+        }
+    });
+
+    cache[radius] = gray;
+    return gray;
+}
+
+GrayImage
+LocalStats::min(int const radius)
+{
+    return extremum(m_minCache, radius, Min());
+}
+
+GrayImage
+LocalStats::max(int const radius)
+{
+    return extremum(m_maxCache, radius, Max());
+}
+
+} // namespace imageproc
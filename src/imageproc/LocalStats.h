@@ -0,0 +1,118 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_LOCALSTATS_H_
+#define IMAGEPROC_LOCALSTATS_H_
+
+#include "imageproc_config.h"
+#include "NonCopyable.h"
+#include "GrayImage.h"
+#include <QRect>
+#include <vector>
+#include <map>
+#include <stdint.h>
+
+namespace imageproc
+{
+
+/**
+ * \brief Window statistics of a grayscale image, computed once and shared.
+ *
+ * Holds the integral images of pixel values and of their squares, and
+ * produces the mean, deviation, minimum and maximum maps that the window
+ * based filters and binarizers need.  Integral images are built in
+ * parallel row blocks, the squared one only when first needed.  Every map
+ * is cached per radius, so asking for the same statistics twice
+ * costs nothing.
+ *
+ * The maps are bit-identical to those of grayMapMean(), grayMapDeviation()
+ * and grayMapMax(), which are now implemented on top of this class.
+ *
+ * \note Not thread-safe.  Use one instance per page and thread.
+ */
+class IMAGEPROC_EXPORT LocalStats
+{
+    DECLARE_NON_COPYABLE(LocalStats)
+public:
+    explicit LocalStats(GrayImage const& src);
+
+    bool isNull() const
+    {
+        return m_src.isNull();
+    }
+
+    GrayImage const& source() const
+    {
+        return m_src;
+    }
+
+    /**
+     * \brief The sum of pixel values in a rectangle within the image.
+     */
+    uint32_t sum(QRect const& rect) const;
+
+    /**
+     * \brief The sum of squared pixel values in a rectangle within the image.
+     */
+    uint64_t sqsum(QRect const& rect);
+
+    /**
+     * \brief Window mean, as grayMapMean() computes it.
+     */
+    GrayImage mean(int radius);
+
+    /**
+     * \brief Window standard deviation, as grayMapDeviation() computes it.
+     */
+    GrayImage deviation(int radius);
+
+    /**
+     * \brief Window minimum over a (2 * radius + 1) square.
+     */
+    GrayImage min(int radius);
+
+    /**
+     * \brief Window maximum over a (2 * radius + 1) square, as grayMapMax() computes it.
+     */
+    GrayImage max(int radius);
+private:
+    void buildSqSum();
+
+    template<typename Op>
+    GrayImage extremum(std::map<int, GrayImage>& cache, int radius, Op op);
+
+    GrayImage m_src;
+    int m_width;
+    int m_height;
+
+    /**
+     * Integral images of (m_width + 1) x (m_height + 1) elements,
+     * the first row and column being zero.
+     */
+    std::vector<uint32_t> m_sum;
+    std::vector<uint64_t> m_sqsum;
+
+    std::map<int, GrayImage> m_meanCache;
+    std::map<int, GrayImage> m_deviationCache;
+    std::map<int, GrayImage> m_minCache;
+    std::map<int, GrayImage> m_maxCache;
+};
+
+} // namespace imageproc
+
+#endif
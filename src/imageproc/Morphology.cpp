@@ -21,6 +21,8 @@
 #include "GrayImage.h"
 #include "RasterOp.h"
 #include "Grayscale.h"
+#include "BitOps.h"
+#include "ParallelFor.h"
 #include <QPoint>
 #include <QSize>
 #include <QRect>
@@ -206,6 +208,18 @@ inline QRect shrinkByBrick(QRect const& rect, Brick const& brick)
 
 static int const COMPOSITE_THRESHOLD = 8;
 
+/**
+ * Bricks at least this wide or tall go to dilateOrErodeLargeBrick(),
+ * whose cost doesn't grow with brick size.  Below that, spreading
+ * by shifting takes fewer passes over the image.
+ */
+static int const LARGE_BRICK_THRESHOLD = 16;
+
+/**
+ * The number of lines per parallelFor() chunk in dilateOrErodeLargeBrick().
+ */
+static int const ROW_BAND = 32;
+
 void doInitialCopy(
     BinaryImage& dst, CoordinateSystem const& dst_cs,
     QRect const& dst_relevant_rect,
@@ -389,6 +403,229 @@ void spreadInDirection(
     tmp_images.store(tmp);
 }
 
+/**
+ * \brief Sets bits [begin, end) of a line.
+ */
+void setBits(uint32_t* const line, int const begin, int const end)
+{
+    int const first_word = begin >> 5;
+    int const last_word = (end - 1) >> 5;
+    uint32_t const first_mask = ~uint32_t(0) >> (begin & 31);
+    uint32_t const last_mask = ~uint32_t(0) << (31 - ((end - 1) & 31));
+
+    if (first_word == last_word)
+    {
+        line[first_word] |= first_mask & last_mask;
+        return;
+    }
+
+    line[first_word] |= first_mask;
+    for (int i = first_word + 1; i < last_word; ++i)
+    {
+        line[i] = ~uint32_t(0);
+    }
+    line[last_word] |= last_mask;
+}
+
+/**
+ * \brief Finds the first bit in [begin, end) that is set after XOR-ing with \p flip.
+ *
+ * \return The position of that bit, or \p end if there is no such bit.
+ */
+int findSetBit(uint32_t const* const line, int const begin, int const end, uint32_t const flip)
+{
+    if (begin >= end)
+    {
+        return end;
+    }
+
+    int const last_word = (end - 1) >> 5;
+    int word_idx = begin >> 5;
+    uint32_t word = (line[word_idx] ^ flip) & (~uint32_t(0) >> (begin & 31));
+    while (!word)
+    {
+        if (++word_idx > last_word)
+        {
+            return end;
+        }
+        word = line[word_idx] ^ flip;
+    }
+
+    return std::min(end, (word_idx << 5) + countMostSignificantZeroes(word));
+}
+
+/**
+ * \brief Same as dilateOrErodeBrick(), but at a cost that doesn't depend on brick size.
+ *
+ * The horizontal pass extends runs of \p spreading_color pixels by the brick
+ * width, working on whole words wherever possible.  The vertical pass is the
+ * van Herk / Gil-Werman algorithm applied to whole words: lines are split into
+ * blocks of brick height, so that any window of brick height lines covers the
+ * tail of one block and the head of the next one.  With the tails OR-ed (or
+ * AND-ed) bottom to top and the heads top to bottom, each output line takes
+ * a single operation.
+ */
+void dilateOrErodeLargeBrick(
+    BinaryImage& dst, BinaryImage const& src, Brick const& brick,
+    QRect const& dst_area, BWColor const src_surroundings,
+    BWColor const spreading_color)
+{
+    // We treat spreading_color pixels as set bits.  Where it's WHITE,
+    // erosion becomes a dilation of an inverted image.
+    uint32_t const flip = spreading_color == BLACK ? 0 : ~uint32_t(0);
+    bool const surroundings_spread = src_surroundings == spreading_color;
+
+    int const width = dst_area.width();
+    int const height = dst_area.height();
+    int const brick_height = brick.height();
+
+    // Line r of tmp corresponds to line tmp_top + r of src.
+    int const tmp_height = height + brick_height - 1;
+    int const tmp_top = dst_area.top() - brick.maxY();
+    BinaryImage tmp(width, tmp_height);
+    uint32_t* const tmp_data = tmp.data();
+    int const tmp_wpl = tmp.wordsPerLine();
+
+    uint32_t const* const src_data = src.data();
+    int const src_wpl = src.wordsPerLine();
+    int const src_width = src.width();
+    int const src_height = src.height();
+
+    // Pixel x of a tmp line depends on src pixels [x + src_begin, x + src_begin + brick.width()),
+    // so the whole line depends on src pixels [src_begin, src_end).
+    int const src_begin = dst_area.left() - brick.maxX();
+    int const src_end = dst_area.right() - brick.minX() + 1;
+
+    // Horizontal pass.
+    parallelFor(0, tmp_height, ROW_BAND, [&](int const r_begin, int const r_end)
+    {
+        for (int r = r_begin; r < r_end; ++r)
+        {
+            uint32_t* const tmp_line = tmp_data + r * tmp_wpl;
+            int const y = tmp_top + r;
+            if (y < 0 || y >= src_height)
+            {
+                std::fill(tmp_line, tmp_line + tmp_wpl, surroundings_spread ? ~uint32_t(0) : 0);
+                continue;
+            }
+
+            std::fill(tmp_line, tmp_line + tmp_wpl, 0);
+            uint32_t const* const src_line = src_data + y * src_wpl;
+
+            // Runs come in ascending order, so extended runs that overlap
+            // are merged before being written.
+            int span_begin = 0;
+            int span_end = 0;
+            auto const addRun = [&](int const run_begin, int const run_end)
+            {
+                int const begin = std::max(0, run_begin - src_begin - (brick.width() - 1));
+                int const end = std::min(width, run_end - src_begin);
+                if (begin >= end)
+                {
+                    return;
+                }
+                if (begin <= span_end)
+                {
+                    span_end = std::max(span_end, end);
+                }
+                else
+                {
+                    if (span_begin < span_end)
+                    {
+                        setBits(tmp_line, span_begin, span_end);
+                    }
+                    span_begin = begin;
+                    span_end = end;
+                }
+            };
+
+            if (surroundings_spread && src_begin < 0)
+            {
+                addRun(src_begin, 0);
+            }
+
+            int const scan_begin = std::max(0, src_begin);
+            int const scan_end = std::min(src_width, src_end);
+            for (int x = scan_begin; x < scan_end;)
+            {
+                int const run_begin = findSetBit(src_line, x, scan_end, flip);
+                if (run_begin == scan_end)
+                {
+                    break;
+                }
+                int const run_end = findSetBit(src_line, run_begin, scan_end, ~flip);
+                addRun(run_begin, run_end);
+                x = run_end;
+            }
+
+            if (surroundings_spread && src_end > src_width)
+            {
+                addRun(src_width, src_end);
+            }
+
+            if (span_begin < span_end)
+            {
+                setBits(tmp_line, span_begin, span_end);
+            }
+        }
+    });
+
+    // Vertical pass.
+    uint32_t* const dst_data = dst.data();
+    int const dst_wpl = dst.wordsPerLine();
+    assert(dst_wpl == tmp_wpl);
+    int const num_blocks = (tmp_height + brick_height - 1) / brick_height;
+
+    int const blocks_per_chunk = std::max(1, ROW_BAND / brick_height);
+    parallelFor(0, num_blocks, blocks_per_chunk, [&](int const b_begin, int const b_end)
+    {
+        std::vector<uint32_t> tail(tmp_wpl);
+        for (int b = b_begin; b < b_end; ++b)
+        {
+            int const first = b * brick_height;
+            int const last = std::min(tmp_height, first + brick_height) - 1;
+
+            // Block tails.  Only the first height lines of tmp start a window.
+            std::fill(tail.begin(), tail.end(), 0);
+            for (int r = last; r >= first; --r)
+            {
+                uint32_t const* const tmp_line = tmp_data + r * tmp_wpl;
+                for (int i = 0; i < tmp_wpl; ++i)
+                {
+                    tail[i] |= tmp_line[i];
+                }
+                if (r < height)
+                {
+                    std::copy(tail.begin(), tail.end(), dst_data + r * dst_wpl);
+                }
+            }
+
+            // Block heads, in place.
+            for (int r = first + 1; r <= last; ++r)
+            {
+                uint32_t* const tmp_line = tmp_data + r * tmp_wpl;
+                for (int i = 0; i < tmp_wpl; ++i)
+                {
+                    tmp_line[i] |= tmp_line[i - tmp_wpl];
+                }
+            }
+        }
+    });
+
+    parallelFor(0, height, ROW_BAND, [&](int const y_begin, int const y_end)
+    {
+        for (int y = y_begin; y < y_end; ++y)
+        {
+            uint32_t* const dst_line = dst_data + y * dst_wpl;
+            uint32_t const* const head_line = tmp_data + (y + brick_height - 1) * tmp_wpl;
+            for (int i = 0; i < dst_wpl; ++i)
+            {
+                dst_line[i] = (dst_line[i] | head_line[i]) ^ flip;
+            }
+        }
+    });
+}
+
 void dilateOrErodeBrick(
     BinaryImage& dst, BinaryImage const& src, Brick const& brick,
     QRect const& dst_area, BWColor const src_surroundings,
@@ -404,6 +641,12 @@ void dilateOrErodeBrick(
         return;
     }
 
+    if (brick.width() >= LARGE_BRICK_THRESHOLD || brick.height() >= LARGE_BRICK_THRESHOLD)
+    {
+        dilateOrErodeLargeBrick(dst, src, brick, dst_area, src_surroundings, spreading_color);
+        return;
+    }
+
     CoordinateSystem const src_cs; // global coordinate system
     CoordinateSystem const dst_cs(dst_area.topLeft());
     QRect const dst_image_rect(QPoint(0, 0), dst_area.size());
@@ -0,0 +1,724 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PixelKernels.h"
+#include <QAtomicInt>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || ((defined(__i386__) || defined(_M_IX86)) \
+    && (defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)))
+#   define IMAGEPROC_KERNELS_X86
+#   include <immintrin.h>
+#   if defined(_MSC_VER) && !defined(__clang__)
+#       include <intrin.h>
+#       define IMAGEPROC_TARGET_AVX2
+#   else
+#       define IMAGEPROC_TARGET_AVX2 __attribute__((target("avx2")))
+#   endif
+#elif defined(__aarch64__)
+#   define IMAGEPROC_KERNELS_NEON
+#   include <arm_neon.h>
+#endif
+
+namespace imageproc
+{
+
+namespace kernels
+{
+
+namespace
+{
+
+QAtomicInt g_simdLevel(-1);
+
+SimdLevel detectSimdLevel()
+{
+#if defined(IMAGEPROC_KERNELS_X86)
+#   if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7)
+    {
+        __cpuid(info, 1);
+        bool const osxsave = (info[2] & (1 << 27)) != 0;
+        bool const avx = (info[2] & (1 << 28)) != 0;
+        // The OS has to save the YMM registers on context switches.
+        if (osxsave && avx && ((_xgetbv(0) & 6) == 6))
+        {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5))
+            {
+                return SIMD_AVX2;
+            }
+        }
+    }
+    return SIMD_SSE2;
+#   else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? SIMD_AVX2 : SIMD_SSE2;
+#   endif
+#elif defined(IMAGEPROC_KERNELS_NEON)
+    return SIMD_NEON;
+#else
+    return SIMD_NONE;
+#endif
+}
+
+/*
+ * Scalar implementations.  These are the reference the vectorized ones
+ * have to match bit for bit, and they also process the tails of rows.
+ */
+
+uint64_t sumPixelsScalar(
+    unsigned char const* data, int const width, int const height, int const stride)
+{
+    uint64_t sum = 0;
+    for (int y = 0; y < height; y++)
+    {
+        unsigned char const* const line = data + (size_t) y * stride;
+        uint32_t line_sum = 0;
+        for (int x = 0; x < width; x++)
+        {
+            line_sum += line[x];
+        }
+        sum += line_sum;
+    }
+    return sum;
+}
+
+void windowMeanRowScalar(
+    uint32_t const* tl, uint32_t const* tr,
+    uint32_t const* bl, uint32_t const* br,
+    double const r_area, unsigned char* dst, int const count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t window_sum = br[i];
+        window_sum -= tr[i];
+        window_sum += tl[i];
+        window_sum -= bl[i];
+
+        double mean = (double) window_sum * r_area;
+
+        mean += 0.5;
+        mean = (mean < 0.0) ? 0.0 : ((mean < 255.0) ? mean : 255.0);
+        dst[i] = (unsigned char) mean;
+    }
+}
+
+void windowDeviationRowScalar(
+    uint32_t const* tl, uint32_t const* tr,
+    uint32_t const* bl, uint32_t const* br,
+    uint64_t const* sq_tl, uint64_t const* sq_tr,
+    uint64_t const* sq_bl, uint64_t const* sq_br,
+    double const r_area, unsigned char* dst, int const count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t window_sum = br[i];
+        window_sum -= tr[i];
+        window_sum += tl[i];
+        window_sum -= bl[i];
+        uint64_t window_sqsum = sq_br[i];
+        window_sqsum -= sq_tr[i];
+        window_sqsum += sq_tl[i];
+        window_sqsum -= sq_bl[i];
+
+        double const mean = (double) window_sum * r_area;
+        double const sqmean = (double) window_sqsum * r_area;
+
+        double const variance = sqmean - mean * mean;
+        double deviation = sqrt(fabs(variance));
+
+        deviation += 0.5;
+        deviation = (deviation < 0.0) ? 0.0 : ((deviation < 255.0) ? deviation : 255.0);
+        dst[i] = (unsigned char) deviation;
+    }
+}
+
+void sauvolaThresholdRowScalar(
+    unsigned char const* mean_line, unsigned char const* deviation_line,
+    unsigned char* dst, int const count, float const k, int const delta)
+{
+    for (int i = 0; i < count; i++)
+    {
+        float const mean = mean_line[i];
+        float const deviation = deviation_line[i];
+
+        float const shift = deviation + delta;
+        float const part = k * (1.0f - shift / 128.0f);
+        float threshold = mean * (1.0f - part);
+
+        threshold = (threshold < 0.0f) ? 0.0f : ((threshold < 255.0f) ? threshold : 255.0f);
+        dst[i] = (unsigned char) threshold;
+    }
+}
+
+void wolfThresholdRowScalar(
+    unsigned char const* mean_line, unsigned char const* deviation_line,
+    unsigned char* dst, int const count, float const k, int const delta,
+    float const gray_min, float const deviation_max)
+{
+    for (int i = 0; i < count; i++)
+    {
+        float const mean = mean_line[i];
+        float const deviation = deviation_line[i];
+
+        float const base = mean - gray_min;
+        float const frac = (deviation_max > 0.0f) ? (deviation / deviation_max) : 1.0f;
+        float const frac_delta = (float) delta / 128.0f;
+        float const part = 1.0f - (frac + frac_delta);
+        float threshold = base * (1.0f - k * part) + gray_min;
+
+        threshold = (threshold < 0.0f) ? 0.0f : ((threshold < 255.0f) ? threshold : 255.0f);
+        dst[i] = (unsigned char) threshold;
+    }
+}
+
+void wienerRowScalar(
+    unsigned char* src_line, unsigned char const* mean_line,
+    unsigned char const* deviation_line, int const count, float const noise_variance)
+{
+    for (int i = 0; i < count; i++)
+    {
+        float const mean = mean_line[i];
+        float const deviation = deviation_line[i];
+        float const variance = deviation * deviation;
+
+        float const src_pixel = (float) src_line[i];
+        float const delta_pixel = src_pixel - mean;
+        float const delta_variance = variance - noise_variance;
+        float dst_pixel = mean;
+        if (delta_variance > 0.0f)
+        {
+            dst_pixel += delta_pixel * delta_variance / variance;
+        }
+        int val = (int) (dst_pixel + 0.5f);
+        val = (val < 0) ? 0 : (val < 255) ? val : 255;
+        src_line[i] = (unsigned char) val;
+    }
+}
+
+void rgbToYCbCrRowScalar(QRgb const* src, QRgb* dst, int const count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        QRgb const pixel = src[i];
+        int r = qRed(pixel);
+        int g = qGreen(pixel);
+        int b = qBlue(pixel);
+
+        float const cy = 0.299f  * r + 0.587f * g + 0.114f * b;
+        float const cb = 128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b;
+        float const cr = 128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b;
+
+        r = (int) (0.5f + cb);
+        r = (r < 0) ? 0 : (r < 255) ? r : 255;
+        g = (int) (0.5f + cr);
+        g = (g < 0) ? 0 : (g < 255) ? g : 255;
+        b = (int) (0.5f + cy);
+        b = (b < 0) ? 0 : (b < 255) ? b : 255;
+        dst[i] = qRgb(r, g, b);
+    }
+}
+
+#if defined(IMAGEPROC_KERNELS_X86)
+
+uint64_t sumPixelsSse2(
+    unsigned char const* data, int const width, int const height, int const stride)
+{
+    __m128i const zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    uint64_t sum = 0;
+    for (int y = 0; y < height; y++)
+    {
+        unsigned char const* const line = data + (size_t) y * stride;
+        int x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i const pixels = _mm_loadu_si128((__m128i const*) (line + x));
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(pixels, zero));
+        }
+        for (; x < width; x++)
+        {
+            sum += line[x];
+        }
+    }
+    uint64_t parts[2];
+    _mm_storeu_si128((__m128i*) parts, acc);
+    return sum + parts[0] + parts[1];
+}
+
+IMAGEPROC_TARGET_AVX2
+uint64_t sumPixelsAvx2(
+    unsigned char const* data, int const width, int const height, int const stride)
+{
+    __m256i const zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    uint64_t sum = 0;
+    for (int y = 0; y < height; y++)
+    {
+        unsigned char const* const line = data + (size_t) y * stride;
+        int x = 0;
+        for (; x + 32 <= width; x += 32)
+        {
+            __m256i const pixels = _mm256_loadu_si256((__m256i const*) (line + x));
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(pixels, zero));
+        }
+        for (; x < width; x++)
+        {
+            sum += line[x];
+        }
+    }
+    uint64_t parts[4];
+    _mm256_storeu_si256((__m256i*) parts, acc);
+    return sum + parts[0] + parts[1] + parts[2] + parts[3];
+}
+
+/**
+ * Loads 8 pixels and converts them to floats.
+ */
+IMAGEPROC_TARGET_AVX2
+inline __m256 loadPixelsAvx2(unsigned char const* p)
+{
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const*) p)));
+}
+
+/**
+ * Stores 8 integers known to be in [0, 255] as pixels.
+ */
+IMAGEPROC_TARGET_AVX2
+inline void storePixelsAvx2(unsigned char* p, __m256i const values)
+{
+    __m128i const words = _mm_packs_epi32(
+        _mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1));
+    _mm_storel_epi64((__m128i*) p, _mm_packus_epi16(words, words));
+}
+
+/**
+ * Stores 4 integers known to be in [0, 255] as pixels.
+ */
+IMAGEPROC_TARGET_AVX2
+inline void storePixels4Avx2(unsigned char* p, __m128i const values)
+{
+    __m128i const words = _mm_packs_epi32(values, values);
+    int const bytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+    memcpy(p, &bytes, 4);
+}
+
+/**
+ * Clamps to [0, 255] and truncates, like the scalar code does.
+ */
+IMAGEPROC_TARGET_AVX2
+inline __m256i clampToPixelsAvx2(__m256 const values)
+{
+    __m256 const clamped = _mm256_min_ps(
+        _mm256_max_ps(values, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+    return _mm256_cvttps_epi32(clamped);
+}
+
+IMAGEPROC_TARGET_AVX2
+inline __m128i clampToPixelsAvx2(__m256d const values)
+{
+    __m256d const clamped = _mm256_min_pd(
+        _mm256_max_pd(values, _mm256_setzero_pd()), _mm256_set1_pd(255.0));
+    return _mm256_cvttpd_epi32(clamped);
+}
+
+/**
+ * Window sums of 4 pixels, converted to doubles.
+ */
+IMAGEPROC_TARGET_AVX2
+inline __m256d windowSumsAvx2(
+    uint32_t const* tl, uint32_t const* tr,
+    uint32_t const* bl, uint32_t const* br)
+{
+    __m128i sums = _mm_loadu_si128((__m128i const*) br);
+    sums = _mm_sub_epi32(sums, _mm_loadu_si128((__m128i const*) tr));
+    sums = _mm_add_epi32(sums, _mm_loadu_si128((__m128i const*) tl));
+    sums = _mm_sub_epi32(sums, _mm_loadu_si128((__m128i const*) bl));
+
+    // Unsigned to double: flip the sign bit, convert as signed and add it back.
+    __m128i const biased = _mm_xor_si128(sums, _mm_set1_epi32(INT32_MIN));
+    return _mm256_add_pd(_mm256_cvtepi32_pd(biased), _mm256_set1_pd(2147483648.0));
+}
+
+IMAGEPROC_TARGET_AVX2
+void windowMeanRowAvx2(
+    uint32_t const* tl, uint32_t const* tr,
+    uint32_t const* bl, uint32_t const* br,
+    double const r_area, unsigned char* dst, int const count)
+{
+    __m256d const v_r_area = _mm256_set1_pd(r_area);
+    __m256d const v_half = _mm256_set1_pd(0.5);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256d const window_sum = windowSumsAvx2(tl + i, tr + i, bl + i, br + i);
+        __m256d const mean = _mm256_add_pd(_mm256_mul_pd(window_sum, v_r_area), v_half);
+        storePixels4Avx2(dst + i, clampToPixelsAvx2(mean));
+    }
+    windowMeanRowScalar(tl + i, tr + i, bl + i, br + i, r_area, dst + i, count - i);
+}
+
+IMAGEPROC_TARGET_AVX2
+void windowDeviationRowAvx2(
+    uint32_t const* tl, uint32_t const* tr,
+    uint32_t const* bl, uint32_t const* br,
+    uint64_t const* sq_tl, uint64_t const* sq_tr,
+    uint64_t const* sq_bl, uint64_t const* sq_br,
+    double const r_area, unsigned char* dst, int const count)
+{
+    __m256d const v_r_area = _mm256_set1_pd(r_area);
+    __m256d const v_half = _mm256_set1_pd(0.5);
+    __m256d const abs_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(INT64_MAX));
+    // Integers below 2^52 turn into doubles by being or-ed into the mantissa of 2^52.
+    __m256i const magic_bits = _mm256_set1_epi64x(0x4330000000000000LL);
+    __m256d const magic = _mm256_set1_pd(4503599627370496.0);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256d const window_sum = windowSumsAvx2(tl + i, tr + i, bl + i, br + i);
+
+        __m256i sqsums = _mm256_loadu_si256((__m256i const*) (sq_br + i));
+        sqsums = _mm256_sub_epi64(sqsums, _mm256_loadu_si256((__m256i const*) (sq_tr + i)));
+        sqsums = _mm256_add_epi64(sqsums, _mm256_loadu_si256((__m256i const*) (sq_tl + i)));
+        sqsums = _mm256_sub_epi64(sqsums, _mm256_loadu_si256((__m256i const*) (sq_bl + i)));
+        __m256d const window_sqsum = _mm256_sub_pd(
+            _mm256_castsi256_pd(_mm256_or_si256(sqsums, magic_bits)), magic);
+
+        __m256d const mean = _mm256_mul_pd(window_sum, v_r_area);
+        __m256d const sqmean = _mm256_mul_pd(window_sqsum, v_r_area);
+        __m256d const variance = _mm256_sub_pd(sqmean, _mm256_mul_pd(mean, mean));
+        __m256d const deviation = _mm256_add_pd(
+            _mm256_sqrt_pd(_mm256_and_pd(variance, abs_mask)), v_half);
+        storePixels4Avx2(dst + i, clampToPixelsAvx2(deviation));
+    }
+    windowDeviationRowScalar(
+        tl + i, tr + i, bl + i, br + i,
+        sq_tl + i, sq_tr + i, sq_bl + i, sq_br + i,
+        r_area, dst + i, count - i);
+}
+
+IMAGEPROC_TARGET_AVX2
+void sauvolaThresholdRowAvx2(
+    unsigned char const* mean_line, unsigned char const* deviation_line,
+    unsigned char* dst, int const count, float const k, int const delta)
+{
+    __m256 const v_k = _mm256_set1_ps(k);
+    __m256 const v_delta = _mm256_set1_ps((float) delta);
+    __m256 const one = _mm256_set1_ps(1.0f);
+    __m256 const v_128 = _mm256_set1_ps(128.0f);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 const mean = loadPixelsAvx2(mean_line + i);
+        __m256 const deviation = loadPixelsAvx2(deviation_line + i);
+
+        __m256 const shift = _mm256_add_ps(deviation, v_delta);
+        __m256 const part = _mm256_mul_ps(v_k, _mm256_sub_ps(one, _mm256_div_ps(shift, v_128)));
+        __m256 const threshold = _mm256_mul_ps(mean, _mm256_sub_ps(one, part));
+        storePixelsAvx2(dst + i, clampToPixelsAvx2(threshold));
+    }
+    sauvolaThresholdRowScalar(mean_line + i, deviation_line + i, dst + i, count - i, k, delta);
+}
+
+IMAGEPROC_TARGET_AVX2
+void wolfThresholdRowAvx2(
+    unsigned char const* mean_line, unsigned char const* deviation_line,
+    unsigned char* dst, int const count, float const k, int const delta,
+    float const gray_min, float const deviation_max)
+{
+    if (!(deviation_max > 0.0f))
+    {
+        wolfThresholdRowScalar(mean_line, deviation_line, dst, count, k, delta, gray_min, deviation_max);
+        return;
+    }
+
+    __m256 const v_k = _mm256_set1_ps(k);
+    __m256 const v_gray_min = _mm256_set1_ps(gray_min);
+    __m256 const v_deviation_max = _mm256_set1_ps(deviation_max);
+    __m256 const v_frac_delta = _mm256_set1_ps((float) delta / 128.0f);
+    __m256 const one = _mm256_set1_ps(1.0f);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 const mean = loadPixelsAvx2(mean_line + i);
+        __m256 const deviation = loadPixelsAvx2(deviation_line + i);
+
+        __m256 const base = _mm256_sub_ps(mean, v_gray_min);
+        __m256 const frac = _mm256_div_ps(deviation, v_deviation_max);
+        __m256 const part = _mm256_sub_ps(one, _mm256_add_ps(frac, v_frac_delta));
+        __m256 const threshold = _mm256_add_ps(
+            _mm256_mul_ps(base, _mm256_sub_ps(one, _mm256_mul_ps(v_k, part))), v_gray_min);
+        storePixelsAvx2(dst + i, clampToPixelsAvx2(threshold));
+    }
+    wolfThresholdRowScalar(
+        mean_line + i, deviation_line + i, dst + i, count - i, k, delta, gray_min, deviation_max);
+}
+
+IMAGEPROC_TARGET_AVX2
+void wienerRowAvx2(
+    unsigned char* src_line, unsigned char const* mean_line,
+    unsigned char const* deviation_line, int const count, float const noise_variance)
+{
+    __m256 const v_noise_variance = _mm256_set1_ps(noise_variance);
+    __m256 const v_half = _mm256_set1_ps(0.5f);
+    __m256 const zero = _mm256_setzero_ps();
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 const mean = loadPixelsAvx2(mean_line + i);
+        __m256 const deviation = loadPixelsAvx2(deviation_line + i);
+        __m256 const variance = _mm256_mul_ps(deviation, deviation);
+        __m256 const src_pixel = loadPixelsAvx2(src_line + i);
+
+        __m256 const delta_pixel = _mm256_sub_ps(src_pixel, mean);
+        __m256 const delta_variance = _mm256_sub_ps(variance, v_noise_variance);
+        __m256 const correction = _mm256_div_ps(_mm256_mul_ps(delta_pixel, delta_variance), variance);
+        // Lanes without a correction may hold NaNs, which the mask turns into zeros.
+        __m256 const apply = _mm256_cmp_ps(delta_variance, zero, _CMP_GT_OQ);
+        __m256 const dst_pixel = _mm256_add_ps(mean, _mm256_and_ps(correction, apply));
+
+        __m256i val = _mm256_cvttps_epi32(_mm256_add_ps(dst_pixel, v_half));
+        val = _mm256_min_epi32(_mm256_max_epi32(val, _mm256_setzero_si256()), _mm256_set1_epi32(255));
+        storePixelsAvx2(src_line + i, val);
+    }
+    wienerRowScalar(src_line + i, mean_line + i, deviation_line + i, count - i, noise_variance);
+}
+
+IMAGEPROC_TARGET_AVX2
+void rgbToYCbCrRowAvx2(QRgb const* src, QRgb* dst, int const count)
+{
+    __m256i const byte_mask = _mm256_set1_epi32(0xff);
+    __m256i const max_val = _mm256_set1_epi32(255);
+    __m256i const zero = _mm256_setzero_si256();
+    __m256i const alpha = _mm256_set1_epi32((int) 0xff000000u);
+    __m256 const half = _mm256_set1_ps(0.5f);
+    __m256 const v_128 = _mm256_set1_ps(128.0f);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i const pixels = _mm256_loadu_si256((__m256i const*) (src + i));
+        __m256 const r = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), byte_mask));
+        __m256 const g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), byte_mask));
+        __m256 const b = _mm256_cvtepi32_ps(_mm256_and_si256(pixels, byte_mask));
+
+        __m256 const cy = _mm256_add_ps(
+            _mm256_add_ps(
+                _mm256_mul_ps(_mm256_set1_ps(0.299f), r),
+                _mm256_mul_ps(_mm256_set1_ps(0.587f), g)),
+            _mm256_mul_ps(_mm256_set1_ps(0.114f), b));
+        __m256 const cb = _mm256_add_ps(
+            _mm256_sub_ps(
+                _mm256_sub_ps(v_128, _mm256_mul_ps(_mm256_set1_ps(0.168736f), r)),
+                _mm256_mul_ps(_mm256_set1_ps(0.331264f), g)),
+            _mm256_mul_ps(half, b));
+        __m256 const cr = _mm256_sub_ps(
+            _mm256_sub_ps(
+                _mm256_add_ps(v_128, _mm256_mul_ps(half, r)),
+                _mm256_mul_ps(_mm256_set1_ps(0.418688f), g)),
+            _mm256_mul_ps(_mm256_set1_ps(0.081312f), b));
+
+        __m256i const out_r = _mm256_min_epi32(_mm256_max_epi32(
+            _mm256_cvttps_epi32(_mm256_add_ps(half, cb)), zero), max_val);
+        __m256i const out_g = _mm256_min_epi32(_mm256_max_epi32(
+            _mm256_cvttps_epi32(_mm256_add_ps(half, cr)), zero), max_val);
+        __m256i const out_b = _mm256_min_epi32(_mm256_max_epi32(
+            _mm256_cvttps_epi32(_mm256_add_ps(half, cy)), zero), max_val);
+
+        __m256i out = _mm256_or_si256(alpha, _mm256_slli_epi32(out_r, 16));
+        out = _mm256_or_si256(out, _mm256_slli_epi32(out_g, 8));
+        out = _mm256_or_si256(out, out_b);
+        _mm256_storeu_si256((__m256i*) (dst + i), out);
+    }
+    rgbToYCbCrRowScalar(src + i, dst + i, count - i);
+}
+
+#endif // IMAGEPROC_KERNELS_X86
+
+#if defined(IMAGEPROC_KERNELS_NEON)
+
+uint64_t sumPixelsNeon(
+    unsigned char const* data, int const width, int const height, int const stride)
+{
+    uint64x2_t acc = vdupq_n_u64(0);
+    uint64_t sum = 0;
+    for (int y = 0; y < height; y++)
+    {
+        unsigned char const* const line = data + (size_t) y * stride;
+        int x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            uint16x8_t const pairs = vpaddlq_u8(vld1q_u8(line + x));
+            acc = vpadalq_u32(acc, vpaddlq_u16(pairs));
+        }
+        for (; x < width; x++)
+        {
+            sum += line[x];
+        }
+    }
+    return sum + vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1);
+}
+
+#endif // IMAGEPROC_KERNELS_NEON
+
+} // anonymous namespace
+
+SimdLevel detectedSimdLevel()
+{
+    static SimdLevel const level = detectSimdLevel();
+    return level;
+}
+
+SimdLevel simdLevel()
+{
+    int level = g_simdLevel.loadAcquire();
+    if (level < 0)
+    {
+        level = detectedSimdLevel();
+        g_simdLevel.storeRelease(level);
+    }
+    return SimdLevel(level);
+}
+
+void setSimdLevel(SimdLevel const level)
+{
+    SimdLevel const detected = detectedSimdLevel();
+    bool const supported = (level == SIMD_NONE) || (level == detected)
+                           || ((level == SIMD_SSE2) && (detected == SIMD_AVX2));
+    g_simdLevel.storeRelease(supported ? level : detected);
+}
+
+uint64_t sumPixels(
+    unsigned char const* data, int const width, int const height, int const stride)
+{
+    switch (simdLevel())
+    {
+#if defined(IMAGEPROC_KERNELS_X86)
+    case SIMD_AVX2:
+        return sumPixelsAvx2(data, width, height, stride);
+    case SIMD_SSE2:
+        return sumPixelsSse2(data, width, height, stride);
+#endif
+#if defined(IMAGEPROC_KERNELS_NEON)
+    case SIMD_NEON:
+        return sumPixelsNeon(data, width, height, stride);
+#endif
+    default:
+        return sumPixelsScalar(data, width, height, stride);
+    }
+}
+
+void windowMeanRow(
+    uint32_t const* tl, uint32_t const* tr,
+    uint32_t const* bl, uint32_t const* br,
+    double const r_area, unsigned char* dst, int const count)
+{
+#if defined(IMAGEPROC_KERNELS_X86)
+    if (simdLevel() == SIMD_AVX2)
+    {
+        windowMeanRowAvx2(tl, tr, bl, br, r_area, dst, count);
+        return;
+    }
+#endif
+    windowMeanRowScalar(tl, tr, bl, br, r_area, dst, count);
+}
+
+void windowDeviationRow(
+    uint32_t const* tl, uint32_t const* tr,
+    uint32_t const* bl, uint32_t const* br,
+    uint64_t const* sq_tl, uint64_t const* sq_tr,
+    uint64_t const* sq_bl, uint64_t const* sq_br,
+    double const r_area, unsigned char* dst, int const count)
+{
+#if defined(IMAGEPROC_KERNELS_X86)
+    if (simdLevel() == SIMD_AVX2)
+    {
+        windowDeviationRowAvx2(tl, tr, bl, br, sq_tl, sq_tr, sq_bl, sq_br, r_area, dst, count);
+        return;
+    }
+#endif
+    windowDeviationRowScalar(tl, tr, bl, br, sq_tl, sq_tr, sq_bl, sq_br, r_area, dst, count);
+}
+
+void sauvolaThresholdRow(
+    unsigned char const* mean, unsigned char const* deviation,
+    unsigned char* dst, int const count, float const k, int const delta)
+{
+#if defined(IMAGEPROC_KERNELS_X86)
+    if (simdLevel() == SIMD_AVX2)
+    {
+        sauvolaThresholdRowAvx2(mean, deviation, dst, count, k, delta);
+        return;
+    }
+#endif
+    sauvolaThresholdRowScalar(mean, deviation, dst, count, k, delta);
+}
+
+void wolfThresholdRow(
+    unsigned char const* mean, unsigned char const* deviation,
+    unsigned char* dst, int const count, float const k, int const delta,
+    float const gray_min, float const deviation_max)
+{
+#if defined(IMAGEPROC_KERNELS_X86)
+    if (simdLevel() == SIMD_AVX2)
+    {
+        wolfThresholdRowAvx2(mean, deviation, dst, count, k, delta, gray_min, deviation_max);
+        return;
+    }
+#endif
+    wolfThresholdRowScalar(mean, deviation, dst, count, k, delta, gray_min, deviation_max);
+}
+
+void wienerRow(
+    unsigned char* src, unsigned char const* mean,
+    unsigned char const* deviation, int const count, float const noise_variance)
+{
+#if defined(IMAGEPROC_KERNELS_X86)
+    if (simdLevel() == SIMD_AVX2)
+    {
+        wienerRowAvx2(src, mean, deviation, count, noise_variance);
+        return;
+    }
+#endif
+    wienerRowScalar(src, mean, deviation, count, noise_variance);
+}
+
+void rgbToYCbCrRow(QRgb const* src, QRgb* dst, int const count)
+{
+#if defined(IMAGEPROC_KERNELS_X86)
+    if (simdLevel() == SIMD_AVX2)
+    {
+        rgbToYCbCrRowAvx2(src, dst, count);
+        return;
+    }
+#endif
+    rgbToYCbCrRowScalar(src, dst, count);
+}
+
+} // namespace kernels
+
+} // namespace imageproc
@@ -0,0 +1,144 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_PIXELKERNELS_H_
+#define IMAGEPROC_PIXELKERNELS_H_
+
+#include "imageproc_config.h"
+#include <QRgb>
+#include <stdint.h>
+
+namespace imageproc
+{
+
+/**
+ * \brief Per-pixel loops with vectorized implementations selected at run time.
+ *
+ * Every kernel has a scalar implementation, which is the reference, and
+ * some have vectorized ones that produce exactly the same output.  Each
+ * kernel lists the instruction sets it is vectorized for.  Which version
+ * runs depends on simdLevel(), falling back to the scalar one for the
+ * levels a kernel has no implementation for.
+ */
+namespace kernels
+{
+
+enum SimdLevel
+{
+    SIMD_NONE,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_NEON
+};
+
+/**
+ * \brief The best instruction set supported by both the build and the CPU.
+ */
+IMAGEPROC_EXPORT SimdLevel detectedSimdLevel();
+
+/**
+ * \brief The instruction set the kernels currently dispatch to.
+ */
+IMAGEPROC_EXPORT SimdLevel simdLevel();
+
+/**
+ * \brief Restricts the instruction set the kernels may use.
+ *
+ * Meant for tests and for working around broken hardware.
+ * A level the CPU doesn't support is replaced with detectedSimdLevel().
+ */
+IMAGEPROC_EXPORT void setSimdLevel(SimdLevel level);
+
+/**
+ * \brief The sum of all pixels of an 8-bit image.
+ *
+ * Vectorized for SSE2, AVX2 and NEON.
+ */
+IMAGEPROC_EXPORT uint64_t sumPixels(
+    unsigned char const* data, int width, int height, int stride);
+
+/**
+ * \brief Window means from an integral image, one row of them.
+ *
+ * The window sum of pixel i is br[i] - tr[i] + tl[i] - bl[i], where the
+ * four pointers address the integral image at the bottom-right, top-right,
+ * top-left and bottom-left corners of the window of pixel 0.  Each sum is
+ * multiplied by \p r_area, rounded and clamped to [0, 255].
+ *
+ * Vectorized for AVX2.
+ */
+IMAGEPROC_EXPORT void windowMeanRow(
+    uint32_t const* tl, uint32_t const* tr,
+    uint32_t const* bl, uint32_t const* br,
+    double r_area, unsigned char* dst, int count);
+
+/**
+ * \brief Window standard deviations from integral images, one row of them.
+ *
+ * The corner pointers are as in windowMeanRow(), the \p sq ones being
+ * those of the integral image of squares.
+ *
+ * Vectorized for AVX2.
+ */
+IMAGEPROC_EXPORT void windowDeviationRow(
+    uint32_t const* tl, uint32_t const* tr,
+    uint32_t const* bl, uint32_t const* br,
+    uint64_t const* sq_tl, uint64_t const* sq_tr,
+    uint64_t const* sq_bl, uint64_t const* sq_br,
+    double r_area, unsigned char* dst, int count);
+
+/**
+ * \brief One row of graySauvolaMap() thresholds.  \p dst may be \p mean.
+ *
+ * Vectorized for AVX2.
+ */
+IMAGEPROC_EXPORT void sauvolaThresholdRow(
+    unsigned char const* mean, unsigned char const* deviation,
+    unsigned char* dst, int count, float k, int delta);
+
+/**
+ * \brief One row of grayWolfMap() thresholds.  \p dst may be \p mean.
+ *
+ * Vectorized for AVX2.
+ */
+IMAGEPROC_EXPORT void wolfThresholdRow(
+    unsigned char const* mean, unsigned char const* deviation,
+    unsigned char* dst, int count, float k, int delta,
+    float gray_min, float deviation_max);
+
+/**
+ * \brief One row of grayWienerInPlace() output, written over \p src.
+ *
+ * Vectorized for AVX2.
+ */
+IMAGEPROC_EXPORT void wienerRow(
+    unsigned char* src, unsigned char const* mean,
+    unsigned char const* deviation, int count, float noise_variance);
+
+/**
+ * \brief One row of imageYCbCr() output: Cb, Cr, Y in place of R, G, B.
+ *
+ * Vectorized for AVX2.
+ */
+IMAGEPROC_EXPORT void rgbToYCbCrRow(QRgb const* src, QRgb* dst, int count);
+
+} // namespace kernels
+
+} // namespace imageproc
+
+#endif
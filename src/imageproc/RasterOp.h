@@ -26,6 +26,7 @@
 #include <QSize>
 #include <boost/cstdint.hpp>
 #include <stdexcept>
+#include <string.h>
 #include <assert.h>
 
 namespace imageproc
@@ -43,6 +44,8 @@ namespace imageproc
  *
  * The template argument is the operation to perform.  This is generally
  * a combination of several Rop* class templates, such as RopXor\<RopSrc, RopDst\>.
+ * Raster operations are purely bitwise and have their transform() templated
+ * on the word type, which lets whole spans be processed 64 bits at a time.
  */
 template<typename Rop>
 void rasterOp(BinaryImage& dst, QRect const& dr,
@@ -68,7 +71,8 @@ void rasterOp(BinaryImage& dst, BinaryImage const& src);
 class RopSrc
 {
 public:
-    static uint32_t transform(uint32_t src, uint32_t /*dst*/)
+    template<typename Word>
+    static Word transform(Word src, Word /*dst*/)
     {
         return src;
     }
@@ -81,7 +85,8 @@ public:
 class RopDst
 {
 public:
-    static uint32_t transform(uint32_t /*src*/, uint32_t dst)
+    template<typename Word>
+    static Word transform(Word /*src*/, Word dst)
     {
         return dst;
     }
@@ -95,9 +100,10 @@ template<typename Arg>
 class RopNot
 {
 public:
-    static uint32_t transform(uint32_t src, uint32_t dst)
+    template<typename Word>
+    static Word transform(Word src, Word dst)
     {
-        return ~Arg::transform(src, dst);
+        return Word(~Arg::transform(src, dst));
     }
 };
 
@@ -109,7 +115,8 @@ template<typename Arg1, typename Arg2>
 class RopAnd
 {
 public:
-    static uint32_t transform(uint32_t src, uint32_t dst)
+    template<typename Word>
+    static Word transform(Word src, Word dst)
     {
         return Arg1::transform(src, dst) & Arg2::transform(src, dst);
     }
@@ -123,7 +130,8 @@ template<typename Arg1, typename Arg2>
 class RopOr
 {
 public:
-    static uint32_t transform(uint32_t src, uint32_t dst)
+    template<typename Word>
+    static Word transform(Word src, Word dst)
     {
         return Arg1::transform(src, dst) | Arg2::transform(src, dst);
     }
@@ -137,7 +145,8 @@ template<typename Arg1, typename Arg2>
 class RopXor
 {
 public:
-    static uint32_t transform(uint32_t src, uint32_t dst)
+    template<typename Word>
+    static Word transform(Word src, Word dst)
     {
         return Arg1::transform(src, dst) ^ Arg2::transform(src, dst);
     }
@@ -151,10 +160,11 @@ template<typename Arg1, typename Arg2>
 class RopSubtract
 {
 public:
-    static uint32_t transform(uint32_t src, uint32_t dst)
+    template<typename Word>
+    static Word transform(Word src, Word dst)
     {
-        uint32_t lhs = Arg1::transform(src, dst);
-        uint32_t rhs = Arg2::transform(src, dst);
+        Word lhs = Arg1::transform(src, dst);
+        Word rhs = Arg2::transform(src, dst);
         return lhs & (lhs ^ rhs);
     }
 };
@@ -167,10 +177,11 @@ template<typename Arg1, typename Arg2>
 class RopSubtractWhite
 {
 public:
-    static uint32_t transform(uint32_t src, uint32_t dst)
+    template<typename Word>
+    static Word transform(Word src, Word dst)
     {
-        uint32_t lhs = Arg1::transform(src, dst);
-        uint32_t rhs = Arg2::transform(src, dst);
+        Word lhs = Arg1::transform(src, dst);
+        Word rhs = Arg2::transform(src, dst);
         return lhs | ~(lhs ^ rhs);
     }
 };
@@ -218,6 +229,62 @@ public:
 namespace detail
 {
 
+/**
+ * dst[i] = Rop(src[i], dst[i]) for i in [0, count), left to right.
+ * Pairs of words are combined into 64-bit ones, which is fine as
+ * raster operations don't care about the bit order.
+ */
+template<typename Rop>
+void rasterOpWords(uint32_t* dst, uint32_t const* src, int const count)
+{
+    int i = 0;
+    for (; i + 1 < count; i += 2)
+    {
+        uint64_t src_pair;
+        uint64_t dst_pair;
+        memcpy(&src_pair, src + i, sizeof(src_pair));
+        memcpy(&dst_pair, dst + i, sizeof(dst_pair));
+        dst_pair = Rop::transform(src_pair, dst_pair);
+        memcpy(dst + i, &dst_pair, sizeof(dst_pair));
+    }
+    if (i < count)
+    {
+        dst[i] = Rop::transform(src[i], dst[i]);
+    }
+}
+
+/**
+ * Same as rasterOpWords(), but dst[i] is combined with the source bits
+ * starting at bit \p src_word1_shift of src[i], that is with
+ * (src[i] << src_word1_shift) | (src[i + 1] >> src_word2_shift).
+ * Reads src[count] and never writes a dst word before reading
+ * the source words it overlaps with when going left to right.
+ */
+template<typename Rop>
+void shiftedRasterOpWords(
+    uint32_t* dst, uint32_t const* src, int const count,
+    int const src_word1_shift, int const src_word2_shift)
+{
+    int i = 0;
+    for (; i + 1 < count; i += 2)
+    {
+        uint64_t const src_pair = (uint64_t(src[i]) << 32) | src[i + 1];
+        uint64_t const dst_pair = (uint64_t(dst[i]) << 32) | dst[i + 1];
+        uint64_t const shifted = (src_pair << src_word1_shift)
+                                 | (uint64_t(src[i + 2]) >> src_word2_shift);
+        uint64_t const res = Rop::transform(shifted, dst_pair);
+        dst[i] = static_cast<uint32_t>(res >> 32);
+        dst[i + 1] = static_cast<uint32_t>(res);
+    }
+    if (i < count)
+    {
+        dst[i] = Rop::transform(
+                     (src[i] << src_word1_shift) | (src[i + 1] >> src_word2_shift),
+                     dst[i]
+                 );
+    }
+}
+
 template<typename Rop>
 void rasterOpInDirection(
     BinaryImage& dst, QRect const& dr,
@@ -318,6 +385,12 @@ void rasterOpInDirection(
                 uint32_t new_dst_word = Rop::transform(src_word, dst_word);
                 dst_span[widx] = (dst_word & ~first_dst_mask) | (new_dst_word & first_dst_mask);
 
+                if (dx == 1)
+                {
+                    rasterOpWords<Rop>(dst_span + 1, src_span + 1, last_dst_word - 1);
+                    widx = last_dst_word - 1;
+                }
+
                 while ((widx += dx) != last_dst_word)
                 {
                     src_word = src_span[widx];
@@ -390,6 +463,21 @@ void rasterOpInDirection(
             uint32_t new_dst_word = Rop::transform(src_word, dst_word);
             new_dst_word = (dst_word & ~first_dst_mask) | (new_dst_word & first_dst_mask);
 
+            if (dx == 1 && last_dst_word > 2)
+            {
+                // Going left to right, a dst word never overlaps with
+                // the source words still to be read, so the middle words
+                // except the last one are written in place.  The loop below
+                // then rewrites word last_dst_word - 2 with the same value.
+                dst_span[widx] = new_dst_word;
+                shiftedRasterOpWords<Rop>(
+                    dst_span + 1, src_span + 1, last_dst_word - 2,
+                    src_word1_shift, src_word2_shift
+                );
+                widx = last_dst_word - 2;
+                new_dst_word = dst_span[widx];
+            }
+
             while ((widx += dx) != last_dst_word)
             {
                 uint32_t const src_word1 = src_span[widx];
@@ -28,99 +28,107 @@ namespace
 {
 
 /**
- * This lookup table is filled like this:
- * \code
- * for (unsigned i = 0; i < 256; i += 2) {
- *    unsigned out =
- *        ((i & (1 << 1)) >> 1) |  // bit 1 becomes bit 0
- *        ((i & (1 << 3)) >> 2) |  // bit 3 becomes bit 1
- *        ((i & (1 << 5)) >> 3) |  // bit 5 becomes bit 2
- *        ((i & (1 << 7)) >> 4);   // bit 7 becomes bit 3
- *    compressBitsLut[i >> 1] = static_cast<uint8_t>(out);
- * }
- * \endcode
- * We take every other byte because bit 0 doesn't matter here.
+ * Takes a pair of adjacent words as a 64-bit one, throws away every
+ * other bit starting with bit 0 and packs the remaining 32 bits
+ * into a word.  The upper half of the result comes from the first word
+ * of the pair, the lower half from the second one.
+ *
+ * This is the usual bit unshuffle: each step halves the number of
+ * gaps between the bits we keep, so a pair of source words is handled
+ * with a handful of shifts and masks instead of table lookups.
  */
-static uint8_t const compressBitsLut[128] =
+inline uint32_t compressBits(uint64_t bits)
 {
-    0x0, 0x1, 0x0, 0x1, 0x2, 0x3, 0x2, 0x3,
-    0x0, 0x1, 0x0, 0x1, 0x2, 0x3, 0x2, 0x3,
-    0x4, 0x5, 0x4, 0x5, 0x6, 0x7, 0x6, 0x7,
-    0x4, 0x5, 0x4, 0x5, 0x6, 0x7, 0x6, 0x7,
-    0x0, 0x1, 0x0, 0x1, 0x2, 0x3, 0x2, 0x3,
-    0x0, 0x1, 0x0, 0x1, 0x2, 0x3, 0x2, 0x3,
-    0x4, 0x5, 0x4, 0x5, 0x6, 0x7, 0x6, 0x7,
-    0x4, 0x5, 0x4, 0x5, 0x6, 0x7, 0x6, 0x7,
-    0x8, 0x9, 0x8, 0x9, 0xa, 0xb, 0xa, 0xb,
-    0x8, 0x9, 0x8, 0x9, 0xa, 0xb, 0xa, 0xb,
-    0xc, 0xd, 0xc, 0xd, 0xe, 0xf, 0xe, 0xf,
-    0xc, 0xd, 0xc, 0xd, 0xe, 0xf, 0xe, 0xf,
-    0x8, 0x9, 0x8, 0x9, 0xa, 0xb, 0xa, 0xb,
-    0x8, 0x9, 0x8, 0x9, 0xa, 0xb, 0xa, 0xb,
-    0xc, 0xd, 0xc, 0xd, 0xe, 0xf, 0xe, 0xf,
-    0xc, 0xd, 0xc, 0xd, 0xe, 0xf, 0xe, 0xf
-};
-
-/**
- * Throw away every other bit starting with bit 0 and
- * pack the remaining bits into the upper half of a word.
- */
-inline uint32_t compressBitsUpperHalf(uint32_t const bits)
-{
-    uint32_t r;
-    r = compressBitsLut[(bits >> 25) /*& 0x7F*/] << 28;
-    r |= compressBitsLut[(bits >> 17) & 0x7F] << 24;
-    r |= compressBitsLut[(bits >> 9) & 0x7F] << 20;
-    r |= compressBitsLut[(bits >> 1) & 0x7F] << 16;
-    return r;
+    bits = (bits >> 1) & UINT64_C(0x5555555555555555);
+    bits = (bits | (bits >> 1)) & UINT64_C(0x3333333333333333);
+    bits = (bits | (bits >> 2)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+    bits = (bits | (bits >> 4)) & UINT64_C(0x00FF00FF00FF00FF);
+    bits = (bits | (bits >> 8)) & UINT64_C(0x0000FFFF0000FFFF);
+    bits = (bits | (bits >> 16)) & UINT64_C(0x00000000FFFFFFFF);
+    return static_cast<uint32_t>(bits);
 }
 
 /**
- * Throw away every other bit starting with bit 0 and
- * pack the remaining bits into the lower half of a word.
+ * Word pairs are formed so that bit 0 of the first word is followed
+ * by bit 31 of the second one.  The thresholds below shift left by one,
+ * moving the latter into the former, which is fine as bit 0 gets thrown
+ * away by compressBits() anyway.
  */
-inline uint32_t compressBitsLowerHalf(uint32_t const bits)
+inline uint64_t wordPair(uint32_t const* words)
 {
-    uint32_t r;
-    r = compressBitsLut[(bits >> 25) /*& 0x7F*/] << 12;
-    r |= compressBitsLut[(bits >> 17) & 0x7F] << 8;
-    r |= compressBitsLut[(bits >> 9) & 0x7F] << 4;
-    r |= compressBitsLut[(bits >> 1) & 0x7F];
-    return r;
+    return (uint64_t(words[0]) << 32) | words[1];
 }
 
-inline uint32_t threshold1(uint32_t const top, uint32_t const bottom)
+inline uint64_t threshold1(uint64_t const top, uint64_t const bottom)
 {
-    uint32_t word = top | bottom;
+    uint64_t word = top | bottom;
     word |= word << 1;
     return word;
 }
 
-inline uint32_t threshold2(uint32_t const top, uint32_t const bottom)
+inline uint64_t threshold2(uint64_t const top, uint64_t const bottom)
 {
-    uint32_t word1 = top & bottom;
+    uint64_t word1 = top & bottom;
     word1 |= word1 << 1;
-    uint32_t word2 = top | bottom;
+    uint64_t word2 = top | bottom;
     word2 &= word2 << 1;
     return word1 | word2;
 }
 
-inline uint32_t threshold3(uint32_t const top, uint32_t const bottom)
+inline uint64_t threshold3(uint64_t const top, uint64_t const bottom)
 {
-    uint32_t word1 = top | bottom;
+    uint64_t word1 = top | bottom;
     word1 &= word1 << 1;
-    uint32_t word2 = top & bottom;
+    uint64_t word2 = top & bottom;
     word2 |= word2 << 1;
     return word1 & word2;
 }
 
-inline uint32_t threshold4(uint32_t const top, uint32_t const bottom)
+inline uint64_t threshold4(uint64_t const top, uint64_t const bottom)
 {
-    uint32_t word = top & bottom;
+    uint64_t word = top & bottom;
     word &= word << 1;
     return word;
 }
 
+/**
+ * Reduces \p dst_h pairs of lines.  The bottom line of a pair is
+ * \p src_wpl words after the top one, so passing 0 makes a line
+ * act as both.
+ */
+template<uint64_t (*Threshold)(uint64_t, uint64_t)>
+void reduceLines(
+    uint32_t const* src_line, int const src_wpl,
+    uint32_t* dst_line, int const dst_wpl,
+    int const steps_per_line, int const dst_h)
+{
+    int const src_stride = src_wpl * 2;
+
+    for (int i = dst_h; i > 0; --i)
+    {
+        int j = 0;
+        for (; j + 1 < steps_per_line; j += 2)
+        {
+            uint64_t const word = Threshold(
+                                      wordPair(src_line + j),
+                                      wordPair(src_line + j + src_wpl)
+                                  );
+            dst_line[j / 2] = compressBits(word);
+        }
+        if (j < steps_per_line)
+        {
+            // An odd word at the end of the line fills the upper half only.
+            uint64_t const word = Threshold(
+                                      uint64_t(src_line[j]) << 32,
+                                      uint64_t(src_line[j + src_wpl]) << 32
+                                  );
+            dst_line[j / 2] = compressBits(word);
+        }
+        src_line += src_stride;
+        dst_line += dst_wpl;
+    }
+}
+
 } // anonymous namespace
 
 
@@ -169,79 +177,20 @@ ReduceThreshold::reduce(int const threshold)
     uint32_t const* src_line = src.data();
     uint32_t* dst_line = dst.data();
 
-    uint32_t word;
-
-    if (threshold == 1)
-    {
-        for (int i = dst_h; i > 0; --i)
-        {
-            for (int j = 0; j < steps_per_line; j += 2)
-            {
-                word = threshold1(src_line[j], src_line[j + src_wpl]);
-                dst_line[j / 2] = compressBitsUpperHalf(word);
-            }
-            for (int j = 1; j < steps_per_line; j += 2)
-            {
-                word = threshold1(src_line[j], src_line[j + src_wpl]);
-                dst_line[j / 2] |= compressBitsLowerHalf(word);
-            }
-            src_line += src_wpl * 2;
-            dst_line += dst_wpl;
-        }
-    }
-    else if (threshold == 2)
-    {
-        for (int i = dst_h; i > 0; --i)
-        {
-            for (int j = 0; j < steps_per_line; j += 2)
-            {
-                word = threshold2(src_line[j], src_line[j + src_wpl]);
-                dst_line[j / 2] = compressBitsUpperHalf(word);
-            }
-            for (int j = 1; j < steps_per_line; j += 2)
-            {
-                word = threshold2(src_line[j], src_line[j + src_wpl]);
-                dst_line[j / 2] |= compressBitsLowerHalf(word);
-            }
-            src_line += src_wpl * 2;
-            dst_line += dst_wpl;
-        }
-    }
-    else if (threshold == 3)
-    {
-        for (int i = dst_h; i > 0; --i)
-        {
-            for (int j = 0; j < steps_per_line; j += 2)
-            {
-                word = threshold3(src_line[j], src_line[j + src_wpl]);
-                dst_line[j / 2] = compressBitsUpperHalf(word);
-            }
-            for (int j = 1; j < steps_per_line; j += 2)
-            {
-                word = threshold3(src_line[j], src_line[j + src_wpl]);
-                dst_line[j / 2] |= compressBitsLowerHalf(word);
-            }
-            src_line += src_wpl * 2;
-            dst_line += dst_wpl;
-        }
-    }
-    else if (threshold == 4)
+    switch (threshold)
     {
-        for (int i = dst_h; i > 0; --i)
-        {
-            for (int j = 0; j < steps_per_line; j += 2)
-            {
-                word = threshold4(src_line[j], src_line[j + src_wpl]);
-                dst_line[j / 2] = compressBitsUpperHalf(word);
-            }
-            for (int j = 1; j < steps_per_line; j += 2)
-            {
-                word = threshold4(src_line[j], src_line[j + src_wpl]);
-                dst_line[j / 2] |= compressBitsLowerHalf(word);
-            }
-            src_line += src_wpl * 2;
-            dst_line += dst_wpl;
-        }
+    case 1:
+        reduceLines<threshold1>(src_line, src_wpl, dst_line, dst_wpl, steps_per_line, dst_h);
+        break;
+    case 2:
+        reduceLines<threshold2>(src_line, src_wpl, dst_line, dst_wpl, steps_per_line, dst_h);
+        break;
+    case 3:
+        reduceLines<threshold3>(src_line, src_wpl, dst_line, dst_wpl, steps_per_line, dst_h);
+        break;
+    case 4:
+        reduceLines<threshold4>(src_line, src_wpl, dst_line, dst_wpl, steps_per_line, dst_h);
+        break;
     }
 
     m_image = dst;
@@ -268,45 +217,18 @@ ReduceThreshold::reduceHorLine(int const threshold)
     assert(steps_per_line <= src.wordsPerLine());
     assert(steps_per_line / 2 <= dst.wordsPerLine());
 
-    uint32_t word;
-
+    // The line is treated as if it was duplicated vertically.
     switch (threshold)
     {
     case 1:
     case 2:
-    {
-        for (int j = 0; j < steps_per_line; j += 2)
-        {
-            word = src_line[j];
-            word |= word << 1;
-            dst_line[j / 2] = compressBitsUpperHalf(word);
-        }
-        for (int j = 1; j < steps_per_line; j += 2)
-        {
-            word = src_line[j];
-            word |= word << 1;
-            dst_line[j / 2] |= compressBitsLowerHalf(word);
-        }
+        reduceLines<threshold1>(src_line, 0, dst_line, 0, steps_per_line, 1);
         break;
-    }
     case 3:
     case 4:
-    {
-        for (int j = 0; j < steps_per_line; j += 2)
-        {
-            word = src_line[j];
-            word &= word << 1;
-            dst_line[j / 2] = compressBitsUpperHalf(word);
-        }
-        for (int j = 1; j < steps_per_line; j += 2)
-        {
-            word = src_line[j];
-            word &= word << 1;
-            dst_line[j / 2] |= compressBitsLowerHalf(word);
-        }
+        reduceLines<threshold4>(src_line, 0, dst_line, 0, steps_per_line, 1);
         break;
     }
-    }
 
     m_image = dst;
 }
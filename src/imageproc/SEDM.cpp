@@ -25,6 +25,7 @@
 #include "Morphology.h"
 #include "SeedFill.h"
 #include "RasterOp.h"
+#include "ParallelFor.h"
 #include <algorithm>
 #include <string.h>
 #include <math.h>
@@ -33,6 +34,21 @@
 namespace imageproc
 {
 
+namespace
+{
+
+/**
+ * The number of columns processColumns() processes at once.
+ */
+int const COLUMN_BAND = 64;
+
+/**
+ * The number of rows per parallelFor() chunk in processRows().
+ */
+int const ROW_BAND = 32;
+
+} // anonymous namespace
+
 // Note that -1 is an implementation detail.
 // It exists to make sure INF_DIST + 1 doesn't overflow.
 uint32_t const SEDM::INF_DIST = ~uint32_t(0) - 1;
@@ -255,43 +271,56 @@ SEDM::processColumns()
 {
     int const width = m_size.width() + 2;
     int const height = m_size.height() + 2;
+    uint32_t* const data = &m_data[0];
 
-    uint32_t* p_sqd = &m_data[0];
-    for (int x = 0; x < width; ++x, ++p_sqd)
+    // Columns are independent.  We process a band of them at once,
+    // going line by line, which is a lot kinder to the cache than
+    // walking down each column.
+    parallelFor(0, width, COLUMN_BAND, [=](int const x_begin, int const x_end)
     {
+        int const band_width = x_end - x_begin;
+
         // (d + 1)^2 = d^2 + 2d + 1
-        uint32_t b = 1; // 2d + 1 in the above formula.
+        std::vector<uint32_t> b(band_width, 1); // 2d + 1 in the above formula.
+
+        uint32_t* p_sqd = data + x_begin;
         for (int todo = height - 1; todo > 0; --todo)
         {
-            uint32_t const sqd = *p_sqd + b;
-            p_sqd += width;
-            if (*p_sqd > sqd)
-            {
-                *p_sqd = sqd;
-                b += 2;
-            }
-            else
+            for (int i = 0; i < band_width; ++i)
             {
-                b = 1;
+                uint32_t const sqd = p_sqd[i] + b[i];
+                if (p_sqd[i + width] > sqd)
+                {
+                    p_sqd[i + width] = sqd;
+                    b[i] += 2;
+                }
+                else
+                {
+                    b[i] = 1;
+                }
             }
+            p_sqd += width;
         }
 
-        b = 1;
+        std::fill(b.begin(), b.end(), 1);
         for (int todo = height - 1; todo > 0; --todo)
         {
-            uint32_t const sqd = *p_sqd + b;
-            p_sqd -= width;
-            if (*p_sqd > sqd)
-            {
-                *p_sqd = sqd;
-                b += 2;
-            }
-            else
+            for (int i = 0; i < band_width; ++i)
             {
-                b = 1;
+                uint32_t const sqd = p_sqd[i] + b[i];
+                if (p_sqd[i - width] > sqd)
+                {
+                    p_sqd[i - width] = sqd;
+                    b[i] += 2;
+                }
+                else
+                {
+                    b[i] = 1;
+                }
             }
+            p_sqd -= width;
         }
-    }
+    });
 }
 
 void
@@ -299,48 +328,60 @@ SEDM::processColumns(ConnectivityMap& cmap)
 {
     int const width = m_size.width() + 2;
     int const height = m_size.height() + 2;
+    uint32_t* const data = &m_data[0];
+    uint32_t* const labels = cmap.paddedData();
 
-    uint32_t* p_sqd = &m_data[0];
-    uint32_t* p_label = cmap.paddedData();
-    for (int x = 0; x < width; ++x, ++p_sqd, ++p_label)
+    // See processColumns() above.
+    parallelFor(0, width, COLUMN_BAND, [=](int const x_begin, int const x_end)
     {
+        int const band_width = x_end - x_begin;
+
         // (d + 1)^2 = d^2 + 2d + 1
-        uint32_t b = 1; // 2d + 1 in the above formula.
+        std::vector<uint32_t> b(band_width, 1); // 2d + 1 in the above formula.
+
+        uint32_t* p_sqd = data + x_begin;
+        uint32_t* p_label = labels + x_begin;
         for (int todo = height - 1; todo > 0; --todo)
         {
-            uint32_t const sqd = *p_sqd + b;
-            p_sqd += width;
-            p_label += width;
-            if (sqd < *p_sqd)
-            {
-                *p_sqd = sqd;
-                *p_label = p_label[-width];
-                b += 2;
-            }
-            else
+            for (int i = 0; i < band_width; ++i)
             {
-                b = 1;
+                uint32_t const sqd = p_sqd[i] + b[i];
+                if (sqd < p_sqd[i + width])
+                {
+                    p_sqd[i + width] = sqd;
+                    p_label[i + width] = p_label[i];
+                    b[i] += 2;
+                }
+                else
+                {
+                    b[i] = 1;
+                }
             }
+            p_sqd += width;
+            p_label += width;
         }
 
-        b = 1;
+        std::fill(b.begin(), b.end(), 1);
         for (int todo = height - 1; todo > 0; --todo)
         {
-            uint32_t const sqd = *p_sqd + b;
-            p_sqd -= width;
-            p_label -= width;
-            if (sqd < *p_sqd)
-            {
-                *p_sqd = sqd;
-                *p_label = p_label[width];
-                b += 2;
-            }
-            else
+            for (int i = 0; i < band_width; ++i)
             {
-                b = 1;
+                uint32_t const sqd = p_sqd[i] + b[i];
+                if (sqd < p_sqd[i - width])
+                {
+                    p_sqd[i - width] = sqd;
+                    p_label[i - width] = p_label[i];
+                    b[i] += 2;
+                }
+                else
+                {
+                    b[i] = 1;
+                }
             }
+            p_sqd -= width;
+            p_label -= width;
         }
-    }
+    });
 }
 
 void
@@ -348,60 +389,65 @@ SEDM::processRows()
 {
     int const width = m_size.width() + 2;
     int const height = m_size.height() + 2;
+    uint32_t* const data = &m_data[0];
 
-    std::vector<int> s(width, 0);
-    std::vector<int> t(width, 0);
-    std::vector<uint32_t> row_copy(width, 0);
-
-    uint32_t* line = &m_data[0];
-    for (int y = 0; y < height; ++y, line += width)
+    // Rows are independent.
+    parallelFor(0, height, ROW_BAND, [=](int const y_begin, int const y_end)
     {
-        int q = 0;
-        s[0] = 0;
-        t[0] = 0;
-        for (int x = 1; x < width; ++x)
+        std::vector<int> s(width, 0);
+        std::vector<int> t(width, 0);
+        std::vector<uint32_t> row_copy(width, 0);
+
+        uint32_t* line = data + y_begin * width;
+        for (int y = y_begin; y < y_end; ++y, line += width)
         {
-            while (q >= 0 && distSq(t[q], s[q], line[s[q]])
-                    > distSq(t[q], x, line[x]))
+            int q = 0;
+            s[0] = 0;
+            t[0] = 0;
+            for (int x = 1; x < width; ++x)
             {
-                --q;
-            }
+                while (q >= 0 && distSq(t[q], s[q], line[s[q]])
+                        > distSq(t[q], x, line[x]))
+                {
+                    --q;
+                }
 
-            if (q < 0)
-            {
-                q = 0;
-                s[0] = x;
-            }
-            else
-            {
-                int const x2 = s[q];
-                if (line[x] != INF_DIST && line[x2] != INF_DIST)
+                if (q < 0)
+                {
+                    q = 0;
+                    s[0] = x;
+                }
+                else
                 {
-                    int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
-                    w /= (x - x2) << 1;
-                    ++w;
-                    if ((unsigned)w < (unsigned)width)
+                    int const x2 = s[q];
+                    if (line[x] != INF_DIST && line[x2] != INF_DIST)
                     {
-                        ++q;
-                        s[q] = x;
-                        t[q] = w;
+                        int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
+                        w /= (x - x2) << 1;
+                        ++w;
+                        if ((unsigned)w < (unsigned)width)
+                        {
+                            ++q;
+                            s[q] = x;
+                            t[q] = w;
+                        }
                     }
                 }
             }
-        }
 
-        memcpy(&row_copy[0], line, width * sizeof(*line));
+            memcpy(&row_copy[0], line, width * sizeof(*line));
 
-        for (int x = width - 1; x >= 0; --x)
-        {
-            int const x2 = s[q];
-            line[x] = distSq(x, x2, row_copy[x2]);
-            if (x == t[q])
+            for (int x = width - 1; x >= 0; --x)
             {
-                --q;
+                int const x2 = s[q];
+                line[x] = distSq(x, x2, row_copy[x2]);
+                if (x == t[q])
+                {
+                    --q;
+                }
             }
         }
-    }
+    });
 }
 
 void
@@ -409,64 +455,70 @@ SEDM::processRows(ConnectivityMap& cmap)
 {
     int const width = m_size.width() + 2;
     int const height = m_size.height() + 2;
+    uint32_t* const data = &m_data[0];
+    uint32_t* const labels = cmap.paddedData();
 
-    std::vector<int> s(width, 0);
-    std::vector<int> t(width, 0);
-    std::vector<uint32_t> row_copy(width, 0);
-    std::vector<uint32_t> cmap_row_copy(width, 0);
-
-    uint32_t* line = &m_data[0];
-    uint32_t* cmap_line = cmap.paddedData();
-    for (int y = 0; y < height; ++y, line += width, cmap_line += width)
+    // Rows are independent.
+    parallelFor(0, height, ROW_BAND, [=](int const y_begin, int const y_end)
     {
-        int q = 0;
-        s[0] = 0;
-        t[0] = 0;
-        for (int x = 1; x < width; ++x)
+        std::vector<int> s(width, 0);
+        std::vector<int> t(width, 0);
+        std::vector<uint32_t> row_copy(width, 0);
+        std::vector<uint32_t> cmap_row_copy(width, 0);
+
+        uint32_t* line = data + y_begin * width;
+        uint32_t* cmap_line = labels + y_begin * width;
+        for (int y = y_begin; y < y_end; ++y, line += width, cmap_line += width)
         {
-            while (q >= 0 && distSq(t[q], s[q], line[s[q]])
-                    > distSq(t[q], x, line[x]))
+            int q = 0;
+            s[0] = 0;
+            t[0] = 0;
+            for (int x = 1; x < width; ++x)
             {
-                --q;
-            }
+                while (q >= 0 && distSq(t[q], s[q], line[s[q]])
+                        > distSq(t[q], x, line[x]))
+                {
+                    --q;
+                }
 
-            if (q < 0)
-            {
-                q = 0;
-                s[0] = x;
-            }
-            else
-            {
-                int const x2 = s[q];
-                if (line[x] != INF_DIST && line[x2] != INF_DIST)
+                if (q < 0)
                 {
-                    int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
-                    w /= (x - x2) << 1;
-                    ++w;
-                    if ((unsigned)w < (unsigned)width)
+                    q = 0;
+                    s[0] = x;
+                }
+                else
+                {
+                    int const x2 = s[q];
+                    if (line[x] != INF_DIST && line[x2] != INF_DIST)
                     {
-                        ++q;
-                        s[q] = x;
-                        t[q] = w;
+                        int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
+                        w /= (x - x2) << 1;
+                        ++w;
+                        if ((unsigned)w < (unsigned)width)
+                        {
+                            ++q;
+                            s[q] = x;
+                            t[q] = w;
+                        }
                     }
                 }
             }
-        }
 
-        memcpy(&row_copy[0], line, width * sizeof(*line));
-        memcpy(&cmap_row_copy[0], cmap_line, width * sizeof(*cmap_line));
+            memcpy(&row_copy[0], line, width * sizeof(*line));
+            memcpy(&cmap_row_copy[0], cmap_line, width * sizeof(*cmap_line));
 
-        for (int x = width - 1; x >= 0; --x)
-        {
-            int const x2 = s[q];
-            line[x] = distSq(x, x2, row_copy[x2]);
-            cmap_line[x] = cmap_row_copy[x2];
-            if (x == t[q])
+            for (int x = width - 1; x >= 0; --x)
             {
-                --q;
+                int const x2 = s[q];
+                line[x] = distSq(x, x2, row_copy[x2]);
+                cmap_line[x] = cmap_row_copy[x2];
+                if (x == t[q])
+                {
+                    --q;
+                }
             }
         }
-    }
+    });
 }
 
 
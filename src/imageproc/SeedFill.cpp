@@ -19,7 +19,10 @@
 #include "SeedFill.h"
 #include "SeedFillGeneric.h"
 #include "GrayImage.h"
+#include "BitOps.h"
+#include "FastQueue.h"
 #include <QSize>
+#include <QPoint>
 #include <QImage>
 #include <QDebug>
 #include <algorithm>
@@ -159,6 +162,7 @@ void seedFill8Iteration(BinaryImage& seed, BinaryImage const& mask)
     for (int y = 0; y < h; ++y)
     {
         uint32_t prev_word = 0;
+        uint32_t prev_line_prev_word = 0;
 
         // Make sure offscreen bits area 0.
         seed_line[last_word_idx] &= last_word_mask;
@@ -169,14 +173,17 @@ void seedFill8Iteration(BinaryImage& seed, BinaryImage const& mask)
         {
             uint32_t const mask = mask_line[i];
             uint32_t word = prev_line[i];
+            uint32_t const prev_line_word = word;
             word |= (word << 1) | (word >> 1);
             word |= seed_line[i];
             word |= prev_line[i + 1] >> 31;
+            word |= prev_line_prev_word << 31;
             word |= prev_word << 31;
             word &= mask;
             word = fillWordHorizontally(word, mask);
             seed_line[i] = word;
             prev_word = word;
+            prev_line_prev_word = prev_line_word;
         }
 
         // Last word.
@@ -184,6 +191,7 @@ void seedFill8Iteration(BinaryImage& seed, BinaryImage const& mask)
         uint32_t word = prev_line[i];
         word |= (word << 1) | (word >> 1);
         word |= seed_line[i];
+        word |= prev_line_prev_word << 31;
         word |= prev_word << 31;
         word &= mask;
         word = fillWordHorizontally(word, mask);
@@ -202,6 +210,7 @@ void seedFill8Iteration(BinaryImage& seed, BinaryImage const& mask)
     for (int y = h - 1; y >= 0; --y)
     {
         uint32_t prev_word = 0;
+        uint32_t prev_line_prev_word = 0;
 
         // Make sure offscreen bits area 0.
         seed_line[last_word_idx] &= last_word_mask;
@@ -212,14 +221,17 @@ void seedFill8Iteration(BinaryImage& seed, BinaryImage const& mask)
         {
             uint32_t const mask = mask_line[i];
             uint32_t word = prev_line[i];
+            uint32_t const prev_line_word = word;
             word |= (word << 1) | (word >> 1);
             word |= seed_line[i];
             word |= prev_line[i - 1] << 31;
+            word |= prev_line_prev_word >> 31;
             word |= prev_word >> 31;
             word &= mask;
             word = fillWordHorizontally(word, mask);
             seed_line[i] = word;
             prev_word = word;
+            prev_line_prev_word = prev_line_word;
         }
 
         // Last word.
@@ -227,6 +239,7 @@ void seedFill8Iteration(BinaryImage& seed, BinaryImage const& mask)
         uint32_t word = prev_line[i];
         word |= (word << 1) | (word >> 1);
         word |= seed_line[i];
+        word |= prev_line_prev_word >> 31;
         word |= prev_word >> 31;
         word &= mask;
         word = fillWordHorizontally(word, mask);
@@ -245,6 +258,152 @@ void seedFill8Iteration(BinaryImage& seed, BinaryImage const& mask)
     }
 }
 
+inline uint32_t dilateWordHorizontally(uint32_t const* line, int const i, int const last_word_idx)
+{
+    uint32_t const word = line[i];
+    uint32_t res = word | (word << 1) | (word >> 1);
+    if (i > 0)
+    {
+        res |= line[i - 1] << 31;
+    }
+    if (i < last_word_idx)
+    {
+        res |= line[i + 1] >> 31;
+    }
+    return res;
+}
+
+inline void pushPixel(uint32_t* line, int const x, int const y, FastQueue<QPoint>& queue)
+{
+    line[x >> 5] |= uint32_t(0x80000000) >> (x & 31);
+    queue.push(QPoint(x, y));
+}
+
+/**
+ * \brief Finishes a seed fill started with one seedFill4Iteration()
+ *        or seedFill8Iteration() call.
+ *
+ * After a raster and anti-raster sweep, most of the filling is done.
+ * What's left are the parts of the mask reachable only by going against
+ * the sweep directions, which typically is a small number of pixels.
+ * We collect black pixels that may spread further into a FIFO queue and
+ * propagate from there pixel by pixel.  Every pixel is queued at most once.
+ *
+ * \p seed is expected to be already clipped by \p mask.
+ */
+void seedFillQueuePhase(BinaryImage& seed, BinaryImage const& mask, Connectivity const connectivity)
+{
+    int const w = seed.width();
+    int const h = seed.height();
+
+    int const seed_wpl = seed.wordsPerLine();
+    int const mask_wpl = mask.wordsPerLine();
+    int const last_word_idx = (w - 1) >> 5;
+    uint32_t const last_word_mask = ~uint32_t(0) << (((last_word_idx + 1) << 5) - w);
+
+    uint32_t* const seed_data = seed.data();
+    uint32_t const* const mask_data = mask.data();
+
+    FastQueue<QPoint> queue;
+
+    // Find white pixels in mask that are adjacent to black pixels in seed.
+    // Such pixels are made black and queued.  Pixels becoming black here
+    // can only make us find more such pixels, which is fine.
+    uint32_t* seed_line = seed_data;
+    uint32_t const* mask_line = mask_data;
+    for (int y = 0; y < h; ++y)
+    {
+        uint32_t const* const prev_line = y > 0 ? seed_line - seed_wpl : 0;
+        uint32_t const* const next_line = y < h - 1 ? seed_line + seed_wpl : 0;
+
+        for (int i = 0; i <= last_word_idx; ++i)
+        {
+            uint32_t neighbours = dilateWordHorizontally(seed_line, i, last_word_idx);
+            if (connectivity == CONN4)
+            {
+                if (prev_line)
+                {
+                    neighbours |= prev_line[i];
+                }
+                if (next_line)
+                {
+                    neighbours |= next_line[i];
+                }
+            }
+            else
+            {
+                if (prev_line)
+                {
+                    neighbours |= dilateWordHorizontally(prev_line, i, last_word_idx);
+                }
+                if (next_line)
+                {
+                    neighbours |= dilateWordHorizontally(next_line, i, last_word_idx);
+                }
+            }
+
+            uint32_t unstable = neighbours & mask_line[i] & ~seed_line[i];
+            if (i == last_word_idx)
+            {
+                unstable &= last_word_mask;
+            }
+
+            while (unstable)
+            {
+                int const bit = countMostSignificantZeroes(unstable);
+                unstable &= ~(uint32_t(0x80000000) >> bit);
+                pushPixel(seed_line, (i << 5) + bit, y, queue);
+            }
+        }
+
+        seed_line += seed_wpl;
+        mask_line += mask_wpl;
+    }
+
+    // Propagate from queued pixels.
+    while (!queue.empty())
+    {
+        QPoint const pt(queue.front());
+        queue.pop();
+
+        int const x = pt.x();
+        int const y = pt.y();
+
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            int const ny = y + dy;
+            if (ny < 0 || ny >= h)
+            {
+                continue;
+            }
+
+            uint32_t* const nseed_line = seed_data + ny * seed_wpl;
+            uint32_t const* const nmask_line = mask_data + ny * mask_wpl;
+
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                if ((dx | dy) == 0 || (connectivity == CONN4 && dx != 0 && dy != 0))
+                {
+                    continue;
+                }
+
+                int const nx = x + dx;
+                if (nx < 0 || nx >= w)
+                {
+                    continue;
+                }
+
+                uint32_t const bit = uint32_t(0x80000000) >> (nx & 31);
+                int const idx = nx >> 5;
+                if ((nmask_line[idx] & bit) && !(nseed_line[idx] & bit))
+                {
+                    pushPixel(nseed_line, nx, ny, queue);
+                }
+            }
+        }
+    }
+}
+
 inline uint8_t lightest(uint8_t lhs, uint8_t rhs)
 {
     return lhs > rhs ? lhs : rhs;
@@ -527,6 +686,39 @@ BinaryImage seedFill(
         throw std::invalid_argument("seedFill: seed and mask have different sizes");
     }
 
+    BinaryImage img(seed);
+    if (img.isNull())
+    {
+        return img;
+    }
+
+    // A single pair of raster and anti-raster sweeps does most of the work.
+    // The rest is finished by queue-based propagation, so unlike
+    // seedFillSlow(), the number of passes doesn't depend on how winding
+    // the mask is.
+    if (connectivity == CONN4)
+    {
+        seedFill4Iteration(img, mask);
+    }
+    else
+    {
+        seedFill8Iteration(img, mask);
+    }
+
+    seedFillQueuePhase(img, mask, connectivity);
+
+    return img;
+}
+
+BinaryImage seedFillSlow(
+    BinaryImage const& seed, BinaryImage const& mask,
+    Connectivity const connectivity)
+{
+    if (seed.size() != mask.size())
+    {
+        throw std::invalid_argument("seedFillSlow: seed and mask have different sizes");
+    }
+
     BinaryImage prev;
     BinaryImage img(seed);
 
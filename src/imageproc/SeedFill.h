@@ -47,6 +47,17 @@ IMAGEPROC_EXPORT BinaryImage seedFill(
     BinaryImage const& seed, BinaryImage const& mask,
     Connectivity connectivity);
 
+/**
+ * \brief A slower but more simple implementation of seedFill().
+ *
+ * Repeats raster and anti-raster sweeps until nothing changes.
+ * This function should not be used for anything but testing the correctness
+ * of the fast and complex implementation that is seedFill().
+ */
+IMAGEPROC_EXPORT BinaryImage seedFillSlow(
+    BinaryImage const& seed, BinaryImage const& mask,
+    Connectivity connectivity);
+
 /**
  * \brief Spread darker colors from seed as long as mask allows it.
  *
@@ -0,0 +1,174 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ColorFilter.h"
+#include "BinaryImage.h"
+#include "BWColor.h"
+#include "ParallelFor.h"
+#include <QImage>
+#include <QRect>
+#include <QColor>
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <stdint.h>
+#include <stdlib.h>
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+namespace
+{
+
+/**
+ * A page with dark and saturated "ink" colors in the mask and light
+ * "paper" colors outside it.  A little noise makes for many distinct
+ * colors, some repeating, so k-means has ties to resolve.
+ */
+void randomPage(int const width, int const height, QImage& image, BinaryImage& mask)
+{
+    static QRgb const ink[] =
+    {
+        qRgb(20, 20, 20), qRgb(200, 30, 40), qRgb(30, 60, 190)
+    };
+    static QRgb const paper[] =
+    {
+        qRgb(240, 240, 235), qRgb(250, 220, 60), qRgb(128, 128, 128)
+    };
+
+    image = QImage(width, height, QImage::Format_RGB32);
+    mask = BinaryImage(width, height, WHITE);
+    for (int y = 0; y < height; ++y)
+    {
+        QRgb* const line = (QRgb*)image.scanLine(y);
+        for (int x = 0; x < width; ++x)
+        {
+            QRgb color;
+            if (rand() % 3 == 0)
+            {
+                mask.fill(QRect(x, y, 1, 1), BLACK);
+                color = ink[rand() % 3];
+            }
+            else
+            {
+                color = paper[rand() % 3];
+            }
+            int const noise = rand() % 5 - 2;
+            line[x] = qRgb(
+                          qBound(0, qRed(color) + noise, 255),
+                          qBound(0, qGreen(color) + noise, 255),
+                          qBound(0, qBlue(color) + noise, 255)
+                      );
+        }
+    }
+}
+
+bool isBlack(BinaryImage const& image, int const x, int const y)
+{
+    uint32_t const* const line = image.data() + y * image.wordsPerLine();
+    return (line[x >> 5] & (uint32_t(1) << (31 - (x & 31)))) != 0;
+}
+
+double kMeans(
+    QImage& dst, QImage const& image,
+    BinaryImage const& mask, BinaryImage const& mask_zones)
+{
+    dst = image.copy();
+    return hsvKMeansInPlace(dst, image, mask, mask_zones, 6, 0, 0, 0.0f, 0.0f, 0.5f);
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(ColorFilterTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_kmeans_doesnt_depend_on_pixels_outside_zones)
+{
+    // Moving the page by a row and a column moves every mask bit to another
+    // position within its word, while keeping the raster order of pixels.
+    // The new row and column are outside the zones and, apart from the top
+    // left pixel, which k-means may take over, are all in the mask.
+    int const width = 97;
+    int const height = 61;
+    QImage image;
+    BinaryImage mask;
+    randomPage(width, height, image, mask);
+
+    QImage moved_image(width + 1, height + 1, QImage::Format_RGB32);
+    moved_image.fill(image.pixel(0, 0));
+    BinaryImage moved_mask(width + 1, height + 1, BLACK);
+    if (!isBlack(mask, 0, 0))
+    {
+        moved_mask.fill(QRect(0, 0, 1, 1), WHITE);
+    }
+    BinaryImage moved_zones(width + 1, height + 1, WHITE);
+    moved_zones.fill(QRect(1, 1, width, height), BLACK);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            moved_image.setPixel(x + 1, y + 1, image.pixel(x, y));
+            if (!isBlack(mask, x, y))
+            {
+                moved_mask.fill(QRect(x + 1, y + 1, 1, 1), WHITE);
+            }
+        }
+    }
+
+    QImage dst;
+    double const mse = kMeans(dst, image, mask, BinaryImage(width, height, BLACK));
+    QImage moved_dst;
+    double const moved_mse = kMeans(moved_dst, moved_image, moved_mask, moved_zones);
+
+    BOOST_CHECK_EQUAL(mse, moved_mse);
+    BOOST_CHECK(dst == moved_dst.copy(1, 1, width, height));
+}
+
+BOOST_AUTO_TEST_CASE(test_kmeans_doesnt_depend_on_thread_count)
+{
+    // Tall enough for several bands of rows.
+    int const width = 83;
+    int const height = 700;
+    QImage image;
+    BinaryImage mask;
+    randomPage(width, height, image, mask);
+    BinaryImage const zones(width, height, BLACK);
+
+    int const thread_limit = parallelForThreadLimit();
+
+    setParallelForThreadLimit(1);
+    QImage serial_dst;
+    double const serial_mse = kMeans(serial_dst, image, mask, zones);
+
+    setParallelForThreadLimit(std::max(thread_limit, 4));
+    QImage parallel_dst;
+    double const parallel_mse = kMeans(parallel_dst, image, mask, zones);
+
+    setParallelForThreadLimit(thread_limit);
+
+    BOOST_CHECK_EQUAL(serial_mse, parallel_mse);
+    BOOST_CHECK(serial_dst == parallel_dst);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
@@ -29,6 +29,8 @@
 #include <QApplication>
 #include <boost/test/unit_test.hpp>
 #include <cmath>
+#include <cstdlib>
+#include <vector>
 
 using namespace Eigen;
 
@@ -102,8 +104,134 @@ static double calcRMSE(
     return std::sqrt(mse);
 }
 
+/**
+ * The recursive filter gaussBlurGeneric() applies to each row and column,
+ * applied in place to a single line, without any banding.
+ */
+static void filterLineSerially(
+    gauss_blur_impl::FilterParams const& p, std::vector<float>& line)
+{
+    int const n = line.size();
+    std::vector<float> w(3 + n + 3);
+    float* const p_w = &w[3];
+
+    p_w[-1] = p_w[-2] = p_w[-3] = line[0] * p.A;
+    for (int i = 0; i < n; ++i)
+    {
+        p_w[i] = line[i] + p.a1 * p_w[i - 1] + p.a2 * p_w[i - 2] + p.a3 * p_w[i - 3];
+    }
+
+    p_w[n] = p_w[n + 1] = p_w[n + 2] = p_w[n - 1] * p.A;
+    float const B2 = p.B * p.B;
+    for (int i = n - 1; i >= 0; --i)
+    {
+        p_w[i] = p_w[i] + p.a1 * p_w[i + 1] + p.a2 * p_w[i + 2] + p.a3 * p_w[i + 3];
+        line[i] = p_w[i] * B2;
+    }
+}
+
+/**
+ * Filters the columns and then the rows of \p grid one at a time.
+ */
+static Grid<float> gaussBlurSerially(Grid<float> const& grid, float h_sigma, float v_sigma)
+{
+    int const width = grid.width();
+    int const height = grid.height();
+    Grid<float> result(width, height, /*padding=*/0);
+
+    gauss_blur_impl::FilterParams const v_params(v_sigma);
+    std::vector<float> column(height);
+    for (int x = 0; x < width; ++x)
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            column[y] = grid(x, y);
+        }
+        filterLineSerially(v_params, column);
+        for (int y = 0; y < height; ++y)
+        {
+            result(x, y) = column[y];
+        }
+    }
+
+    gauss_blur_impl::FilterParams const h_params(h_sigma);
+    std::vector<float> row(width);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            row[x] = result(x, y);
+        }
+        filterLineSerially(h_params, row);
+        for (int x = 0; x < width; ++x)
+        {
+            result(x, y) = row[x];
+        }
+    }
+
+    return result;
+}
+
 BOOST_AUTO_TEST_SUITE(GaussBlurTestSuite);
 
+BOOST_AUTO_TEST_CASE(test_bands_match_serial_filtering)
+{
+    using gauss_blur_impl::COLUMN_BAND;
+    using gauss_blur_impl::ROW_BAND;
+
+    // Sizes on both sides of the band boundaries, as well as a few bands
+    // with a partial one at the end.
+    int const widths[] = { COLUMN_BAND - 1, COLUMN_BAND, COLUMN_BAND + 1, 3 * COLUMN_BAND + 1 };
+    int const heights[] = { ROW_BAND - 1, ROW_BAND, ROW_BAND + 1, 3 * ROW_BAND - 1 };
+
+    srand(7);
+    for (int const width : widths)
+    {
+        for (int const height : heights)
+        {
+            // Padding makes the stride differ from the width.
+            Grid<float> src(width, height, /*padding=*/1);
+            src.initPadding(0.f);
+            for (int y = 0; y < height; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    src(x, y) = float(rand() % 256);
+                }
+            }
+
+            Grid<float> const control(gaussBlurSerially(src, 3.f, 5.f));
+
+            Grid<float> banded(width, height, /*padding=*/0);
+            gaussBlurGeneric(
+                QSize(width, height), 3.f, 5.f,
+                src.data(), src.stride(), [](float val)
+            {
+                return val;
+            },
+            banded.data(), banded.stride(),
+            [](float& dst, float src)
+            {
+                dst = src;
+            }
+            );
+
+            float max_error = 0.f;
+            for (int y = 0; y < height; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    max_error = std::max(max_error, std::fabs(banded(x, y) - control(x, y)));
+                }
+            }
+            BOOST_CHECK_MESSAGE(
+                max_error < 1e-3f,
+                "size " << width << "x" << height << ": max error " << max_error
+            );
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(test_aligned_gaussian)
 {
     QSize const size(101, 101);
@@ -0,0 +1,79 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GrayFilterChain.h"
+#include "GrayImage.h"
+#include "Utils.h"
+#include <QImage>
+#include <boost/test/unit_test.hpp>
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+using namespace utils;
+
+BOOST_AUTO_TEST_SUITE(GrayFilterChainTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_banded_equals_sequential)
+{
+    // Tall enough to be split into several bands.
+    GrayImage const input(randomGrayImage(531, 2203));
+
+    GrayImage sequential(input);
+    graySqrFilterInPlace(sequential, 0.3f);
+    grayKnnDenoiserInPlace(sequential, 5, 0.5f);
+    grayDespeckleInPlace(sequential, 3, 0.7f);
+    grayCurveFilterInPlace(sequential, 0.4f);
+    grayDespeckleInPlace(sequential, 2, 0.5f);
+
+    GrayFilterChain chain;
+    chain.appendLocal(0, [](GrayImage& image)
+    {
+        graySqrFilterInPlace(image, 0.3f);
+    });
+    chain.appendLocal(5, [](GrayImage& image)
+    {
+        grayKnnDenoiserInPlace(image, 5, 0.5f);
+    });
+    chain.appendLocal(3, [](GrayImage& image)
+    {
+        grayDespeckleInPlace(image, 3, 0.7f);
+    });
+    chain.appendGlobal([](GrayImage& image)
+    {
+        grayCurveFilterInPlace(image, 0.4f);
+    });
+    chain.appendLocal(2, [](GrayImage& image)
+    {
+        grayDespeckleInPlace(image, 2, 0.5f);
+    });
+
+    GrayImage fused(input);
+    chain.process(fused);
+
+    BOOST_CHECK(fused == sequential);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
@@ -0,0 +1,129 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LocalStats.h"
+#include "GrayImage.h"
+#include "Utils.h"
+#include <QImage>
+#include <QRect>
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <math.h>
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+using namespace utils;
+
+BOOST_AUTO_TEST_SUITE(LocalStatsTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_sums)
+{
+    GrayImage const input(randomGrayImage(97, 61));
+    LocalStats stats(input);
+
+    QRect const rect(13, 7, 40, 29);
+    uint32_t sum = 0;
+    uint64_t sqsum = 0;
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+    {
+        for (int x = rect.left(); x <= rect.right(); ++x)
+        {
+            uint32_t const pixel = input.data()[y * input.stride() + x];
+            sum += pixel;
+            sqsum += pixel * pixel;
+        }
+    }
+
+    BOOST_CHECK_EQUAL(stats.sum(rect), sum);
+    BOOST_CHECK_EQUAL(stats.sqsum(rect), sqsum);
+}
+
+BOOST_AUTO_TEST_CASE(test_min_max_deviation)
+{
+    int const radius = 4;
+    GrayImage const input(randomGrayImage(83, 71));
+    int const w = input.width();
+    int const h = input.height();
+    LocalStats stats(input);
+
+    GrayImage const min_map(stats.min(radius));
+    GrayImage const max_map(stats.max(radius));
+    GrayImage const deviation_map(stats.deviation(radius));
+
+    bool ok = true;
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            int const top = std::max(0, y - radius);
+            int const bottom = std::min(h, y + radius + 1);
+            int const left = std::max(0, x - radius);
+            int const right = std::min(w, x + radius + 1);
+
+            int min_val = 255;
+            int max_val = 0;
+            double sum = 0.0;
+            double sqsum = 0.0;
+            for (int yy = top; yy < bottom; ++yy)
+            {
+                for (int xx = left; xx < right; ++xx)
+                {
+                    int const pixel = input.data()[yy * input.stride() + xx];
+                    min_val = std::min(min_val, pixel);
+                    max_val = std::max(max_val, pixel);
+                    sum += pixel;
+                    sqsum += pixel * pixel;
+                }
+            }
+            double const area = (bottom - top) * (right - left);
+            double const mean = sum / area;
+            double const deviation = sqrt(fabs(sqsum / area - mean * mean));
+
+            ok = ok && (min_map.data()[y * min_map.stride() + x] == min_val);
+            ok = ok && (max_map.data()[y * max_map.stride() + x] == max_val);
+            ok = ok && (fabs(deviation_map.data()[y * deviation_map.stride() + x] - deviation) <= 0.5 + 1e-6);
+        }
+    }
+    BOOST_CHECK(ok);
+
+    // Repeated requests are served from the cache.
+    BOOST_CHECK(stats.max(radius) == max_map);
+    BOOST_CHECK(grayMapMax(input, radius) == max_map);
+    BOOST_CHECK(grayMapDeviation(input, radius) == deviation_map);
+}
+
+BOOST_AUTO_TEST_CASE(test_shared_threshold_maps)
+{
+    GrayImage const input(randomGrayImage(120, 90));
+    LocalStats stats(input);
+
+    BOOST_CHECK(graySauvolaMap(stats, 10, 0.3f, 0) == graySauvolaMap(input, 10, 0.3f, 0));
+    BOOST_CHECK(grayNiblackMap(stats, 10, 0.2f, 0) == grayNiblackMap(input, 10, 0.2f, 0));
+    BOOST_CHECK(grayWANMap(stats, 10, 0.3f, 0) == grayWANMap(input, 10, 0.3f, 0));
+    BOOST_CHECK(stats.source() == input);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
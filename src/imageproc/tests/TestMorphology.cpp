@@ -24,7 +24,12 @@
 #include <QImage>
 #include <QSize>
 #include <QPoint>
+#include <QRect>
 #include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <stdlib.h>
 
 namespace imageproc
 {
@@ -34,6 +39,73 @@ namespace tests
 
 using namespace utils;
 
+/**
+ * Splits [min, max] into intervals no longer than \p max_len, such that
+ * their sum (in terms of adding ranges of offsets) is [min, max].
+ */
+static std::vector<std::pair<int, int>> splitRange(int const min, int const max, int const max_len)
+{
+    std::vector<std::pair<int, int>> parts;
+    int const first_len = std::min(max_len, max - min + 1);
+    parts.emplace_back(min, min + first_len - 1);
+    for (int remaining = max - min + 1 - first_len; remaining > 0; remaining -= max_len - 1)
+    {
+        parts.emplace_back(0, std::min(max_len - 1, remaining));
+    }
+    return parts;
+}
+
+/**
+ * Does the same as dilateBrick() or erodeBrick() with a large brick, but as
+ * a sequence of operations with small bricks.  Those go through the
+ * shift-based implementation rather than the one for large bricks.
+ */
+static BinaryImage dilateOrErodeInSmallSteps(
+    BinaryImage const& src, Brick const& brick, QRect const& dst_area,
+    BWColor const src_surroundings, bool const dilate)
+{
+    std::vector<std::pair<int, int>> const x_parts(splitRange(brick.minX(), brick.maxX(), 4));
+    std::vector<std::pair<int, int>> const y_parts(splitRange(brick.minY(), brick.maxY(), 4));
+    std::vector<Brick> steps;
+    for (size_t i = 0; i < std::max(x_parts.size(), y_parts.size()); ++i)
+    {
+        std::pair<int, int> const x = i < x_parts.size() ? x_parts[i] : std::make_pair(0, 0);
+        std::pair<int, int> const y = i < y_parts.size() ? y_parts[i] : std::make_pair(0, 0);
+        steps.push_back(Brick(x.first, y.first, x.second, y.second));
+    }
+
+    // Each step has to produce every pixel the next step reads.
+    std::vector<QRect> areas(steps.size());
+    areas.back() = dst_area;
+    for (size_t i = steps.size() - 1; i > 0; --i)
+    {
+        Brick const& next = steps[i];
+        areas[i - 1] = areas[i].adjusted(-next.maxX(), -next.maxY(), -next.minX(), -next.minY());
+    }
+
+    BinaryImage img(src);
+    QPoint origin(0, 0);
+    for (size_t i = 0; i < steps.size(); ++i)
+    {
+        QRect const area(areas[i].translated(-origin));
+        img = dilate ? dilateBrick(img, steps[i], area, src_surroundings)
+              : erodeBrick(img, steps[i], area, src_surroundings);
+        origin = areas[i].topLeft();
+    }
+
+    return img;
+}
+
+static BinaryImage randomBlobs(int const width, int const height, int const num_blobs)
+{
+    BinaryImage img(width, height, WHITE);
+    for (int i = 0; i < num_blobs; ++i)
+    {
+        img.fill(QRect(rand() % width, rand() % height, 1 + rand() % 5, 1 + rand() % 5), BLACK);
+    }
+    return img;
+}
+
 BOOST_AUTO_TEST_SUITE(MorphologyTestSuite);
 
 BOOST_AUTO_TEST_CASE(test_dilate_1x1)
@@ -675,6 +747,44 @@ BOOST_AUTO_TEST_CASE(test_large_dilate)
     BOOST_CHECK(dilateBrick(img, brick, img.rect(), WHITE) == control);
 }
 
+BOOST_AUTO_TEST_CASE(test_large_bricks_match_small_steps)
+{
+    std::vector<Brick> const bricks
+    {
+        Brick(QSize(40, 3)),
+        Brick(QSize(3, 50)),
+        Brick(QSize(17, 17)),
+        Brick(-30, -2, 5, 0),
+        Brick(0, -7, 0, 30),
+        Brick(3, 4, 22, 40)
+    };
+
+    for (int iteration = 0; iteration < 4; ++iteration)
+    {
+        BinaryImage const sparse(randomBlobs(97, 81, 30));
+        BinaryImage const dense(sparse.inverted());
+        QRect const areas[] = { sparse.rect(), QRect(-20, 10, 140, 60), QRect(60, -30, 70, 50) };
+
+        for (Brick const& brick : bricks)
+        {
+            for (QRect const& area : areas)
+            {
+                for (BWColor const surroundings : { WHITE, BLACK })
+                {
+                    BOOST_CHECK(
+                        dilateBrick(sparse, brick, area, surroundings)
+                        == dilateOrErodeInSmallSteps(sparse, brick, area, surroundings, true)
+                    );
+                    BOOST_CHECK(
+                        erodeBrick(dense, brick, area, surroundings)
+                        == dilateOrErodeInSmallSteps(dense, brick, area, surroundings, false)
+                    );
+                }
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(test_erode_1x1)
 {
     static int const inp[] =
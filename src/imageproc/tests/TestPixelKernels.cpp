@@ -0,0 +1,156 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PixelKernels.h"
+#include "LocalStats.h"
+#include "GrayImage.h"
+#include "ColorFilter.h"
+#include <QImage>
+#include <QSize>
+#include <boost/test/unit_test.hpp>
+#include <stdlib.h>
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+using namespace kernels;
+
+namespace
+{
+
+GrayImage fullRangeGrayImage(int const width, int const height)
+{
+    GrayImage image(QSize(width, height));
+    for (int y = 0; y < height; ++y)
+    {
+        unsigned char* const line = image.data() + y * image.stride();
+        for (int x = 0; x < width; ++x)
+        {
+            line[x] = (unsigned char) (rand() % 256);
+        }
+    }
+    return image;
+}
+
+/**
+ * Runs \p func with the scalar kernels and with the best ones available,
+ * and checks both produce the same image.
+ */
+template<typename Func>
+void checkMatchesScalar(Func func)
+{
+    SimdLevel const detected = detectedSimdLevel();
+
+    setSimdLevel(SIMD_NONE);
+    auto const scalar = func();
+    setSimdLevel(detected);
+    auto const vectorized = func();
+
+    BOOST_CHECK(scalar == vectorized);
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(PixelKernelsTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_sum_pixels)
+{
+    // An odd width leaves tails for the scalar code.
+    GrayImage const input(fullRangeGrayImage(203, 67));
+
+    uint64_t expected = 0;
+    for (int y = 0; y < input.height(); ++y)
+    {
+        for (int x = 0; x < input.width(); ++x)
+        {
+            expected += input.data()[y * input.stride() + x];
+        }
+    }
+
+    BOOST_CHECK_EQUAL(sumPixels(input.data(), input.width(), input.height(), input.stride()), expected);
+}
+
+BOOST_AUTO_TEST_CASE(test_window_statistics)
+{
+    GrayImage const input(fullRangeGrayImage(203, 67));
+
+    checkMatchesScalar([&]()
+    {
+        return LocalStats(input).mean(7);
+    });
+    checkMatchesScalar([&]()
+    {
+        return LocalStats(input).deviation(7);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_threshold_maps)
+{
+    GrayImage const input(fullRangeGrayImage(203, 67));
+
+    checkMatchesScalar([&]()
+    {
+        return graySauvolaMap(input, 9, 0.34f, 3);
+    });
+    checkMatchesScalar([&]()
+    {
+        return grayWolfMap(input, 9, 0.3f, -5);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_filters)
+{
+    GrayImage const input(fullRangeGrayImage(203, 67));
+
+    checkMatchesScalar([&]()
+    {
+        return grayWiener(input, 5, 3.0f);
+    });
+    checkMatchesScalar([&]()
+    {
+        GrayImage image(input);
+        grayCurveFilterInPlace(image, 0.5f);
+        return image;
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_ycbcr)
+{
+    QImage input(101, 13, QImage::Format_RGB32);
+    for (int y = 0; y < input.height(); ++y)
+    {
+        for (int x = 0; x < input.width(); ++x)
+        {
+            input.setPixel(x, y, qRgb(rand() % 256, rand() % 256, rand() % 256));
+        }
+    }
+
+    checkMatchesScalar([&]()
+    {
+        return imageYCbCr(input);
+    });
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
@@ -128,6 +128,35 @@ BOOST_AUTO_TEST_CASE(test_lines)
     BOOST_CHECK(makeBinaryImage(out4, 1, 4) == ReduceThreshold(img)(4));
 }
 
+BOOST_AUTO_TEST_CASE(test_wide_image)
+{
+    // Lines spanning an odd number of words go through both the word pair
+    // and the single word code paths.
+    int const widths[] = { 64, 97, 130, 161 };
+    for (int width : widths)
+    {
+        BinaryImage const img(randomBinaryImage(width, 6));
+        int const dst_w = width / 2;
+        int const dst_h = img.height() / 2;
+
+        for (int threshold = 1; threshold <= 4; ++threshold)
+        {
+            BinaryImage const reduced(ReduceThreshold(img)(threshold));
+            BOOST_REQUIRE(reduced.size() == QSize(dst_w, dst_h));
+
+            for (int y = 0; y < dst_h; ++y)
+            {
+                for (int x = 0; x < dst_w; ++x)
+                {
+                    int const black = img.countBlackPixels(QRect(x * 2, y * 2, 2, 2));
+                    QRect const dst_pixel(x, y, 1, 1);
+                    BOOST_CHECK_EQUAL(reduced.countBlackPixels(dst_pixel), black >= threshold ? 1 : 0);
+                }
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
@@ -22,8 +22,11 @@
 #include "Utils.h"
 #include <iostream>
 #include <QImage>
+#include <QPoint>
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
+#include <vector>
 #include <math.h>
 
 namespace imageproc
@@ -101,6 +104,45 @@ BOOST_AUTO_TEST_CASE(test1)
     BOOST_CHECK(verifySEDM(sedm, out));
 }
 
+BOOST_AUTO_TEST_CASE(test_brute_force)
+{
+    // Big enough to be split into several bands of rows and columns.
+    int const width = 203;
+    int const height = 117;
+
+    BinaryImage img(width, height, BLACK);
+    std::vector<QPoint> white_pixels;
+    unsigned seed = 12345;
+    for (int i = 0; i < 40; ++i)
+    {
+        seed = seed * 1103515245u + 12345u;
+        int const x = (seed >> 8) % width;
+        seed = seed * 1103515245u + 12345u;
+        int const y = (seed >> 8) % height;
+        img.data()[y * img.wordsPerLine() + (x >> 5)] &= ~((uint32_t(1) << 31) >> (x & 31));
+        white_pixels.push_back(QPoint(x, y));
+    }
+
+    std::vector<uint32_t> control;
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            uint32_t min_sqdist = SEDM::INF_DIST;
+            for (QPoint const& pt : white_pixels)
+            {
+                int const dx = x - pt.x();
+                int const dy = y - pt.y();
+                min_sqdist = std::min<uint32_t>(min_sqdist, dx * dx + dy * dy);
+            }
+            control.push_back(min_sqdist);
+        }
+    }
+
+    SEDM const sedm(img, SEDM::DIST_TO_WHITE, SEDM::DIST_TO_NO_BORDERS);
+    BOOST_CHECK(verifySEDM(sedm, &control[0]));
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
@@ -25,6 +25,7 @@
 #include <QImage>
 #include <QSize>
 #include <QPoint>
+#include <QRect>
 #include <boost/test/unit_test.hpp>
 
 namespace imageproc
@@ -144,6 +145,67 @@ BOOST_AUTO_TEST_CASE(test_regression_4)
     BOOST_REQUIRE(seedFill(seed, mask, CONN4) == fill);
 }
 
+BOOST_AUTO_TEST_CASE(test_diagonal_across_words)
+{
+    int seed_data[70*2] = { 0 };
+    int mask_data[70*2] = { 0 };
+
+    seed_data[63] = 1;
+
+    mask_data[63] = 1;
+    mask_data[70 + 64] = 1;
+
+    BinaryImage const seed(makeBinaryImage(seed_data, 70, 2));
+    BinaryImage const mask(makeBinaryImage(mask_data, 70, 2));
+    BOOST_CHECK(seedFill(seed, mask, CONN8) == mask);
+    BOOST_CHECK(seedFillSlow(seed, mask, CONN8) == mask);
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_random)
+{
+    for (int i = 0; i < 200; ++i)
+    {
+        BinaryImage const seed(randomBinaryImage(70, 9));
+        BinaryImage const mask(randomBinaryImage(70, 9));
+        for (Connectivity const conn : { CONN4, CONN8 })
+        {
+            BinaryImage const fill_new(seedFill(seed, mask, conn));
+            BinaryImage const fill_old(seedFillSlow(seed, mask, conn));
+            if (fill_new != fill_old)
+            {
+                BOOST_ERROR("fill_new != fill_old at iteration " << i);
+                dumpBinaryImage(seed, "seed");
+                dumpBinaryImage(mask, "mask");
+                dumpBinaryImage(fill_old, "fill_old");
+                dumpBinaryImage(fill_new, "fill_new");
+                return;
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_winding)
+{
+    // A single 4-connected path snaking through the whole image.
+    int const w = 100;
+    int const h = 61;
+    BinaryImage mask(w, h, WHITE);
+    for (int y = 0; y < h; y += 2)
+    {
+        mask.fill(QRect(0, y, w, 1), BLACK);
+        if (y + 1 < h)
+        {
+            mask.fill(QRect((y / 2) % 2 ? 0 : w - 1, y + 1, 1, 1), BLACK);
+        }
+    }
+
+    BinaryImage seed(w, h, WHITE);
+    seed.fill(QRect(0, h - 1, 1, 1), BLACK);
+
+    BOOST_CHECK(seedFill(seed, mask, CONN4) == mask);
+    BOOST_CHECK(seedFill(seed, mask, CONN8) == mask);
+}
+
 BOOST_AUTO_TEST_CASE(test_gray4_random)
 {
     for (int i = 0; i < 200; ++i)
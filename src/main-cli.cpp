@@ -27,6 +27,7 @@
 
 #include "CommandLine.h"
 #include "ConsoleBatch.h"
+#include "ProcessingProfiler.h"
 
 
 int main(int argc, char **argv)
@@ -52,6 +53,12 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    if (cli.hasProfile() && !ProcessingProfiler::start(cli.profileFile()))
+    {
+        std::cerr << "Unable to open the profile file." << std::endl;
+        exit(1);
+    }
+
     std::unique_ptr<ConsoleBatch> cbatch;
 
     try
@@ -68,10 +75,13 @@ int main(int argc, char **argv)
     }
     catch(std::exception const& e)
     {
+        ProcessingProfiler::stop();
         std::cerr << e.what() << std::endl;
         exit(1);
     }
 
+    ProcessingProfiler::stop();
+
     if (cli.hasOutputProject())
         cbatch->saveProject(cli.outputProjectFile());
 }
@@ -40,6 +40,8 @@
 #include <string.h>
 
 #include "CommandLine.h"
+#include "ProcessingProfiler.h"
+#include "Utils.h"
 
 int main(int argc, char** argv)
 {
@@ -134,6 +136,15 @@ int main(int argc, char** argv)
     app.setOrganizationDomain("scantailor.sourceforge.net");
     QSettings settings;
 
+    if (cli.hasProfile())
+    {
+        ProcessingProfiler::start(cli.profileFile());
+    }
+    else
+    {
+        Utils::applyProfilingSettings();
+    }
+
     //PngMetadataLoader::registerMyself();
     TiffMetadataLoader::registerMyself();
     //JpegMetadataLoader::registerMyself();
@@ -159,5 +170,7 @@ int main(int argc, char** argv)
     QImageReader::setAllocationLimit(0);
 #endif
 
-    return app.exec();
+    int const ret = app.exec();
+    ProcessingProfiler::stop();
+    return ret;
 }
@@ -16,13 +16,10 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <boost/foreach.hpp>
-#include <QMutexLocker>
 #include "Settings.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
 #include "DistortionType.h"
-#include "../../Utils.h"
 
 namespace deskew
 {
@@ -38,43 +35,34 @@ Settings::~Settings()
 void
 Settings::clear()
 {
-    QMutexLocker locker(&m_mutex);
     m_perPageParams.clear();
 }
 
 void
 Settings::performRelinking(AbstractRelinker const& relinker)
 {
-    QMutexLocker locker(&m_mutex);
-    PerPageParams new_params;
-
-    BOOST_FOREACH(PerPageParams::value_type const& kv, m_perPageParams)
+    m_perPageParams.rekey([&relinker](PageId const& page_id)
     {
-        RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
-        PageId new_page_id(kv.first);
+        RelinkablePath const old_path(page_id.imageId().filePath(), RelinkablePath::File);
+        PageId new_page_id(page_id);
         new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-        new_params.insert(PerPageParams::value_type(new_page_id, kv.second));
-    }
-
-    m_perPageParams.swap(new_params);
+        return new_page_id;
+    });
 }
 
 void
 Settings::setPageParams(PageId const& page_id, Params const& params)
 {
-    QMutexLocker locker(&m_mutex);
-    Utils::mapSetValue(m_perPageParams, page_id, params);
+    m_perPageParams.set(page_id, params);
 }
 
 std::unique_ptr<Params>
 Settings::getPageParams(PageId const& page_id) const
 {
-    QMutexLocker locker(&m_mutex);
-
-    PerPageParams::const_iterator it(m_perPageParams.find(page_id));
-    if (it != m_perPageParams.end())
+    PerPageParams::ValuePtr const params(m_perPageParams.find(page_id));
+    if (params)
     {
-        return std::unique_ptr<Params>(new Params(it->second));
+        return std::unique_ptr<Params>(new Params(*params));
     }
     else
     {
@@ -85,12 +73,10 @@ Settings::getPageParams(PageId const& page_id) const
 DistortionType
 Settings::getDistortionType(PageId const& page_id) const
 {
-    QMutexLocker locker(&m_mutex);
-
-    PerPageParams::const_iterator it(m_perPageParams.find(page_id));
-    if (it != m_perPageParams.end())
+    PerPageParams::ValuePtr const params(m_perPageParams.find(page_id));
+    if (params)
     {
-        return it->second.distortionType();
+        return params->distortionType();
     }
     else
     {
@@ -98,114 +84,69 @@ Settings::getDistortionType(PageId const& page_id) const
     }
 }
 
+template<typename Setter>
 void
-Settings::setDistortionType(
-    std::set<PageId> const& pages, DistortionType const& distortion_type)
+Settings::updatePages(std::set<PageId> const& pages, Setter setter)
 {
-    QMutexLocker const locker(&m_mutex);
-
-    for (PageId const& page_id : pages)
+    m_perPageParams.updateBatch(
+        pages, [&setter](PageId const&, std::unique_ptr<Params>& params)
     {
-        PerPageParams::iterator it = m_perPageParams.find(page_id);
-        if (it != m_perPageParams.end())
+        if (!params)
         {
-            it->second.setDistortionType(distortion_type);
+            params.reset(new Params((Dependencies())));
         }
-        else
-        {
-            Params params((Dependencies()));
-            params.setDistortionType(distortion_type);
-            Utils::mapSetValue(m_perPageParams, page_id, params);
-        }
-    }
+        setter(*params);
+    });
+}
+
+void
+Settings::setDistortionType(
+    std::set<PageId> const& pages, DistortionType const& distortion_type)
+{
+    updatePages(pages, [&distortion_type](Params& params)
+    {
+        params.setDistortionType(distortion_type);
+    });
 }
 
 void
 Settings::setSource(
     std::set<PageId> const& pages, SourceParams const& source)
 {
-    QMutexLocker const locker(&m_mutex);
-
-    for (PageId const& page_id : pages)
+    updatePages(pages, [&source](Params& params)
     {
-        PerPageParams::iterator it = m_perPageParams.find(page_id);
-        if (it != m_perPageParams.end())
-        {
-            it->second.setSourceParams(source);
-        }
-        else
-        {
-            Params params((Dependencies()));
-            params.setSourceParams(source);
-            Utils::mapSetValue(m_perPageParams, page_id, params);
-        }
-    }
+        params.setSourceParams(source);
+    });
 }
 
 void
 Settings::setDepthPerception(
     std::set<PageId> const& pages, dewarping::DepthPerception const& depth_perception)
 {
-    QMutexLocker const locker(&m_mutex);
-
-    for (PageId const& page_id : pages)
+    updatePages(pages, [&depth_perception](Params& params)
     {
-        PerPageParams::iterator it = m_perPageParams.find(page_id);
-        if (it != m_perPageParams.end())
-        {
-            it->second.dewarpingParams().setDepthPerception(depth_perception);
-        }
-        else
-        {
-            Params params((Dependencies()));
-            params.dewarpingParams().setDepthPerception(depth_perception);
-            Utils::mapSetValue(m_perPageParams, page_id, params);
-        }
-    }
+        params.dewarpingParams().setDepthPerception(depth_perception);
+    });
 }
 
 void
 Settings::setCorrectCurves(
     std::set<PageId> const& pages, dewarping::DepthPerception const& correct_curves)
 {
-    QMutexLocker const locker(&m_mutex);
-
-    for (PageId const& page_id : pages)
+    updatePages(pages, [&correct_curves](Params& params)
     {
-        PerPageParams::iterator it = m_perPageParams.find(page_id);
-        if (it != m_perPageParams.end())
-        {
-            it->second.dewarpingParams().setCorrectCurves(correct_curves);
-        }
-        else
-        {
-            Params params((Dependencies()));
-            params.dewarpingParams().setCorrectCurves(correct_curves);
-            Utils::mapSetValue(m_perPageParams, page_id, params);
-        }
-    }
+        params.dewarpingParams().setCorrectCurves(correct_curves);
+    });
 }
 
 void
 Settings::setCorrectAngle(
     std::set<PageId> const& pages, dewarping::DepthPerception const& correct_angle)
 {
-    QMutexLocker const locker(&m_mutex);
-
-    for (PageId const& page_id : pages)
+    updatePages(pages, [&correct_angle](Params& params)
     {
-        PerPageParams::iterator it = m_perPageParams.find(page_id);
-        if (it != m_perPageParams.end())
-        {
-            it->second.dewarpingParams().setCorrectAngle(correct_angle);
-        }
-        else
-        {
-            Params params((Dependencies()));
-            params.dewarpingParams().setCorrectAngle(correct_angle);
-            Utils::mapSetValue(m_perPageParams, page_id, params);
-        }
-    }
+        params.dewarpingParams().setCorrectAngle(correct_angle);
+    });
 }
 
 } // namespace deskew
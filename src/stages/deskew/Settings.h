@@ -20,11 +20,10 @@
 #define DESKEW_SETTINGS_H_
 
 #include <memory>
-#include <map>
 #include <set>
-#include <QMutex>
 #include "RefCountable.h"
 #include "NonCopyable.h"
+#include "SnapshotMap.h"
 #include "PageId.h"
 #include "Params.h"
 #include "DistortionType.h"
@@ -74,9 +73,11 @@ public:
     void setCorrectAngle(
         std::set<PageId> const& pages, dewarping::DepthPerception const& correct_angle);
 private:
-    typedef std::map<PageId, Params> PerPageParams;
+    typedef SnapshotMap<PageId, Params> PerPageParams;
+
+    template<typename Setter>
+    void updatePages(std::set<PageId> const& pages, Setter setter);
 
-    mutable QMutex m_mutex;
     PerPageParams m_perPageParams;
 };
 
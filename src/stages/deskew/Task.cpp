@@ -36,6 +36,7 @@
 #include "Params.h"
 #include "Dependencies.h"
 #include "TaskStatus.h"
+#include "ProcessingProfiler.h"
 #include "DebugImagesImpl.h"
 #include "stages/select_content/Task.h"
 #include "FilterUiInterface.h"
@@ -210,11 +211,13 @@ FilterResultPtr
 Task::process(
     TaskStatus const& status,
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
-    QImage const& orig_image,
+    CachingFactory<QImage> const& orig_image_factory,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
     AffineImageTransform const& orig_image_transform,
     OrthogonalRotation const& pre_rotation)
 {
+    ProfileScope const profile_scope("task", "deskew::Task", m_pageId.imageId().filePath());
+
     status.throwIfCancelled();
 
     Dependencies const deps(orig_image_transform.origCropArea(), pre_rotation);
@@ -243,22 +246,22 @@ Task::process(
     {
     case DistortionType::NONE:
         return processNoDistortion(
-                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   status, accel_ops, orig_image_factory, gray_orig_image_factory,
                    orig_image_transform, *params
                );
     case DistortionType::ROTATION:
         return processRotationDistortion(
-                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   status, accel_ops, orig_image_factory, gray_orig_image_factory,
                    orig_image_transform, *params
                );
     case DistortionType::PERSPECTIVE:
         return processPerspectiveDistortion(
-                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   status, accel_ops, orig_image_factory, gray_orig_image_factory,
                    orig_image_transform, *params
                );
     case DistortionType::WARP:
         return processWarpDistortion(
-                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   status, accel_ops, orig_image_factory, gray_orig_image_factory,
                    orig_image_transform, *params
                );
     } // switch
@@ -270,7 +273,7 @@ FilterResultPtr
 Task::processNoDistortion(
     TaskStatus const& status,
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
-    QImage const& orig_image,
+    CachingFactory<QImage> const& orig_image_factory,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
     AffineImageTransform const& orig_image_transform, Params& params)
 {
@@ -280,7 +283,7 @@ Task::processNoDistortion(
     if (m_ptrNextTask)
     {
         return m_ptrNextTask->process(
-                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   status, accel_ops, orig_image_factory, gray_orig_image_factory,
                    std::make_shared<AffineImageTransform>(orig_image_transform)
                );
     }
@@ -289,7 +292,7 @@ Task::processNoDistortion(
         return FilterResultPtr(
                    new NoDistortionUiUpdater(
                        m_ptrFilter, accel_ops, std::move(m_ptrDbg),
-                       AffineTransformedImage(orig_image, orig_image_transform),
+                       AffineTransformedImage(orig_image_factory(), orig_image_transform),
                        m_pageId, params, m_batchProcessing
                    )
                );
@@ -300,7 +303,7 @@ FilterResultPtr
 Task::processRotationDistortion(
     TaskStatus const& status,
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
-    QImage const& orig_image,
+    CachingFactory<QImage> const& orig_image_factory,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
     AffineImageTransform const& orig_image_transform, Params& params)
 {
@@ -373,7 +376,7 @@ Task::processRotationDistortion(
     {
         double const angle = params.rotationParams().compensationAngleDeg();
         return m_ptrNextTask->process(
-                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   status, accel_ops, orig_image_factory, gray_orig_image_factory,
                    std::make_shared<AffineImageTransform>(
                        orig_image_transform.adjusted(
                            [angle](AffineImageTransform& xform)
@@ -389,7 +392,7 @@ Task::processRotationDistortion(
         return FilterResultPtr(
                    new RotationUiUpdater(
                        m_ptrFilter, accel_ops, std::move(m_ptrDbg),
-                       AffineTransformedImage(orig_image, orig_image_transform),
+                       AffineTransformedImage(orig_image_factory(), orig_image_transform),
                        m_pageId, params, m_batchProcessing
                    )
                );
@@ -400,7 +403,7 @@ FilterResultPtr
 Task::processPerspectiveDistortion(
     TaskStatus const& status,
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
-    QImage const& orig_image,
+    CachingFactory<QImage> const& orig_image_factory,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
     AffineImageTransform const& orig_image_transform, Params& params)
 {
@@ -420,6 +423,7 @@ Task::processPerspectiveDistortion(
             model_builder, status, m_ptrDbg.get()
         );
 
+        QImage const orig_image(orig_image_factory());
         DistortionModel distortion_model(
             model_builder.tryBuildModel(m_ptrDbg.get(), &orig_image)
         );
@@ -477,7 +481,7 @@ Task::processPerspectiveDistortion(
             )
         );
         return m_ptrNextTask->process(
-                   status, accel_ops, orig_image, gray_orig_image_factory, perspective_transform
+                   status, accel_ops, orig_image_factory, gray_orig_image_factory, perspective_transform
                );
     }
     else
@@ -485,7 +489,7 @@ Task::processPerspectiveDistortion(
         return FilterResultPtr(
                    new PerspectiveUiUpdater(
                        m_ptrFilter, accel_ops, std::move(m_ptrDbg),
-                       AffineTransformedImage(orig_image, orig_image_transform),
+                       AffineTransformedImage(orig_image_factory(), orig_image_transform),
                        m_pageId, params, m_batchProcessing
                    )
                );
@@ -496,7 +500,7 @@ FilterResultPtr
 Task::processWarpDistortion(
     TaskStatus const& status,
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
-    QImage const& orig_image,
+    CachingFactory<QImage> const& orig_image_factory,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
     AffineImageTransform const& orig_image_transform, Params& params)
 {
@@ -516,6 +520,7 @@ Task::processWarpDistortion(
             model_builder, status, m_ptrDbg.get()
         );
 
+        QImage const orig_image(orig_image_factory());
         DistortionModel distortion_model(
             model_builder.tryBuildModel(m_ptrDbg.get(), &orig_image)
         );
@@ -572,7 +577,7 @@ Task::processWarpDistortion(
             )
         );
         return m_ptrNextTask->process(
-                   status, accel_ops, orig_image, gray_orig_image_factory, dewarping_transform
+                   status, accel_ops, orig_image_factory, gray_orig_image_factory, dewarping_transform
                );
     }
     else
@@ -580,7 +585,7 @@ Task::processWarpDistortion(
         return FilterResultPtr(
                    new DewarpingUiUpdater(
                        m_ptrFilter, accel_ops, std::move(m_ptrDbg),
-                       AffineTransformedImage(orig_image, orig_image_transform),
+                       AffineTransformedImage(orig_image_factory(), orig_image_transform),
                        m_pageId, params, m_batchProcessing
                    )
                );
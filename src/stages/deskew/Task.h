@@ -67,7 +67,7 @@ public:
     FilterResultPtr process(
         TaskStatus const& status,
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
-        QImage const& orig_image,
+        CachingFactory<QImage> const& orig_image_factory,
         CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
         imageproc::AffineImageTransform const& orig_image_transform,
         OrthogonalRotation const& pre_rotation);
@@ -80,28 +80,28 @@ private:
     FilterResultPtr processNoDistortion(
         TaskStatus const& status,
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
-        QImage const& orig_image,
+        CachingFactory<QImage> const& orig_image_factory,
         CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
         imageproc::AffineImageTransform const& orig_image_transform, Params& params);
 
     FilterResultPtr processRotationDistortion(
         TaskStatus const& status,
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
-        QImage const& orig_image,
+        CachingFactory<QImage> const& orig_image_factory,
         CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
         imageproc::AffineImageTransform const& orig_image_transform, Params& params);
 
     FilterResultPtr processPerspectiveDistortion(
         TaskStatus const& status,
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
-        QImage const& orig_image,
+        CachingFactory<QImage> const& orig_image_factory,
         CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
         imageproc::AffineImageTransform const& orig_image_transform, Params& params);
 
     FilterResultPtr processWarpDistortion(
         TaskStatus const& status,
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
-        QImage const& orig_image,
+        CachingFactory<QImage> const& orig_image_factory,
         CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
         imageproc::AffineImageTransform const& orig_image_transform, Params& params);
 
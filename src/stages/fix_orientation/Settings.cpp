@@ -17,10 +17,9 @@
 */
 
 #include "Settings.h"
-#include "Utils.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
-#include <boost/foreach.hpp>
+#include <vector>
 
 namespace fix_orientation
 {
@@ -36,56 +35,53 @@ Settings::~Settings()
 void
 Settings::clear()
 {
-    QMutexLocker locker(&m_mutex);
     m_perImageRotation.clear();
 }
 
 void
 Settings::performRelinking(AbstractRelinker const& relinker)
 {
-    QMutexLocker locker(&m_mutex);
-    PerImageRotation new_rotations;
-
-    BOOST_FOREACH(PerImageRotation::value_type const& kv, m_perImageRotation)
+    m_perImageRotation.rekey([&relinker](ImageId const& image_id)
     {
-        RelinkablePath const old_path(kv.first.filePath(), RelinkablePath::File);
-        ImageId new_image_id(kv.first);
+        RelinkablePath const old_path(image_id.filePath(), RelinkablePath::File);
+        ImageId new_image_id(image_id);
         new_image_id.setFilePath(relinker.substitutionPathFor(old_path));
-        new_rotations.insert(PerImageRotation::value_type(new_image_id, kv.second));
-    }
-
-    m_perImageRotation.swap(new_rotations);
+        return new_image_id;
+    });
 }
 
 void
 Settings::applyRotation(
     ImageId const& image_id, OrthogonalRotation const rotation)
 {
-    QMutexLocker locker(&m_mutex);
-    setImageRotationLocked(image_id, rotation);
+    m_perImageRotation.set(image_id, rotation);
 }
 
 void
 Settings::applyRotation(
     std::set<PageId> const& pages, OrthogonalRotation const rotation)
 {
-    QMutexLocker locker(&m_mutex);
-
-    BOOST_FOREACH(PageId const& page, pages)
+    std::vector<ImageId> images;
+    images.reserve(pages.size());
+    for (PageId const& page : pages)
     {
-        setImageRotationLocked(page.imageId(), rotation);
+        images.push_back(page.imageId());
     }
+
+    m_perImageRotation.updateBatch(
+        images, [rotation](ImageId const&, std::unique_ptr<OrthogonalRotation>& value)
+    {
+        value.reset(new OrthogonalRotation(rotation));
+    });
 }
 
 OrthogonalRotation
 Settings::getRotationFor(ImageId const& image_id) const
 {
-    QMutexLocker locker(&m_mutex);
-
-    PerImageRotation::const_iterator it(m_perImageRotation.find(image_id));
-    if (it != m_perImageRotation.end())
+    PerImageRotation::ValuePtr const rotation(m_perImageRotation.find(image_id));
+    if (rotation)
     {
-        return it->second;
+        return *rotation;
     }
     else
     {
@@ -93,11 +89,4 @@ Settings::getRotationFor(ImageId const& image_id) const
     }
 }
 
-void
-Settings::setImageRotationLocked(
-    ImageId const& image_id, OrthogonalRotation const& rotation)
-{
-    Utils::mapSetValue(m_perImageRotation, image_id, rotation);
-}
-
 } // namespace fix_orientation
@@ -24,8 +24,7 @@
 #include "OrthogonalRotation.h"
 #include "ImageId.h"
 #include "PageId.h"
-#include <QMutex>
-#include <map>
+#include "SnapshotMap.h"
 #include <set>
 
 class AbstractRelinker;
@@ -51,12 +50,8 @@ public:
 
     OrthogonalRotation getRotationFor(ImageId const& image_id) const;
 private:
-    typedef std::map<ImageId, OrthogonalRotation> PerImageRotation;
+    typedef SnapshotMap<ImageId, OrthogonalRotation> PerImageRotation;
 
-    void setImageRotationLocked(
-        ImageId const& image_id, OrthogonalRotation const& rotation);
-
-    mutable QMutex m_mutex;
     PerImageRotation m_perImageRotation;
 };
 
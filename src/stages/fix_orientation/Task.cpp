@@ -22,6 +22,7 @@
 #include "Settings.h"
 #include "stages/page_split/Task.h"
 #include "TaskStatus.h"
+#include "ProcessingProfiler.h"
 #include "ImageView.h"
 #include "FilterUiInterface.h"
 #include "imageproc/AffineImageTransform.h"
@@ -93,12 +94,14 @@ FilterResultPtr
 Task::process(
     TaskStatus const& status,
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
-    QImage const& orig_image,
+    CachingFactory<QImage> const& orig_image_factory,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
     AffineImageTransform const& orig_image_transform)
 {
     // This function is executed from the worker thread.
 
+    ProfileScope const profile_scope("task", "fix_orientation::Task", m_imageId.filePath());
+
     status.throwIfCancelled();
 
     OrthogonalRotation const rotation(m_ptrSettings->getRotationFor(m_imageId));
@@ -112,7 +115,7 @@ Task::process(
     if (m_ptrNextTask)
     {
         return m_ptrNextTask->process(
-                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   status, accel_ops, orig_image_factory, gray_orig_image_factory,
                    rotated_transform, rotation
                );
     }
@@ -121,7 +124,7 @@ Task::process(
         return FilterResultPtr(
                    new UiUpdater(
                        m_ptrFilter, accel_ops,
-                       AffineTransformedImage(orig_image, rotated_transform),
+                       AffineTransformedImage(orig_image_factory(), rotated_transform),
                        rotation, m_imageId, m_batchProcessing
                    )
                );
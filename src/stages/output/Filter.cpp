@@ -129,6 +129,7 @@ Filter::saveSettings(
 {
     QDomElement filter_el(doc.createElement("output"));
     filter_el.setAttribute("scalingFactor", Utils::doubleToString(m_ptrSettings->scalingFactor()));
+    filter_el.setAttribute("tiffCompression", m_ptrSettings->tiffCompression().toString());
 
     writer.enumPages([this, &doc, &filter_el](PageId const& page_id, int numeric_id)
     {
@@ -171,6 +172,7 @@ Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
     );
 
     m_ptrSettings->setScalingFactor(scalingFactorFromString(filter_el.attribute("scalingFactor")));
+    m_ptrSettings->setTiffCompression(TiffCompression(filter_el.attribute("tiffCompression")));
 
     QString const page_tag_name("page");
     QDomNode node(filter_el.firstChild());
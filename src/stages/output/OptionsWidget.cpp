@@ -64,6 +64,12 @@ OptionsWidget::OptionsWidget(
     colorModeSelector->addItem(tr("Color / Grayscale"), ColorParams::COLOR_GRAYSCALE);
     colorModeSelector->addItem(tr("Mixed"), ColorParams::MIXED);
 
+    compressionSelector->addItem(tr("None"), TiffCompression::NONE);
+    compressionSelector->addItem(tr("LZW"), TiffCompression::LZW);
+    compressionSelector->addItem(tr("Deflate"), TiffCompression::DEFLATE);
+    compressionSelector->addItem(tr("ZSTD"), TiffCompression::ZSTD);
+    compressionSelector->addItem(tr("PackBits"), TiffCompression::PACKBITS);
+
     thresholdMethodSelector->addItem(tr("Otsu"), T_OTSU);
     thresholdMethodSelector->addItem(tr("Mean"), T_MEANDELTA);
     thresholdMethodSelector->addItem(tr("Dots8"), T_DOTS8);
@@ -405,6 +411,22 @@ OptionsWidget::OptionsWidget(
         metricsPanel, SIGNAL(clicked(bool)),
         this, SLOT(metricsPanelToggled(bool))
     );
+    connect(
+        filePanelEmpty, SIGNAL(clicked(bool)),
+        this, SLOT(filePanelToggled(bool))
+    );
+    connect(
+        filePanel, SIGNAL(clicked(bool)),
+        this, SLOT(filePanelToggled(bool))
+    );
+    connect(
+        compressionSelector, SIGNAL(currentIndexChanged(int)),
+        this, SLOT(compressionChanged())
+    );
+    connect(
+        compressionLevel, SIGNAL(valueChanged(int)),
+        this, SLOT(compressionChanged())
+    );
 
     thresholdSlider->setMinimum(-50);
     thresholdSlider->setMaximum(50);
@@ -437,6 +459,7 @@ OptionsWidget::preUpdateUI(PageId const& page_id)
     updateColorsDisplay();
     updateScaleDisplay();
     updateMetricsDisplay();
+    updateCompressionDisplay();
 }
 
 void
@@ -1644,6 +1667,44 @@ OptionsWidget::updateMetricsDisplay()
     metricsBWdelta->setText(tr("%1").arg(metrics_options.getMetricBWdestination() - metrics_options.getMetricBWorigin()));
 }
 
+void
+OptionsWidget::filePanelToggled(bool const checked)
+{
+    filePanelEmpty->setVisible(!checked);
+    filePanelEmpty->setChecked(checked);
+    filePanel->setVisible(checked);
+    filePanel->setChecked(checked);
+}
+
+void
+OptionsWidget::compressionChanged()
+{
+    TiffCompression::Codec const codec = TiffCompression::Codec(
+        compressionSelector->itemData(compressionSelector->currentIndex()).toInt()
+    );
+    m_ptrSettings->setTiffCompression(TiffCompression(codec, compressionLevel->value()));
+    updateCompressionDisplay();
+}
+
+void
+OptionsWidget::updateCompressionDisplay()
+{
+    TiffCompression const compression(m_ptrSettings->tiffCompression());
+    int const max_level = TiffCompression::maxLevel(compression.codec());
+
+    compressionSelector->blockSignals(true);
+    compressionLevel->blockSignals(true);
+
+    compressionSelector->setCurrentIndex(compressionSelector->findData(compression.codec()));
+    compressionLevel->setMaximum(max_level);
+    compressionLevel->setValue(compression.level());
+    compressionLevel->setEnabled(max_level > 0);
+    compressionLevelLabel->setEnabled(max_level > 0);
+
+    compressionSelector->blockSignals(false);
+    compressionLevel->blockSignals(false);
+}
+
 void
 OptionsWidget::updateScaleDisplay()
 {
@@ -165,6 +165,10 @@ private slots:
 
     void metricsPanelToggled(bool checked);
 
+    void filePanelToggled(bool checked);
+
+    void compressionChanged();
+
 private:
     void despeckleLevelSelected(DespeckleLevel level);
 
@@ -174,6 +178,8 @@ private:
 
     void updateColorsDisplay();
 
+    void updateCompressionDisplay();
+
     void updateScaleDisplay();
 
     void updateMetricsDisplay();
@@ -42,6 +42,7 @@
 #include <Qt>
 #include "OutputGenerator.h"
 #include "TaskStatus.h"
+#include "ProcessingProfiler.h"
 #include "Utils.h"
 #include "DebugImages.h"
 #include "EstimateBackground.h"
@@ -74,6 +75,7 @@
 #include "imageproc/PolygonRasterizer.h"
 #include "imageproc/ColorFilter.h"
 #include "imageproc/ImageMetrics.h"
+#include "imageproc/GrayFilterChain.h"
 #include "config.h"
 
 using namespace imageproc;
@@ -281,6 +283,8 @@ OutputGenerator::process(
     imageproc::BinaryImage* out_speckles_image,
     DebugImages* const dbg)
 {
+    ProfileScope const profile_scope("output", "process");
+
     assert(!orig_image.isNull());
 
     if (m_contentRect.isEmpty())
@@ -318,9 +322,11 @@ OutputGenerator::process(
                                   );
     QColor const bg_color(dominant_gray, dominant_gray, dominant_gray);
 
-    QImage transformed_image(
-        m_ptrImageTransform->materialize(orig_image, m_outRect, bg_color, accel_ops)
-    );
+    QImage transformed_image;
+    {
+        ProfileScope const profile_scope("output", "transform");
+        transformed_image = m_ptrImageTransform->materialize(orig_image, m_outRect, bg_color, accel_ops);
+    }
     if (transformed_image.hasAlphaChannel())
     {
         // We don't handle ARGB32_Premultiplied below.
@@ -727,6 +733,8 @@ OutputGenerator::normalizeIlluminationGray(
     boost::optional<QPolygonF> const& estimation_region_of_intereset,
     DebugImages* const dbg)
 {
+    ProfileScope const profile_scope("output", "normalizeIllumination");
+
     PolynomialSurface const bg_ps(
         estimateBackground(
             input_for_estimation, estimation_region_of_intereset, accel_ops, status, dbg
@@ -799,6 +807,8 @@ OutputGenerator::estimateBinarizationMask(
     DebugImages* const dbg,
     float const coef) const
 {
+    ProfileScope const profile_scope("output", "estimateBinarizationMask");
+
     QSize const downscaled_size(gray_source.size().scaled(1600, 1600, Qt::KeepAspectRatio));
     GrayImage downscaled(scaleToGray(gray_source, downscaled_size));
 
@@ -1023,6 +1033,8 @@ OutputGenerator::detectPictures(
     GrayImage const& downscaled_input,
     DebugImages* const dbg)
 {
+    ProfileScope const profile_scope("output", "detectPictures");
+
     // downscaled_input is expected to be ~300 DPI.
 
     // We stretch the range of gray levels to cover the whole
@@ -1160,6 +1172,8 @@ OutputGenerator::adjustThreshold(BinaryThreshold threshold) const
 BinaryImage
 OutputGenerator::binarize(QImage const& image, BinaryImage const& mask) const
 {
+    ProfileScope const profile_scope("output", "binarize");
+
     BlackWhiteOptions const& black_white_options = m_colorParams.blackWhiteOptions();
     BinaryImage binarized;
     if ((image.format() == QImage::Format_Mono) || (image.format() == QImage::Format_MonoLSB))
@@ -1325,53 +1339,72 @@ OutputGenerator::colored(
     TaskStatus const& status,
     DebugImages* const dbg)
 {
+    ProfileScope const profile_scope("output", "colored");
+
     // Color filters begin
     GrayImage gout = GrayImage(image);
     if (!gout.isNull())
     {
-        grayCurveFilterInPlace(gout, color_options.curveCoef());
-
-        graySqrFilterInPlace(gout, color_options.sqrCoef());
-
-        grayRISundefectInPlace(gout, color_options.RISundefectSize(), color_options.RISundefectCoef());
-
-        grayAutoLevelInPlace(gout, color_options.autoLevelSize(), color_options.autoLevelCoef());
-
-        grayBalanceInPlace(gout, color_options.balanceSize(), color_options.balanceCoef());
-
-        grayOverBlurInPlace(gout, color_options.overblurSize(), color_options.overblurCoef());
-
-        grayRetinexInPlace(gout, color_options.retinexSize(), color_options.retinexCoef());
-
-        graySubtractBGInPlace(gout, color_options.subtractbgSize(), color_options.subtractbgCoef());
-
-        grayEqualizeInPlace(gout, color_options.equalizeSize(), color_options.equalizeCoef());
-
-        grayWienerInPlace(gout, color_options.wienerSize(), (255.0f * color_options.wienerCoef() * color_options.wienerCoef()));
-
-        grayKnnDenoiserInPlace(gout, color_options.knndRadius(), color_options.knndCoef());
-
-        grayEMDenoiserInPlace(gout, color_options.emdRadius(), color_options.emdCoef());
-
-        grayDespeckleInPlace(gout, color_options.cdespeckleRadius(), color_options.cdespeckleCoef());
-
-        graySigmaInPlace(gout, color_options.sigmaSize(), color_options.sigmaCoef());
-
-        grayBlurInPlace(gout, color_options.blurSize(), color_options.blurCoef());
-
-        grayScreenInPlace(gout, color_options.screenSize(), color_options.screenCoef());
-
-        grayEdgeDivInPlace(gout, color_options.edgedivSize(), color_options.edgedivCoef(), color_options.edgedivCoef());
-
-        grayRobustInPlace(gout, color_options.robustSize(), color_options.robustCoef());
-
-        grayGrainInPlace(gout, color_options.grainSize(), color_options.grainCoef());
+        // Only grayKnnDenoiser and grayDespeckle have a bounded footprint
+        // and can run band by band.  The rest rely on global statistics
+        // or on the recursive gaussBlur and have to see the whole image.
+        // Neither of the two has a local neighbour to be fused with, but
+        // running their bands in parallel still pays off, as they are
+        // expensive and single-threaded otherwise.  graySqr is point-wise,
+        // yet it's stuck between global filters as well, and banding alone
+        // would only add copying to such a cheap filter, so it runs directly.
+        GrayFilterChain chain;
+
+        chain.appendGlobal([&](GrayImage& g)
+        {
+            grayCurveFilterInPlace(g, color_options.curveCoef());
+            graySqrFilterInPlace(g, color_options.sqrCoef());
+            grayRISundefectInPlace(g, color_options.RISundefectSize(), color_options.RISundefectCoef());
+            grayAutoLevelInPlace(g, color_options.autoLevelSize(), color_options.autoLevelCoef());
+            grayBalanceInPlace(g, color_options.balanceSize(), color_options.balanceCoef());
+            grayOverBlurInPlace(g, color_options.overblurSize(), color_options.overblurCoef());
+            grayRetinexInPlace(g, color_options.retinexSize(), color_options.retinexCoef());
+            graySubtractBGInPlace(g, color_options.subtractbgSize(), color_options.subtractbgCoef());
+            grayEqualizeInPlace(g, color_options.equalizeSize(), color_options.equalizeCoef());
+            grayWienerInPlace(g, color_options.wienerSize(), (255.0f * color_options.wienerCoef() * color_options.wienerCoef()));
+        });
+
+        if ((color_options.knndRadius() > 0) && (color_options.knndCoef() > 0.0))
+        {
+            chain.appendLocal(color_options.knndRadius(), [&](GrayImage& g)
+            {
+                grayKnnDenoiserInPlace(g, color_options.knndRadius(), color_options.knndCoef());
+            });
+        }
 
-        grayComixInPlace(gout, color_options.comixSize(), color_options.comixCoef());
+        chain.appendGlobal([&](GrayImage& g)
+        {
+            grayEMDenoiserInPlace(g, color_options.emdRadius(), color_options.emdCoef());
+        });
 
-        grayGravureInPlace(gout, color_options.gravureSize(), color_options.gravureCoef());
+        if ((color_options.cdespeckleRadius() > 0) && (color_options.cdespeckleCoef() != 0.0f))
+        {
+            // Each of the radius iterations looks one pixel further.
+            chain.appendLocal(color_options.cdespeckleRadius(), [&](GrayImage& g)
+            {
+                grayDespeckleInPlace(g, color_options.cdespeckleRadius(), color_options.cdespeckleCoef());
+            });
+        }
 
-        grayDots8InPlace(gout, color_options.dots8Size(), color_options.dots8Coef());
+        chain.appendGlobal([&](GrayImage& g)
+        {
+            graySigmaInPlace(g, color_options.sigmaSize(), color_options.sigmaCoef());
+            grayBlurInPlace(g, color_options.blurSize(), color_options.blurCoef());
+            grayScreenInPlace(g, color_options.screenSize(), color_options.screenCoef());
+            grayEdgeDivInPlace(g, color_options.edgedivSize(), color_options.edgedivCoef(), color_options.edgedivCoef());
+            grayRobustInPlace(g, color_options.robustSize(), color_options.robustCoef());
+            grayGrainInPlace(g, color_options.grainSize(), color_options.grainCoef());
+            grayComixInPlace(g, color_options.comixSize(), color_options.comixCoef());
+            grayGravureInPlace(g, color_options.gravureSize(), color_options.gravureCoef());
+            grayDots8InPlace(g, color_options.dots8Size(), color_options.dots8Coef());
+        });
+
+        chain.process(gout);
 
         double const norm_coef = color_options.normalizeCoef();
         if (norm_coef > 0.0)
@@ -1457,6 +1490,8 @@ OutputGenerator::maybeDespeckleInPlace(
     TaskStatus const& status,
     DebugImages* dbg) const
 {
+    ProfileScope const profile_scope("output", "despeckle");
+
     if (out_speckles_img)
     {
         *out_speckles_img = image;
@@ -1483,6 +1518,8 @@ OutputGenerator::morphologicalSmoothInPlace(
     BinaryImage& bin_img,
     std::shared_ptr<AcceleratableOperations> const& accel_ops)
 {
+    ProfileScope const profile_scope("output", "morphologicalSmooth");
+
     std::vector<Grid<char>> patterns;
 
     // When removing black noise, remove small ones first.
@@ -27,12 +27,14 @@ namespace output
 
 OutputParams::OutputParams(
     OutputImageParams const& output_image_params,
+    OutputFileParams const& source_file_params,
     OutputFileParams const& output_file_params,
     OutputFileParams const& automask_file_params,
     OutputFileParams const& speckles_file_params,
     ZoneSet const& picture_zones,
     ZoneSet const& fill_zones)
     : m_outputImageParams(output_image_params),
+      m_sourceFileParams(source_file_params),
       m_outputFileParams(output_file_params),
       m_automaskFileParams(automask_file_params),
       m_specklesFileParams(speckles_file_params),
@@ -43,6 +45,7 @@ OutputParams::OutputParams(
 
 OutputParams::OutputParams(QDomElement const& el)
     : m_outputImageParams(el.namedItem("image").toElement()),
+      m_sourceFileParams(el.namedItem("source").toElement()),
       m_outputFileParams(el.namedItem("file").toElement()),
       m_automaskFileParams(el.namedItem("automask").toElement()),
       m_specklesFileParams(el.namedItem("speckles").toElement()),
@@ -56,6 +59,7 @@ OutputParams::toXml(QDomDocument& doc, QString const& name) const
 {
     QDomElement el(doc.createElement(name));
     el.appendChild(m_outputImageParams.toXml(doc, "image"));
+    el.appendChild(m_sourceFileParams.toXml(doc, "source"));
     el.appendChild(m_outputFileParams.toXml(doc, "file"));
     el.appendChild(m_automaskFileParams.toXml(doc, "automask"));
     el.appendChild(m_specklesFileParams.toXml(doc, "speckles"));
@@ -34,6 +34,7 @@ class OutputParams
 {
 public:
     OutputParams(OutputImageParams const& output_image_params,
+                 OutputFileParams const& source_file_params,
                  OutputFileParams const& output_file_params,
                  OutputFileParams const& automask_file_params,
                  OutputFileParams const& speckles_file_params,
@@ -48,6 +49,16 @@ public:
         return m_outputImageParams;
     }
 
+    /**
+     * \brief Parameters of the source image file the output was produced from.
+     *
+     * May be invalid for projects saved before this was recorded.
+     */
+    OutputFileParams const& sourceFileParams() const
+    {
+        return m_sourceFileParams;
+    }
+
     OutputFileParams const& outputFileParams() const
     {
         return m_outputFileParams;
@@ -74,6 +85,7 @@ public:
     }
 private:
     OutputImageParams m_outputImageParams;
+    OutputFileParams m_sourceFileParams;
     OutputFileParams m_outputFileParams;
     OutputFileParams m_automaskFileParams;
     OutputFileParams m_specklesFileParams;
@@ -16,7 +16,6 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <boost/foreach.hpp>
 #include <Qt>
 #include <QColor>
 #include <QMutexLocker>
@@ -26,7 +25,6 @@
 #include "FillColorProperty.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
-#include "../../Utils.h"
 
 namespace output
 {
@@ -50,6 +48,7 @@ Settings::clear()
     initialPictureZoneProps().swap(m_defaultPictureZoneProps);
     initialFillZoneProps().swap(m_defaultFillZoneProps);
     m_scalingFactor = defaultScalingFactor();
+    m_tiffCompression = TiffCompression();
     m_perPageParams.clear();
     m_perPageOutputParams.clear();
     m_perPagePictureZones.clear();
@@ -59,60 +58,41 @@ Settings::clear()
 void
 Settings::performRelinking(AbstractRelinker const& relinker)
 {
-    QMutexLocker const locker(&m_mutex);
-
-    PerPageParams new_params;
-    PerPageOutputParams new_output_params;
-    PerPageZones new_picture_zones;
-    PerPageZones new_fill_zones;
-
-    BOOST_FOREACH(PerPageParams::value_type const& kv, m_perPageParams)
+    auto const relink = [&relinker](PageId const& page_id)
     {
-        RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
-        PageId new_page_id(kv.first);
+        RelinkablePath const old_path(page_id.imageId().filePath(), RelinkablePath::File);
+        PageId new_page_id(page_id);
         new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-        new_params.insert(PerPageParams::value_type(new_page_id, kv.second));
-    }
+        return new_page_id;
+    };
 
-    BOOST_FOREACH(PerPageOutputParams::value_type const& kv, m_perPageOutputParams)
-    {
-        RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
-        PageId new_page_id(kv.first);
-        new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-        new_output_params.insert(PerPageOutputParams::value_type(new_page_id, kv.second));
-    }
-
-    BOOST_FOREACH(PerPageZones::value_type const& kv, m_perPagePictureZones)
-    {
-        RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
-        PageId new_page_id(kv.first);
-        new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-        new_picture_zones.insert(PerPageZones::value_type(new_page_id, kv.second));
-    }
+    m_perPageParams.rekey(relink);
+    m_perPageOutputParams.rekey(relink);
+    m_perPagePictureZones.rekey(relink);
+    m_perPageFillZones.rekey(relink);
+}
 
-    BOOST_FOREACH(PerPageZones::value_type const& kv, m_perPageFillZones)
-    {
-        RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
-        PageId new_page_id(kv.first);
-        new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-        new_fill_zones.insert(PerPageZones::value_type(new_page_id, kv.second));
-    }
+TiffCompression
+Settings::tiffCompression() const
+{
+    QMutexLocker const locker(&m_mutex);
+    return m_tiffCompression;
+}
 
-    m_perPageParams.swap(new_params);
-    m_perPageOutputParams.swap(new_output_params);
-    m_perPagePictureZones.swap(new_picture_zones);
-    m_perPageFillZones.swap(new_fill_zones);
+void
+Settings::setTiffCompression(TiffCompression const& compression)
+{
+    QMutexLocker const locker(&m_mutex);
+    m_tiffCompression = compression;
 }
 
 Params
 Settings::getParams(PageId const& page_id) const
 {
-    QMutexLocker const locker(&m_mutex);
-
-    PerPageParams::const_iterator const it(m_perPageParams.find(page_id));
-    if (it != m_perPageParams.end())
+    PerPageParams::ValuePtr const params(m_perPageParams.find(page_id));
+    if (params)
     {
-        return it->second;
+        return *params;
     }
     else
     {
@@ -123,163 +103,102 @@ Settings::getParams(PageId const& page_id) const
 void
 Settings::setParams(PageId const& page_id, Params const& params)
 {
-    QMutexLocker const locker(&m_mutex);
-    Utils::mapSetValue(m_perPageParams, page_id, params);
+    m_perPageParams.set(page_id, params);
 }
 
+template<typename Setter>
 void
-Settings::setColorParams(PageId const& page_id, ColorParams const& prms)
+Settings::updateParams(PageId const& page_id, Setter setter)
 {
-    QMutexLocker const locker(&m_mutex);
+    m_perPageParams.update(page_id, [&setter](std::unique_ptr<Params>& params)
+    {
+        if (!params)
+        {
+            params.reset(new Params);
+        }
+        setter(*params);
+    });
+}
 
-    PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-    if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first))
+void
+Settings::setColorParams(PageId const& page_id, ColorParams const& prms)
+{
+    updateParams(page_id, [&prms](Params& params)
     {
-        Params params;
         params.setColorParams(prms);
-        m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-    }
-    else
-    {
-        it->second.setColorParams(prms);
-    }
+    });
 }
 
 void
 Settings::setColorGrayscaleOptions(PageId const& page_id, ColorGrayscaleOptions const& color_options)
 {
-    QMutexLocker const locker(&m_mutex);
-
-    PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-    if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first))
+    updateParams(page_id, [&color_options](Params& params)
     {
-        Params params;
         params.setColorGrayscaleOptions(color_options);
-        m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-    }
-    else
-    {
-        it->second.setColorGrayscaleOptions(color_options);
-    }
+    });
 }
 
 void
 Settings::setColorMode(PageId const& page_id, ColorParams::ColorMode const& color_mode)
 {
-    QMutexLocker const locker(&m_mutex);
-
-    PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-    if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first))
+    updateParams(page_id, [&color_mode](Params& params)
     {
-        Params params;
         params.setColorMode(color_mode);
-        m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-    }
-    else
-    {
-        it->second.setColorMode(color_mode);
-    }
+    });
 }
 
 void
 Settings::setBlackWhiteOptions(PageId const& page_id, BlackWhiteOptions const& black_white_options)
 {
-    QMutexLocker const locker(&m_mutex);
-
-    PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-    if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first))
+    updateParams(page_id, [&black_white_options](Params& params)
     {
-        Params params;
         params.setBlackWhiteOptions(black_white_options);
-        m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-    }
-    else
-    {
-        it->second.setBlackWhiteOptions(black_white_options);
-    }
+    });
 }
 
 void
 Settings::setBlackKmeansOptions(PageId const& page_id, BlackKmeansOptions const& black_kmeans_options)
 {
-    QMutexLocker const locker(&m_mutex);
-
-    PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-    if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first))
+    updateParams(page_id, [&black_kmeans_options](Params& params)
     {
-        Params params;
         params.setBlackKmeansOptions(black_kmeans_options);
-        m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-    }
-    else
-    {
-        it->second.setBlackKmeansOptions(black_kmeans_options);
-    }
+    });
 }
 
 void
 Settings::setMetricsOptions(PageId const& page_id, MetricsOptions const& metrics_options)
 {
-    QMutexLocker const locker(&m_mutex);
-
-    PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-    if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first))
+    updateParams(page_id, [&metrics_options](Params& params)
     {
-        Params params;
         params.setMetricsOptions(metrics_options);
-        m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-    }
-    else
-    {
-        it->second.setMetricsOptions(metrics_options);
-    }
+    });
 }
 
 void
 Settings::setDespeckleLevel(PageId const& page_id, DespeckleLevel level)
 {
-    QMutexLocker const locker(&m_mutex);
-
-    PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-    if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first))
+    updateParams(page_id, [&level](Params& params)
     {
-        Params params;
         params.setDespeckleLevel(level);
-        m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-    }
-    else
-    {
-        it->second.setDespeckleLevel(level);
-    }
+    });
 }
 
 void
 Settings::setDespeckleFactor(PageId const& page_id, double factor)
 {
-    QMutexLocker const locker(&m_mutex);
-
-    PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-    if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first))
+    updateParams(page_id, [&factor](Params& params)
     {
-        Params params;
         params.setDespeckleFactor(factor);
-        m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-    }
-    else
-    {
-        it->second.setDespeckleFactor(factor);
-    }
+    });
 }
 
 std::unique_ptr<OutputParams>
 Settings::getOutputParams(PageId const& page_id) const
 {
-    QMutexLocker const locker(&m_mutex);
-
-    PerPageOutputParams::const_iterator const it(m_perPageOutputParams.find(page_id));
-    if (it != m_perPageOutputParams.end())
+    PerPageOutputParams::ValuePtr const params(m_perPageOutputParams.find(page_id));
+    if (params)
     {
-        return std::unique_ptr<OutputParams>(new OutputParams(it->second));
+        return std::unique_ptr<OutputParams>(new OutputParams(*params));
     }
     else
     {
@@ -290,26 +209,22 @@ Settings::getOutputParams(PageId const& page_id) const
 void
 Settings::removeOutputParams(PageId const& page_id)
 {
-    QMutexLocker const locker(&m_mutex);
     m_perPageOutputParams.erase(page_id);
 }
 
 void
 Settings::setOutputParams(PageId const& page_id, OutputParams const& params)
 {
-    QMutexLocker const locker(&m_mutex);
-    Utils::mapSetValue(m_perPageOutputParams, page_id, params);
+    m_perPageOutputParams.set(page_id, params);
 }
 
 ZoneSet
 Settings::pictureZonesForPage(PageId const& page_id) const
 {
-    QMutexLocker const locker(&m_mutex);
-
-    PerPageZones::const_iterator const it(m_perPagePictureZones.find(page_id));
-    if (it != m_perPagePictureZones.end())
+    PerPageZones::ValuePtr const zones(m_perPagePictureZones.find(page_id));
+    if (zones)
     {
-        return it->second;
+        return *zones;
     }
     else
     {
@@ -320,12 +235,10 @@ Settings::pictureZonesForPage(PageId const& page_id) const
 ZoneSet
 Settings::fillZonesForPage(PageId const& page_id) const
 {
-    QMutexLocker const locker(&m_mutex);
-
-    PerPageZones::const_iterator const it(m_perPageFillZones.find(page_id));
-    if (it != m_perPageFillZones.end())
+    PerPageZones::ValuePtr const zones(m_perPageFillZones.find(page_id));
+    if (zones)
     {
-        return it->second;
+        return *zones;
     }
     else
     {
@@ -336,15 +249,13 @@ Settings::fillZonesForPage(PageId const& page_id) const
 void
 Settings::setPictureZones(PageId const& page_id, ZoneSet const& zones)
 {
-    QMutexLocker const locker(&m_mutex);
-    Utils::mapSetValue(m_perPagePictureZones, page_id, zones);
+    m_perPagePictureZones.set(page_id, zones);
 }
 
 void
 Settings::setFillZones(PageId const& page_id, ZoneSet const& zones)
 {
-    QMutexLocker const locker(&m_mutex);
-    Utils::mapSetValue(m_perPageFillZones, page_id, zones);
+    m_perPageFillZones.set(page_id, zones);
 }
 
 PropertySet
@@ -19,17 +19,18 @@
 #ifndef OUTPUT_SETTINGS_H_
 #define OUTPUT_SETTINGS_H_
 
-#include <map>
 #include <memory>
 #include <QMutex>
 #include "RefCountable.h"
 #include "NonCopyable.h"
+#include "SnapshotMap.h"
 #include "PageId.h"
 #include "ColorParams.h"
 #include "OutputParams.h"
 #include "DespeckleLevel.h"
 #include "ZoneSet.h"
 #include "PropertySet.h"
+#include "TiffCompression.h"
 
 class AbstractRelinker;
 
@@ -125,17 +126,32 @@ public:
     {
         m_scalingFactor = factor;
     }
+
+    /**
+     * \brief The codec used for the gray and color output files.
+     */
+    TiffCompression tiffCompression() const;
+
+    void setTiffCompression(TiffCompression const& compression);
 private:
-    typedef std::map<PageId, Params> PerPageParams;
-    typedef std::map<PageId, OutputParams> PerPageOutputParams;
-    typedef std::map<PageId, ZoneSet> PerPageZones;
+    typedef SnapshotMap<PageId, Params> PerPageParams;
+    typedef SnapshotMap<PageId, OutputParams> PerPageOutputParams;
+    typedef SnapshotMap<PageId, ZoneSet> PerPageZones;
+
+    template<typename Setter>
+    void updateParams(PageId const& page_id, Setter setter);
 
     static PropertySet initialPictureZoneProps();
 
     static PropertySet initialFillZoneProps();
 
+    /**
+     * Guards TIFF compression and default zone properties.
+     * Per-page settings are kept in snapshot maps and don't need it.
+     */
     mutable QMutex m_mutex;
     double m_scalingFactor;
+    TiffCompression m_tiffCompression;
     PerPageParams m_perPageParams;
     PerPageOutputParams m_perPageOutputParams;
     PerPageZones m_perPagePictureZones;
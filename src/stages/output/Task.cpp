@@ -41,6 +41,7 @@
 #include "RenderParams.h"
 #include "FilterUiInterface.h"
 #include "TaskStatus.h"
+#include "ProcessingProfiler.h"
 #include "BasicImageView.h"
 #include "ImageViewTab.h"
 #include "TabbedImageView.h"
@@ -83,7 +84,6 @@ public:
               std::unique_ptr<DebugImagesImpl> dbg_img,
               Params const& params,
               PageId const& page_id,
-              QImage const& orig_image,
               QImage const& output_image,
               std::function<QPointF(QPointF const&)> const& orig_to_output,
               std::function<QPointF(QPointF const&)> const& output_to_orig,
@@ -107,7 +107,6 @@ private:
     std::unique_ptr<DebugImagesImpl> m_ptrDbg;
     Params m_params;
     PageId m_pageId;
-    QImage m_origImage;
     QImage m_outputImage;
     std::function<QPointF(QPointF const&)> m_origToOutput;
     std::function<QPointF(QPointF const&)> m_outputToOrig;
@@ -150,17 +149,19 @@ FilterResultPtr
 Task::process(
     TaskStatus const& status,
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
-    QImage const& orig_image,
+    CachingFactory<QImage> const& orig_image_factory,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
     std::shared_ptr<AbstractImageTransform const> const& orig_image_transform,
     QRectF const& content_rect, QRectF const& outer_rect)
 {
+    ProfileScope const profile_scope("task", "output::Task", m_pageId.imageId().filePath());
+
     double const scaling_factor = m_ptrSettings->scalingFactor();
     std::shared_ptr<AbstractImageTransform> const scaled_transform(orig_image_transform->clone());
     QTransform const post_scale_xform(scaled_transform->scale(scaling_factor, scaling_factor));
 
     return processScaled(
-               status, accel_ops, orig_image, gray_orig_image_factory, scaled_transform,
+               status, accel_ops, orig_image_factory, gray_orig_image_factory, scaled_transform,
                post_scale_xform.mapRect(content_rect), post_scale_xform.mapRect(outer_rect)
            );
 }
@@ -169,7 +170,7 @@ FilterResultPtr
 Task::processScaled(
     TaskStatus const& status,
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
-    QImage const& orig_image,
+    CachingFactory<QImage> const& orig_image_factory,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
     std::shared_ptr<AbstractImageTransform const> const& orig_image_transform,
     QRectF const& content_rect, QRectF const& outer_rect)
@@ -180,6 +181,7 @@ Task::processScaled(
     RenderParams const render_params(params.colorParams());
     QString const out_file_path(m_outFileNameGen.filePathFor(m_pageId));
     QFileInfo const out_file_info(out_file_path);
+    OutputFileParams const source_file_params(QFileInfo(m_pageId.imageId().filePath()));
 
     QString const automask_dir(Utils::automaskDir(m_outFileNameGen.outDir()));
     QString const automask_file_path(
@@ -229,6 +231,15 @@ Task::processScaled(
             break;
         }
 
+        // Projects saved before the source file was recorded don't have
+        // its params. Don't force reprocessing of every page for them.
+        if (stored_output_params->sourceFileParams().isValid() &&
+            !stored_output_params->sourceFileParams().matches(source_file_params))
+        {
+            need_reprocess = true;
+            break;
+        }
+
         if (!PictureZoneComparator::equal(stored_output_params->pictureZones(), new_picture_zones))
         {
             need_reprocess = true;
@@ -334,7 +345,7 @@ Task::processScaled(
         speckles_img = BinaryImage();
 
         out_img = generator.process(
-                      status, accel_ops, orig_image, gray_orig_image_factory,
+                      status, accel_ops, orig_image_factory(), gray_orig_image_factory,
                       new_picture_zones, new_fill_zones,
                       write_automask ? &automask_img : nullptr,
                       write_speckles_file ? &speckles_img : nullptr,
@@ -356,40 +367,43 @@ Task::processScaled(
         }
 
         bool invalidate_params = false;
-
-        if (!TiffWriter::writeImage(out_file_path, out_img))
-        {
-            invalidate_params = true;
-        }
-        else
         {
-            deleteMutuallyExclusiveOutputFiles();
-        }
+            ProfileScope const profile_scope("output", "write");
 
-        if (write_automask)
-        {
-            // Note that QDir::mkdir() will fail if the parent directory,
-            // that is $OUT/cache doesn't exist. We want that behaviour,
-            // as otherwise when loading a project from a different machine,
-            // a whole bunch of bogus directories would be created.
-            QDir().mkdir(automask_dir);
-            // Also note that QDir::mkdir() will fail if the directory already exists,
-            // so we ignore its return value here.
-
-            if (!TiffWriter::writeImage(automask_file_path, automask_img.toQImage()))
+            if (!TiffWriter::writeImage(out_file_path, out_img, m_ptrSettings->tiffCompression()))
             {
                 invalidate_params = true;
             }
-        }
-        if (write_speckles_file)
-        {
-            if (!QDir().mkpath(speckles_dir))
+            else
             {
-                invalidate_params = true;
+                deleteMutuallyExclusiveOutputFiles();
             }
-            else if (!TiffWriter::writeImage(speckles_file_path, speckles_img.toQImage()))
+
+            if (write_automask)
             {
-                invalidate_params = true;
+                // Note that QDir::mkdir() will fail if the parent directory,
+                // that is $OUT/cache doesn't exist. We want that behaviour,
+                // as otherwise when loading a project from a different machine,
+                // a whole bunch of bogus directories would be created.
+                QDir().mkdir(automask_dir);
+                // Also note that QDir::mkdir() will fail if the directory already exists,
+                // so we ignore its return value here.
+
+                if (!TiffWriter::writeImage(automask_file_path, automask_img.toQImage()))
+                {
+                    invalidate_params = true;
+                }
+            }
+            if (write_speckles_file)
+            {
+                if (!QDir().mkpath(speckles_dir))
+                {
+                    invalidate_params = true;
+                }
+                else if (!TiffWriter::writeImage(speckles_file_path, speckles_img.toQImage()))
+                {
+                    invalidate_params = true;
+                }
             }
         }
 
@@ -402,7 +416,7 @@ Task::processScaled(
             // Note that we can't reuse *_file_info objects
             // as we've just overwritten those files.
             OutputParams const out_params(
-                new_output_image_params,
+                new_output_image_params, source_file_params,
                 OutputFileParams(QFileInfo(out_file_path)),
                 write_automask ? OutputFileParams(QFileInfo(automask_file_path))
                 : OutputFileParams(),
@@ -440,9 +454,9 @@ Task::processScaled(
 
     QRect const out_rect(generator.outputImageRect());
 
-    auto transform_orig_image = [orig_image, orig_image_transform, out_rect, accel_ops]()
+    auto transform_orig_image = [orig_image_factory, orig_image_transform, out_rect, accel_ops]()
     {
-        return orig_image_transform->materialize(orig_image, out_rect, Qt::transparent, accel_ops);
+        return orig_image_transform->materialize(orig_image_factory(), out_rect, Qt::transparent, accel_ops);
     };
     auto cached_transform_orig_image = cachingFactory<QImage>(transform_orig_image);
 
@@ -466,7 +480,7 @@ Task::processScaled(
     return FilterResultPtr(
                new UiUpdater(
                    m_ptrFilter, accel_ops, m_ptrSettings, std::move(m_ptrDbg), params,
-                   m_pageId, orig_image, out_img,
+                   m_pageId, out_img,
                    generator.origToOutputMapper(),
                    generator.outputToOrigMapper(),
                    automask_img, cached_transform_orig_image,
@@ -518,7 +532,6 @@ Task::UiUpdater::UiUpdater(
     std::unique_ptr<DebugImagesImpl> dbg_img,
     Params const& params,
     PageId const& page_id,
-    QImage const& orig_image,
     QImage const& output_image,
     std::function<QPointF(QPointF const&)> const& orig_to_output,
     std::function<QPointF(QPointF const&)> const& output_to_orig,
@@ -534,7 +547,6 @@ Task::UiUpdater::UiUpdater(
         m_ptrDbg(std::move(dbg_img)),
         m_params(params),
         m_pageId(page_id),
-        m_origImage(orig_image),
         m_outputImage(output_image),
         m_origToOutput(orig_to_output),
         m_outputToOrig(output_to_orig),
@@ -66,7 +66,7 @@ public:
     FilterResultPtr process(
         TaskStatus const& status,
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
-        QImage const& orig_image,
+        CachingFactory<QImage> const& orig_image_factory,
         CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
         std::shared_ptr<imageproc::AbstractImageTransform const> const& orig_image_transform,
         QRectF const& content_rect, QRectF const& outer_rect);
@@ -76,7 +76,7 @@ private:
     FilterResultPtr processScaled(
         TaskStatus const& status,
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
-        QImage const& orig_image,
+        CachingFactory<QImage> const& orig_image_factory,
         CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
         std::shared_ptr<imageproc::AbstractImageTransform const> const& orig_image_transform,
         QRectF const& content_rect, QRectF const& outer_rect);
@@ -31,6 +31,7 @@
 #include "Utils.h"
 #include "FilterUiInterface.h"
 #include "TaskStatus.h"
+#include "ProcessingProfiler.h"
 #include "ImageView.h"
 #include "BasicImageView.h"
 #include "ContentBox.h"
@@ -101,12 +102,14 @@ FilterResultPtr
 Task::process(
     TaskStatus const& status,
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
-    QImage const& orig_image,
+    CachingFactory<QImage> const& orig_image_factory,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
     std::shared_ptr<AbstractImageTransform const> const& orig_image_transform,
     boost::optional<AffineTransformedImage> pre_transformed_image,
     ContentBox const& content_box)
 {
+    ProfileScope const profile_scope("task", "page_layout::Task", m_pageId.imageId().filePath());
+
     status.throwIfCancelled();
 
     QSizeF agg_hard_size_before;
@@ -139,7 +142,7 @@ Task::process(
         page_layout.absorbScalingIntoTransform(*adjusted_transform);
 
         return m_ptrNextTask->process(
-                   status, accel_ops, orig_image, gray_orig_image_factory, adjusted_transform,
+                   status, accel_ops, orig_image_factory, gray_orig_image_factory, adjusted_transform,
                    page_layout.innerRect(), page_layout.extraRect(params.framings())
                );
     }
@@ -149,7 +152,7 @@ Task::process(
         if (!pre_transformed_image)
         {
             pre_transformed_image = orig_image_transform->toAffine(
-                                        orig_image, Qt::transparent, accel_ops
+                                        orig_image_factory(), Qt::transparent, accel_ops
                                     );
         }
 
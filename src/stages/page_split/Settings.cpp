@@ -20,14 +20,17 @@
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
 #include <QMutexLocker>
-#include <boost/foreach.hpp>
+#include <QThread>
+#include <atomic>
+#include <vector>
 #include <assert.h>
 
 namespace page_split
 {
 
 Settings::Settings()
-    : m_defaultLayoutType(AUTO_LAYOUT_TYPE)
+    : m_defaultLayoutType(AUTO_LAYOUT_TYPE),
+      m_layoutChanges(0)
 {
 }
 
@@ -38,150 +41,152 @@ Settings::~Settings()
 void
 Settings::clear()
 {
-    QMutexLocker locker(&m_mutex);
-
-    m_perPageRecords.clear();
-    m_defaultLayoutType = AUTO_LAYOUT_TYPE;
+    resetLayoutTypes(AUTO_LAYOUT_TYPE, true);
 }
 
 void
 Settings::performRelinking(AbstractRelinker const& relinker)
 {
-    QMutexLocker locker(&m_mutex);
-    PerPageRecords new_records;
-
-    BOOST_FOREACH(PerPageRecords::value_type const& kv, m_perPageRecords)
+    m_perPageRecords.rekey([&relinker](ImageId const& image_id)
     {
-        RelinkablePath const old_path(kv.first.filePath(), RelinkablePath::File);
-        ImageId new_image_id(kv.first);
+        RelinkablePath const old_path(image_id.filePath(), RelinkablePath::File);
+        ImageId new_image_id(image_id);
         new_image_id.setFilePath(relinker.substitutionPathFor(old_path));
-        new_records.insert(PerPageRecords::value_type(new_image_id, kv.second));
-    }
-
-    m_perPageRecords.swap(new_records);
+        return new_image_id;
+    });
 }
 
 LayoutType
 Settings::defaultLayoutType() const
 {
-    QMutexLocker locker(&m_mutex);
-    return m_defaultLayoutType;
+    return static_cast<LayoutType>(m_defaultLayoutType.loadAcquire());
 }
 
 void
 Settings::setLayoutTypeForAllPages(LayoutType const layout_type)
 {
-    QMutexLocker locker(&m_mutex);
+    resetLayoutTypes(layout_type, false);
+}
+
+void
+Settings::resetLayoutTypes(LayoutType const layout_type, bool const reset_records)
+{
+    QMutexLocker const locker(&m_layoutResetMutex);
 
-    PerPageRecords::iterator it(m_perPageRecords.begin());
-    PerPageRecords::iterator const end(m_perPageRecords.end());
-    while (it != end)
+    m_perPageRecords.updateAll(
+        [layout_type, reset_records](ImageId const&, std::unique_ptr<BaseRecord>& record)
     {
-        if (it->second.hasLayoutTypeConflict(layout_type))
+        if (reset_records || record->hasLayoutTypeConflict(layout_type))
         {
-            m_perPageRecords.erase(it++);
+            record.reset();
         }
         else
         {
-            it->second.clearLayoutType();
-            ++it;
+            record->clearLayoutType();
         }
+    },
+    [this, layout_type]()
+    {
+        // With all the records locked, page updates wait for us
+        // and never see the new default next to an old record.
+        // Readers don't lock, so they check m_layoutChanges.
+        m_layoutChanges.fetchAndAddOrdered(1);
+        m_defaultLayoutType.storeRelease(layout_type);
     }
+    );
 
-    m_defaultLayoutType = layout_type;
+    m_layoutChanges.fetchAndAddRelease(1);
 }
 
 void
 Settings::setLayoutTypeFor(LayoutType const layout_type, std::set<PageId> const& pages)
 {
-    QMutexLocker locker(&m_mutex);
-
     UpdateAction action;
     action.setLayoutType(layout_type);
 
-    BOOST_FOREACH(PageId const& page_id, pages)
+    std::vector<ImageId> images;
+    images.reserve(pages.size());
+    for (PageId const& page_id : pages)
     {
-        updatePageLocked(page_id.imageId(), action);
+        images.push_back(page_id.imageId());
     }
-}
-
-Settings::Record
-Settings::getPageRecord(ImageId const& image_id) const
-{
-    QMutexLocker locker(&m_mutex);
-    return getPageRecordLocked(image_id);
-}
 
-Settings::Record
-Settings::getPageRecordLocked(ImageId const& image_id) const
-{
-    PerPageRecords::const_iterator it(m_perPageRecords.find(image_id));
-    if (it == m_perPageRecords.end())
-    {
-        return Record(m_defaultLayoutType);
-    }
-    else
+    m_perPageRecords.updateBatch(
+        images, [this, &action](ImageId const&, std::unique_ptr<BaseRecord>& record)
     {
-        return Record(it->second, m_defaultLayoutType);
-    }
-}
-
-void
-Settings::updatePage(ImageId const& image_id, UpdateAction const& action)
-{
-    QMutexLocker locker(&m_mutex);
-    updatePageLocked(image_id, action);
+        updateRecord(record, action, defaultLayoutType());
+    });
 }
 
-void
-Settings::updatePageLocked(ImageId const& image_id, UpdateAction const& action)
+Settings::Record
+Settings::getPageRecord(ImageId const& image_id) const
 {
-    PerPageRecords::iterator it(m_perPageRecords.lower_bound(image_id));
-    if (it == m_perPageRecords.end() ||
-            m_perPageRecords.key_comp()(image_id, it->first))
+    for (;;)
     {
-        // No record exists for this page.
+        int const changes = m_layoutChanges.loadAcquire();
+        if (changes & 1)
+        {
+            // resetLayoutTypes() is in progress.
+            QThread::yieldCurrentThread();
+            continue;
+        }
 
-        Record record(m_defaultLayoutType);
-        record.update(action);
+        LayoutType const default_layout_type = defaultLayoutType();
+        PerPageRecords::ValuePtr const record(m_perPageRecords.find(image_id));
 
-        if (record.hasLayoutTypeConflict())
+        // Keeps the reads above from moving past the check below.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_layoutChanges.loadRelaxed() != changes)
         {
-            record.clearParams();
+            continue;
         }
 
-        if (!record.isNull())
+        if (!record)
         {
-            m_perPageRecords.insert(
-                it, PerPageRecords::value_type(image_id, record)
-            );
+            return Record(default_layout_type);
+        }
+        else
+        {
+            return Record(*record, default_layout_type);
         }
     }
-    else
+}
+
+void
+Settings::updatePage(ImageId const& image_id, UpdateAction const& action)
+{
+    m_perPageRecords.update(
+        image_id, [this, &action](std::unique_ptr<BaseRecord>& record)
     {
-        // A record was found.
-        updatePageLocked(it, action);
-    }
+        updateRecord(record, action, defaultLayoutType());
+    });
 }
 
 void
-Settings::updatePageLocked(PerPageRecords::iterator const it, UpdateAction const& action)
+Settings::updateRecord(
+    std::unique_ptr<BaseRecord>& record,
+    UpdateAction const& action, LayoutType const default_layout_type)
 {
-    Record record(it->second, m_defaultLayoutType);
-    record.update(action);
+    Record new_record(default_layout_type);
+    if (record)
+    {
+        new_record = Record(*record, default_layout_type);
+    }
 
-    if (record.hasLayoutTypeConflict())
+    new_record.update(action);
+
+    if (new_record.hasLayoutTypeConflict())
     {
-        record.clearParams();
+        new_record.clearParams();
     }
 
-    if (record.isNull())
+    if (new_record.isNull())
     {
-        m_perPageRecords.erase(it);
+        record.reset();
     }
     else
     {
-        it->second = record;
+        record.reset(new BaseRecord(new_record));
     }
 }
 
@@ -189,71 +194,51 @@ Settings::Record
 Settings::conditionalUpdate(
     ImageId const& image_id, UpdateAction const& action, bool* conflict)
 {
-    QMutexLocker locker(&m_mutex);
+    // Overwritten by the modifier below.
+    Record result(AUTO_LAYOUT_TYPE);
+    bool conflict_found = false;
 
-    PerPageRecords::iterator it(m_perPageRecords.lower_bound(image_id));
-    if (it == m_perPageRecords.end() ||
-            m_perPageRecords.key_comp()(image_id, it->first))
+    m_perPageRecords.update(image_id, [&](std::unique_ptr<BaseRecord>& record)
     {
-        // No record exists for this page.
-
-        Record record(m_defaultLayoutType);
-        record.update(action);
+        LayoutType const default_layout_type = defaultLayoutType();
+        result = Record(default_layout_type);
 
-        if (record.hasLayoutTypeConflict())
+        Record new_record(default_layout_type);
+        if (record)
         {
-            if (conflict)
-            {
-                *conflict = true;
-            }
-            return Record(m_defaultLayoutType);
+            new_record = Record(*record, default_layout_type);
         }
 
-        if (!record.isNull())
-        {
-            m_perPageRecords.insert(
-                it, PerPageRecords::value_type(image_id, record)
-            );
-        }
+        new_record.update(action);
 
-        if (conflict)
+        if (new_record.hasLayoutTypeConflict())
         {
-            *conflict = false;
-        }
-        return record;
-    }
-    else
-    {
-        // A record was found.
-
-        Record record(it->second, m_defaultLayoutType);
-        record.update(action);
-
-        if (record.hasLayoutTypeConflict())
-        {
-            if (conflict)
+            // Leave the record as it is.
+            conflict_found = true;
+            if (record)
             {
-                *conflict = true;
+                result = Record(*record, default_layout_type);
             }
-            return Record(it->second, m_defaultLayoutType);
-        }
-
-        if (conflict)
-        {
-            *conflict = false;
+            return;
         }
 
-        if (record.isNull())
+        if (new_record.isNull())
         {
-            m_perPageRecords.erase(it);
-            return Record(m_defaultLayoutType);
+            record.reset();
         }
         else
         {
-            it->second = record;
-            return record;
+            record.reset(new BaseRecord(new_record));
+            result = new_record;
         }
+    });
+
+    if (conflict)
+    {
+        *conflict = conflict_found;
     }
+
+    return result;
 }
 
 
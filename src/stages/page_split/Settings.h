@@ -26,9 +26,10 @@
 #include "Params.h"
 #include "ImageId.h"
 #include "PageId.h"
+#include "SnapshotMap.h"
+#include <QAtomicInt>
 #include <QMutex>
 #include <memory>
-#include <map>
 #include <set>
 
 class AbstractRelinker;
@@ -191,17 +192,40 @@ public:
         ImageId const& image_id, UpdateAction const& action,
         bool* conflict = 0);
 private:
-    typedef std::map<ImageId, BaseRecord> PerPageRecords;
+    typedef SnapshotMap<ImageId, BaseRecord> PerPageRecords;
 
-    Record getPageRecordLocked(ImageId const& image_id) const;
-
-    void updatePageLocked(ImageId const& image_id, UpdateAction const& action);
+    /**
+     * Applies \p action to \p record, which may be null or become null.
+     */
+    static void updateRecord(std::unique_ptr<BaseRecord>& record,
+                             UpdateAction const& action, LayoutType default_layout_type);
 
-    void updatePageLocked(PerPageRecords::iterator it, UpdateAction const& action);
+    /**
+     * Sets the default layout type and brings every record in line with it,
+     * \p reset_records telling whether to drop the records altogether.
+     */
+    void resetLayoutTypes(LayoutType layout_type, bool reset_records);
 
-    mutable QMutex m_mutex;
     PerPageRecords m_perPageRecords;
-    LayoutType m_defaultLayoutType;
+
+    /**
+     * Holds a LayoutType.  It's atomic rather than part of the records,
+     * so that reading a page record doesn't take any locks.
+     */
+    QAtomicInt m_defaultLayoutType;
+
+    /**
+     * Odd while resetLayoutTypes() is changing the default and the records,
+     * and incremented twice by every such call.  Readers that see it change
+     * retry, so they never combine a default with records of another one.
+     */
+    QAtomicInt m_layoutChanges;
+
+    /**
+     * Serializes resetLayoutTypes() calls, which keeps m_layoutChanges odd
+     * for as long as any of them runs.
+     */
+    QMutex m_layoutResetMutex;
 };
 
 } // namespace page_split
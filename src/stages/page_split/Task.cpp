@@ -18,6 +18,7 @@
 
 #include "Task.h"
 #include "TaskStatus.h"
+#include "ProcessingProfiler.h"
 #include "Filter.h"
 #include "OptionsWidget.h"
 #include "Settings.h"
@@ -125,17 +126,19 @@ FilterResultPtr
 Task::process(
     TaskStatus const& status,
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
-    QImage const& orig_image,
+    CachingFactory<QImage> const& orig_image_factory,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
     imageproc::AffineImageTransform const& orig_image_transform,
     OrthogonalRotation const& rotation)
 {
+    ProfileScope const profile_scope("task", "page_split::Task", m_pageInfo.imageId().filePath());
+
     status.throwIfCancelled();
 
     Settings::Record record(m_ptrSettings->getPageRecord(m_pageInfo.imageId()));
 
     Dependencies const deps(
-        orig_image.size(), rotation, record.combinedLayoutType()
+        orig_image_transform.origSize(), rotation, record.combinedLayoutType()
     );
 
     for (;;)
@@ -212,7 +215,7 @@ Task::process(
             )
         );
         return m_ptrNextTask->process(
-                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   status, accel_ops, orig_image_factory, gray_orig_image_factory,
                    cropping_transform, rotation
                );
     }
@@ -221,7 +224,7 @@ Task::process(
         return FilterResultPtr(
                    new UiUpdater(
                        m_ptrFilter, accel_ops, m_ptrPages, std::move(m_ptrDbg),
-                       AffineTransformedImage(orig_image, orig_image_transform),
+                       AffineTransformedImage(orig_image_factory(), orig_image_transform),
                        m_pageInfo, *record.params(),
                        record.combinedLayoutType() == AUTO_LAYOUT_TYPE,
                        m_batchProcessing
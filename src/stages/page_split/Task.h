@@ -70,7 +70,7 @@ public:
     FilterResultPtr process(
         TaskStatus const& status,
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
-        QImage const& orig_image,
+        CachingFactory<QImage> const& orig_image_factory,
         CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
         imageproc::AffineImageTransform const& orig_image_transform,
         OrthogonalRotation const& rotation);
@@ -17,11 +17,8 @@
 */
 
 #include "Settings.h"
-#include "Utils.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
-#include <QMutexLocker>
-#include <boost/foreach.hpp>
 
 namespace select_content
 {
@@ -37,50 +34,40 @@ Settings::~Settings()
 void
 Settings::clear()
 {
-    QMutexLocker locker(&m_mutex);
     m_pageParams.clear();
 }
 
 void
 Settings::performRelinking(AbstractRelinker const& relinker)
 {
-    QMutexLocker locker(&m_mutex);
-    PageParams new_params;
-
-    BOOST_FOREACH(PageParams::value_type const& kv, m_pageParams)
+    m_pageParams.rekey([&relinker](PageId const& page_id)
     {
-        RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
-        PageId new_page_id(kv.first);
+        RelinkablePath const old_path(page_id.imageId().filePath(), RelinkablePath::File);
+        PageId new_page_id(page_id);
         new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-        new_params.insert(PageParams::value_type(new_page_id, kv.second));
-    }
-
-    m_pageParams.swap(new_params);
+        return new_page_id;
+    });
 }
 
 void
 Settings::setPageParams(PageId const& page_id, Params const& params)
 {
-    QMutexLocker locker(&m_mutex);
-    Utils::mapSetValue(m_pageParams, page_id, params);
+    m_pageParams.set(page_id, params);
 }
 
 void
 Settings::clearPageParams(PageId const& page_id)
 {
-    QMutexLocker locker(&m_mutex);
     m_pageParams.erase(page_id);
 }
 
 std::unique_ptr<Params>
 Settings::getPageParams(PageId const& page_id) const
 {
-    QMutexLocker locker(&m_mutex);
-
-    PageParams::const_iterator const it(m_pageParams.find(page_id));
-    if (it != m_pageParams.end())
+    PageParams::ValuePtr const params(m_pageParams.find(page_id));
+    if (params)
     {
-        return std::unique_ptr<Params>(new Params(it->second));
+        return std::unique_ptr<Params>(new Params(*params));
     }
     else
     {
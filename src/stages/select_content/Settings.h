@@ -23,9 +23,8 @@
 #include "NonCopyable.h"
 #include "PageId.h"
 #include "Params.h"
-#include <QMutex>
+#include "SnapshotMap.h"
 #include <memory>
-#include <map>
 
 class AbstractRelinker;
 
@@ -50,9 +49,8 @@ public:
 
     std::unique_ptr<Params> getPageParams(PageId const& page_id) const;
 private:
-    typedef std::map<PageId, Params> PageParams;
+    typedef SnapshotMap<PageId, Params> PageParams;
 
-    mutable QMutex m_mutex;
     PageParams m_pageParams;
 };
 
@@ -25,6 +25,7 @@
 #include "Params.h"
 #include "Settings.h"
 #include "TaskStatus.h"
+#include "ProcessingProfiler.h"
 #include "ContentBoxFinder.h"
 #include "FilterUiInterface.h"
 #include "ImageView.h"
@@ -98,11 +99,12 @@ FilterResultPtr
 Task::process(
     TaskStatus const& status,
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
-    QImage const& orig_image,
+    CachingFactory<QImage> const& orig_image_factory,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
     std::shared_ptr<AbstractImageTransform const> const& orig_image_transform)
 {
-    assert(!orig_image.isNull());
+    ProfileScope const profile_scope("task", "select_content::Task", m_pageId.imageId().filePath());
+
     assert(orig_image_transform);
 
     status.throwIfCancelled();
@@ -136,7 +138,7 @@ Task::process(
     if (!params.get())
     {
         dewarped = orig_image_transform->toAffine(
-                       orig_image, Qt::transparent, accel_ops
+                       orig_image_factory(), Qt::transparent, accel_ops
                    );
 
         QRectF const content_rect(
@@ -158,7 +160,7 @@ Task::process(
     if (m_ptrNextTask)
     {
         return m_ptrNextTask->process(
-                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   status, accel_ops, orig_image_factory, gray_orig_image_factory,
                    orig_image_transform, dewarped, params->contentBox()
                );
     }
@@ -167,7 +169,7 @@ Task::process(
         if (!dewarped)
         {
             dewarped = orig_image_transform->toAffine(
-                           orig_image, Qt::transparent, accel_ops
+                           orig_image_factory(), Qt::transparent, accel_ops
                        );
         }
 
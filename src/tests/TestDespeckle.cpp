@@ -0,0 +1,91 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "Despeckle.h"
+#include "TaskStatus.h"
+#include "imageproc/BinaryImage.h"
+#include <QRect>
+#include <boost/test/unit_test.hpp>
+#include <thread>
+#include <stdlib.h>
+
+namespace Tests
+{
+
+using namespace imageproc;
+
+namespace
+{
+
+class NeverCancelled : public TaskStatus
+{
+public:
+    virtual void cancel() {}
+
+    virtual bool isCancelled() const
+    {
+        return false;
+    }
+
+    virtual void throwIfCancelled() const {}
+};
+
+/**
+ * Specks and blobs of different sizes close to each other, so that
+ * the outcome for many of them depends on their neighbours.
+ */
+BinaryImage randomSpecks(int const width, int const height, unsigned const seed)
+{
+    srand(seed);
+    BinaryImage img(width, height, WHITE);
+    for (int i = width * height / 40; i > 0; --i)
+    {
+        int const size = rand() % 8 == 0 ? 2 + rand() % 10 : 1 + rand() % 2;
+        img.fill(QRect(rand() % width, rand() % height, size, 1 + rand() % size), BLACK);
+    }
+    return img;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(DespeckleTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_result_does_not_depend_on_earlier_pages)
+{
+    NeverCancelled const status;
+    double const factor = 2.5;
+    BinaryImage const page(randomSpecks(300, 200, 1));
+
+    // A fresh thread starts with an empty connection table.
+    BinaryImage fresh;
+    std::thread([&]()
+    {
+        fresh = Despeckle::despeckle(page, factor, status);
+    }).join();
+
+    // Here the table has grown to hold the connections of a bigger page.
+    Despeckle::despeckle(randomSpecks(1500, 1000, 2), factor, status);
+    BinaryImage const after_big_page(Despeckle::despeckle(page, factor, status));
+
+    BOOST_CHECK(fresh == after_big_page);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
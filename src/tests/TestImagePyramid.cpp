@@ -0,0 +1,176 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ImagePyramid.h"
+#include "acceleration/NonAcceleratedOperations.h"
+#include <QImage>
+#include <QPointF>
+#include <QRect>
+#include <QRectF>
+#include <QTransform>
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace Tests
+{
+
+namespace
+{
+
+class CountingOperations : public NonAcceleratedOperations
+{
+public:
+    CountingOperations() : m_numTransforms(0) {}
+
+    virtual QImage affineTransform(
+        QImage const& src, QTransform const& xform,
+        QRect const& dst_rect, imageproc::OutsidePixels const& outside_pixels,
+        QSizeF const& min_mapping_area) const
+    {
+        ++m_numTransforms;
+        return NonAcceleratedOperations::affineTransform(
+                   src, xform, dst_rect, outside_pixels, min_mapping_area
+               );
+    }
+
+    int numTransforms() const
+    {
+        return m_numTransforms;
+    }
+private:
+    mutable std::atomic<int> m_numTransforms;
+};
+
+QImage uniformImage(int const width, int const height)
+{
+    QImage image(width, height, QImage::Format_RGB32);
+    image.fill(0xff408020);
+    return image;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(ImagePyramidTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_level_for_scale)
+{
+    // 301 >> 3 is the last height not below 32.
+    ImagePyramid pyramid(uniformImage(1001, 301), std::make_shared<NonAcceleratedOperations>());
+    BOOST_REQUIRE_EQUAL(pyramid.maxLevel(), 3);
+
+    BOOST_CHECK_EQUAL(pyramid.levelFor(2.0), 0);
+    BOOST_CHECK_EQUAL(pyramid.levelFor(1.0), 0);
+    BOOST_CHECK_EQUAL(pyramid.levelFor(0.75), 0);
+    BOOST_CHECK_EQUAL(pyramid.levelFor(0.5), 1);
+    BOOST_CHECK_EQUAL(pyramid.levelFor(0.3), 1);
+    BOOST_CHECK_EQUAL(pyramid.levelFor(0.25), 2);
+    BOOST_CHECK_EQUAL(pyramid.levelFor(0.125), 3);
+    BOOST_CHECK_EQUAL(pyramid.levelFor(0.001), 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_level_to_image)
+{
+    QImage const image(uniformImage(1001, 301));
+    ImagePyramid pyramid(image, std::make_shared<NonAcceleratedOperations>());
+
+    for (int level = 0; level <= pyramid.maxLevel(); ++level)
+    {
+        QImage const level_image(pyramid.level(level));
+        BOOST_REQUIRE_EQUAL(level_image.width(), image.width() >> level);
+        BOOST_REQUIRE_EQUAL(level_image.height(), image.height() >> level);
+
+        // The corners of the level map to the corners of the image,
+        // even though the sizes don't divide evenly.
+        QTransform const xform(pyramid.levelToImage(level));
+        QPointF const corner(xform.map(QPointF(level_image.width(), level_image.height())));
+        BOOST_CHECK_CLOSE(corner.x(), image.width(), 1e-9);
+        BOOST_CHECK_CLOSE(corner.y(), image.height(), 1e-9);
+        BOOST_CHECK_SMALL(xform.map(QPointF(0, 0)).x(), 1e-9);
+
+        QRgb const center = level_image.pixel(level_image.width() / 2, level_image.height() / 2);
+        BOOST_CHECK_EQUAL(center, image.pixel(0, 0));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_levels_are_built_once)
+{
+    std::shared_ptr<CountingOperations> const ops(std::make_shared<CountingOperations>());
+    ImagePyramid pyramid(uniformImage(1024, 1024), ops);
+    int const max_level = pyramid.maxLevel();
+    BOOST_REQUIRE_EQUAL(max_level, 5);
+
+    std::vector<QImage> results(8);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < (int)results.size(); ++i)
+    {
+        threads.emplace_back([&pyramid, &results, i, max_level]()
+        {
+            results[i] = pyramid.level(max_level - i % 2);
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    BOOST_CHECK_EQUAL(ops->numTransforms(), max_level);
+    for (int i = 0; i < (int)results.size(); ++i)
+    {
+        BOOST_CHECK(results[i] == pyramid.level(max_level - i % 2));
+    }
+    BOOST_CHECK_EQUAL(ops->numTransforms(), max_level);
+}
+
+BOOST_AUTO_TEST_CASE(test_tiles_covering)
+{
+    int const tile = 256;
+
+    BOOST_CHECK(ImagePyramid::tilesCovering(QRectF(), tile).isEmpty());
+    BOOST_CHECK(
+        ImagePyramid::tilesCovering(QRectF(0, 0, 512, 256), tile)
+        == QRect(0, 0, 2, 1)
+    );
+    BOOST_CHECK(
+        ImagePyramid::tilesCovering(QRectF(255.5, 10, 1, 300), tile)
+        == QRect(0, 0, 2, 2)
+    );
+
+    // Negative coordinates must round down rather than towards zero.
+    BOOST_CHECK(
+        ImagePyramid::tilesCovering(QRectF(-300, -10, 310, 530), tile)
+        == QRect(QPoint(-2, -1), QPoint(0, 2))
+    );
+    BOOST_CHECK(
+        ImagePyramid::tilesCovering(QRectF(-512, -256, 512, 256), tile)
+        == QRect(QPoint(-2, -1), QPoint(-1, -1))
+    );
+
+    // A rotated image lands on negative tile coordinates.
+    QRectF const rotated(QTransform().rotate(90).mapRect(QRectF(0, 0, 600, 300)));
+    BOOST_CHECK(
+        ImagePyramid::tilesCovering(rotated, tile)
+        == QRect(QPoint(-2, 0), QPoint(-1, 2))
+    );
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
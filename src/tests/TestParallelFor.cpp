@@ -0,0 +1,215 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ParallelFor.h"
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace Tests
+{
+
+namespace
+{
+
+/**
+ * Tracks how many threads are inside the bodies of parallelFor() calls
+ * at once.  Nested bodies on the same thread count once.
+ */
+class ThreadCounter
+{
+public:
+    ThreadCounter() : m_numThreads(0), m_peak(0) {}
+
+    void enter()
+    {
+        if (t_depth++ > 0)
+        {
+            return;
+        }
+
+        int const num_threads = ++m_numThreads;
+        int peak = m_peak;
+        while (num_threads > peak && !m_peak.compare_exchange_weak(peak, num_threads))
+        {
+        }
+    }
+
+    void leave()
+    {
+        if (--t_depth == 0)
+        {
+            --m_numThreads;
+        }
+    }
+
+    int peak() const
+    {
+        return m_peak;
+    }
+private:
+    static thread_local int t_depth;
+    std::atomic<int> m_numThreads;
+    std::atomic<int> m_peak;
+};
+
+thread_local int ThreadCounter::t_depth = 0;
+
+/**
+ * Gives other threads the time to pick up chunks while we are busy.
+ */
+void work(ThreadCounter& counter)
+{
+    counter.enter();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    counter.leave();
+}
+
+/**
+ * Sets the thread limit for the lifetime of the object.
+ */
+class ThreadLimitGuard
+{
+public:
+    explicit ThreadLimitGuard(int const limit) : m_oldLimit(parallelForThreadLimit())
+    {
+        setParallelForThreadLimit(limit);
+    }
+
+    ~ThreadLimitGuard()
+    {
+        setParallelForThreadLimit(m_oldLimit);
+    }
+private:
+    int const m_oldLimit;
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(ParallelForTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_all_items_processed_once)
+{
+    ThreadLimitGuard const guard(4);
+
+    std::vector<std::atomic<int>> visits(1001);
+    for (std::atomic<int>& v : visits)
+    {
+        v = 0;
+    }
+
+    // Boost.Test assertions aren't thread-safe, so the body only records.
+    std::atomic<bool> bad_chunk(false);
+    parallelFor(0, (int)visits.size(), 7, [&](int const begin, int const end)
+    {
+        if (end - begin < 1 || end - begin > 7)
+        {
+            bad_chunk = true;
+        }
+        for (int i = begin; i < end; ++i)
+        {
+            ++visits[i];
+        }
+    });
+
+    BOOST_CHECK(!bad_chunk);
+    for (std::atomic<int> const& v : visits)
+    {
+        BOOST_REQUIRE_EQUAL(v.load(), 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_unscoped_caller_stays_within_limit)
+{
+    int const limit = 3;
+    ThreadLimitGuard const guard(limit);
+    ThreadCounter counter;
+
+    parallelFor(0, 64, 1, [&](int, int)
+    {
+        work(counter);
+    });
+
+    BOOST_CHECK_LE(counter.peak(), limit);
+    // Helpers were started at all.
+    BOOST_CHECK_GT(counter.peak(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_nested_calls_stay_within_limit)
+{
+    int const limit = 3;
+    ThreadLimitGuard const guard(limit);
+    ThreadCounter counter;
+
+    // The calling thread isn't a page worker, but parallelFor() has to
+    // count it, or the inner calls would start helpers of their own.
+    parallelFor(0, 16, 1, [&](int, int)
+    {
+        counter.enter();
+        parallelFor(0, 8, 1, [&](int, int)
+        {
+            work(counter);
+        });
+        counter.leave();
+    });
+
+    BOOST_CHECK_LE(counter.peak(), limit);
+}
+
+BOOST_AUTO_TEST_CASE(test_scoped_workers_share_the_limit)
+{
+    int const limit = 3;
+    ThreadLimitGuard const guard(limit);
+    ThreadCounter counter;
+
+    // Two page workers leave room for a single helper between them.
+    // They only start once both are counted, as helpers started before
+    // a worker comes along don't go away for it.
+    int const num_workers = 2;
+    std::atomic<int> num_ready(0);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < num_workers; ++i)
+    {
+        workers.emplace_back([&]()
+        {
+            ParallelForWorkerScope const scope;
+            ++num_ready;
+            while (num_ready < num_workers)
+            {
+                std::this_thread::yield();
+            }
+
+            parallelFor(0, 32, 1, [&](int, int)
+            {
+                work(counter);
+            });
+        });
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    BOOST_CHECK_LE(counter.peak(), limit);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
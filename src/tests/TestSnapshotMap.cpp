@@ -0,0 +1,299 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SnapshotMap.h"
+#include <QHash>
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace Tests
+{
+
+namespace
+{
+
+/**
+ * Writers always change both members together, so seeing them differ
+ * means seeing a value in the middle of an update.
+ */
+struct Counter
+{
+    int first;
+    int second;
+
+    explicit Counter(int value = 0) : first(value), second(value) {}
+
+    void increment()
+    {
+        ++first;
+        ++second;
+    }
+};
+
+typedef SnapshotMap<int, Counter> Counters;
+
+int valueOf(Counters const& map, int const key)
+{
+    Counters::ValuePtr const value(map.find(key));
+    return value ? value->first : -1;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(SnapshotMapTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_single_entry_operations)
+{
+    Counters map;
+    BOOST_CHECK(!map.find(1));
+
+    map.set(1, Counter(10));
+    Counters::ValuePtr const snapshot(map.find(1));
+    BOOST_REQUIRE(snapshot);
+    BOOST_CHECK_EQUAL(snapshot->first, 10);
+
+    map.update(1, [](std::unique_ptr<Counter>& value)
+    {
+        BOOST_REQUIRE(value);
+        value->increment();
+    });
+    BOOST_CHECK_EQUAL(valueOf(map, 1), 11);
+    // Values already handed out stay as they were.
+    BOOST_CHECK_EQUAL(snapshot->first, 10);
+
+    map.update(2, [](std::unique_ptr<Counter>& value)
+    {
+        BOOST_CHECK(!value);
+        value.reset(new Counter(20));
+    });
+    BOOST_CHECK_EQUAL(valueOf(map, 2), 20);
+
+    map.update(2, [](std::unique_ptr<Counter>& value)
+    {
+        value.reset();
+    });
+    BOOST_CHECK(!map.find(2));
+
+    map.erase(1);
+    BOOST_CHECK(!map.find(1));
+}
+
+BOOST_AUTO_TEST_CASE(test_batch_and_whole_map_operations)
+{
+    Counters map;
+    for (int key = 0; key < 100; ++key)
+    {
+        map.set(key, Counter(key));
+    }
+
+    std::vector<int> const keys { 3, 50, 200 };
+    map.updateBatch(keys, [](int const key, std::unique_ptr<Counter>& value)
+    {
+        if (key == 200)
+        {
+            BOOST_CHECK(!value);
+            value.reset(new Counter(key));
+        }
+        else
+        {
+            value->increment();
+        }
+    });
+    BOOST_CHECK_EQUAL(valueOf(map, 3), 4);
+    BOOST_CHECK_EQUAL(valueOf(map, 50), 51);
+    BOOST_CHECK_EQUAL(valueOf(map, 200), 200);
+
+    // Drop the odd keys and double the rest.
+    map.updateAll([](int const key, std::unique_ptr<Counter>& value)
+    {
+        BOOST_REQUIRE(value);
+        if (key % 2)
+        {
+            value.reset();
+        }
+        else
+        {
+            value.reset(new Counter(key * 2));
+        }
+    });
+    for (int key = 0; key < 100; ++key)
+    {
+        BOOST_CHECK_EQUAL(valueOf(map, key), key % 2 ? -1 : key * 2);
+    }
+
+    map.clear();
+    BOOST_CHECK(!map.find(0));
+    BOOST_CHECK(!map.find(200));
+}
+
+BOOST_AUTO_TEST_CASE(test_rekey_keeps_the_value_of_the_smallest_key)
+{
+    Counters map;
+    for (int key = 0; key < 100; ++key)
+    {
+        map.set(key, Counter(key));
+    }
+
+    // Four keys map to each new key.  The keys are spread over all
+    // shards, so the outcome doesn't depend on the order of shards.
+    map.rekey([](int const key)
+    {
+        return key / 4;
+    });
+
+    for (int key = 0; key < 25; ++key)
+    {
+        BOOST_CHECK_EQUAL(valueOf(map, key), key * 4);
+    }
+    BOOST_CHECK(!map.find(25));
+}
+
+BOOST_AUTO_TEST_CASE(test_update_all_prepares_with_all_entries_locked)
+{
+    int const num_keys = 64;
+    Counters map;
+    for (int key = 0; key < num_keys; ++key)
+    {
+        map.set(key, Counter(0));
+    }
+
+    // Each updateAll() pass bumps the generation and every value to match.
+    // Updates of single entries must never see them disagree.
+    std::atomic<int> generation(0);
+    std::atomic<bool> mismatch(false);
+    std::atomic<bool> done(false);
+
+    std::thread updater([&]()
+    {
+        for (int key = 0; !done; key = (key + 1) % num_keys)
+        {
+            map.update(key, [&](std::unique_ptr<Counter>& value)
+            {
+                if (value->first != generation)
+                {
+                    mismatch = true;
+                }
+            });
+        }
+    });
+
+    for (int pass = 0; pass < 200; ++pass)
+    {
+        map.updateAll(
+            [](int, std::unique_ptr<Counter>& value)
+        {
+            value->increment();
+        },
+        [&generation]()
+        {
+            ++generation;
+        }
+        );
+    }
+    done = true;
+    updater.join();
+
+    BOOST_CHECK(!mismatch);
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_reads_and_writes)
+{
+    int const num_keys = 64;
+    int const num_writers = 4;
+    int const increments_per_writer = 20000;
+    int const num_passes = 50;
+
+    Counters map;
+    for (int key = 0; key < num_keys; ++key)
+    {
+        map.set(key, Counter(0));
+    }
+
+    std::atomic<bool> torn(false);
+    std::atomic<int> writers_left(num_writers + 1);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_writers; ++i)
+    {
+        threads.emplace_back([&, i]()
+        {
+            for (int n = 0; n < increments_per_writer; ++n)
+            {
+                map.update((n * 7 + i) % num_keys, [](std::unique_ptr<Counter>& value)
+                {
+                    value->increment();
+                });
+            }
+            --writers_left;
+        });
+    }
+    threads.emplace_back([&]()
+    {
+        for (int pass = 0; pass < num_passes; ++pass)
+        {
+            map.updateAll([](int, std::unique_ptr<Counter>& value)
+            {
+                value->increment();
+            });
+        }
+        --writers_left;
+    });
+    for (int i = 0; i < 2; ++i)
+    {
+        threads.emplace_back([&]()
+        {
+            std::vector<int> last_seen(num_keys, 0);
+            while (writers_left > 0)
+            {
+                for (int key = 0; key < num_keys; ++key)
+                {
+                    Counters::ValuePtr const value(map.find(key));
+                    if (!value || value->first != value->second || value->first < last_seen[key])
+                    {
+                        torn = true;
+                    }
+                    else
+                    {
+                        last_seen[key] = value->first;
+                    }
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    BOOST_CHECK(!torn);
+
+    // No increment got lost.
+    int total = 0;
+    for (int key = 0; key < num_keys; ++key)
+    {
+        total += valueOf(map, key);
+    }
+    BOOST_CHECK_EQUAL(total, num_writers * increments_per_writer + num_passes * num_keys);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
@@ -0,0 +1,261 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ThumbnailPack.h"
+#include <QImage>
+#include <QFile>
+#include <QFileInfo>
+#include <QString>
+#include <QTemporaryDir>
+#include <QColor>
+#include <QVector>
+#include <boost/test/unit_test.hpp>
+#include <stdint.h>
+#include <stdlib.h>
+
+namespace Tests
+{
+
+namespace
+{
+
+QImage randomImage(int const width, int const height, QImage::Format const format)
+{
+    QImage image(width, height, format);
+    int const bytes = image.bytesPerLine() * image.height();
+    uint8_t* data = image.bits();
+    for (int i = 0; i < bytes; ++i)
+    {
+        data[i] = static_cast<uint8_t>(rand());
+    }
+
+    if (format == QImage::Format_Mono)
+    {
+        QVector<QRgb> color_table(2);
+        color_table[0] = 0xffffffff;
+        color_table[1] = 0xff000000;
+        image.setColorTable(color_table);
+    }
+    else if (format == QImage::Format_Indexed8)
+    {
+        QVector<QRgb> color_table(256);
+        for (int i = 0; i < 256; ++i)
+        {
+            color_table[i] = qRgb(rand() & 0xFF, rand() & 0xFF, rand() & 0xFF);
+        }
+        image.setColorTable(color_table);
+    }
+    else if (format == QImage::Format_ARGB32_Premultiplied)
+    {
+        // Keep the pixels valid premultiplied colors.
+        for (int y = 0; y < height; ++y)
+        {
+            QRgb* line = (QRgb*)image.scanLine(y);
+            for (int x = 0; x < width; ++x)
+            {
+                line[x] |= 0xFF000000;
+            }
+        }
+    }
+
+    return image;
+}
+
+bool sameImages(QImage const& image1, QImage const& image2)
+{
+    if (image1.format() != image2.format() || image1.size() != image2.size())
+    {
+        return false;
+    }
+
+    for (int y = 0; y < image1.height(); ++y)
+    {
+        for (int x = 0; x < image1.width(); ++x)
+        {
+            if (image1.pixel(x, y) != image2.pixel(x, y))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+qint64 fileSize(QString const& path)
+{
+    return QFileInfo(path).size();
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(ThumbnailPackTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_save_and_load)
+{
+    QTemporaryDir dir;
+    BOOST_REQUIRE(dir.isValid());
+    QString const path(dir.path() + "/thumbs.pack");
+
+    QImage const mono(randomImage(37, 29, QImage::Format_Mono));
+    QImage const indexed(randomImage(41, 23, QImage::Format_Indexed8));
+    QImage const rgb(randomImage(33, 31, QImage::Format_RGB32));
+    QImage const argb(randomImage(29, 37, QImage::Format_ARGB32_Premultiplied));
+
+    {
+        ThumbnailPack pack(path);
+        BOOST_CHECK(!pack.contains("mono"));
+        BOOST_CHECK(pack.load("mono").isNull());
+
+        BOOST_REQUIRE(pack.save("mono", mono, "fp1"));
+        BOOST_REQUIRE(pack.save("indexed", indexed, "fp2"));
+        BOOST_REQUIRE(pack.save("rgb", rgb, "fp3"));
+        BOOST_REQUIRE(pack.save("argb", argb, "fp4"));
+
+        BOOST_CHECK(sameImages(pack.load("mono"), mono));
+        BOOST_CHECK(sameImages(pack.load("rgb"), rgb));
+    }
+
+    // Everything has to survive reopening.
+    ThumbnailPack pack(path);
+    QString fingerprint;
+    BOOST_CHECK(pack.contains("indexed", &fingerprint));
+    BOOST_CHECK(fingerprint == "fp2");
+    BOOST_CHECK(sameImages(pack.load("mono"), mono));
+    BOOST_CHECK(sameImages(pack.load("indexed"), indexed));
+    BOOST_CHECK(sameImages(pack.load("rgb"), rgb));
+    BOOST_CHECK(sameImages(pack.load("argb"), argb));
+}
+
+BOOST_AUTO_TEST_CASE(test_formats_without_fixed_byte_order_are_converted)
+{
+    QTemporaryDir dir;
+    BOOST_REQUIRE(dir.isValid());
+
+    QImage const rgb16(randomImage(19, 17, QImage::Format_RGB16));
+
+    ThumbnailPack pack(dir.path() + "/thumbs.pack");
+    BOOST_REQUIRE(pack.save("rgb16", rgb16, "fp"));
+    BOOST_CHECK(sameImages(pack.load("rgb16"), rgb16.convertToFormat(QImage::Format_RGB32)));
+}
+
+BOOST_AUTO_TEST_CASE(test_supersede)
+{
+    QTemporaryDir dir;
+    BOOST_REQUIRE(dir.isValid());
+    QString const path(dir.path() + "/thumbs.pack");
+
+    QImage const old_image(randomImage(20, 20, QImage::Format_RGB32));
+    QImage const new_image(randomImage(30, 10, QImage::Format_RGB32));
+
+    {
+        ThumbnailPack pack(path);
+        BOOST_REQUIRE(pack.save("key", old_image, "old"));
+        BOOST_REQUIRE(pack.save("key", new_image, "new"));
+
+        QString fingerprint;
+        BOOST_CHECK(pack.contains("key", &fingerprint));
+        BOOST_CHECK(fingerprint == "new");
+        BOOST_CHECK(sameImages(pack.load("key"), new_image));
+    }
+
+    ThumbnailPack pack(path);
+    QString fingerprint;
+    BOOST_CHECK(pack.contains("key", &fingerprint));
+    BOOST_CHECK(fingerprint == "new");
+    BOOST_CHECK(sameImages(pack.load("key"), new_image));
+}
+
+BOOST_AUTO_TEST_CASE(test_compact)
+{
+    QTemporaryDir dir;
+    BOOST_REQUIRE(dir.isValid());
+    QString const path(dir.path() + "/thumbs.pack");
+
+    QImage const image1(randomImage(40, 40, QImage::Format_RGB32));
+    QImage const image2(randomImage(40, 40, QImage::Format_RGB32));
+
+    {
+        ThumbnailPack pack(path);
+        BOOST_REQUIRE(pack.save("key1", image1, "fp1"));
+        BOOST_REQUIRE(pack.save("key2", image2, "fp2"));
+    }
+    qint64 const live_size = fileSize(path);
+
+    ThumbnailPack pack(path);
+
+    // Not worth it yet.
+    BOOST_REQUIRE(pack.save("key2", image2, "fp2"));
+    BOOST_CHECK(pack.compactIfWasteful());
+    BOOST_CHECK(fileSize(path) > live_size);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        BOOST_REQUIRE(pack.save("key2", image2, "fp2"));
+    }
+    BOOST_CHECK(pack.compactIfWasteful());
+    BOOST_CHECK_EQUAL(fileSize(path), live_size);
+
+    BOOST_CHECK(sameImages(pack.load("key1"), image1));
+    BOOST_CHECK(sameImages(pack.load("key2"), image2));
+
+    // The pack keeps working after having replaced its file.
+    BOOST_REQUIRE(pack.save("key3", image1, "fp3"));
+    BOOST_CHECK(sameImages(pack.load("key3"), image1));
+}
+
+BOOST_AUTO_TEST_CASE(test_truncated_tail)
+{
+    QTemporaryDir dir;
+    BOOST_REQUIRE(dir.isValid());
+    QString const path(dir.path() + "/thumbs.pack");
+
+    QImage const image1(randomImage(25, 25, QImage::Format_Indexed8));
+    QImage const image2(randomImage(25, 25, QImage::Format_Indexed8));
+
+    qint64 first_record_end = 0;
+    {
+        ThumbnailPack pack(path);
+        BOOST_REQUIRE(pack.save("key1", image1, "fp1"));
+        first_record_end = fileSize(path);
+        BOOST_REQUIRE(pack.save("key2", image2, "fp2"));
+    }
+
+    // Simulate a crash in the middle of writing the second record.
+    {
+        QFile file(path);
+        BOOST_REQUIRE(file.resize(fileSize(path) - 7));
+    }
+
+    {
+        ThumbnailPack pack(path);
+        BOOST_CHECK(sameImages(pack.load("key1"), image1));
+        BOOST_CHECK(!pack.contains("key2"));
+        BOOST_CHECK_EQUAL(fileSize(path), first_record_end);
+
+        BOOST_REQUIRE(pack.save("key2", image2, "fp2"));
+    }
+
+    ThumbnailPack pack(path);
+    BOOST_CHECK(sameImages(pack.load("key1"), image1));
+    BOOST_CHECK(sameImages(pack.load("key2"), image2));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
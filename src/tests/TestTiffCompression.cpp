@@ -0,0 +1,102 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "TiffCompression.h"
+#include <QString>
+#include <boost/test/unit_test.hpp>
+
+namespace Tests
+{
+
+BOOST_AUTO_TEST_SUITE(TiffCompressionTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_default)
+{
+    TiffCompression const compression;
+    BOOST_CHECK(compression.codec() == TiffCompression::LZW);
+    BOOST_CHECK_EQUAL(compression.level(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_parsing)
+{
+    BOOST_CHECK(TiffCompression(QString("none")) == TiffCompression(TiffCompression::NONE));
+    BOOST_CHECK(TiffCompression(QString("lzw")) == TiffCompression(TiffCompression::LZW));
+    BOOST_CHECK(TiffCompression(QString("packbits")) == TiffCompression(TiffCompression::PACKBITS));
+    BOOST_CHECK(TiffCompression(QString("Deflate")) == TiffCompression(TiffCompression::DEFLATE));
+    BOOST_CHECK(TiffCompression(QString("deflate:6")) == TiffCompression(TiffCompression::DEFLATE, 6));
+    BOOST_CHECK(TiffCompression(QString("ZSTD:19")) == TiffCompression(TiffCompression::ZSTD, 19));
+
+    // Unknown codecs fall back to the default.
+    BOOST_CHECK(TiffCompression(QString("jpeg")) == TiffCompression());
+    BOOST_CHECK(TiffCompression(QString("")) == TiffCompression());
+}
+
+BOOST_AUTO_TEST_CASE(test_level_clamping)
+{
+    BOOST_CHECK_EQUAL(TiffCompression(TiffCompression::DEFLATE, 15).level(), 9);
+    BOOST_CHECK_EQUAL(TiffCompression(TiffCompression::ZSTD, 30).level(), 22);
+    BOOST_CHECK_EQUAL(TiffCompression(TiffCompression::ZSTD, -3).level(), 0);
+    BOOST_CHECK_EQUAL(TiffCompression(TiffCompression::LZW, 5).level(), 0);
+    BOOST_CHECK_EQUAL(TiffCompression(QString("deflate:15")).level(), 9);
+    BOOST_CHECK_EQUAL(TiffCompression(QString("zstd:30")).level(), 22);
+    BOOST_CHECK_EQUAL(TiffCompression(QString("packbits:4")).level(), 0);
+    BOOST_CHECK_EQUAL(TiffCompression(QString("deflate:x")).level(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_string_round_trip)
+{
+    static TiffCompression const compressions[] = {
+        TiffCompression(TiffCompression::NONE),
+        TiffCompression(TiffCompression::LZW),
+        TiffCompression(TiffCompression::PACKBITS),
+        TiffCompression(TiffCompression::DEFLATE),
+        TiffCompression(TiffCompression::DEFLATE, 1),
+        TiffCompression(TiffCompression::DEFLATE, 9),
+        TiffCompression(TiffCompression::ZSTD),
+        TiffCompression(TiffCompression::ZSTD, 22)
+    };
+    for (TiffCompression const& compression : compressions)
+    {
+        QString const str(compression.toString());
+        BOOST_CHECK(TiffCompression::isValid(str));
+        BOOST_CHECK(TiffCompression(str) == compression);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_validation)
+{
+    BOOST_CHECK(TiffCompression::isValid("lzw"));
+    BOOST_CHECK(TiffCompression::isValid("LZW"));
+    BOOST_CHECK(TiffCompression::isValid("deflate:0"));
+    BOOST_CHECK(TiffCompression::isValid("deflate:9"));
+    BOOST_CHECK(TiffCompression::isValid("zstd:22"));
+
+    BOOST_CHECK(!TiffCompression::isValid(""));
+    BOOST_CHECK(!TiffCompression::isValid("jpeg"));
+    BOOST_CHECK(!TiffCompression::isValid("lzw:1"));
+    BOOST_CHECK(!TiffCompression::isValid("deflate:10"));
+    BOOST_CHECK(!TiffCompression::isValid("deflate:-1"));
+    BOOST_CHECK(!TiffCompression::isValid("deflate:"));
+    BOOST_CHECK(!TiffCompression::isValid("deflate:x"));
+    BOOST_CHECK(!TiffCompression::isValid("zstd:23"));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
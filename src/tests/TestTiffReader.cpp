@@ -0,0 +1,334 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "TiffReader.h"
+#include <QImage>
+#include <QSize>
+#include <QFile>
+#include <QTemporaryFile>
+#include <QColor>
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <vector>
+#include <tiff.h>
+#include <tiffio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace Tests
+{
+
+namespace
+{
+
+enum Layout { STRIPS, TILES };
+
+/**
+ * A page with \p bpp of 1, 8 or 24, stored as gray levels or as RGB triplets.
+ * Bilevel pages only have levels of 0 and 255.
+ */
+class TestPage
+{
+public:
+    TestPage(int width, int height, int bpp)
+        : m_width(width), m_height(height), m_bpp(bpp),
+          m_samples(width * height * (bpp == 24 ? 3 : 1))
+    {
+        srand(width * 1000 + height + bpp);
+        for (size_t i = 0; i < m_samples.size(); ++i)
+        {
+            m_samples[i] = static_cast<uint8_t>(bpp == 1 ? (rand() & 1) * 255 : rand() & 0xFF);
+        }
+    }
+
+    int width() const
+    {
+        return m_width;
+    }
+
+    int height() const
+    {
+        return m_height;
+    }
+
+    int bpp() const
+    {
+        return m_bpp;
+    }
+
+    QRgb pixel(int x, int y) const
+    {
+        size_t const idx = size_t(y) * m_width + x;
+        if (m_bpp == 24)
+        {
+            uint8_t const* p = &m_samples[idx * 3];
+            return qRgb(p[0], p[1], p[2]);
+        }
+        return qRgb(m_samples[idx], m_samples[idx], m_samples[idx]);
+    }
+
+    /**
+     * Packs a line the way it's stored in the file.
+     * Bilevel pages are stored as PHOTOMETRIC_MINISWHITE.
+     */
+    void packLine(int y, uint8_t* dst) const
+    {
+        if (m_bpp == 1)
+        {
+            memset(dst, 0, (m_width + 7) / 8);
+            for (int x = 0; x < m_width; ++x)
+            {
+                if (!m_samples[size_t(y) * m_width + x])
+                {
+                    dst[x >> 3] |= static_cast<uint8_t>(0x80 >> (x & 7));
+                }
+            }
+        }
+        else
+        {
+            size_t const line_size = size_t(m_width) * (m_bpp / 8);
+            memcpy(dst, &m_samples[line_size * y], line_size);
+        }
+    }
+
+    /**
+     * The average of each \p factor x \p factor block, rounded to nearest.
+     * Blocks at the right and bottom edges may be incomplete.
+     */
+    QRgb blockAverage(int dst_x, int dst_y, int factor) const
+    {
+        int const x1 = std::min(m_width, (dst_x + 1) * factor);
+        int const y1 = std::min(m_height, (dst_y + 1) * factor);
+        unsigned r = 0, g = 0, b = 0, count = 0;
+        for (int y = dst_y * factor; y < y1; ++y)
+        {
+            for (int x = dst_x * factor; x < x1; ++x)
+            {
+                QRgb const rgb = pixel(x, y);
+                r += qRed(rgb);
+                g += qGreen(rgb);
+                b += qBlue(rgb);
+                ++count;
+            }
+        }
+        return qRgb((r + count / 2) / count, (g + count / 2) / count, (b + count / 2) / count);
+    }
+private:
+    int m_width;
+    int m_height;
+    int m_bpp;
+    std::vector<uint8_t> m_samples;
+};
+
+bool writeTiff(QString const& path, TestPage const& page, Layout const layout)
+{
+    TIFF* tif = TIFFOpen(QFile::encodeName(path).constData(), "w");
+    if (!tif)
+    {
+        return false;
+    }
+
+    uint16_t const samples_per_pixel = page.bpp() == 24 ? 3 : 1;
+    uint16_t const photometric = page.bpp() == 1 ? PHOTOMETRIC_MINISWHITE
+                                 : page.bpp() == 8 ? PHOTOMETRIC_MINISBLACK : PHOTOMETRIC_RGB;
+    TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, uint32_t(page.width()));
+    TIFFSetField(tif, TIFFTAG_IMAGELENGTH, uint32_t(page.height()));
+    TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, uint16_t(page.bpp() / samples_per_pixel));
+    TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, samples_per_pixel);
+    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, photometric);
+    TIFFSetField(tif, TIFFTAG_PLANARCONFIG, uint16_t(PLANARCONFIG_CONTIG));
+    TIFFSetField(tif, TIFFTAG_COMPRESSION, uint16_t(COMPRESSION_LZW));
+
+    std::vector<uint8_t> line((page.width() * page.bpp() + 7) / 8 + 1);
+    bool ok = true;
+
+    if (layout == STRIPS)
+    {
+        // Several lines per strip, with a shorter strip at the bottom.
+        TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, uint32_t(5));
+        for (int y = 0; y < page.height() && ok; ++y)
+        {
+            page.packLine(y, &line[0]);
+            ok = TIFFWriteScanline(tif, &line[0], y, 0) >= 0;
+        }
+    }
+    else
+    {
+        // Tiles stick out of the image at the right and at the bottom.
+        int const tile_size = 16;
+        TIFFSetField(tif, TIFFTAG_TILEWIDTH, uint32_t(tile_size));
+        TIFFSetField(tif, TIFFTAG_TILELENGTH, uint32_t(tile_size));
+
+        size_t const line_size = line.size() - 1;
+        size_t const tile_row_size = size_t(TIFFTileRowSize(tif));
+        std::vector<uint8_t> tile(TIFFTileSize(tif));
+        for (int ty = 0; ty < page.height() && ok; ty += tile_size)
+        {
+            for (int tx = 0; tx < page.width() && ok; tx += tile_size)
+            {
+                std::fill(tile.begin(), tile.end(), 0);
+                size_t const offset = size_t(tx) * page.bpp() / 8;
+                size_t const bytes = std::min(tile_row_size, line_size - offset);
+                for (int y = ty; y < std::min(ty + tile_size, page.height()); ++y)
+                {
+                    page.packLine(y, &line[0]);
+                    memcpy(&tile[tile_row_size * (y - ty)], &line[offset], bytes);
+                }
+                ok = TIFFWriteTile(tif, &tile[0], tx, ty, 0, 0) >= 0;
+            }
+        }
+    }
+
+    TIFFClose(tif);
+    return ok;
+}
+
+bool checkFullImage(QImage const& image, TestPage const& page)
+{
+    QImage::Format const expected_format = page.bpp() == 1 ? QImage::Format_Mono
+                                           : page.bpp() == 8 ? QImage::Format_Indexed8 : QImage::Format_RGB32;
+    if (image.format() != expected_format || image.size() != QSize(page.width(), page.height()))
+    {
+        return false;
+    }
+
+    for (int y = 0; y < page.height(); ++y)
+    {
+        for (int x = 0; x < page.width(); ++x)
+        {
+            if ((image.pixel(x, y) & 0x00FFFFFF) != (page.pixel(x, y) & 0x00FFFFFF))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool checkDownscaledImage(QImage const& image, TestPage const& page, int const factor)
+{
+    // Averaging turns bilevel images into grayscale.
+    QImage::Format const expected_format = page.bpp() == 24
+                                           ? QImage::Format_RGB32 : QImage::Format_Indexed8;
+    QSize const expected_size(
+        (page.width() + factor - 1) / factor, (page.height() + factor - 1) / factor
+    );
+    if (image.format() != expected_format || image.size() != expected_size)
+    {
+        return false;
+    }
+
+    for (int y = 0; y < expected_size.height(); ++y)
+    {
+        for (int x = 0; x < expected_size.width(); ++x)
+        {
+            if ((image.pixel(x, y) & 0x00FFFFFF) != (page.blockAverage(x, y, factor) & 0x00FFFFFF))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Writes a page whose dimensions are neither multiples of the tile
+ * size nor of the downscale factors, and reads it back in full and
+ * downscaled by 2, 3 and 5.
+ */
+bool roundTrip(Layout const layout, int const bpp)
+{
+    TestPage const page(101, 67, bpp);
+
+    QTemporaryFile file;
+    if (!file.open())
+    {
+        return false;
+    }
+    file.close();
+    if (!writeTiff(file.fileName(), page, layout))
+    {
+        return false;
+    }
+
+    QFile in(file.fileName());
+    if (!in.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    if (!checkFullImage(TiffReader::readImage(in), page))
+    {
+        return false;
+    }
+
+    static int const factors[] = { 2, 3, 5 };
+    for (int i = 0; i < 3; ++i)
+    {
+        int const factor = factors[i];
+        QSize const target_size(page.width() / factor, page.height() / factor);
+        in.seek(0);
+        QImage const image(TiffReader::readDownscaledImage(in, 0, target_size));
+        if (!checkDownscaledImage(image, page, factor))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(TiffReaderTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_bilevel_strips)
+{
+    BOOST_CHECK(roundTrip(STRIPS, 1));
+}
+
+BOOST_AUTO_TEST_CASE(test_bilevel_tiles)
+{
+    BOOST_CHECK(roundTrip(TILES, 1));
+}
+
+BOOST_AUTO_TEST_CASE(test_gray_strips)
+{
+    BOOST_CHECK(roundTrip(STRIPS, 8));
+}
+
+BOOST_AUTO_TEST_CASE(test_gray_tiles)
+{
+    BOOST_CHECK(roundTrip(TILES, 8));
+}
+
+BOOST_AUTO_TEST_CASE(test_rgb_strips)
+{
+    BOOST_CHECK(roundTrip(STRIPS, 24));
+}
+
+BOOST_AUTO_TEST_CASE(test_rgb_tiles)
+{
+    BOOST_CHECK(roundTrip(TILES, 24));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
@@ -0,0 +1,198 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "TiffWriter.h"
+#include "TiffReader.h"
+#include "TiffCompression.h"
+#include <QImage>
+#include <QBuffer>
+#include <QIODevice>
+#include <QColor>
+#include <QVector>
+#include <boost/test/unit_test.hpp>
+#include <stdint.h>
+#include <stdlib.h>
+
+namespace Tests
+{
+
+namespace
+{
+
+/**
+ * Random pixels in an image taller than a single strip,
+ * with a width that's not a multiple of 8.
+ */
+QImage randomImage(QImage::Format const format, unsigned const seed)
+{
+    srand(seed);
+    bool const bilevel = format == QImage::Format_Mono || format == QImage::Format_MonoLSB;
+    QImage image(bilevel ? 4099 : 1001, bilevel ? 700 : 300, format);
+
+    int const bytes = image.bytesPerLine() * image.height();
+    uint8_t* data = image.bits();
+    for (int i = 0; i < bytes; ++i)
+    {
+        data[i] = static_cast<uint8_t>(rand());
+    }
+    if (format == QImage::Format_ARGB32)
+    {
+        // Semi-transparent pixels would depend on premultiplication.
+        for (int y = 0; y < image.height(); ++y)
+        {
+            QRgb* line = (QRgb*)image.scanLine(y);
+            for (int x = 0; x < image.width(); ++x)
+            {
+                line[x] |= 0xFF000000;
+            }
+        }
+    }
+
+    return image;
+}
+
+QImage grayImage()
+{
+    QImage image(randomImage(QImage::Format_Indexed8, 3));
+    QVector<QRgb> color_table(256);
+    for (int i = 0; i < 256; ++i)
+    {
+        color_table[i] = qRgb(i, i, i);
+    }
+    image.setColorTable(color_table);
+    return image;
+}
+
+QImage paletteImage()
+{
+    QImage image(randomImage(QImage::Format_Indexed8, 4));
+    QVector<QRgb> color_table(256);
+    for (int i = 0; i < 256; ++i)
+    {
+        color_table[i] = qRgb(rand() & 0xFF, rand() & 0xFF, rand() & 0xFF);
+    }
+    image.setColorTable(color_table);
+    return image;
+}
+
+QImage bilevelImage(QImage::Format const format, QRgb const color0, QRgb const color1)
+{
+    QImage image(randomImage(format, 5));
+    QVector<QRgb> color_table(2);
+    color_table[0] = color0;
+    color_table[1] = color1;
+    image.setColorTable(color_table);
+    return image;
+}
+
+bool sameColors(QImage const& image1, QImage const& image2)
+{
+    if (image1.size() != image2.size())
+    {
+        return false;
+    }
+
+    for (int y = 0; y < image1.height(); ++y)
+    {
+        for (int x = 0; x < image1.width(); ++x)
+        {
+            if (image1.pixel(x, y) != image2.pixel(x, y))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Writes the image with every codec, reads it back and checks
+ * the format and the pixels.
+ */
+bool roundTrip(QImage const& image, QImage::Format const expected_format)
+{
+    static TiffCompression::Codec const codecs[] = {
+        TiffCompression::NONE, TiffCompression::LZW, TiffCompression::DEFLATE,
+        TiffCompression::ZSTD, TiffCompression::PACKBITS
+    };
+    for (TiffCompression::Codec const codec : codecs)
+    {
+        QBuffer buffer;
+        buffer.open(QIODevice::ReadWrite);
+        if (!TiffWriter::writeImage(buffer, image, TiffCompression(codec)))
+        {
+            return false;
+        }
+
+        // Libtiff closes the device when it's done with it.
+        buffer.open(QIODevice::ReadOnly);
+        QImage const read_back(TiffReader::readImage(buffer));
+        if (read_back.format() != expected_format || !sameColors(image, read_back))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(TiffWriterTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_bilevel_white_is_zero)
+{
+    QImage const image(bilevelImage(QImage::Format_Mono, 0xffffffff, 0xff000000));
+    BOOST_CHECK(roundTrip(image, QImage::Format_Mono));
+}
+
+BOOST_AUTO_TEST_CASE(test_bilevel_black_is_zero)
+{
+    QImage const image(bilevelImage(QImage::Format_Mono, 0xff000000, 0xffffffff));
+    BOOST_CHECK(roundTrip(image, QImage::Format_Mono));
+}
+
+BOOST_AUTO_TEST_CASE(test_bilevel_lsb_first)
+{
+    QImage const image(bilevelImage(QImage::Format_MonoLSB, 0xffffffff, 0xff000000));
+    BOOST_CHECK(roundTrip(image, QImage::Format_Mono));
+}
+
+BOOST_AUTO_TEST_CASE(test_gray)
+{
+    BOOST_CHECK(roundTrip(grayImage(), QImage::Format_Indexed8));
+}
+
+BOOST_AUTO_TEST_CASE(test_palette)
+{
+    BOOST_CHECK(roundTrip(paletteImage(), QImage::Format_Indexed8));
+}
+
+BOOST_AUTO_TEST_CASE(test_rgb)
+{
+    BOOST_CHECK(roundTrip(randomImage(QImage::Format_RGB32, 1), QImage::Format_RGB32));
+}
+
+BOOST_AUTO_TEST_CASE(test_argb)
+{
+    BOOST_CHECK(roundTrip(randomImage(QImage::Format_ARGB32, 2), QImage::Format_ARGB32));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests